@@ -26,9 +26,10 @@
 #define ADDRESSSPACE_H
 
 #include "CallframeMapper.h"
+#include "MappingTable.h"
 #include "ProfilerTypes.h"
+#include "SharedPtr.h"
 
-#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -39,8 +40,9 @@
 class Callframe;
 class Image;
 class ImageFactory;
+class ModulePathIndex;
 class ProcessExec;
-class SharedString;
+class Sample;
 
 class AddressSpace : public CallframeMapper
 {
@@ -48,23 +50,63 @@ private:
 	struct LoadedImage
 	{
 		Image *image;
+		TargetAddr start;
+
+		/*
+		 * Only worked out once an address in the image is sampled, as
+		 * it needs the image's ELF headers.
+		 */
 		TargetAddr loadOffset;
+		bool isExecutable;
+		bool resolved;
 
-		LoadedImage(Image *i, TargetAddr off)
-		  : image(i), loadOffset(off)
+		LoadedImage(Image *i, TargetAddr s, bool exe)
+		  : image(i), start(s), loadOffset(0), isExecutable(exe),
+		    resolved(false)
 		{
 		}
 	};
 
-	typedef std::map<TargetAddr, LoadedImage> LoadableImageMap;
+	typedef MappingTable<TargetAddr, LoadedImage> LoadableImageMap;
 
 	ImageFactory &imgFactory;
-	LoadableImageMap loadableImageMap;
+
+	/*
+	 * Shared with the processes forked from this one, or the one that
+	 * this was forked from, until one of them maps something in.
+	 */
+	SharedPtr<LoadableImageMap> loadableImageMap;
 	Image *executable;
 
-	static TargetAddr getLoadAddr(const std::string &executable);
+	/*
+	 * An executable that was exec()d is mapped at its link address, which
+	 * is only read from its headers once an address in the space is
+	 * looked up.  Until then it isn't in the table.
+	 */
+	Image *pendingExec;
+
+	struct UnmappedRange
+	{
+		TargetAddr start;
+		TargetAddr end;
+	};
+
+	/*
+	 * The addresses that stopped mapping to an image each time one was
+	 * mapped out, oldest first.  The epoch is the number of them, plus
+	 * the epochBase that were mapped out before this space was forked.
+	 */
+	std::vector<UnmappedRange> unmapped;
+	uint64_t epochBase;
 
-	Image &getImage(TargetAddr addr, TargetAddr & loadOffset) const;
+	LoadableImageMap &writableImageMap();
+	void mapPendingExec();
+
+	static void readLoadInfo(Image &image);
+	static TargetAddr getLoadAddr(Image &image);
+	static bool isPie(Image &image);
+
+	Image &getImage(TargetAddr addr, TargetAddr & loadOffset);
 	void mapImage(TargetAddr addr, Image *image);
 
 public:
@@ -74,14 +116,23 @@ public:
 	AddressSpace(const AddressSpace&) = delete;
 	AddressSpace& operator=(const AddressSpace &) = delete;
 
+	void forkFrom(const AddressSpace &parent);
 	void mapIn(TargetAddr start, SharedString imagePath);
-	void findAndMap(TargetAddr start, const std::vector<std::string> path,
+	void mapOut(TargetAddr start, TargetAddr end);
+	void findAndMap(TargetAddr start, ModulePathIndex & modules,
 	    SharedString name);
 
 	const Callframe & mapFrame(TargetAddr addr);
 	void processExec(const ProcessExec& ev);
 
 	SharedString getExecutableName() const;
+
+	uint64_t getEpoch() const override
+	{
+		return (epochBase + unmapped.size());
+	}
+
+	bool isStale(const Sample &, uint64_t epoch) const override;
 };
 
 #endif
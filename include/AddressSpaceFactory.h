@@ -36,6 +36,10 @@ public:
 	virtual AddressSpace &GetKernelAddressSpace() = 0;
 	virtual AddressSpace &GetProcessAddressSpace(pid_t) = 0;
 	virtual AddressSpace &ReplaceAddressSpace(pid_t pid) = 0;
+
+	// The child gets a new address space with the parent's mappings.
+	virtual AddressSpace &ForkAddressSpace(pid_t parent, pid_t child) = 0;
+	virtual void ReleaseAddressSpace(pid_t pid) = 0;
 };
 
 #endif
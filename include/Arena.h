@@ -0,0 +1,108 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(ARENA_H)
+#define ARENA_H
+
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+/*
+ * Deletes an object that may live in an Arena.  An arena object is only
+ * destroyed; its memory goes back when the whole Arena is freed.  A
+ * std::unique_ptr from std::make_unique converts into an ArenaPtr, and is
+ * deleted as usual.
+ */
+template <typename T>
+class ArenaDelete
+{
+	bool inArena;
+
+public:
+	ArenaDelete()
+	  : inArena(false)
+	{
+	}
+
+	explicit ArenaDelete(bool arena)
+	  : inArena(arena)
+	{
+	}
+
+	template <typename U>
+	ArenaDelete(const std::default_delete<U> &)
+	  : inArena(false)
+	{
+	}
+
+	void operator()(T *obj) const
+	{
+		if (inArena)
+			obj->~T();
+		else
+			delete obj;
+	}
+};
+
+template <typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDelete<T>>;
+
+/*
+ * Bump allocation for the many small, long-lived objects of a profile
+ * (Callframes, Callchains and the map nodes that index them).  Memory is
+ * never reused, and is released in one step when the Arena is destroyed,
+ * which must happen after every object in it has been destroyed.  The Arena
+ * isn't thread-safe.
+ */
+class Arena
+{
+	static const size_t INITIAL_SIZE = 64 * 1024;
+
+	std::pmr::monotonic_buffer_resource resource;
+
+public:
+	Arena()
+	  : resource(INITIAL_SIZE)
+	{
+	}
+
+	Arena(const Arena &) = delete;
+	Arena & operator=(const Arena &) = delete;
+
+	std::pmr::memory_resource * getResource()
+	{
+		return &resource;
+	}
+
+	template <typename T, typename... Args>
+	ArenaPtr<T> make(Args &&... args)
+	{
+		void *mem = resource.allocate(sizeof(T), alignof(T));
+
+		return ArenaPtr<T>(new (mem) T(std::forward<Args>(args)...),
+		    ArenaDelete<T>(true));
+	}
+};
+
+#endif // #if !defined(ARENA_H)
@@ -26,10 +26,12 @@
 
 #include <vector>
 
+#include "Callframe.h"
 #include "ProfilerTypes.h"
 #include "InlineFrame.h"
+#include "SharedString.h"
 
-class Callframe;
+class CallchainTrie;
 class CallframeMapper;
 class Sample;
 
@@ -47,30 +49,56 @@ public:
 		}
 
 		friend class Callchain;
+		friend class CallchainTrie;
+
+	public:
+		TargetAddr getAddress() const
+		{
+			return addr;
+		}
+
+		const Callframe & getFrame() const
+		{
+			return frame;
+		}
 	};
 
 	typedef std::vector<CallchainRecord> RecordChain;
 
 private:
-	const CallframeMapper &space;
+	SharedString executable;
+
+	/*
+	 * A callchain either owns its frames, or is a node of a trie that
+	 * shares them with other chains of the same aggregation.
+	 */
 	RecordChain callframes;
-	std::unique_ptr<InlineFrame> selfFrame;
+	CallchainTrie *trie;
+	uint32_t trieNode;
+
 	size_t sampleCount;
 	bool kernel;
 
+	const Callframe & getLeafCallframe() const;
+
 public:
-	Callchain(CallframeMapper &, const Sample &);
+	Callchain(CallframeMapper &, const Sample &, CallchainTrie * = nullptr);
 
 	Callchain(const Callchain&) = delete;
 	Callchain& operator=(const Callchain &) = delete;
 
 	Callchain(Callchain&& other) noexcept = default;
 
-	void addSample();
+	void addSample(size_t count = 1);
 
-	const CallframeMapper & getMapper() const
+	/*
+	 * The executable of the address space that the callchain was mapped
+	 * with.  The address space itself may be gone by the time that the
+	 * profile is printed.
+	 */
+	const SharedString & getExecutableName() const
 	{
-		return space;
+		return executable;
 	}
 
 	size_t getSampleCount() const
@@ -78,20 +106,37 @@ public:
 		return sampleCount;
 	}
 
-	TargetAddr getAddress() const
-	{
-		return callframes.front().addr;
-	}
+	TargetAddr getAddress() const;
 
 	bool isKernel() const
 	{
 		return kernel;
 	}
 
-	const InlineFrame * getSelfFrame(const InlineFrame &);
+	/* Leaf first.  Chains stored in a trie build a copy. */
+	RecordChain getRecords() const;
+
+	const CallchainTrie * getTrie() const
+	{
+		return trie;
+	}
+
+	uint32_t getTrieNode() const
+	{
+		return trieNode;
+	}
 
 	bool isMapped() const;
 
+	/*
+	 * Whether the address space maps every address of the chain to the
+	 * frame that the chain already has for it.
+	 */
+	bool isMappedBy(CallframeMapper &) const;
+
+	/* Whether the chain was made from the sample's addresses. */
+	bool matches(const Sample &) const;
+
 	const InlineFrame & getLeafFrame() const;
 
 	void flatten(std::vector<const InlineFrame*> &) const;
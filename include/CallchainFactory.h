@@ -24,16 +24,21 @@
 #ifndef CALLCHAIN_FACTORY_H
 #define CALLCHAIN_FACTORY_H
 
-#include <memory>
+#include "Arena.h"
 
 class Callchain;
+class CallchainTrie;
 class CallframeMapper;
 class Sample;
 
+typedef ArenaPtr<Callchain> CallchainPtr;
+
 class CallchainFactory
 {
 public:
-	virtual std::unique_ptr<Callchain> MakeCallchain(CallframeMapper &space, const Sample & sample) = 0;
+	/* trie is null unless the chain should be stored in it. */
+	virtual CallchainPtr MakeCallchain(CallframeMapper &space,
+	    const Sample & sample, CallchainTrie *trie) = 0;
 };
 
 #endif
@@ -0,0 +1,139 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(CALLCHAINSTORE_H)
+#define CALLCHAINSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Sample;
+
+typedef uint32_t ChainId;
+
+static const ChainId NO_CHAIN = UINT32_MAX;
+
+/*
+ * What an aggregation names its chains by: a ChainId, or in an aggregation
+ * that doesn't intern its chains, the chain's hash.
+ */
+typedef uint64_t ChainKey;
+
+/*
+ * Interns callchains.  Every distinct chain of PCs is stored once and is
+ * named by a 32-bit ChainId.  Lookups go through an open-addressed table of
+ * ids that keeps each chain's full hash, so a probe only compares addresses
+ * when the hashes match.
+ *
+ * The pid is not part of a chain, so identical chains from different
+ * processes running the same binary share an id.
+ *
+ * The store is split into shards by hash, each with its own lock, so that
+ * the threads decoding a samples file can intern their chains at the same
+ * time.  A chain's addresses never move once it is interned.
+ */
+class CallchainStore
+{
+	struct Entry
+	{
+		uint64_t hash;
+		const uintptr_t *pcs;
+		uint32_t depth;
+		bool kernel;
+	};
+
+	struct Shard
+	{
+		mutable std::mutex lock;
+		std::vector<Entry> entries;
+
+		/* Index + 1 of the chain in each slot, or EMPTY. */
+		std::vector<uint32_t> slots;
+		size_t mask;
+
+		/* The addresses of the chains, in blocks that never move. */
+		std::vector<std::unique_ptr<uintptr_t[]>> blocks;
+		size_t blockUsed;
+		size_t blockSize;
+
+		Shard();
+
+		const uintptr_t * copyPCs(const uintptr_t *, size_t);
+		void grow();
+	};
+
+	static const int SHARD_BITS = 4;
+	static const size_t NUM_SHARDS = 1 << SHARD_BITS;
+	static const size_t INITIAL_SLOTS = 64;
+	static const size_t BLOCK_PCS = 16384;
+	static const uint32_t EMPTY = 0;
+
+	Shard shards[NUM_SHARDS];
+
+	static uint64_t Hash(const Sample &);
+	static bool Matches(const Entry &, uint64_t hash, const Sample &);
+
+	static size_t ShardOf(uint64_t hash)
+	{
+		return (hash >> (64 - SHARD_BITS));
+	}
+
+	/* A ChainId is the index of the chain in its shard and the shard. */
+	Entry getEntry(ChainId id) const;
+
+public:
+	CallchainStore() = default;
+
+	CallchainStore(const CallchainStore&) = delete;
+	CallchainStore& operator=(const CallchainStore &) = delete;
+
+	/* May be called by several threads at once. */
+	ChainId intern(const Sample &);
+
+	size_t size() const;
+
+	uint32_t getDepth(ChainId id) const
+	{
+		return getEntry(id).depth;
+	}
+
+	bool isKernel(ChainId id) const
+	{
+		return getEntry(id).kernel;
+	}
+
+	const uintptr_t * getPCs(ChainId id) const
+	{
+		return getEntry(id).pcs;
+	}
+
+	/* A Sample that refers to the interned chain. */
+	Sample getSample(pid_t pid, ChainId id) const;
+};
+
+#endif // #if !defined(CALLCHAINSTORE_H)
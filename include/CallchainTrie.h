@@ -0,0 +1,165 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(CALLCHAINTRIE_H)
+#define CALLCHAINTRIE_H
+
+#include "Callchain.h"
+#include "FlatHashMap.h"
+#include "ProfilerTypes.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+class Callframe;
+class CallframeMapper;
+class Sample;
+
+/*
+ * A prefix tree of the callchains of one address space, keyed from the root
+ * of the stack to the leaf.  Chains that share their outermost frames (main,
+ * the event loop, the dispatcher...) share those nodes, so a chain costs one
+ * node per frame that isn't shared with some earlier chain.  Each node counts
+ * the samples whose leaf it is, which makes the trie a ready-made call tree.
+ *
+ * Most nodes have a single child, so a child is found by walking its parent's
+ * sibling list.  Only the children of nodes wider than INDEX_FANOUT go into a
+ * hash table, which keeps the lookup table a small fraction of the trie.
+ */
+class CallchainTrie
+{
+public:
+	typedef uint32_t NodeId;
+
+	/* The root has no frame; its children are the outermost frames. */
+	static const NodeId ROOT = 0;
+	static const NodeId NONE = UINT32_MAX;
+
+private:
+	struct Node
+	{
+		TargetAddr addr;
+		const Callframe *frame;
+		NodeId parent;
+		NodeId firstChild;
+		NodeId nextSibling;
+		uint16_t depth;
+		/* Saturates once the children are indexed. */
+		uint16_t fanout;
+		size_t count;
+	};
+
+	static const uint16_t INDEX_FANOUT = 8;
+
+	struct ChildKey
+	{
+		NodeId parent;
+		TargetAddr addr;
+
+		bool operator==(const ChildKey & other) const
+		{
+			return parent == other.parent && addr == other.addr;
+		}
+	};
+
+	struct ChildHash
+	{
+		size_t operator()(const ChildKey & key) const
+		{
+			return std::hash<TargetAddr>()(key.addr) * 31 + key.parent;
+		}
+	};
+
+	std::vector<Node> nodes;
+	FlatHashMap<ChildKey, NodeId, ChildHash> children;
+
+	NodeId findChild(NodeId parent, TargetAddr) const;
+	void indexChild(NodeId parent, NodeId child);
+	NodeId getChild(CallframeMapper &, NodeId parent, TargetAddr);
+
+public:
+	CallchainTrie();
+
+	CallchainTrie(const CallchainTrie&) = delete;
+	CallchainTrie& operator=(const CallchainTrie &) = delete;
+
+	/* Returns the node of the sample's leaf frame. */
+	NodeId insert(CallframeMapper &, const Sample &);
+
+	/*
+	 * Drops the lookup table once chains are no longer expected.  Any that
+	 * are inserted later are still found, only more slowly.
+	 */
+	void finalize();
+
+	void addSample(NodeId id, size_t count)
+	{
+		nodes.at(id).count += count;
+	}
+
+	/* Fills in the chain ending at the node, leaf first. */
+	void getRecords(NodeId, Callchain::RecordChain &) const;
+
+	size_t size() const
+	{
+		return nodes.size();
+	}
+
+	TargetAddr getAddress(NodeId id) const
+	{
+		return nodes.at(id).addr;
+	}
+
+	const Callframe & getFrame(NodeId id) const
+	{
+		return *nodes.at(id).frame;
+	}
+
+	uint32_t getDepth(NodeId id) const
+	{
+		return nodes.at(id).depth;
+	}
+
+	size_t getSampleCount(NodeId id) const
+	{
+		return nodes.at(id).count;
+	}
+
+	NodeId getParent(NodeId id) const
+	{
+		return nodes.at(id).parent;
+	}
+
+	NodeId getFirstChild(NodeId id) const
+	{
+		return nodes.at(id).firstChild;
+	}
+
+	NodeId getNextSibling(NodeId id) const
+	{
+		return nodes.at(id).nextSibling;
+	}
+};
+
+#endif // #if !defined(CALLCHAINTRIE_H)
@@ -44,7 +44,7 @@ public:
 	Callframe(const Callframe&) = delete;
 	Callframe& operator=(const Callframe &) = delete;
 
-	Callframe(Callframe &&) noexcept = default;
+	Callframe(Callframe &&) noexcept;
 
 	void addFrame(SharedString file, SharedString func,
 	    SharedString demangled, int codeLine, int funcLine,
@@ -56,6 +56,11 @@ public:
 		return offset;
 	}
 
+	const SharedString & getImageName() const
+	{
+		return imageName;
+	}
+
 	const std::vector<InlineFrame> & getInlineFrames() const
 	{
 		return inlineFrames;
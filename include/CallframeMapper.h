@@ -27,13 +27,34 @@
 #include "ProfilerTypes.h"
 
 class Callframe;
-class SharedString;
+class Sample;
 
 class CallframeMapper
 {
 public:
+	virtual ~CallframeMapper() = default;
+
 	virtual const Callframe & mapFrame(TargetAddr addr) = 0;
 	virtual SharedString getExecutableName() const = 0;
+
+	/*
+	 * Changes whenever an address may have stopped mapping to the frame
+	 * that it used to.  A callchain mapped in an earlier epoch has to be
+	 * checked with isStale().
+	 */
+	virtual uint64_t getEpoch() const
+	{
+		return (0);
+	}
+
+	/*
+	 * Whether any of the sample's addresses was in a range that has been
+	 * mapped out since epoch.
+	 */
+	virtual bool isStale(const Sample &, uint64_t epoch) const
+	{
+		return (false);
+	}
 };
 
 #endif
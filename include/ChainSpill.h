@@ -0,0 +1,138 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(CHAINSPILL_H)
+#define CHAINSPILL_H
+
+#include "CallchainStore.h"
+#include "CallframeMapper.h"
+#include "FlatHashMap.h"
+#include "ProfilerTypes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+class Callchain;
+class Callframe;
+class Sample;
+
+/*
+ * Writes an aggregation's callchains to temporary files as runs of
+ * (ChainKey, count, frames) sorted by id, and merges the runs back.  The
+ * frames of a chain are saved as indices into a table of the Callframes
+ * seen so far.  The Callframes stay in memory: there is one per distinct
+ * address, where there is a Callchain for every distinct chain.
+ */
+class ChainSpill
+{
+public:
+	struct SpilledChain
+	{
+		ChainKey id;
+		const Callchain *chain;
+
+		bool operator<(const SpilledChain & other) const
+		{
+			return (id < other.id);
+		}
+	};
+
+	typedef std::vector<SpilledChain> ChainList;
+
+	/*
+	 * Called once per spilled chain, in order of id, with its counts from
+	 * every run summed.  Runs of a chain whose frames changed when an
+	 * image was mapped out are passed separately, once per set of frames.
+	 * The chain is rebuilt by passing space and sample to a
+	 * CallchainFactory.
+	 */
+	typedef std::function<void(ChainKey, size_t count,
+	    CallframeMapper & space, const Sample &)> MergeFunc;
+
+private:
+	struct Frame
+	{
+		TargetAddr addr;
+		const Callframe *frame;
+	};
+
+	class Run;
+	class ReplayMapper;
+
+	pid_t pid;
+	std::vector<Frame> frames;
+	FlatHashMap<const Callframe *, uint32_t> frameIds;
+	std::vector<SharedString> executables;
+	FlatHashMap<SharedString, uint32_t> executableIds;
+	std::vector<FILE *> runs;
+	size_t spilledBytes;
+	size_t spilledChains;
+
+	uint32_t getFrameId(TargetAddr, const Callframe &);
+	uint32_t getExecutableId(const SharedString &);
+
+public:
+	explicit ChainSpill(pid_t pid);
+	~ChainSpill();
+
+	ChainSpill(const ChainSpill &) = delete;
+	ChainSpill & operator=(const ChainSpill &) = delete;
+
+	/* chains must be sorted by id. */
+	void writeRun(const ChainList & chains);
+
+	/*
+	 * Streams the merge of every run into func.  The runs stay on disk,
+	 * so they can be merged again.
+	 */
+	void merge(const MergeFunc & func) const;
+
+	bool empty() const
+	{
+		return runs.empty();
+	}
+
+	size_t getNumRuns() const
+	{
+		return runs.size();
+	}
+
+	size_t getSpilledBytes() const
+	{
+		return spilledBytes;
+	}
+
+	/* Counts a chain once for every run that it is in. */
+	size_t getSpilledChains() const
+	{
+		return spilledChains;
+	}
+};
+
+#endif // #if !defined(CHAINSPILL_H)
@@ -26,8 +26,8 @@
 
 #include "AddressSpaceFactory.h"
 #include "AddressSpace.h"
+#include "FlatHashMap.h"
 
-#include <unordered_map>
 #include <vector>
 
 class ImageFactory;
@@ -35,12 +35,10 @@ class ImageFactory;
 class DefaultAddressSpaceFactory : public AddressSpaceFactory
 {
 private:
-	typedef std::unordered_map<pid_t, AddressSpace*> AddressSpaceMap;
-	typedef std::vector<std::unique_ptr<AddressSpace> > AddressSpaceList;
+	typedef FlatHashMap<pid_t, std::unique_ptr<AddressSpace> > AddressSpaceMap;
 
 	ImageFactory &imgFactory;
 	AddressSpaceMap addressSpaceMap;
-	AddressSpaceList addressSpaceList;
 
 	AddressSpace kernelAddressSpace;
 
@@ -50,6 +48,8 @@ public:
 	virtual AddressSpace &GetKernelAddressSpace();
 	virtual AddressSpace &GetProcessAddressSpace(pid_t);
 	virtual AddressSpace &ReplaceAddressSpace(pid_t pid);
+	virtual AddressSpace &ForkAddressSpace(pid_t parent, pid_t child);
+	virtual void ReleaseAddressSpace(pid_t pid);
 };
 
 #endif
\ No newline at end of file
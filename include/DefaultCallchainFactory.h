@@ -28,8 +28,23 @@
 
 class DefaultCallchainFactory : public CallchainFactory
 {
+	/*
+	 * Holds every Callchain that the factory makes, so it must outlive
+	 * the aggregations that own them.  Not used if the aggregations free
+	 * chains as they go (see SampleAggregation's bounded mode), as the
+	 * arena would never reuse their memory.
+	 */
+	Arena arena;
+	bool useArena;
+
 public:
-	std::unique_ptr<Callchain> MakeCallchain(CallframeMapper & space, const Sample & sample) override;
+	DefaultCallchainFactory(bool useArena = true)
+	  : useArena(useArena)
+	{
+	}
+
+	CallchainPtr MakeCallchain(CallframeMapper & space,
+	    const Sample & sample, CallchainTrie *trie) override;
 };
 
 #endif
@@ -24,6 +24,7 @@
 #ifndef DEFAULT_IMAGE_FACTORY_H
 #define DEFAULT_IMAGE_FACTORY_H
 
+#include "Arena.h"
 #include "ImageFactory.h"
 #include "SharedString.h"
 
@@ -35,6 +36,8 @@ class DefaultImageFactory : public ImageFactory
 private:
 	typedef std::unordered_map<SharedString, std::unique_ptr<Image>> ImageMap;
 
+	/* Holds the images' Callframes, so it must be destroyed last. */
+	Arena arena;
 	ImageMap imageMap;
 	std::unique_ptr<Image> unmappedImage;
 
@@ -45,7 +48,7 @@ public:
 
 	virtual Image *GetImage(SharedString name);
 	virtual Image &GetUnmappedImage();
-	virtual void MapAll();
+	virtual void MapAll(bool more = false);
 };
 
 #endif
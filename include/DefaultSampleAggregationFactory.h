@@ -24,35 +24,74 @@
 #ifndef DEFAULT_SAMPLE_AGGREGATION_FACTORY
 #define DEFAULT_SAMPLE_AGGREGATION_FACTORY
 
+#include "CallchainStore.h"
+#include "FlatHashMap.h"
 #include "SampleAggregationFactory.h"
 
-#include <unordered_map>
+#include <memory>
+#include <string>
 #include <vector>
 
 class CallchainFactory;
+class SpillBudget;
 
 class DefaultSampleAggregationFactory : public SampleAggregationFactory
 {
 private:
 	typedef std::vector<std::unique_ptr<SampleAggregation>> AggregationOwnerList;
-	typedef std::unordered_map<pid_t, SampleAggregation*> AggregationMap;
+
+	/*
+	 * A live process.  The aggregation is only allocated once the first
+	 * sample arrives, so that processes that are never sampled cost no more
+	 * than this entry.  The entry of a process that has exited is kept,
+	 * with its finalized aggregation, until the pid is reused so that any
+	 * samples that still turn up for it are added to that aggregation.
+	 */
+	struct LiveProcess
+	{
+		std::string name;
+		SampleAggregation *agg = nullptr;
+		bool exited = false;
+	};
+	typedef FlatHashMap<pid_t, LiveProcess> AggregationMap;
 
 	AggregationOwnerList aggregationOwnerList;
 	AggregationMap aggregationMap;
 	CallchainFactory & ccFactory;
+	bool useTrie;
+	size_t maxChains;
+	SpillBudget *spillBudget;
+
+	/* Shared by all aggregations, so processes running the same code
+	 * share their chains' addresses. */
+	CallchainStore chainStore;
 
 	SampleAggregation &AddAggregation(pid_t, const std::string &);
 
 public:
 	// These need to be defined in the .cpp file to prevent consumers from
 	// needing to include SampleAggregation.h
-	DefaultSampleAggregationFactory(CallchainFactory &);
+	DefaultSampleAggregationFactory(CallchainFactory &, bool useTrie = false,
+	    size_t maxChains = 0, SpillBudget *spillBudget = nullptr);
 	~DefaultSampleAggregationFactory();
 
 	virtual SampleAggregation &GetAggregation(const Sample &);
 	virtual void GetAggregationList(AggregationList &);
 	virtual void HandleExec(const ProcessExec &);
 	virtual void HandleMapIn(pid_t pid, const char *path);
+	virtual void HandleFork(pid_t parent, pid_t child);
+	virtual void HandleExit(pid_t pid);
+
+	/*
+	 * Bounded and spilling aggregations key their chains on a hash, so
+	 * that the chains that they evict or spill are freed.
+	 */
+	virtual CallchainStore *GetCallchainStore()
+	{
+		if (maxChains != 0 || spillBudget != nullptr)
+			return nullptr;
+		return &chainStore;
+	}
 };
 
 #endif
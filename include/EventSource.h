@@ -0,0 +1,50 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(EVENTSOURCE_H)
+#define EVENTSOURCE_H
+
+class Profiler;
+
+/*
+ * A source of profiling events.  Feed() delivers every event in the source,
+ * in order, to Profiler::processEvent(), Profiler::processMapIn(),
+ * Profiler::processMapOut(), Profiler::processFork() and
+ * Profiler::processExit().
+ */
+class EventSource
+{
+public:
+	EventSource() = default;
+	virtual ~EventSource() = default;
+
+	EventSource(const EventSource&) = delete;
+	EventSource& operator=(const EventSource &) = delete;
+
+	/*
+	 * Returns false if the source could not be read in its entirety.
+	 */
+	virtual bool Feed(Profiler &) = 0;
+};
+
+#endif // #if !defined(EVENTSOURCE_H)
@@ -0,0 +1,366 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(FLATHASHMAP_H)
+#define FLATHASHMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/*
+ * An open-addressed hash table using Robin Hood linear probing.  Each slot
+ * holds its key, value and probe distance inline, so a lookup of a key that
+ * is in the table usually touches a single cache line, unlike the node-based
+ * std::unordered_map which always chases a pointer to the node.
+ *
+ * The interface is the subset of std::unordered_map that the profiler uses,
+ * with some differences:
+ *
+ *  - K and V must be default constructible and move assignable; empty slots
+ *    hold default-constructed entries.
+ *  - Inserting or erasing invalidates all iterators and references into the
+ *    table, as entries are moved around.  Values that must stay put (e.g.
+ *    the things returned by reference from a factory) should be held by
+ *    pointer.
+ *  - erase(iterator) does not return the next iterator.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class FlatHashMap
+{
+public:
+	typedef K key_type;
+	typedef V mapped_type;
+	typedef std::pair<K, V> value_type;
+
+private:
+	struct Slot
+	{
+		value_type kv;
+
+		/* Distance from the slot the key hashes to, plus 1.  0 if empty. */
+		uint32_t dist = 0;
+	};
+
+	static const size_t MIN_SLOTS = 16;
+
+	std::vector<Slot> slots;
+	size_t used = 0;
+	unsigned shift = 64;
+
+	/*
+	 * Fibonacci hashing takes the high bits of the product, so that keys
+	 * that are dense integers, like pids or ChainIds with the identity
+	 * std::hash, still spread over the whole table.
+	 */
+	size_t home(const K & key) const
+	{
+		uint64_t h = Hash()(key);
+
+		return ((h * 0x9e3779b97f4a7c15ULL) >> shift);
+	}
+
+	size_t next(size_t i) const
+	{
+		return ((i + 1) & (slots.size() - 1));
+	}
+
+	size_t lookup(const K & key) const
+	{
+		if (used == 0)
+			return (slots.size());
+
+		size_t i = home(key);
+		for (uint32_t dist = 1; dist <= slots[i].dist; ++dist) {
+			if (slots[i].dist == dist && slots[i].kv.first == key)
+				return (i);
+			i = next(i);
+		}
+
+		return (slots.size());
+	}
+
+	/* The key must not already be in the table, which must have room. */
+	size_t place(value_type && kv)
+	{
+		size_t i = home(kv.first);
+		uint32_t dist = 1;
+		size_t placed = slots.size();
+
+		for (;;) {
+			Slot & slot = slots[i];
+
+			if (slot.dist == 0) {
+				slot.kv = std::move(kv);
+				slot.dist = dist;
+				return (placed == slots.size() ? i : placed);
+			}
+
+			/* Take the slot from a richer entry and carry it on. */
+			if (slot.dist < dist) {
+				std::swap(slot.kv, kv);
+				std::swap(slot.dist, dist);
+				if (placed == slots.size())
+					placed = i;
+			}
+
+			i = next(i);
+			dist++;
+		}
+	}
+
+	void rehash(size_t n)
+	{
+		std::vector<Slot> old(n);
+		unsigned bits = 0;
+
+		while ((size_t(1) << bits) < n)
+			bits++;
+
+		old.swap(slots);
+		shift = 64 - bits;
+		for (auto & slot : old) {
+			if (slot.dist != 0)
+				place(std::move(slot.kv));
+		}
+	}
+
+	void reserveOne()
+	{
+		/* Keep the load factor at or below 7/8. */
+		if ((used + 1) * 8 > slots.size() * 7)
+			rehash(slots.empty() ? MIN_SLOTS : slots.size() * 2);
+	}
+
+	void eraseSlot(size_t i)
+	{
+		/* Shift the following entries back instead of leaving a tombstone. */
+		size_t n = next(i);
+		while (slots[n].dist > 1) {
+			slots[i].kv = std::move(slots[n].kv);
+			slots[i].dist = slots[n].dist - 1;
+			i = n;
+			n = next(n);
+		}
+
+		slots[i].kv = value_type();
+		slots[i].dist = 0;
+		used--;
+	}
+
+	template <typename Map, typename Value>
+	class Iterator
+	{
+		Map *map;
+		size_t i;
+
+		void skip()
+		{
+			while (i < map->slots.size() && map->slots[i].dist == 0)
+				i++;
+		}
+
+		friend class FlatHashMap;
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Value value_type;
+		typedef ptrdiff_t difference_type;
+		typedef Value *pointer;
+		typedef Value &reference;
+
+		Iterator(Map *m, size_t index)
+		  : map(m), i(index)
+		{
+			skip();
+		}
+
+		Value & operator*() const
+		{
+			return map->slots[i].kv;
+		}
+
+		Value * operator->() const
+		{
+			return &map->slots[i].kv;
+		}
+
+		Iterator & operator++()
+		{
+			i++;
+			skip();
+			return *this;
+		}
+
+		bool operator==(const Iterator & other) const
+		{
+			return i == other.i;
+		}
+
+		bool operator!=(const Iterator & other) const
+		{
+			return i != other.i;
+		}
+	};
+
+public:
+	typedef Iterator<FlatHashMap, value_type> iterator;
+	typedef Iterator<const FlatHashMap, const value_type> const_iterator;
+
+	FlatHashMap() = default;
+
+	FlatHashMap(const FlatHashMap &) = delete;
+	FlatHashMap & operator=(const FlatHashMap &) = delete;
+
+	/* A map that is moved from is left empty, and can still be used. */
+	FlatHashMap(FlatHashMap && other) noexcept
+	{
+		swap(other);
+	}
+
+	FlatHashMap & operator=(FlatHashMap && other) noexcept
+	{
+		if (this != &other) {
+			clear();
+			swap(other);
+		}
+		return *this;
+	}
+
+	iterator begin()
+	{
+		return iterator(this, 0);
+	}
+
+	iterator end()
+	{
+		return iterator(this, slots.size());
+	}
+
+	const_iterator begin() const
+	{
+		return const_iterator(this, 0);
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(this, slots.size());
+	}
+
+	size_t size() const
+	{
+		return used;
+	}
+
+	bool empty() const
+	{
+		return used == 0;
+	}
+
+	iterator find(const K & key)
+	{
+		return iterator(this, lookup(key));
+	}
+
+	const_iterator find(const K & key) const
+	{
+		return const_iterator(this, lookup(key));
+	}
+
+	size_t count(const K & key) const
+	{
+		return lookup(key) != slots.size();
+	}
+
+	std::pair<iterator, bool> insert(value_type && kv)
+	{
+		size_t i = lookup(kv.first);
+		if (i != slots.size())
+			return std::make_pair(iterator(this, i), false);
+
+		reserveOne();
+		i = place(std::move(kv));
+		used++;
+		return std::make_pair(iterator(this, i), true);
+	}
+
+	std::pair<iterator, bool> emplace(const K & key, V && value)
+	{
+		return insert(value_type(key, std::move(value)));
+	}
+
+	V & operator[](const K & key)
+	{
+		size_t i = lookup(key);
+		if (i != slots.size())
+			return slots[i].kv.second;
+
+		return insert(value_type(key, V())).first->second;
+	}
+
+	size_t erase(const K & key)
+	{
+		size_t i = lookup(key);
+		if (i == slots.size())
+			return (0);
+
+		eraseSlot(i);
+		return (1);
+	}
+
+	void erase(iterator it)
+	{
+		eraseSlot(it.i);
+	}
+
+	/* Frees the table, unlike std::unordered_map::clear(). */
+	void clear()
+	{
+		std::vector<Slot>().swap(slots);
+		used = 0;
+		shift = 64;
+	}
+
+	void reserve(size_t n)
+	{
+		size_t want = MIN_SLOTS;
+
+		while (want * 7 < n * 8)
+			want *= 2;
+		if (want > slots.size())
+			rehash(want);
+	}
+
+	void swap(FlatHashMap & other)
+	{
+		slots.swap(other.slots);
+		std::swap(used, other.used);
+		std::swap(shift, other.shift);
+	}
+};
+
+#endif // #if !defined(FLATHASHMAP_H)
@@ -42,20 +42,43 @@
 #include <string.h>
 #include <fcntl.h>
 
+class Arena;
 class Callframe;
 class ProcessExec;
 class FunctionLocation;
 class ImageFactory;
 class Location;
-class SharedString;
 
 class Image
 {
+public:
+	/*
+	 * What an AddressSpace needs from the ELF headers to place the image:
+	 * the address that its executable segment is linked at, and whether
+	 * it is position-independent (ET_DYN).
+	 */
+	struct LoadInfo
+	{
+		TargetAddr loadAddr;
+		bool pie;
+	};
+
 private:
 	SharedString imageFile;
+
+	/* Read from the file the first time that an address space needs it. */
+	bool loadInfoKnown = false;
+	LoadInfo loadInfo = {0, false};
+
+	/* Where the Callframes and the maps' nodes are allocated, if set. */
+	Arena *arena;
 	FrameMap frameMap;
 
-	explicit Image(SharedString imageName);
+	/* Frames that have been added since the last MapAllFrames(). */
+	FrameMap pendingFrames;
+	std::unique_ptr<DwarfResolver> resolver;
+
+	explicit Image(SharedString imageName, Arena *arena = nullptr);
 
 	Image() = delete;
 	Image(const Image&) = delete;
@@ -73,8 +96,19 @@ public:
 		return imageFile;
 	}
 
+	const LoadInfo * GetLoadInfo() const
+	{
+		return loadInfoKnown ? &loadInfo : nullptr;
+	}
+
+	void SetLoadInfo(const LoadInfo & info)
+	{
+		loadInfo = info;
+		loadInfoKnown = true;
+	}
+
 	const Callframe & GetFrame(TargetAddr offset);
-	void MapAllFrames();
+	void MapAllFrames(bool keepResolver = false);
 	void MapAllAsUnmapped();
 };
 
@@ -24,20 +24,26 @@
 #ifndef IMAGE_FACTORY_H
 #define IMAGE_FACTORY_H
 
+#include "SharedString.h"
+
 #include <memory>
 
+class Arena;
 class Image;
-class SharedString;
 
 class ImageFactory
 {
 protected:
-	std::unique_ptr<Image> AllocImage(SharedString);
+	std::unique_ptr<Image> AllocImage(SharedString, Arena * = nullptr);
 
 public:
 	virtual Image *GetImage(SharedString name) = 0;
 	virtual Image &GetUnmappedImage() = 0;
-	virtual void MapAll() = 0;
+	/*
+	 * Symbolizes every frame seen so far.  Pass more if frames will be
+	 * added and mapped again later, as when following a log.
+	 */
+	virtual void MapAll(bool more = false) = 0;
 };
 
 #endif
@@ -26,26 +26,70 @@
 
 #include "SharedString.h"
 #include "ProfilerTypes.h"
+#include "StringIdTable.h"
 
+class Callframe;
+
+/*
+ * One level of the inline stack of a Callframe.  Frames are numerous once
+ * symbolized, but most are one of a few functions seen at many PCs, so a
+ * frame only stores its code line and the id of its function in a table
+ * shared by all frames.  The image and offset are read from the owning
+ * Callframe.
+ */
 class InlineFrame
 {
-	SharedString file;
-	SharedString func;
-	SharedString demangledFunc;
-	TargetAddr offset;
+	/* Everything about a frame that all PCs in an inline instance share. */
+	struct Function
+	{
+		StringIdTable::Id file;
+		StringIdTable::Id func;
+		StringIdTable::Id demangledFunc;
+		int funcLine;
+		uint64_t dwarfDieOffset;
+
+		bool operator==(const Function & other) const
+		{
+			return file == other.file && func == other.func &&
+			    demangledFunc == other.demangledFunc &&
+			    funcLine == other.funcLine &&
+			    dwarfDieOffset == other.dwarfDieOffset;
+		}
+	};
+
+	struct FunctionHash
+	{
+		size_t operator()(const Function & f) const;
+	};
+
+	typedef uint32_t FunctionId;
+
+	struct FunctionTable;
+
+	const Callframe *callframe;
+	FunctionId function;
 	int codeLine;
-	int funcLine;
-	uint64_t dwarfDieOffset;
-	SharedString imageName;
+
+	friend class Callframe;
+
+	static StringIdTable & GetStrings();
+	static FunctionTable & GetFunctions();
+	static FunctionId InternFunction(const Function &);
+	static const Function & GetFunction(FunctionId);
 
 public:
-	InlineFrame(SharedString file, SharedString func,
-	    SharedString demangled, TargetAddr off,
-	    int codeLine, int funcLine, uint64_t dwarfDieOffset,
-	    SharedString imageName)
-	  : file(file), func(func), demangledFunc(demangled),
-	    offset(off), codeLine(codeLine), funcLine(funcLine),
-	    dwarfDieOffset(dwarfDieOffset), imageName(imageName)
+	InlineFrame(const Callframe &callframe, SharedString file,
+	    SharedString func, SharedString demangled, int codeLine,
+	    int funcLine, uint64_t dwarfDieOffset)
+	  : callframe(&callframe),
+	    function(InternFunction(Function{
+		.file = GetStrings().intern(file),
+		.func = GetStrings().intern(func),
+		.demangledFunc = GetStrings().intern(demangled),
+		.funcLine = funcLine,
+		.dwarfDieOffset = dwarfDieOffset,
+	    })),
+	    codeLine(codeLine)
 	{
 	}
 
@@ -54,28 +98,21 @@ public:
 
 	SharedString getFile() const
 	{
-		return (file);
+		return (GetStrings().get(GetFunction(function).file));
 	}
 
 	SharedString getFunc() const
 	{
-		return (func);
+		return (GetStrings().get(GetFunction(function).func));
 	}
 
 	SharedString getDemangled() const
 	{
-		return (demangledFunc);
-	}
-
-	SharedString getImageName() const
-	{
-		return imageName;
+		return (GetStrings().get(GetFunction(function).demangledFunc));
 	}
 
-	TargetAddr getOffset() const
-	{
-		return offset;
-	}
+	SharedString getImageName() const;
+	TargetAddr getOffset() const;
 
 	int getCodeLine() const
 	{
@@ -84,7 +121,7 @@ public:
 
 	int getFuncLine() const
 	{
-		return (funcLine);
+		return (GetFunction(function).funcLine);
 	}
 
 	bool isMapped() const
@@ -94,7 +131,7 @@ public:
 
 	uint64_t getDieOffset() const
 	{
-		return dwarfDieOffset;
+		return GetFunction(function).dwarfDieOffset;
 	}
 
 	InlineFrame &operator=(const InlineFrame &) = delete;
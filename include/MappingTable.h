@@ -0,0 +1,185 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(MAPPINGTABLE_H)
+#define MAPPINGTABLE_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/*
+ * A table of non-overlapping ranges, each identified by the key it starts
+ * at and running up to the start of the next one, for mapping an address
+ * to the image that it falls in.  Lookups vastly outnumber changes, so the
+ * keys are kept sorted in their own contiguous array and searched without
+ * branching on the comparisons, and the range that was last found is
+ * checked first, as consecutive frames tend to land in the same image.
+ *
+ * Inserting and erasing are linear in the size of the table and invalidate
+ * pointers to the values.
+ */
+template <typename K, typename V>
+class MappingTable
+{
+private:
+	std::vector<K> keys;
+	std::vector<V> values;
+	size_t lastHit = 0;
+
+	/* Index of the first key greater than key. */
+	size_t upperBound(const K & key) const
+	{
+		return (std::upper_bound(keys.begin(), keys.end(), key) -
+		    keys.begin());
+	}
+
+	/* Index of the first key not less than key. */
+	size_t lowerBound(const K & key) const
+	{
+		return (std::lower_bound(keys.begin(), keys.end(), key) -
+		    keys.begin());
+	}
+
+	/* Index of the last key <= addr.  There must be one. */
+	size_t search(const K & addr) const
+	{
+		const K *base = keys.data();
+		size_t n = keys.size();
+
+		while (n > 1) {
+			size_t half = n / 2;
+			base = (base[half] <= addr) ? base + half : base;
+			n -= half;
+		}
+
+		return (base - keys.data());
+	}
+
+public:
+	size_t size() const
+	{
+		return (keys.size());
+	}
+
+	bool empty() const
+	{
+		return (keys.empty());
+	}
+
+	/*
+	 * Add a range starting at key.  Like std::map::insert, nothing is
+	 * changed if there is already a range starting there.
+	 */
+	bool insert(const K & key, V && value)
+	{
+		size_t i = upperBound(key);
+
+		if (i > 0 && keys[i - 1] == key)
+			return (false);
+
+		keys.insert(keys.begin() + i, key);
+		values.insert(values.begin() + i, std::move(value));
+		lastHit = 0;
+		return (true);
+	}
+
+	bool erase(const K & key)
+	{
+		size_t i = upperBound(key);
+
+		if (i == 0 || keys[i - 1] != key)
+			return (false);
+
+		keys.erase(keys.begin() + i - 1);
+		values.erase(values.begin() + i - 1);
+		lastHit = 0;
+		return (true);
+	}
+
+	/* The number of ranges that start in [from, to). */
+	size_t countRange(const K & from, const K & to) const
+	{
+		if (!(from < to))
+			return (0);
+
+		return (lowerBound(to) - lowerBound(from));
+	}
+
+	/* Remove every range that starts in [from, to). */
+	size_t eraseRange(const K & from, const K & to)
+	{
+		size_t first, last;
+
+		if (!(from < to))
+			return (0);
+
+		first = lowerBound(from);
+		last = lowerBound(to);
+		keys.erase(keys.begin() + first, keys.begin() + last);
+		values.erase(values.begin() + first, values.begin() + last);
+		lastHit = 0;
+		return (last - first);
+	}
+
+	/* Returns the first key that is not less than key, or NULL. */
+	const K * ceiling(const K & key) const
+	{
+		size_t i = lowerBound(key);
+
+		if (i == keys.size())
+			return (NULL);
+		return (&keys[i]);
+	}
+
+	void clear()
+	{
+		keys.clear();
+		values.clear();
+		lastHit = 0;
+	}
+
+	/*
+	 * Returns the value of the range that addr falls in, or NULL if addr
+	 * is below the start of every range.
+	 */
+	V * find(const K & addr)
+	{
+		size_t i = lastHit;
+
+		if (i < keys.size() && keys[i] <= addr &&
+		    (i + 1 == keys.size() || addr < keys[i + 1]))
+			return (&values[i]);
+
+		if (keys.empty() || addr < keys[0])
+			return (NULL);
+
+		i = search(addr);
+		lastHit = i;
+		return (&values[i]);
+	}
+};
+
+#endif // #if !defined(MAPPINGTABLE_H)
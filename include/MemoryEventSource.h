@@ -0,0 +1,83 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(MEMORYEVENTSOURCE_H)
+#define MEMORYEVENTSOURCE_H
+
+#include "EventSource.h"
+#include "ProfilerTypes.h"
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Events recorded in memory so that they can be replayed any number of times.
+ * Callchain addresses are stored back to back in a single array and are
+ * handed to the Profiler as Sample views, so replaying a sample does not
+ * allocate.
+ */
+class MemoryEventSource : public EventSource
+{
+	struct Event
+	{
+		enum Type { SAMPLE, MAP_IN, EXEC };
+
+		Type type;
+		pid_t pid;
+		uint32_t npc;
+
+		/*
+		 * For samples, the index of the first address in pcs;
+		 * otherwise the index of the pathname in paths.
+		 */
+		size_t index;
+
+		/* The start address of a mapping or the exec entry point. */
+		TargetAddr addr;
+	};
+
+	std::vector<Event> events;
+	std::vector<uintptr_t> pcs;
+	std::vector<std::string> paths;
+
+	size_t AddPath(const std::string &);
+
+public:
+	MemoryEventSource() = default;
+
+	void AddSample(pid_t pid, const uintptr_t *pc, uint32_t npc);
+	void AddMapIn(pid_t pid, TargetAddr start, const std::string & path);
+	void AddExec(pid_t pid, const std::string & path, TargetAddr entry);
+
+	size_t GetNumEvents() const
+	{
+		return (events.size());
+	}
+
+	virtual bool Feed(Profiler &);
+};
+
+#endif // #if !defined(MEMORYEVENTSOURCE_H)
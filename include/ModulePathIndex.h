@@ -0,0 +1,85 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(MODULEPATHINDEX_H)
+#define MODULEPATHINDEX_H
+
+#include "SharedString.h"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Maps the file name of a kernel module to where it lives in the module
+ * path.  The directories are each read once, the first time that a module
+ * is looked up, so resolving the modules of a kernel costs a scan of the
+ * module path rather than a probe of every directory for every module.
+ *
+ * Modules that can't be found are remembered and reported together by
+ * ReportMissing().
+ */
+class ModulePathIndex
+{
+private:
+	std::vector<std::string> path;
+	std::unordered_map<std::string, SharedString> modules;
+	bool scanned = false;
+
+	std::unordered_set<std::string> notFound;
+	std::vector<std::string> missing;
+
+	void scanDir(const std::string & dir);
+	void scan();
+
+	static void parsePath(char * pathBuf, std::vector<std::string> & vec);
+
+public:
+	ModulePathIndex() = default;
+
+	ModulePathIndex(const ModulePathIndex &) = delete;
+	ModulePathIndex & operator=(const ModulePathIndex &) = delete;
+
+	void SetPath(const std::vector<std::string> & dirs);
+
+	/* Sets the path from a list of directories separated by ';'. */
+	void SetPathList(const char *dirs);
+
+	/* Sets the path to the running kernel's kern.module_path. */
+	void SetLocalPath();
+
+	/*
+	 * Returns the full path of the module, or NULL if it isn't in any
+	 * directory of the module path.
+	 */
+	const SharedString * Find(const std::string & name);
+
+	/*
+	 * Print the modules that weren't found since the last call, exiting if
+	 * we're to quit on errors.
+	 */
+	void ReportMissing();
+};
+
+#endif // #if !defined(MODULEPATHINDEX_H)
@@ -0,0 +1,70 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(PERFDATAEVENTSOURCE_H)
+#define PERFDATAEVENTSOURCE_H
+
+#include "EventSource.h"
+#include "ProfilerTypes.h"
+#include "SampleDecimator.h"
+
+#include <sys/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_set>
+#include <vector>
+
+struct PerfSample;
+
+/*
+ * Events read from a Linux perf.data file recorded with "perf record -g".
+ * Samples become Samples (one per callchain context), MMAP and MMAP2 records
+ * become map-ins, and the first executable mapping after a COMM record that
+ * is flagged as an exec becomes a ProcessExec as well.
+ */
+class PerfDataEventSource : public EventSource
+{
+	const char *buf;
+	size_t len;
+	SampleDecimator decimator;
+
+	/* Processes that have exec'ed but whose executable isn't mapped yet. */
+	std::unordered_set<pid_t> pendingExec;
+
+	/* Used only for callchains that aren't suitably aligned in the file. */
+	std::vector<uintptr_t> scratch;
+
+	void processKernelMmap(Profiler &, TargetAddr addr, const char *path);
+	void processMmap(Profiler &, pid_t pid, TargetAddr addr,
+	    const char *path);
+	void processSample(Profiler &, const PerfSample &);
+
+public:
+	PerfDataEventSource(const char *buf, size_t len,
+	    const SampleDecimator & decimator = SampleDecimator());
+
+	virtual bool Feed(Profiler &);
+};
+
+#endif // #if !defined(PERFDATAEVENTSOURCE_H)
@@ -0,0 +1,273 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(PERFDATAREADER_H)
+#define PERFDATAREADER_H
+
+#include <sys/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Layout of the Linux perf.data file written by "perf record".  These mirror
+ * the structures in tools/perf/util/header.h and <linux/perf_event.h>; they are
+ * declared here because neither is available on FreeBSD.  Only the little
+ * endian, non-pipe form of the file is understood.
+ */
+struct PerfFileSection
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct PerfFileHeader
+{
+	char magic[8];
+	uint64_t size;
+	uint64_t attrSize;
+	PerfFileSection attrs;
+	PerfFileSection data;
+	PerfFileSection eventTypes;
+	uint64_t features[4];
+};
+
+struct PerfEventHeader
+{
+	uint32_t type;
+	uint16_t misc;
+	uint16_t size;
+};
+
+struct PerfRecordMmap
+{
+	PerfEventHeader hdr;
+	uint32_t pid;
+	uint32_t tid;
+	uint64_t addr;
+	uint64_t len;
+	uint64_t pgoff;
+};
+
+struct PerfRecordMmap2
+{
+	PerfEventHeader hdr;
+	uint32_t pid;
+	uint32_t tid;
+	uint64_t addr;
+	uint64_t len;
+	uint64_t pgoff;
+	uint32_t maj;
+	uint32_t min;
+	uint64_t ino;
+	uint64_t inoGeneration;
+	uint32_t prot;
+	uint32_t flags;
+};
+
+struct PerfRecordComm
+{
+	PerfEventHeader hdr;
+	uint32_t pid;
+	uint32_t tid;
+};
+
+struct PerfRecordExit
+{
+	PerfEventHeader hdr;
+	uint32_t pid;
+	uint32_t ppid;
+	uint32_t tid;
+	uint32_t ptid;
+	uint64_t time;
+};
+
+/* PERF_RECORD_FORK has the same layout as PERF_RECORD_EXIT. */
+typedef PerfRecordExit PerfRecordFork;
+
+/*
+ * The parts of a PERF_RECORD_SAMPLE that the profiler uses.  ips points into
+ * the record; it may include PERF_CONTEXT_* markers.
+ */
+struct PerfSample
+{
+	uint32_t pid;
+	uint32_t tid;
+	const uint64_t *ip;
+	const uint64_t *ips;
+	uint64_t nr;
+};
+
+/*
+ * A view of a single record in the data section.  It is only valid for as
+ * long as the buffer that it points into.
+ */
+class PerfDataRecord
+{
+	const char *data;
+
+	const PerfEventHeader & getHeader() const
+	{
+		return *reinterpret_cast<const PerfEventHeader *>(data);
+	}
+
+public:
+	enum Type
+	{
+		MMAP = 1,
+		LOST = 2,
+		COMM = 3,
+		EXIT = 4,
+		THROTTLE = 5,
+		UNTHROTTLE = 6,
+		FORK = 7,
+		READ = 8,
+		SAMPLE = 9,
+		MMAP2 = 10,
+	};
+
+	static const uint16_t MISC_CPUMODE_MASK = 0x7;
+	static const uint16_t MISC_MMAP_DATA = 1 << 13;
+	static const uint16_t MISC_COMM_EXEC = 1 << 13;
+
+	PerfDataRecord()
+	  : data(NULL)
+	{
+	}
+
+	explicit PerfDataRecord(const char *d)
+	  : data(d)
+	{
+	}
+
+	const char *getData() const
+	{
+		return data;
+	}
+
+	uint32_t getType() const
+	{
+		return getHeader().type;
+	}
+
+	uint16_t getMisc() const
+	{
+		return getHeader().misc;
+	}
+
+	size_t getLength() const
+	{
+		return getHeader().size;
+	}
+
+	template <typename T>
+	const T & get() const
+	{
+		return *reinterpret_cast<const T *>(data);
+	}
+
+	/*
+	 * Returns the NUL-terminated string that follows the fixed part of an
+	 * MMAP, MMAP2 or COMM record, or NULL if it runs off the end of the
+	 * record.
+	 */
+	const char *getString() const;
+};
+
+/*
+ * Walks the records of the data section of a perf.data file in place.
+ */
+class PerfDataReader
+{
+	const char *buf;
+	size_t len;
+	size_t off;
+	size_t end;
+	uint64_t sampleType;
+	bool error;
+
+	bool readAttrs(const PerfFileHeader &);
+
+public:
+	/* Bits of perf_event_attr.sample_type. */
+	static const uint64_t SAMPLE_IP = 1 << 0;
+	static const uint64_t SAMPLE_TID = 1 << 1;
+	static const uint64_t SAMPLE_TIME = 1 << 2;
+	static const uint64_t SAMPLE_ADDR = 1 << 3;
+	static const uint64_t SAMPLE_READ = 1 << 4;
+	static const uint64_t SAMPLE_CALLCHAIN = 1 << 5;
+	static const uint64_t SAMPLE_ID = 1 << 6;
+	static const uint64_t SAMPLE_CPU = 1 << 7;
+	static const uint64_t SAMPLE_PERIOD = 1 << 8;
+	static const uint64_t SAMPLE_STREAM_ID = 1 << 9;
+	static const uint64_t SAMPLE_IDENTIFIER = 1 << 16;
+
+	/* Callchain entries at or above this are PERF_CONTEXT_* markers. */
+	static const uint64_t CONTEXT_MAX = static_cast<uint64_t>(-4095);
+	static const uint64_t CONTEXT_HV = static_cast<uint64_t>(-32);
+	static const uint64_t CONTEXT_KERNEL = static_cast<uint64_t>(-128);
+	static const uint64_t CONTEXT_USER = static_cast<uint64_t>(-512);
+
+	static const size_t ATTR_SAMPLE_TYPE_OFFSET = 24;
+
+	PerfDataReader(const char *buf, size_t len)
+	  : buf(buf), len(len), off(0), end(0), sampleType(0), error(false)
+	{
+	}
+
+	PerfDataReader(const PerfDataReader&) = delete;
+	PerfDataReader& operator=(const PerfDataReader &) = delete;
+
+	/*
+	 * Returns true if the buffer starts with a perf.data magic number
+	 * (in either byte order).
+	 */
+	static bool IsPerfData(const char *buf, size_t len);
+
+	static bool IsContext(uint64_t ip)
+	{
+		return (ip >= CONTEXT_MAX);
+	}
+
+	/*
+	 * Validates the file header and the event attributes.  Returns false,
+	 * after warning about why, if the file can't be decoded.
+	 */
+	bool open();
+
+	bool next(PerfDataRecord &);
+
+	/* Decode the fields of a SAMPLE record that we need. */
+	bool parseSample(const PerfDataRecord &, PerfSample &) const;
+
+	bool failed() const
+	{
+		return error;
+	}
+
+	uint64_t getSampleType() const
+	{
+		return sampleType;
+	}
+};
+
+#endif // #if !defined(PERFDATAREADER_H)
@@ -0,0 +1,51 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(PMCLOGEVENTSOURCE_H)
+#define PMCLOGEVENTSOURCE_H
+
+#include "EventSource.h"
+#include "TimeWindow.h"
+
+#include <stddef.h>
+
+/*
+ * Events read from a complete hwpmc log, normally a MappedLog of the samples
+ * file.  With more than one job the log is decoded by a ShardDecoder.  Only
+ * the samples inside of the given time window are delivered.
+ */
+class PmcLogEventSource : public EventSource
+{
+	const char *buf;
+	size_t len;
+	unsigned jobs;
+	TimeWindow window;
+
+public:
+	PmcLogEventSource(const char *buf, size_t len, unsigned jobs,
+	    const TimeWindow & window = TimeWindow());
+
+	virtual bool Feed(Profiler &);
+};
+
+#endif // #if !defined(PMCLOGEVENTSOURCE_H)
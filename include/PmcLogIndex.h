@@ -0,0 +1,110 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(PMCLOGINDEX_H)
+#define PMCLOGINDEX_H
+
+#include "PmcLogReader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+struct TimeWindow;
+
+/*
+ * A coarse index of a pmclog buffer, built by walking only the record
+ * headers.  The log is cut into blocks at record boundaries, and each block
+ * records the range of timestamps in it and which of its records change
+ * process state (MAP_IN, PROCEXEC and exits).  A block that lies wholly
+ * outside of a time window can then be handled by replaying just those
+ * records, without decoding any of its samples.
+ *
+ * hwpmc writes each CPU's records into its own buffer, so timestamps are only
+ * roughly ordered through the file; the per-block bounds don't assume any
+ * ordering.
+ */
+class PmcLogIndex
+{
+public:
+	struct Block
+	{
+		size_t offset;
+		size_t length;
+		uint64_t minTsc;
+		uint64_t maxTsc;
+
+		/* The block's state records are events[firstEvent, lastEvent). */
+		size_t firstEvent;
+		size_t lastEvent;
+	};
+
+private:
+	static const size_t BLOCK_SIZE = 256 * 1024;
+
+	const char *buf;
+	size_t len;
+	std::vector<Block> blocks;
+	std::vector<size_t> events;
+	uint64_t firstTsc;
+	bool haveInit;
+	PmcLogInitialize init;
+
+	uint64_t secondsToTsc(double seconds, bool absolute) const;
+
+public:
+	PmcLogIndex(const char *buf, size_t len);
+
+	PmcLogIndex(const PmcLogIndex&) = delete;
+	PmcLogIndex& operator=(const PmcLogIndex &) = delete;
+
+	static bool IsStateEvent(uint32_t type);
+
+	/* Returns false if the log is corrupt. */
+	bool build();
+
+	/*
+	 * Converts a window into an inclusive range of timestamps.  Returns
+	 * false if the log has no INITIALIZE record with a TSC frequency.
+	 */
+	bool resolve(const TimeWindow &, uint64_t &fromTsc,
+	    uint64_t &toTsc) const;
+
+	const std::vector<Block> & getBlocks() const
+	{
+		return blocks;
+	}
+
+	PmcLogRecord getEvent(size_t i) const
+	{
+		return PmcLogRecord(buf + events.at(i));
+	}
+
+	const char * getData() const
+	{
+		return buf;
+	}
+};
+
+#endif // #if !defined(PMCLOGINDEX_H)
@@ -0,0 +1,267 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(PMCLOGREADER_H)
+#define PMCLOGREADER_H
+
+#include <sys/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Layout of the records that hwpmc(4) writes to its log.  These mirror the
+ * structures in <sys/pmclog.h>; they are declared here so that records can be
+ * read in place, without the copy into a struct pmclog_ev that pmclog_read()
+ * does.  Variable-length data (callchain PCs, pathnames) immediately follows
+ * the fixed part of each record.
+ */
+struct PmcLogHeader
+{
+	uint32_t header;
+	uint32_t spare;
+	uint64_t tsc;
+};
+
+struct PmcLogCallchain
+{
+	PmcLogHeader hdr;
+	uint32_t pid;
+	uint32_t tid;
+	uint32_t pmcid;
+	uint32_t cpuflags;
+};
+
+struct PmcLogInitialize
+{
+	PmcLogHeader hdr;
+	uint32_t version;
+	uint32_t cpu;
+	uint64_t tscFreq;
+	int64_t tsSec;
+	int64_t tsNsec;
+};
+
+struct PmcLogMapIn
+{
+	PmcLogHeader hdr;
+	uint32_t pid;
+	uint32_t pad;
+	uint64_t start;
+};
+
+struct PmcLogMapOut
+{
+	PmcLogHeader hdr;
+	uint32_t pid;
+	uint32_t pad;
+	uint64_t start;
+	uint64_t end;
+};
+
+struct PmcLogProcExec
+{
+	PmcLogHeader hdr;
+	uint32_t pid;
+	uint32_t pmcid;
+	uint64_t baseaddr;
+	uint64_t dynaddr;
+};
+
+struct PmcLogProcExit
+{
+	PmcLogHeader hdr;
+	uint32_t pmcid;
+	uint32_t pid;
+	uint64_t value;
+};
+
+struct PmcLogSysExit
+{
+	PmcLogHeader hdr;
+	uint32_t pid;
+	uint32_t pad;
+};
+
+struct PmcLogProcFork
+{
+	PmcLogHeader hdr;
+	uint32_t oldpid;
+	uint32_t newpid;
+};
+
+/*
+ * A view of a single record in the log buffer.  It is only valid for as
+ * long as the buffer that it points into.
+ */
+class PmcLogRecord
+{
+	const char *data;
+
+	uint32_t getHeader() const
+	{
+		return reinterpret_cast<const PmcLogHeader *>(data)->header;
+	}
+
+public:
+	static const uint32_t HEADER_MAGIC = 0xEE;
+
+	PmcLogRecord()
+	  : data(NULL)
+	{
+	}
+
+	explicit PmcLogRecord(const char *d)
+	  : data(d)
+	{
+	}
+
+	static uint32_t HeaderToMagic(uint32_t h)
+	{
+		return ((h & 0xFF000000) >> 24);
+	}
+
+	static uint32_t HeaderToType(uint32_t h)
+	{
+		return ((h & 0x00FF0000) >> 16);
+	}
+
+	static uint32_t HeaderToLength(uint32_t h)
+	{
+		return (h & 0x0000FFFF);
+	}
+
+	uint32_t getType() const
+	{
+		return HeaderToType(getHeader());
+	}
+
+	size_t getLength() const
+	{
+		return HeaderToLength(getHeader());
+	}
+
+	uint64_t getTimestamp() const
+	{
+		return reinterpret_cast<const PmcLogHeader *>(data)->tsc;
+	}
+
+	template <typename T>
+	const T & get() const
+	{
+		return *reinterpret_cast<const T *>(data);
+	}
+
+	const uintptr_t *getCallchainPCs() const
+	{
+		return reinterpret_cast<const uintptr_t *>(data +
+		    sizeof(PmcLogCallchain));
+	}
+
+	uint32_t getCallchainDepth() const
+	{
+		return (getLength() - sizeof(PmcLogCallchain)) /
+		    sizeof(uintptr_t);
+	}
+
+	/* Only valid for MAP_IN and PROCEXEC records. */
+	const char *getPathname() const;
+};
+
+/*
+ * Walks the records of a pmclog buffer in place.  The buffer is normally a
+ * mapping of the whole log file, but any range that starts on a record
+ * boundary will do.  A partial reader is used on data that is still being
+ * read in; a record cut off by the end of its buffer is left for the next
+ * buffer rather than being treated as corruption.
+ */
+class PmcLogReader
+{
+	const char *buf;
+	size_t len;
+	size_t off;
+	bool partial;
+	bool error;
+
+	static size_t MinLength(uint32_t type);
+	static bool Truncated(const char *rec, size_t avail);
+
+public:
+	PmcLogReader(const char *buf, size_t len, bool partial = false)
+	  : buf(buf), len(len), off(0), partial(partial), error(false)
+	{
+	}
+
+	PmcLogReader(const PmcLogReader&) = delete;
+	PmcLogReader& operator=(const PmcLogReader &) = delete;
+
+	/*
+	 * Returns the length of the valid record at offset off in the
+	 * buffer, or 0 if there isn't one.
+	 */
+	static size_t RecordLength(const char *buf, size_t off, size_t len);
+
+	bool next(PmcLogRecord &);
+
+	bool failed() const
+	{
+		return error;
+	}
+
+	/* The maximum length of a single record. */
+	static const size_t MAX_RECORD_LENGTH = 0xFFFF;
+
+	size_t getOffset() const
+	{
+		return off;
+	}
+};
+
+/*
+ * A read-only mapping of an open log file, advised for sequential access.
+ */
+class MappedLog
+{
+	void *buf;
+	size_t len;
+
+public:
+	MappedLog();
+	~MappedLog();
+
+	MappedLog(const MappedLog&) = delete;
+	MappedLog& operator=(const MappedLog &) = delete;
+
+	bool map(int fd);
+
+	const char *getData() const
+	{
+		return static_cast<const char *>(buf);
+	}
+
+	size_t getLength() const
+	{
+		return len;
+	}
+};
+
+#endif // #if !defined(PMCLOGREADER_H)
@@ -0,0 +1,91 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(PROFILEFILE_H)
+#define PROFILEFILE_H
+
+#include "ProfilerTypes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class CallframeMapper;
+class ImageFactory;
+class Profiler;
+
+/*
+ * A pre-aggregated profile (pmcprofiler -W), which can be loaded back with
+ * -R to skip decoding the samples file.  After a fixed header, everything is
+ * a stream of LEB128 varints (signed values are zigzag-encoded):
+ *
+ *   strings:       count, then for each: length, bytes
+ *   address spaces: count, then for each: executable name string,
+ *                  frame count, then for each frame in address order:
+ *                  address delta, image name string, load offset delta
+ *   aggregations:  count, then for each: pid, executable name string,
+ *                  callchain count, then for each callchain: address space,
+ *                  sample count, depth, then the frame index delta of each
+ *                  frame
+ *
+ * The callchains of each aggregation are grouped into address spaces by
+ * executable name, so that processes whose images were loaded at different
+ * addresses are kept apart.  A chain whose addresses map to other frames
+ * than those of an earlier chain (an image was replaced while the process
+ * ran) goes in an address space of its own.  An image name of "" is the
+ * unmapped image.  The frames of an address space
+ * are only the ones that its callchains use, so the image table is exactly as
+ * large as it needs to be to re-symbolize the profile.
+ */
+class ProfileFile
+{
+public:
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 1;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+	};
+
+	typedef std::vector<std::unique_ptr<CallframeMapper>> MapperList;
+
+	ProfileFile() = delete;
+
+	static bool Write(const std::string & path, const AggregationList &);
+
+	/*
+	 * Feed the saved profile in buf to the profiler.  The address spaces
+	 * that the loaded callchains refer to are added to spaces, which has
+	 * to outlive the profile.
+	 */
+	static bool Read(const char *buf, size_t len, Profiler &,
+	    ImageFactory &, MapperList & spaces);
+};
+
+#endif // #if !defined(PROFILEFILE_H)
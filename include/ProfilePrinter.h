@@ -24,12 +24,15 @@
 #ifndef PROFILER_PRINTER_H
 #define PROFILER_PRINTER_H
 
+#include "Callframe.h"
 #include "ProfilerTypes.h"
 #include "StringChain.h"
 
 #include <cstdio>
 #include <cassert>
 #include <functional>
+#include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -37,7 +40,6 @@ class Callchain;
 class FunctionLocation;
 class InlineFrame;
 class Profiler;
-class SharedString;
 class SampleAggregation;
 
 class ProfilePrinter
@@ -68,6 +70,14 @@ public:
 	typedef std::unordered_map<StringChain, FuncLocMap, StringChain::Hasher> StringChainMap;
 
 private:
+	/*
+	 * The "[self]" frames made from each leaf frame.  They outlive the
+	 * callchains, some of which are only read back from disk while the
+	 * function locations are being counted.
+	 */
+	std::unordered_map<const InlineFrame *, std::unique_ptr<Callframe>>
+	    selfFrames;
+
 	void insertFuncLoc(FuncLocMap &, const InlineFrame &, const Callchain &);
 
 	class SampleCountComp
@@ -115,10 +125,28 @@ public:
 
 	void printLineNumbers(const Profiler & profiler, const LineLocationList & functionLocation);
 
+	// Explains the "[other]" chain of an aggregation that only kept its
+	// heaviest callchains.  Prints nothing for other aggregations.
+	static void printOtherChains(FILE *outfile, const SampleAggregation &agg);
+
+	void resetOutput();
+
+	// The frame that stands for the samples taken in the function of
+	// prototype itself, rather than in its callees.
+	const InlineFrame * getSelfFrame(const InlineFrame & prototype);
+
 };
 
 class FlatProfilePrinter : public ProfilePrinter
 {
+	static std::string formatCallchain(const SampleAggregation &,
+	    const Callchain &);
+	void printCallchain(const Profiler &, size_t count, size_t cumulative,
+	    const std::string & line);
+	void printCallchains(const Profiler &, const AggregationList &);
+	void printSpilledCallchains(const Profiler &, const AggregationList &,
+	    size_t budget);
+
 public:
 	FlatProfilePrinter(FILE * file)
 	  : ProfilePrinter(file)
@@ -143,7 +171,7 @@ struct LeafProcessStrategy
 		return vec.end();
 	}
 
-	void insertSelfFrame(std::vector<const InlineFrame*> &, Callchain &, const InlineFrame &) const
+	void insertSelfFrame(std::vector<const InlineFrame*> &, ProfilePrinter &, const InlineFrame &) const
 	{
 	}
 };
@@ -154,7 +182,7 @@ struct RootProcessStrategy
 
 	iterator begin(std::vector<const InlineFrame*> & vec) const;
 	iterator end(std::vector<const InlineFrame*> & vec) const;
-	void insertSelfFrame(std::vector<const InlineFrame*> &, Callchain &, const InlineFrame &) const;
+	void insertSelfFrame(std::vector<const InlineFrame*> &, ProfilePrinter &, const InlineFrame &) const;
 };
 
 #endif
@@ -24,18 +24,28 @@
 #if !defined(PROFILER_H)
 #define PROFILER_H
 
+#include <deque>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <stdint.h>
 
 #include <sys/types.h>
 
+#include <unordered_map>
 #include <unordered_set>
 
+#include "CallchainStore.h"
+#include "CallframeMapper.h"
+#include "ModulePathIndex.h"
 #include "ProfilerTypes.h"
+#include "SampleDecimator.h"
+#include "TimeWindow.h"
 
 class AddressSpace;
 class AddressSpaceFactory;
+class EventSource;
 class ImageFactory;
 class Process;
 class ProcessExit;
@@ -49,27 +59,70 @@ extern std::unordered_set<pid_t> pid_filter;
 class Profiler
 {
 private:
-	unsigned m_sampleCount;
+	/*
+	 * hwpmc logs each CPU's records into its own buffer, so samples from
+	 * the other threads of a process can appear in the log after its exit
+	 * record.  An exit is only acted on once this many more sample records
+	 * have been read, at the next mapping or process event after that.
+	 */
+	static const uint64_t EXIT_DELAY = 4096;
+
+	struct PendingExit
+	{
+		pid_t pid;
+		uint64_t due;
+	};
+
+	uint64_t m_sampleCount;
+
+	/*
+	 * Number of sample records read, including those that were filtered
+	 * out but not those dropped by decimation.
+	 */
+	uint64_t m_sampleSeq;
+	std::deque<PendingExit> pendingExits;
+	std::unordered_map<pid_t, uint64_t> exitingPids;
+
+	/*
+	 * Processes that have been finished but whose address spaces are kept
+	 * until their pid is reused, for samples that turn up even later.
+	 */
+	std::unordered_set<pid_t> exitedPids;
 
 	const std::string m_dataFile;
 	bool m_showlines;
+	unsigned m_jobs;
+	TimeWindow m_window;
+	SampleDecimator m_decimator;
+	uint64_t m_maxSamples;
 
 	std::string kernelFile;
-	std::vector<std::string> modulePath;
+
+	/* Shared by the Profilers of every samples file. */
+	ModulePathIndex &moduleIndex;
 	AddressSpaceFactory &asFactory;
 	SampleAggregationFactory &aggFactory;
 	ImageFactory &imgFactory;
 
-	void parseModulePath(char * path_buf, std::vector<std::string> & vec);
-	void getLocalModulePath();
-	void overrideModulePath(const char *modulePathStr);
+	/* The address spaces of a profile loaded with LoadProfile(). */
+	std::vector<std::unique_ptr<CallframeMapper>> savedSpaces;
+
+	/* Profilers for other samples files whose profiles are merged in. */
+	std::vector<Profiler *> merged;
 
 	AddressSpace & GetAddressSpace(bool kernel, pid_t pid);
+	bool filterSample(const Sample & sample) const;
+	void addSample(const Sample & sample, uint64_t count, ChainId id);
+	void getAggregations(AggregationList & list) const;
+	void advanceSamples(uint64_t count);
+	void finishExits();
+	void reusePid(pid_t pid);
+	void finishProcess(pid_t pid);
 
 public:
 
 	Profiler(const std::string& dataFile, bool showlines,
-	    const char *modulePathStr, AddressSpaceFactory &,
+	    ModulePathIndex &, AddressSpaceFactory &,
 	    SampleAggregationFactory &, ImageFactory &);
 
 	Profiler(const Profiler&) = delete;
@@ -80,7 +133,7 @@ public:
 		return m_dataFile;
 	}
 
-	unsigned getSampleCount() const
+	uint64_t getSampleCount() const
 	{
 		return m_sampleCount;
 	}
@@ -90,12 +143,79 @@ public:
 		return m_showlines;
 	}
 
+	unsigned getJobs() const
+	{
+		return m_jobs;
+	}
+
+	void setJobs(unsigned jobs)
+	{
+		m_jobs = jobs;
+	}
+
+	const TimeWindow & getTimeWindow() const
+	{
+		return m_window;
+	}
+
+	void setTimeWindow(const TimeWindow & window)
+	{
+		m_window = window;
+	}
+
+	const SampleDecimator & getDecimator() const
+	{
+		return m_decimator;
+	}
+
+	void setSampleRate(uint64_t rate)
+	{
+		m_decimator = SampleDecimator(rate);
+	}
+
+	uint64_t getMaxSamples() const
+	{
+		return m_maxSamples;
+	}
+
+	void setMaxSamples(uint64_t max)
+	{
+		m_maxSamples = max;
+	}
+
 	void MapSamples();
+	void MapSamples(EventSource & source);
+	void ReadSamples();
+	void ReadSamples(const std::vector<Profiler *> & others);
+	void MapImages();
+	void LoadProfile(const std::string & path);
+	void SaveProfile(const std::string & path);
+	void FollowSamples(unsigned interval, unsigned everySamples,
+	    const std::function<void()> & emit);
 	void createProfile(ProfilePrinter & printer);
 
 	void processEvent(const ProcessExec& processExec);
-	void processEvent(const Sample& sample);
+	void processEvent(const Sample& sample, uint64_t count = 1);
 	void processMapIn(pid_t pid, TargetAddr map_start, const char * image);
+	void processMapOut(pid_t pid, TargetAddr start, TargetAddr end);
+	void processFork(pid_t parent, pid_t child);
+	void processExit(pid_t pid);
+
+	/*
+	 * For decoders that intern samples on their own threads: a sample
+	 * whose chain is in store.  Chains should be interned in
+	 * getCallchainStore(), unless that is null because the aggregations
+	 * don't keep every chain, in which case the decoder should use a
+	 * store of its own that it frees once the samples are processed.
+	 */
+	CallchainStore * getCallchainStore();
+	void processChain(const CallchainStore & store, pid_t pid, ChainId id,
+	    uint64_t count);
+
+	/* Used by ProfileFile to load a saved profile. */
+	void startAggregation(pid_t pid, const std::string & executable);
+	void processEvent(CallframeMapper & space, const Sample & sample,
+	    uint64_t count);
 };
 
 #endif // #if !defined(PROFILER_H)
@@ -32,6 +32,9 @@
 #include <set>
 #include <vector>
 
+#include "Arena.h"
+#include "SharedString.h"
+
 typedef uintptr_t TargetAddr;
 
 extern bool g_includeTemplates;
@@ -44,7 +47,6 @@ const uint32_t PROFILE_KERN = 0x0002;
 class Callchain;
 class Callframe;
 class SampleAggregation;
-class SharedString;
 
 struct AggCallChain
 {
@@ -64,7 +66,7 @@ struct AggCallChain
 
 typedef std::vector<SampleAggregation*> AggregationList;
 typedef std::vector<AggCallChain> CallchainList;
-typedef std::map<TargetAddr, std::unique_ptr<Callframe> > FrameMap;
+typedef std::pmr::map<TargetAddr, ArenaPtr<Callframe> > FrameMap;
 typedef std::set<unsigned> LineLocationList;
 typedef std::map<TargetAddr, SharedString> SymbolMap;
 
@@ -0,0 +1,130 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#ifndef REFCOUNT_H
+#define REFCOUNT_H
+
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+
+/*
+ * Reference-counting policies for SharedPtr and SharedString.  A policy
+ * starts out holding one reference.  unref() returns true when the last
+ * reference was dropped, and tryRef() only takes a reference if the count
+ * has not already reached zero.  unique() is true if there is exactly one
+ * reference, so the holder may modify the object in place.  Mutex is the
+ * lock used to guard any other state shared between the counted objects
+ * (e.g. the SharedString intern table).
+ */
+
+/* Counts for objects that are only ever shared within a single thread. */
+class SingleThreadRefCount
+{
+	int count;
+
+public:
+	struct Mutex
+	{
+		void lock() {}
+		void unlock() {}
+	};
+
+	SingleThreadRefCount()
+	  : count(1)
+	{
+	}
+
+	void ref()
+	{
+		assert(count > 0);
+		++count;
+	}
+
+	bool tryRef()
+	{
+		if (count == 0)
+			return false;
+		++count;
+		return true;
+	}
+
+	bool unref()
+	{
+		assert(count > 0);
+		--count;
+		return count == 0;
+	}
+
+	bool unique() const
+	{
+		return count == 1;
+	}
+};
+
+/* Counts for objects that may be copied and dropped from several threads. */
+class AtomicRefCount
+{
+	std::atomic<int> count;
+
+public:
+	typedef std::mutex Mutex;
+
+	AtomicRefCount()
+	  : count(1)
+	{
+	}
+
+	void ref()
+	{
+		int prev = count.fetch_add(1, std::memory_order_relaxed);
+		assert(prev > 0);
+		(void)prev;
+	}
+
+	bool tryRef()
+	{
+		int prev = count.load(std::memory_order_relaxed);
+
+		do {
+			if (prev == 0)
+				return false;
+		} while (!count.compare_exchange_weak(prev, prev + 1,
+		    std::memory_order_relaxed));
+		return true;
+	}
+
+	bool unref()
+	{
+		int prev = count.fetch_sub(1, std::memory_order_acq_rel);
+		assert(prev > 0);
+		return prev == 1;
+	}
+
+	bool unique() const
+	{
+		return count.load(std::memory_order_acquire) == 1;
+	}
+};
+
+#endif
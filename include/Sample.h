@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <pmclog.h>
+#include <stdint.h>
 
 #include <unordered_map>
 
@@ -34,43 +35,101 @@
 #include <limits>
 #include <vector>
 
+/*
+ * A Sample constructed from a raw callchain is a view of the PCs in the
+ * record that it was built from and does not allocate.  Copying or moving a
+ * Sample always produces one that owns its addresses, so a Sample can be
+ * kept (e.g. as a map key) after the record is gone.
+ */
 class Sample
 {
 	bool m_isKernel;
 	pid_t m_processID;
-	std::vector<uintptr_t> m_address;
+	const uintptr_t *m_pc;
+	int m_depth;
+	std::vector<uintptr_t> m_storage;
 
 	static bool IsKernel(uintptr_t pc)
 	{
 		return (pc & 0x1000000000000000UL);
 	}
 
-public:
-	Sample(const pmclog_ev_callchain & event)
-	  : m_isKernel(IsKernel(event.pl_pc[0])),
-	m_processID(event.pl_pid)
+	static int ChainDepth(const uintptr_t *pc, uint32_t npc)
 	{
+		bool kernel = IsKernel(pc[0]);
 		uint32_t i;
-		for (i = 0; i < event.pl_npc; i++) {
-			/*
-			 * Callchains can now include kernel code and the
-			 * backtrace of the userland code that called into
-			 * the kernel.  That isn't supported yet, so cut off
-			 * the backtrace at the transition from kernel to user.
-			 */
-			if (IsKernel(event.pl_pc[i]) != m_isKernel)
+
+		/*
+		 * Callchains can now include kernel code and the
+		 * backtrace of the userland code that called into
+		 * the kernel.  That isn't supported yet, so cut off
+		 * the backtrace at the transition from kernel to user.
+		 */
+		for (i = 0; i < npc; i++) {
+			if (IsKernel(pc[i]) != kernel)
 				break;
-			m_address.push_back(event.pl_pc[i]-1);
 		}
+
+		return i;
+	}
+
+	void own()
+	{
+		m_storage.assign(m_pc, m_pc + m_depth);
+		m_pc = m_storage.data();
+	}
+
+public:
+	Sample(pid_t pid, const uintptr_t *pc, uint32_t npc)
+	  : m_isKernel(IsKernel(pc[0])),
+	    m_processID(pid),
+	    m_pc(pc),
+	    m_depth(ChainDepth(pc, npc))
+	{
+	}
+
+	Sample(const pmclog_ev_callchain & event)
+	  : Sample(event.pl_pid, event.pl_pc, event.pl_npc)
+	{
+		own();
 	}
 
 	Sample(const pmclog_ev_pcsample & event)
 	  : m_isKernel(event.pl_usermode == 0),
-	m_processID(event.pl_pid)
+	    m_processID(event.pl_pid),
+	    m_pc(&event.pl_pc),
+	    m_depth(1)
+	{
+		own();
+	}
+
+	Sample(const Sample & other)
+	  : m_isKernel(other.m_isKernel),
+	    m_processID(other.m_processID),
+	    m_pc(other.m_pc),
+	    m_depth(other.m_depth)
 	{
-		m_address.push_back(event.pl_pc-1);
+		own();
 	}
 
+	Sample(Sample && other)
+	  : m_isKernel(other.m_isKernel),
+	    m_processID(other.m_processID),
+	    m_pc(other.m_pc),
+	    m_depth(other.m_depth)
+	{
+		if (other.m_pc == other.m_storage.data()) {
+			m_storage = std::move(other.m_storage);
+			m_pc = m_storage.data();
+			other.m_pc = nullptr;
+			other.m_depth = 0;
+		} else
+			own();
+	}
+
+	Sample & operator=(const Sample &) = delete;
+	Sample & operator=(Sample &&) = delete;
+
 	bool isKernel() const
 	{
 		return m_isKernel;
@@ -83,12 +142,63 @@ public:
 
 	uintptr_t getAddress(size_t index) const
 	{
-		return m_address[index];
+		return m_pc[index] - 1;
 	}
 
 	int getChainDepth() const
 	{
-		return m_address.size();
+		return m_depth;
+	}
+
+	/* The raw PCs of the chain; getAddress(i) is getPCs()[i] - 1. */
+	const uintptr_t * getPCs() const
+	{
+		return m_pc;
+	}
+
+	/*
+	 * A strong hash of a chain of PCs, in the style of xxHash64.  Every
+	 * address passes through a multiply and a rotate, and the order of
+	 * the addresses matters, so chains that are permutations of each
+	 * other or that share a set of addresses don't collide.  The chain is
+	 * consumed in four independent lanes so that the rounds can overlap
+	 * (or be vectorized, where there is a 64-bit vector multiply).
+	 */
+	static uint64_t HashPCs(const uintptr_t *pc, size_t n, uint64_t seed = 0)
+	{
+		const uint64_t P1 = 0x9e3779b185ebca87ULL;
+		const uint64_t P2 = 0xc2b2ae3d27d4eb4fULL;
+		const uint64_t P3 = 0x165667b19e3779f9ULL;
+		uint64_t lane[4] = { seed + P1 + P2, seed + P2, seed, seed - P1 };
+		uint64_t h;
+		size_t i, j;
+
+		for (i = 0; i + 4 <= n; i += 4) {
+			for (j = 0; j < 4; ++j) {
+				lane[j] += pc[i + j] * P2;
+				lane[j] = ((lane[j] << 31) | (lane[j] >> 33)) * P1;
+			}
+		}
+
+		h = ((lane[0] << 1) | (lane[0] >> 63)) +
+		    ((lane[1] << 7) | (lane[1] >> 57)) +
+		    ((lane[2] << 12) | (lane[2] >> 52)) +
+		    ((lane[3] << 18) | (lane[3] >> 46));
+		h += n;
+
+		for (; i < n; ++i) {
+			uint64_t k = pc[i] * P2;
+			k = ((k << 31) | (k >> 33)) * P1;
+			h ^= k;
+			h = ((h << 27) | (h >> 37)) * P1 + P3;
+		}
+
+		h ^= h >> 33;
+		h *= P2;
+		h ^= h >> 29;
+		h *= P3;
+		h ^= h >> 32;
+		return (h);
 	}
 
 	bool operator==(const Sample & other) const
@@ -99,27 +209,18 @@ public:
 		if (m_processID != other.m_processID)
 			return false;
 
-		if (getChainDepth() != other.getChainDepth())
+		if (m_depth != other.m_depth)
 			return false;
 
-		for (int i = 0; i < getChainDepth(); i++) {
-			if (m_address[i] != other.m_address[i])
-				return false;
-		}
-
-		return true;
+		return std::equal(m_pc, m_pc + m_depth, other.m_pc);
 	}
 
 	struct hash
 	{
 		size_t operator()(const Sample & sample) const
 		{
-			int i;
-			size_t val = sample.isKernel();
-			for (i = 0; i < sample.getChainDepth(); i++)
-				val += sample.getAddress(i);
-
-			return val;
+			return HashPCs(sample.m_pc, sample.m_depth,
+			    sample.m_processID * 2 + sample.m_isKernel);
 		}
 	};
 
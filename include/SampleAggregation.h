@@ -24,27 +24,89 @@
 #ifndef SAMPLEAGGREGATION_H
 #define SAMPLEAGGREGATION_H
 
+#include "CallchainFactory.h"
+#include "CallchainStore.h"
+#include "FlatHashMap.h"
 #include "ProfilerTypes.h"
 #include "Sample.h"
 
 #include <sys/types.h>
 
+#include <functional>
 #include <sstream>
 #include <vector>
 #include <memory>
-#include <unordered_map>
 
 class Callchain;
-class CallchainFactory;
+class CallchainTrie;
+class ChainSpill;
 class CallframeMapper;
 class ProcessExec;
+class SampleAggregation;
+
+/*
+ * The memory that the callchains of every spilling aggregation may use
+ * between them.  Once they use more than the limit, the aggregations holding
+ * the most chains are spilled until no more than half of it is in use.
+ * It isn't locked: samples are only ever added on the main thread.
+ */
+class SpillBudget
+{
+	size_t limit;
+	size_t used;
+	std::vector<SampleAggregation *> aggregations;
+
+	friend class SampleAggregation;
+
+	void add(SampleAggregation *);
+	void remove(SampleAggregation *);
+	void charge(size_t bytes);
+	void release(size_t bytes);
+	void enforce();
+
+public:
+	explicit SpillBudget(size_t limit);
+
+	SpillBudget(const SpillBudget &) = delete;
+	SpillBudget & operator=(const SpillBudget &) = delete;
+
+	size_t getLimit() const
+	{
+		return limit;
+	}
+
+	size_t getUsed() const
+	{
+		return used;
+	}
+};
 
 class SampleAggregation
 {
 private:
-	typedef std::unordered_map<Sample, std::unique_ptr<Callchain>, Sample::hash> FrameMap;
+	struct LiveChain
+	{
+		CallchainPtr chain;
+
+		// The epoch of the address space that chain was mapped in.
+		uint64_t epoch = 0;
+	};
+
+	struct FinalChain
+	{
+		ChainKey key;
+		CallchainPtr chain;
+	};
+
+	typedef FlatHashMap<ChainKey, LiveChain> FrameMap;
+	typedef std::vector<FinalChain> ChainList;
 
 	FrameMap frameMap;
+
+	// Callchains of an aggregation whose process has exited, or whose
+	// addresses mapped to different frames before an image was mapped
+	// out.  No more samples will be added to them.
+	ChainList finalChains;
 	std::string executableName;
 	mutable std::string baseName;
 	mutable std::string displayName;
@@ -52,11 +114,60 @@ private:
 	size_t sampleCount;
 	size_t userlandSampleCount;
 	CallchainFactory & factory;
+	CallchainStore & store;
+
+	// Only set if the aggregation stores its callchains in a trie.
+	std::unique_ptr<CallchainTrie> trie;
+
+	/*
+	 * In bounded mode (maxChains != 0) only the heaviest chains are kept,
+	 * Space-Saving style.  Once maxChains are tracked, the lighter half is
+	 * evicted and their samples move to otherChain.  A chain may have had
+	 * up to errorBound samples before it was (re)admitted; those are
+	 * counted in otherChain, never in the chain itself.
+	 *
+	 * Bounded and spilling aggregations don't intern their chains in the
+	 * store, which would keep every distinct chain ever seen.  Their
+	 * chains are keyed on their hash instead.
+	 */
+	typedef FlatHashMap<ChainKey, size_t> ErrorMap;
 
-	Callchain * addFrame(CallframeMapper &space, const Sample &);
+	size_t maxChains;
+	size_t errorBound;
+	ErrorMap chainErrors;
+	std::unique_ptr<CallframeMapper> otherMapper;
+	CallchainPtr otherChain;
+
+	/*
+	 * If spillBudget is set, the chains in memory are written out to runs
+	 * in spill once those of every aggregation sharing the budget are
+	 * estimated to use more than it allows.  chainBytes is this
+	 * aggregation's share.
+	 */
+	SpillBudget *spillBudget;
+	size_t chainBytes;
+	std::unique_ptr<ChainSpill> spill;
+
+	friend class SpillBudget;
+
+	bool internsChains() const
+	{
+		return maxChains == 0 && spillBudget == nullptr;
+	}
+
+	ChainKey getKey(const Sample &, ChainId);
+	Callchain * addFrame(CallframeMapper &space, const Sample &, ChainKey);
+	Callchain * remapChain(CallframeMapper &space, const Sample &, ChainKey,
+	    LiveChain &);
+	void addChainBytes(const Sample &);
+	void evictChains();
+	void addOther(size_t count);
+	void spillChains();
 
 public:
-	SampleAggregation(CallchainFactory &, const std::string & name, pid_t);
+	SampleAggregation(CallchainFactory &, CallchainStore &,
+	    const std::string & name, pid_t, bool useTrie = false,
+	    size_t maxChains = 0, SpillBudget *spillBudget = nullptr);
 
 	// Prevent consumers from getting a dependency on ~Callchain
 	~SampleAggregation();
@@ -64,10 +175,34 @@ public:
 	SampleAggregation(const SampleAggregation&) = delete;
 	SampleAggregation& operator=(const SampleAggregation &) = delete;
 
-	void addSample(CallframeMapper &, const Sample &);
+	// id is the sample's chain in the CallchainStore, if the caller has
+	// already interned it.  Aggregations that don't intern ignore it.
+	void addSample(CallframeMapper &, const Sample &, size_t count = 1,
+	    ChainId id = NO_CHAIN);
 
+	// Lists the callchains in memory.  Spilled chains aren't listed.
 	void getCallchainList(CallchainList &) const;
 
+	// Calls func with every callchain, including the spilled ones.  These
+	// are merged from disk one at a time as they are passed, and don't
+	// outlive the call.
+	void forEachCallchain(
+	    const std::function<void(const Callchain &)> & func) const;
+
+	// An upper bound on the number of callchains that forEachCallchain()
+	// passes.
+	size_t getCallchainBound() const;
+
+	// Writes the chains still in memory out to the spill, if there is one,
+	// so that forEachCallchain() merges each spilled chain in one place.
+	void flushSpill();
+
+	// Called once the process has exited, and again once its pid is reused
+	// if samples turned up in between.  Drops the per-sample lookup table
+	// and keeps only the callchains themselves.  If any were spilled, all
+	// of them are.
+	void finalize();
+
 	const std::string & getExecutable() const
 	{
 		return executableName;
@@ -81,11 +216,40 @@ public:
 		return pid;
 	}
 
+	// The call tree of every sample, or null if the callchains aren't
+	// stored in a trie.
+	const CallchainTrie * getTrie() const
+	{
+		return trie.get();
+	}
+
 	size_t getSampleCount() const
 	{
 		return sampleCount;
 	}
 
+	// The most chains tracked at once, or 0 if every chain is kept.
+	size_t getMaxChains() const
+	{
+		return maxChains;
+	}
+
+	// How many samples any reported chain may be short by in bounded mode.
+	size_t getErrorBound() const
+	{
+		return errorBound;
+	}
+
+	// The budget shared with other spilling aggregations, or null if the
+	// callchains are never spilled.
+	const SpillBudget * getSpillBudget() const
+	{
+		return spillBudget;
+	}
+
+	// Samples in the "[other]" chain: those of untracked chains.
+	size_t getOtherCount() const;
+
 	class NumSampleComp
 	{
 	public:
@@ -28,6 +28,7 @@
 
 #include <sys/types.h>
 
+class CallchainStore;
 class ProcessExec;
 class Sample;
 class SampleAggregation;
@@ -41,6 +42,18 @@ public:
 	virtual void GetAggregationList(AggregationList &) = 0;
 	virtual void HandleExec(const ProcessExec &) = 0;
 	virtual void HandleMapIn(pid_t pid, const char *path) = 0;
+
+	// The child is named after the parent until it execs.
+	virtual void HandleFork(pid_t parent, pid_t child) = 0;
+
+	// The process has exited.  Its aggregation is finalized and a later
+	// process that reuses the pid gets a new aggregation.
+	virtual void HandleExit(pid_t pid) = 0;
+
+	// The store that the aggregations intern their callchains in, or null
+	// if they don't intern them.  It is safe to intern chains in it from
+	// other threads.
+	virtual CallchainStore *GetCallchainStore() = 0;
 };
 
 #endif
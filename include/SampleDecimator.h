@@ -0,0 +1,77 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(SAMPLEDECIMATOR_H)
+#define SAMPLEDECIMATOR_H
+
+#include <stdint.h>
+
+/*
+ * Selects roughly one sample in every rate for --sample-rate and
+ * --max-samples.  Whether a sample is kept depends only on a key taken from
+ * its record (its timestamp and CPU, or its offset in the file), so the
+ * serial and sharded decoders keep exactly the same samples and repeated
+ * runs give the same profile.  Each kept sample stands in for rate samples.
+ */
+class SampleDecimator
+{
+	uint64_t rate;
+
+	/* splitmix64 */
+	static uint64_t Mix(uint64_t x)
+	{
+		x += 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return (x ^ (x >> 31));
+	}
+
+public:
+	explicit SampleDecimator(uint64_t rate = 1)
+	  : rate(rate == 0 ? 1 : rate)
+	{
+	}
+
+	uint64_t getRate() const
+	{
+		return rate;
+	}
+
+	bool keep(uint64_t key, uint64_t salt = 0) const
+	{
+		if (rate == 1)
+			return (true);
+
+		return (Mix(key ^ Mix(salt)) % rate == 0);
+	}
+
+	/* The rate that brings total samples down to at most max. */
+	static uint64_t RateFor(uint64_t total, uint64_t max)
+	{
+		if (max == 0 || total <= max)
+			return (1);
+		return ((total + max - 1) / max);
+	}
+};
+
+#endif // #if !defined(SAMPLEDECIMATOR_H)
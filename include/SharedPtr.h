@@ -24,44 +24,46 @@
 #ifndef SHAREDPTR_H
 #define SHAREDPTR_H
 
+#include "RefCount.h"
+
 #include <assert.h>
 #include <string>
 #include <unordered_map>
 
-template <typename T>
+/*
+ * A reference-counted pointer.  The RefCount policy decides whether copies
+ * may be made and dropped concurrently; see RefCount.h.
+ */
+template <typename T, typename RefCount = SingleThreadRefCount>
 class SharedPtr
 {
 private:
 	struct RefValue
 	{
 		T value;
-		int count;
+		RefCount count;
 
 		template <typename... Args>
 		RefValue(Args &&... args)
-		  : value(std::forward<Args>(args)...), count(1)
+		  : value(std::forward<Args>(args)...)
 		{
 		}
 
 		RefValue(T && t)
-		  : value(std::move(t)), count(1)
+		  : value(std::move(t))
 		{
 		}
 	};
 
 	RefValue *value;
 
-	void Copy(const SharedPtr<T> &other)
+	void Copy(const SharedPtr &other)
 	{
 		Drop();
 
 		value = other.value;
-		if (value != NULL) {
-			assert(value->count > 0);
-			++value->count;
-		}
-// 		fprintf(stderr, "%p: Add ref; count=%d\n",
-// 			value, value->count);
+		if (value != NULL)
+			value->count.ref();
 	}
 
 	void Drop()
@@ -69,11 +71,7 @@ private:
 		if (value == NULL)
 			return;
 
-// 		fprintf(stderr, "%p: Drop ref; count=%d\n",
-// 			value, value->count);
-		assert(value->count > 0);
-		--value->count;
-		if (value->count == 0)
+		if (value->count.unref())
 			delete value;
 		value = NULL;
 	}
@@ -89,27 +87,27 @@ public:
 	{
 	}
 
-	SharedPtr(const SharedPtr<T> &other)
+	SharedPtr(const SharedPtr &other)
 	  : value(NULL)
 	{
 		Copy(other);
 	}
 
-	SharedPtr(SharedPtr<T> &&other) noexcept
+	SharedPtr(SharedPtr &&other) noexcept
 	  : value(other.value)
 	{
 		other.value = NULL;
 	}
 
 	template <typename... Args>
-	static SharedPtr<T> make(Args &&... args)
+	static SharedPtr make(Args &&... args)
 	{
-		return SharedPtr<T>(new RefValue(args...));
+		return SharedPtr(new RefValue(args...));
 	}
 
-	static SharedPtr<T> make(T && t)
+	static SharedPtr make(T && t)
 	{
-		return SharedPtr<T>(new RefValue(std::move(t)));
+		return SharedPtr(new RefValue(std::move(t)));
 	}
 
 	~SharedPtr()
@@ -142,18 +140,18 @@ public:
 		Drop();
 	}
 
-	bool operator==(const SharedPtr<T> &other) const
+	bool operator==(const SharedPtr &other) const
 	{
 		return value == other.value;
 	}
 
-	SharedPtr<T> &operator=(const SharedPtr<T> &other)
+	SharedPtr &operator=(const SharedPtr &other)
 	{
 		Copy(other);
 		return *this;
 	}
 
-	SharedPtr<T> &operator=(SharedPtr<T> &&other)
+	SharedPtr &operator=(SharedPtr &&other)
 	{
 		Drop();
 		value = other.value;
@@ -175,6 +173,12 @@ public:
 	{
 		return value != NULL;
 	}
+
+	/* True if this is the only reference to the value. */
+	bool unique() const
+	{
+		return value != NULL && value->count.unique();
+	}
 };
 
 #endif
@@ -24,39 +24,61 @@
 #ifndef SHARED_STRING_H
 #define SHARED_STRING_H
 
+#include "RefCount.h"
+
 #include <assert.h>
 #include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
-class SharedString
+/*
+ * A reference-counted, immutable string.  Strings are interned: every
+ * SharedString with the same text shares one value, so comparing and
+ * hashing SharedStrings never looks at the text.  Each RefCount policy has
+ * its own intern table, guarded by the policy's Mutex, so SharedString is
+ * only usable from one thread while ConcurrentSharedString may be shared
+ * freely.
+ */
+template <typename RefCount>
+class BasicSharedString
 {
 	struct StringValue
 	{
 		std::string str;
-		int count;
+		size_t hash;
+		RefCount count;
 
-		StringValue(const char *s)
-		  : str(s), count(1)
+		StringValue(std::string_view s, size_t h)
+		  : str(s), hash(h)
 		{
 		}
 	};
 
+	typedef std::unordered_map<std::string_view, StringValue *> InternTable;
+
+	struct Interned
+	{
+		InternTable table;
+		typename RefCount::Mutex lock;
+	};
+
 	StringValue *value;
 
+	static Interned & GetInterned();
+
 	// These are separate functions solely to facilitate unit tests.  If
 	// SharedString was taught to use allocators, this could be avoid.
 	void Init(const char *str);
 	void Destroy(StringValue *);
 
-	void Copy(const SharedString &other)
+	void Copy(const BasicSharedString &other)
 	{
 		Drop();
 
 		value = other.value;
-		assert(value->count > 0);
-		++value->count;
+		value->count.ref();
 	}
 
 	void Drop()
@@ -64,45 +86,43 @@ class SharedString
 		if (value == NULL)
 			return;
 
-		assert(value->count > 0);
-		--value->count;
-		if (value->count == 0)
+		if (value->count.unref())
 			Destroy(value);
 		value = NULL;
 	}
 
 public:
-	SharedString()
+	BasicSharedString()
 	  : value(NULL)
 	{
 		Init("");
 	}
 
-	SharedString(const std::string &str)
+	BasicSharedString(const std::string &str)
 	  : value(NULL)
 	{
 		Init(str.c_str());
 	}
 
-	SharedString(const char *str)
+	BasicSharedString(const char *str)
 	  : value(NULL)
 	{
 		Init(str);
 	}
 
-	SharedString(const SharedString &other)
+	BasicSharedString(const BasicSharedString &other)
 	  : value(NULL)
 	{
 		Copy(other);
 	}
 
-	SharedString(SharedString &&other) noexcept
+	BasicSharedString(BasicSharedString &&other) noexcept
 	  : value(other.value)
 	{
 		other.value = NULL;
 	}
 
-	~SharedString()
+	~BasicSharedString()
 	{
 		Drop();
 	}
@@ -122,26 +142,29 @@ public:
 		*this = "";
 	}
 
-	bool operator==(const SharedString &other) const
+	// Equal strings are always interned to the same value.
+	bool operator==(const BasicSharedString &other) const
 	{
-		if (value == other.value)
-			return true;
+		return value == other.value;
+	}
 
-		return **this == *other;
+	size_t hash() const
+	{
+		return value->hash;
 	}
 
-	bool operator!=(const SharedString &other) const
+	bool operator!=(const BasicSharedString &other) const
 	{
 		return !(*this == other);
 	}
 
-	SharedString &operator=(const SharedString &other)
+	BasicSharedString &operator=(const BasicSharedString &other)
 	{
 		Copy(other);
 		return *this;
 	}
 
-	SharedString &operator=(SharedString &&other)
+	BasicSharedString &operator=(BasicSharedString &&other)
 	{
 		Drop();
 		value = other.value;
@@ -150,14 +173,17 @@ public:
 	}
 };
 
+typedef BasicSharedString<SingleThreadRefCount> SharedString;
+typedef BasicSharedString<AtomicRefCount> ConcurrentSharedString;
+
 namespace std
 {
-	template <>
-	struct hash<SharedString>
+	template <typename RefCount>
+	struct hash<BasicSharedString<RefCount>>
 	{
-		size_t operator()(const SharedString & str) const
+		size_t operator()(const BasicSharedString<RefCount> & str) const
 		{
-			return std::hash<std::string>()(*str);
+			return str.hash();
 		}
 	};
 }
@@ -0,0 +1,64 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(STRING_ID_TABLE_H)
+#define STRING_ID_TABLE_H
+
+#include "SharedString.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Numbers SharedStrings densely, so that structures that hold many strings
+ * can store a 32-bit id in place of each one.  Ids are never released; the
+ * table only grows.  Like SharedString, the table is not thread-safe.
+ */
+class StringIdTable
+{
+public:
+	typedef uint32_t Id;
+
+private:
+	std::vector<SharedString> strings;
+	std::unordered_map<SharedString, Id> ids;
+
+public:
+	Id intern(const SharedString &str);
+
+	const SharedString & get(Id id) const
+	{
+		assert(id < strings.size());
+		return strings[id];
+	}
+
+	size_t size() const
+	{
+		return strings.size();
+	}
+};
+
+#endif // #if !defined(STRING_ID_TABLE_H)
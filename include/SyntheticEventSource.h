@@ -0,0 +1,82 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(SYNTHETICEVENTSOURCE_H)
+#define SYNTHETICEVENTSOURCE_H
+
+#include "EventSource.h"
+#include "ProfilerTypes.h"
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#include <string>
+
+class MemoryEventSource;
+
+/*
+ * A deterministic stream of made-up events, for benchmarking the ingest path
+ * without a real pmclog file.  Every process execs /synthetic/bin/prog and
+ * maps in images - 1 shared libraries, and then the samples are spread
+ * randomly across the processes.  A sample starts a new callchain with
+ * probability uniqueRatio and otherwise repeats a callchain that was already
+ * generated.  The same parameters always produce the same events.
+ */
+class SyntheticEventSource : public EventSource
+{
+public:
+	struct Params
+	{
+		unsigned pids;
+		unsigned depth;
+		double uniqueRatio;
+		unsigned images;
+		uint64_t samples;
+		uint64_t seed;
+	};
+
+	static const Params DEFAULT_PARAMS;
+
+	static const TargetAddr EXEC_BASE = 0x400000;
+	static const TargetAddr LIB_BASE = 0x800000000;
+	static const TargetAddr IMAGE_SPAN = 0x1000000;
+	static const pid_t FIRST_PID = 100;
+
+private:
+	Params params;
+
+	template <typename Sink>
+	void Generate(Sink &) const;
+
+	static std::string LibraryPath(unsigned image);
+
+public:
+	explicit SyntheticEventSource(const Params &);
+
+	/* Append the generated events to a MemoryEventSource. */
+	void Record(MemoryEventSource &) const;
+
+	virtual bool Feed(Profiler &);
+};
+
+#endif // #if !defined(SYNTHETICEVENTSOURCE_H)
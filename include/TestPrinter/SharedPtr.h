@@ -27,8 +27,8 @@
 #include <string.h>
 #include <ostream>
 
-template <typename T>
-void PrintTo(const SharedPtr<T> &ptr, ::std::ostream *os)
+template <typename T, typename RefCount>
+void PrintTo(const SharedPtr<T, RefCount> &ptr, ::std::ostream *os)
 {
 	*os << ptr.get();
 }
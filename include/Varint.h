@@ -0,0 +1,169 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(VARINT_H)
+#define VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string_view>
+#include <vector>
+
+/*
+ * LEB128 variable-length integers.  Signed values are zigzag-encoded so that
+ * small negative deltas stay small.
+ */
+class VarintWriter
+{
+	std::vector<uint8_t> & buf;
+
+public:
+	explicit VarintWriter(std::vector<uint8_t> & b)
+	  : buf(b)
+	{
+	}
+
+	static uint64_t ZigZag(int64_t val)
+	{
+		return ((static_cast<uint64_t>(val) << 1) ^
+		    static_cast<uint64_t>(val >> 63));
+	}
+
+	void put(uint64_t val)
+	{
+		while (val >= 0x80) {
+			buf.push_back(static_cast<uint8_t>(val) | 0x80);
+			val >>= 7;
+		}
+		buf.push_back(static_cast<uint8_t>(val));
+	}
+
+	void putSigned(int64_t val)
+	{
+		put(ZigZag(val));
+	}
+
+	void putString(std::string_view str)
+	{
+		put(str.size());
+		buf.insert(buf.end(), str.begin(), str.end());
+	}
+};
+
+/*
+ * Decodes varints in place.  Running off the end of the buffer or reading
+ * an over-long varint sets the error flag and returns 0, so a caller can
+ * check failed() once after decoding a batch of values.
+ */
+class VarintReader
+{
+	const uint8_t *p;
+	const uint8_t *end;
+	bool error;
+
+public:
+	VarintReader(const char *buf, size_t len)
+	  : p(reinterpret_cast<const uint8_t *>(buf)),
+	    end(reinterpret_cast<const uint8_t *>(buf) + len),
+	    error(false)
+	{
+	}
+
+	static int64_t UnZigZag(uint64_t val)
+	{
+		return (static_cast<int64_t>(val >> 1) ^
+		    -static_cast<int64_t>(val & 1));
+	}
+
+	uint64_t get()
+	{
+		uint64_t val = 0;
+		unsigned shift;
+
+		for (shift = 0; shift < 64; shift += 7) {
+			if (p == end)
+				break;
+
+			uint8_t byte = *p++;
+			val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				return (val);
+		}
+
+		error = true;
+		return (0);
+	}
+
+	int64_t getSigned()
+	{
+		return (UnZigZag(get()));
+	}
+
+	std::string_view getString()
+	{
+		uint64_t len = get();
+
+		if (len > static_cast<uint64_t>(end - p)) {
+			error = true;
+			return (std::string_view());
+		}
+
+		std::string_view str(reinterpret_cast<const char *>(p), len);
+		p += len;
+		return (str);
+	}
+
+	/*
+	 * Reads a count of items that are each at least minSize bytes long.
+	 * A count that could not fit in what is left of the buffer is an
+	 * error, so it's safe to size an allocation with the result.
+	 */
+	uint64_t getCount(size_t minSize = 1)
+	{
+		uint64_t count = get();
+
+		if (count > static_cast<uint64_t>(end - p) / minSize) {
+			error = true;
+			return (0);
+		}
+		return (count);
+	}
+
+	bool atEnd() const
+	{
+		return (p == end);
+	}
+
+	void setFailed()
+	{
+		error = true;
+	}
+
+	bool failed() const
+	{
+		return error;
+	}
+};
+
+#endif // #if !defined(VARINT_H)
@@ -36,6 +36,8 @@ public:
 	MOCK_METHOD0(GetKernelAddressSpace, AddressSpace &());
 	MOCK_METHOD1(GetProcessAddressSpace, AddressSpace &(pid_t pid));
 	MOCK_METHOD1(ReplaceAddressSpace, AddressSpace & (pid_t pid));
+	MOCK_METHOD2(ForkAddressSpace, AddressSpace & (pid_t parent, pid_t child));
+	MOCK_METHOD1(ReleaseAddressSpace, void (pid_t pid));
 };
 
 #endif
@@ -57,10 +57,12 @@ Image::GetFrame(TargetAddr offset)
 	return MockImage::MockObj().GetFrame(this, offset);
 }
 
-Image::Image(SharedString n)
+Image::Image(SharedString n, Arena *)
   : imageFile(n)
 {}
 
 Image::~Image() {}
 
+DwarfResolver::~DwarfResolver() {}
+
 #endif
@@ -40,7 +40,7 @@ private:
 public:
 	MOCK_METHOD1(GetImage, Image *(SharedString name));
 	MOCK_METHOD0(GetUnmappedImage, Image &());
-	MOCK_METHOD0(MapAll, void ());
+	MOCK_METHOD1(MapAll, void (bool));
 
 	Image * ExpectGetImage(SharedString name)
 	{
@@ -58,8 +58,10 @@ public:
 
 	Image * ExpectGetUnmappedImage()
 	{
-		if (!unmapped)
+		if (!unmapped) {
 			unmapped = AllocImage("<unknown>");
+			unmapped->SetLoadInfo({0, false});
+		}
 
 		EXPECT_CALL(*this, GetUnmappedImage())
 		    .Times(1)
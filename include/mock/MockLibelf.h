@@ -36,6 +36,7 @@ class MockLibelf : public GlobalMockBase<MockLibelf>
 {
 public:
 	MOCK_METHOD3(elf_begin, Elf *(int, Elf_Cmd, Elf *));
+	MOCK_METHOD2(gelf_getehdr, GElf_Ehdr *(Elf *, GElf_Ehdr*));
 	MOCK_METHOD2(elf_getphdrnum, int(Elf *, size_t *));
 	MOCK_METHOD3(gelf_getphdr, GElf_Phdr *(Elf *, int, GElf_Phdr*));
 	MOCK_METHOD1(elf_end, int (Elf *));
@@ -47,6 +48,12 @@ elf_begin(int fd, Elf_Cmd cmd, Elf *ar)
 	return MockLibelf::MockObj().elf_begin(fd, cmd, ar);
 }
 
+GElf_Ehdr *
+gelf_getehdr(Elf *elf, GElf_Ehdr *dst)
+{
+	return MockLibelf::MockObj().gelf_getehdr(elf, dst);
+}
+
 int
 elf_getphdrnum(Elf *elf, size_t *phnum)
 {
@@ -38,6 +38,9 @@ public:
 	MOCK_METHOD1(GetAggregationList, void (AggregationList &));
 	MOCK_METHOD1(HandleExec, void (const ProcessExec &));
 	MOCK_METHOD2(HandleMapIn, void (pid_t pid, const char *path));
+	MOCK_METHOD2(HandleFork, void (pid_t parent, pid_t child));
+	MOCK_METHOD1(HandleExit, void (pid_t pid));
+	MOCK_METHOD0(GetCallchainStore, CallchainStore *());
 };
 
 #endif
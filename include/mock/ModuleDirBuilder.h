@@ -0,0 +1,90 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(MOCK_MODULEDIRBUILDER_H)
+#define MOCK_MODULEDIRBUILDER_H
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Lays out a module path under a temporary directory, for tests that look
+ * kernel modules up in it.  Everything is removed again on destruction.
+ */
+class ModuleDirBuilder
+{
+	std::string root;
+	std::vector<std::string> files;
+	std::vector<std::string> dirs;
+
+public:
+	ModuleDirBuilder()
+	{
+		char tmp[] = "/tmp/modulepath.XXXXXX";
+		if (mkdtemp(tmp) != NULL)
+			root = tmp;
+	}
+
+	~ModuleDirBuilder()
+	{
+		for (auto it = files.rbegin(); it != files.rend(); ++it)
+			unlink(it->c_str());
+		for (auto it = dirs.rbegin(); it != dirs.rend(); ++it)
+			rmdir(it->c_str());
+		rmdir(root.c_str());
+	}
+
+	ModuleDirBuilder(const ModuleDirBuilder &) = delete;
+	ModuleDirBuilder & operator=(const ModuleDirBuilder &) = delete;
+
+	/* The full path of a directory of the module path. */
+	std::string Dir(const std::string & dir) const
+	{
+		return (root + '/' + dir);
+	}
+
+	std::string AddDir(const std::string & dir)
+	{
+		std::string path(Dir(dir));
+		mkdir(path.c_str(), 0700);
+		dirs.push_back(path);
+		return (path);
+	}
+
+	std::string AddFile(const std::string & dir, const std::string & name)
+	{
+		std::string path(Dir(dir) + '/' + name);
+		int fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0600);
+		if (fd >= 0)
+			::close(fd);
+		files.push_back(path);
+		return (path);
+	}
+};
+
+#endif // #if !defined(MOCK_MODULEDIRBUILDER_H)
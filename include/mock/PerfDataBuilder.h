@@ -0,0 +1,222 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#ifndef MOCK_PERFDATA_BUILDER_H
+#define MOCK_PERFDATA_BUILDER_H
+
+#include "PerfDataReader.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+ * Builds an in-memory perf.data file in the format that "perf record"
+ * writes, for tests that feed raw records to the decoders.
+ */
+class PerfDataBuilder
+{
+	std::vector<uint64_t> sampleTypes;
+	std::vector<char> records;
+	mutable std::vector<char> file;
+
+	static const size_t ATTR_SIZE = 136;
+
+	static size_t RoundUp(size_t len)
+	{
+		return ((len + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1));
+	}
+
+	template <typename T>
+	T & AddFixed(uint32_t type, uint16_t misc, size_t extra = 0)
+	{
+		char *rec = AddRecord(type, misc, sizeof(T) + RoundUp(extra));
+		return *reinterpret_cast<T *>(rec);
+	}
+
+	void Put(std::vector<char> & buf, const void *data, size_t len) const
+	{
+		const char *p = static_cast<const char *>(data);
+		buf.insert(buf.end(), p, p + len);
+	}
+
+	void Put64(std::vector<char> & buf, uint64_t val) const
+	{
+		Put(buf, &val, sizeof(val));
+	}
+
+public:
+	static const uint64_t DEFAULT_SAMPLE_TYPE =
+	    PerfDataReader::SAMPLE_IDENTIFIER | PerfDataReader::SAMPLE_IP |
+	    PerfDataReader::SAMPLE_TID | PerfDataReader::SAMPLE_TIME |
+	    PerfDataReader::SAMPLE_CPU | PerfDataReader::SAMPLE_PERIOD |
+	    PerfDataReader::SAMPLE_CALLCHAIN;
+
+	explicit PerfDataBuilder(uint64_t sampleType = DEFAULT_SAMPLE_TYPE)
+	  : sampleTypes(1, sampleType)
+	{
+	}
+
+	void AddAttr(uint64_t sampleType)
+	{
+		sampleTypes.push_back(sampleType);
+	}
+
+	char * AddRecord(uint32_t type, uint16_t misc, size_t len)
+	{
+		size_t off = records.size();
+		PerfEventHeader header = {
+			.type = type,
+			.misc = misc,
+			.size = static_cast<uint16_t>(len),
+		};
+
+		records.resize(off + len);
+		memcpy(&records[off], &header, std::min(len, sizeof(header)));
+		return &records[off];
+	}
+
+	void AddComm(pid_t pid, const std::string & comm, bool exec)
+	{
+		auto & rec = AddFixed<PerfRecordComm>(PerfDataRecord::COMM,
+		    exec ? PerfDataRecord::MISC_COMM_EXEC : 0, comm.size() + 1);
+		rec.pid = rec.tid = pid;
+		memcpy(&rec + 1, comm.c_str(), comm.size() + 1);
+	}
+
+	void AddExit(pid_t pid, pid_t tid)
+	{
+		auto & rec = AddFixed<PerfRecordExit>(PerfDataRecord::EXIT, 0);
+		rec.pid = pid;
+		rec.tid = tid;
+	}
+
+	void AddFork(pid_t ppid, pid_t pid, pid_t tid)
+	{
+		auto & rec = AddFixed<PerfRecordFork>(PerfDataRecord::FORK, 0);
+		rec.pid = pid;
+		rec.ppid = ppid;
+		rec.tid = tid;
+	}
+
+	void AddMmap(pid_t pid, uint64_t addr, uint64_t pgoff,
+	    const std::string & path)
+	{
+		auto & rec = AddFixed<PerfRecordMmap>(PerfDataRecord::MMAP, 0,
+		    path.size() + 1);
+		rec.pid = rec.tid = pid;
+		rec.addr = addr;
+		rec.len = 0x1000;
+		rec.pgoff = pgoff;
+		memcpy(&rec + 1, path.c_str(), path.size() + 1);
+	}
+
+	void AddMmap2(pid_t pid, uint64_t addr, uint64_t pgoff, uint32_t prot,
+	    const std::string & path)
+	{
+		auto & rec = AddFixed<PerfRecordMmap2>(PerfDataRecord::MMAP2, 0,
+		    path.size() + 1);
+		rec.pid = rec.tid = pid;
+		rec.addr = addr;
+		rec.len = 0x1000;
+		rec.pgoff = pgoff;
+		rec.prot = prot;
+		memcpy(&rec + 1, path.c_str(), path.size() + 1);
+	}
+
+	/* Add a sample laid out according to the first event's sample_type. */
+	void AddSample(pid_t pid, uint64_t ip, const std::vector<uint64_t> & chain)
+	{
+		std::vector<char> body;
+		uint64_t type = sampleTypes.at(0);
+
+		if (type & PerfDataReader::SAMPLE_IDENTIFIER)
+			Put64(body, 1);
+		if (type & PerfDataReader::SAMPLE_IP)
+			Put64(body, ip);
+		if (type & PerfDataReader::SAMPLE_TID)
+			Put64(body, (static_cast<uint64_t>(pid) << 32) | pid);
+		if (type & PerfDataReader::SAMPLE_TIME)
+			Put64(body, 12345);
+		if (type & PerfDataReader::SAMPLE_ADDR)
+			Put64(body, 0);
+		if (type & PerfDataReader::SAMPLE_ID)
+			Put64(body, 1);
+		if (type & PerfDataReader::SAMPLE_STREAM_ID)
+			Put64(body, 1);
+		if (type & PerfDataReader::SAMPLE_CPU)
+			Put64(body, 3);
+		if (type & PerfDataReader::SAMPLE_PERIOD)
+			Put64(body, 4000);
+		if (type & PerfDataReader::SAMPLE_CALLCHAIN) {
+			Put64(body, chain.size());
+			Put(body, chain.data(), chain.size() * sizeof(uint64_t));
+		}
+
+		char *rec = AddRecord(PerfDataRecord::SAMPLE, 0,
+		    sizeof(PerfEventHeader) + body.size());
+		memcpy(rec + sizeof(PerfEventHeader), body.data(), body.size());
+	}
+
+	void AddGarbage(size_t len)
+	{
+		records.resize(records.size() + len, 0x5a);
+	}
+
+	/* Assemble the header, the event attributes and the data section. */
+	const char * data() const
+	{
+		PerfFileHeader header;
+
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, "PERFILE2", sizeof(header.magic));
+		header.size = sizeof(header);
+		header.attrSize = ATTR_SIZE;
+		header.attrs.offset = sizeof(header);
+		header.attrs.size = sampleTypes.size() * ATTR_SIZE;
+		header.data.offset = header.attrs.offset + header.attrs.size;
+		header.data.size = records.size();
+
+		file.clear();
+		Put(file, &header, sizeof(header));
+		for (uint64_t type : sampleTypes) {
+			size_t off = file.size();
+			file.resize(off + ATTR_SIZE);
+			memcpy(&file[off + PerfDataReader::ATTR_SAMPLE_TYPE_OFFSET],
+			    &type, sizeof(type));
+		}
+		Put(file, records.data(), records.size());
+
+		return file.data();
+	}
+
+	size_t size() const
+	{
+		return sizeof(PerfFileHeader) + sampleTypes.size() * ATTR_SIZE +
+		    records.size();
+	}
+};
+
+#endif
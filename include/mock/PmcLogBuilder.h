@@ -0,0 +1,163 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#ifndef MOCK_PMCLOG_BUILDER_H
+#define MOCK_PMCLOG_BUILDER_H
+
+#include "PmcLogReader.h"
+
+#include <pmc.h>
+#include <pmclog.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+ * Builds an in-memory pmclog buffer in the format that hwpmc writes, for
+ * tests that feed raw records to the decoders.
+ */
+class PmcLogBuilder
+{
+	std::vector<char> log;
+	uint64_t tsc;
+
+	static size_t RoundUp(size_t len)
+	{
+		return ((len + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1));
+	}
+
+	template <typename T>
+	T & AddFixed(pmclog_type type, size_t extra = 0)
+	{
+		size_t len = sizeof(T) + RoundUp(extra);
+		char *rec = AddRecord(type, len);
+		return *reinterpret_cast<T *>(rec);
+	}
+
+public:
+	PmcLogBuilder()
+	  : tsc(0)
+	{
+	}
+
+	void SetTimestamp(uint64_t t)
+	{
+		tsc = t;
+	}
+
+	char * AddRecord(uint32_t type, size_t len)
+	{
+		size_t off = log.size();
+		PmcLogHeader header = {
+			.header = (PmcLogRecord::HEADER_MAGIC << 24) |
+			    (type << 16) | static_cast<uint32_t>(len),
+			.spare = 0,
+			.tsc = tsc,
+		};
+
+		log.resize(off + len);
+		memcpy(&log[off], &header, std::min(len, sizeof(header)));
+		return &log[off];
+	}
+
+	void AddInitialize(uint64_t tscFreq, int64_t tsSec = 0)
+	{
+		auto & rec = AddFixed<PmcLogInitialize>(PMCLOG_TYPE_INITIALIZE);
+		rec.tscFreq = tscFreq;
+		rec.tsSec = tsSec;
+	}
+
+	void AddCallchain(pid_t pid, bool usermode,
+	    const std::vector<uintptr_t> & pcs)
+	{
+		auto & rec = AddFixed<PmcLogCallchain>(PMCLOG_TYPE_CALLCHAIN,
+		    pcs.size() * sizeof(uintptr_t));
+		rec.pid = pid;
+		rec.cpuflags = usermode ? PMC_CC_F_USERSPACE : 0;
+		memcpy(&rec + 1, pcs.data(), pcs.size() * sizeof(uintptr_t));
+	}
+
+	void AddMapIn(pid_t pid, uint64_t start, const std::string & path)
+	{
+		auto & rec = AddFixed<PmcLogMapIn>(PMCLOG_TYPE_MAP_IN,
+		    path.size() + 1);
+		rec.pid = pid;
+		rec.start = start;
+		memcpy(&rec + 1, path.c_str(), path.size() + 1);
+	}
+
+	void AddMapOut(pid_t pid, uint64_t start, uint64_t end)
+	{
+		auto & rec = AddFixed<PmcLogMapOut>(PMCLOG_TYPE_MAP_OUT);
+		rec.pid = pid;
+		rec.start = start;
+		rec.end = end;
+	}
+
+	void AddExec(pid_t pid, const std::string & path, uint64_t dynaddr)
+	{
+		auto & rec = AddFixed<PmcLogProcExec>(PMCLOG_TYPE_PROCEXEC,
+		    path.size() + 1);
+		rec.pid = pid;
+		rec.dynaddr = dynaddr;
+		memcpy(&rec + 1, path.c_str(), path.size() + 1);
+	}
+
+	void AddExit(pid_t pid)
+	{
+		auto & rec = AddFixed<PmcLogProcExit>(PMCLOG_TYPE_PROCEXIT);
+		rec.pid = pid;
+	}
+
+	void AddSysExit(pid_t pid)
+	{
+		auto & rec = AddFixed<PmcLogSysExit>(PMCLOG_TYPE_SYSEXIT);
+		rec.pid = pid;
+	}
+
+	void AddFork(pid_t oldpid, pid_t newpid)
+	{
+		auto & rec = AddFixed<PmcLogProcFork>(PMCLOG_TYPE_PROCFORK);
+		rec.oldpid = oldpid;
+		rec.newpid = newpid;
+	}
+
+	void AddGarbage(size_t len)
+	{
+		log.resize(log.size() + len, 0x5a);
+	}
+
+	const char * data() const
+	{
+		return log.data();
+	}
+
+	size_t size() const
+	{
+		return log.size();
+	}
+};
+
+#endif
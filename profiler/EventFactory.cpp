@@ -25,99 +25,524 @@
 __FBSDID("$FreeBSD$");
 
 #include "EventFactory.h"
+#include "PerfDataEventSource.h"
+#include "PerfDataReader.h"
+#include "PmcLogEventSource.h"
+#include "PmcLogIndex.h"
+#include "PmcLogReader.h"
 #include "Profiler.h"
+#include "ShardDecoder.h"
 #include "ProcessState.h"
 #include "Sample.h"
 
 #include <err.h>
+#include <errno.h>
 #include <stdio.h>
-#include <sys/queue.h>
 #include <pmc.h>
 #include <pmclog.h>
-#include <assert.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 extern void usage(void);
 
-void
-EventFactory::createEvents(Profiler& profiler)
+static uint64_t
+countPmcLogSamples(const char *buf, size_t len)
+{
+	size_t off, reclen;
+	uint64_t samples;
+
+	off = 0;
+	samples = 0;
+	while ((reclen = PmcLogReader::RecordLength(buf, off, len)) != 0) {
+		if (PmcLogRecord(buf + off).getType() == PMCLOG_TYPE_CALLCHAIN)
+			samples++;
+		off += reclen;
+	}
+
+	return (samples);
+}
+
+static uint64_t
+countPerfDataSamples(const char *buf, size_t len)
+{
+	PerfDataReader reader(buf, len);
+	PerfDataRecord record;
+	uint64_t samples;
+
+	samples = 0;
+	if (!reader.open())
+		return (0);
+
+	while (reader.next(record)) {
+		if (record.getType() == PerfDataRecord::SAMPLE)
+			samples++;
+	}
+
+	return (samples);
+}
+
+static uint64_t
+countSamples(const MappedLog & log, bool isPerfData)
+{
+	if (isPerfData)
+		return (countPerfDataSamples(log.getData(), log.getLength()));
+	else
+		return (countPmcLogSamples(log.getData(), log.getLength()));
+}
+
+bool
+EventFactory::mapSamplesFile(const std::string& path, MappedLog& log)
 {
-	pmclog_ev pmcEvent;
-	void *logCookie;
 	int fd;
-	
-	fd = open(profiler.getDataFile().c_str(), O_RDONLY);
+
+	fd = open(path.c_str(), O_RDONLY);
 	if (fd < 0) {
-		warn("Could not open data file %s\n", 
-		     profiler.getDataFile().c_str());
+		warn("Could not open data file %s\n", path.c_str());
 		usage();
-		return;
+		return (false);
 	}
 
-	logCookie = pmclog_open(fd);
-	if (logCookie == NULL) {
-		warn("Could not open log file!\n");
-		close(fd);
+	if (!log.map(fd))
+		err(1, "Could not map data file %s", path.c_str());
+
+	/* The mapping outlives the descriptor. */
+	close(fd);
+	return (true);
+}
+
+void
+EventFactory::createEvents(Profiler& profiler)
+{
+	std::unique_ptr<EventSource> source;
+	MappedLog log;
+	bool isPerfData;
+
+	if (!mapSamplesFile(profiler.getDataFile(), log))
 		return;
+
+	isPerfData = PerfDataReader::IsPerfData(log.getData(),
+	    log.getLength());
+
+	/*
+	 * --max-samples is turned into a sample rate up front; counting the
+	 * samples only needs the record headers.
+	 */
+	if (profiler.getMaxSamples() != 0) {
+		uint64_t rate = SampleDecimator::RateFor(
+		    countSamples(log, isPerfData), profiler.getMaxSamples());
+
+		if (rate > profiler.getDecimator().getRate())
+			profiler.setSampleRate(rate);
+	}
+
+	/* Linux perf.data files are decoded serially. */
+	if (isPerfData) {
+		if (profiler.getTimeWindow().isSet())
+			errx(1, "--from and --to are not supported for "
+			    "perf.data files");
+		if (profiler.getJobs() > 1)
+			warnx("%s: -j is ignored for perf.data files",
+			    profiler.getDataFile().c_str());
+		source = std::make_unique<PerfDataEventSource>(log.getData(),
+		    log.getLength(), profiler.getDecimator());
+	} else
+		source = std::make_unique<PmcLogEventSource>(log.getData(),
+		    log.getLength(), profiler.getJobs(),
+		    profiler.getTimeWindow());
+
+	if (!source->Feed(profiler))
+		errx(1, "Got error reading from samples file");
+}
+
+/*
+ * Decode several samples files, each into its own Profiler so that every
+ * file keeps its own pids and address spaces.  pmclog files are decoded on a
+ * thread each, but their samples are replayed into their Profiler on this
+ * thread, so the ImageFactory that the Profilers share is only ever used
+ * from here.
+ */
+void
+EventFactory::createEvents(const std::vector<Profiler *>& profilers)
+{
+	struct Input
+	{
+		MappedLog log;
+		bool isPerfData = false;
+		uint64_t fromTsc = 0;
+		uint64_t toTsc = UINT64_MAX;
+		ShardDecoder::SegmentList segments;
+		bool done = false;
+		bool ok = false;
+	};
+	std::vector<std::unique_ptr<Input>> inputs;
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable cv;
+
+	for (Profiler * profiler : profilers) {
+		auto input = std::make_unique<Input>();
+
+		if (!mapSamplesFile(profiler->getDataFile(), input->log))
+			return;
+
+		input->isPerfData = PerfDataReader::IsPerfData(
+		    input->log.getData(), input->log.getLength());
+
+		if (profiler->getTimeWindow().isSet()) {
+			if (input->isPerfData)
+				errx(1, "--from and --to are not supported for "
+				    "perf.data files");
+
+			PmcLogIndex index(input->log.getData(),
+			    input->log.getLength());
+			if (!index.build())
+				errx(1, "Got error reading from samples file %s",
+				    profiler->getDataFile().c_str());
+			if (!index.resolve(profiler->getTimeWindow(),
+			    input->fromTsc, input->toTsc))
+				errx(1, "--from and --to need a log that records "
+				    "its TSC frequency");
+		}
+
+		inputs.push_back(std::move(input));
+	}
+
+	/* --max-samples applies to all of the files together. */
+	Profiler & first = *profilers.front();
+	if (first.getMaxSamples() != 0) {
+		uint64_t total = 0;
+		for (const auto & input : inputs)
+			total += countSamples(input->log, input->isPerfData);
+
+		uint64_t rate = SampleDecimator::RateFor(total,
+		    first.getMaxSamples());
+		if (rate > first.getDecimator().getRate()) {
+			for (Profiler * profiler : profilers)
+				profiler->setSampleRate(rate);
+		}
+	}
+
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		CallchainStore *store = profilers[i]->getCallchainStore();
+
+		/*
+		 * Decoding a whole file ahead interns all of its chains.  If
+		 * the profiler doesn't keep every chain, the file is decoded
+		 * in its turn, a few shards at a time.
+		 */
+		if (inputs[i]->isPerfData || store == nullptr)
+			continue;
+
+		Input & input = *inputs[i];
+		SampleDecimator decimator = profilers[i]->getDecimator();
+		workers.emplace_back([&input, &lock, &cv, store, decimator]() {
+			ShardDecoder decoder(input.log.getData(),
+			    input.log.getLength(), input.fromTsc, input.toTsc,
+			    decimator);
+			ShardDecoder::SegmentList segments;
+			bool ok = decoder.decodeSegments(segments, *store);
+
+			std::lock_guard<std::mutex> guard(lock);
+			input.segments = std::move(segments);
+			input.ok = ok;
+			input.done = true;
+			cv.notify_all();
+		});
+	}
+
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		Input & input = *inputs[i];
+		Profiler & profiler = *profilers[i];
+
+		/*
+		 * perf.data samples go straight into the Profiler, which
+		 * shares its ImageFactory with the others, so they can't be
+		 * decoded on another thread.
+		 */
+		if (input.isPerfData) {
+			if (profiler.getJobs() > 1)
+				warnx("%s: -j is ignored for perf.data files",
+				    profiler.getDataFile().c_str());
+
+			PerfDataEventSource source(input.log.getData(),
+			    input.log.getLength(), profiler.getDecimator());
+			if (!source.Feed(profiler))
+				errx(1, "Got error reading from samples file %s",
+				    profiler.getDataFile().c_str());
+			continue;
+		}
+
+		if (profiler.getCallchainStore() == nullptr) {
+			ShardDecoder decoder(input.log.getData(),
+			    input.log.getLength(), input.fromTsc, input.toTsc,
+			    profiler.getDecimator());
+			decoder.decode(profiler, profiler.getJobs());
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		cv.wait(guard, [&input]() { return input.done; });
+		ShardDecoder::SegmentList segments = std::move(input.segments);
+		guard.unlock();
+
+		if (!input.ok)
+			errx(1, "Got error reading from samples file %s",
+			    profiler.getDataFile().c_str());
+
+		for (const auto & segment : segments)
+			segment->replay(profiler, *profiler.getCallchainStore());
 	}
 
-	while (pmclog_read(logCookie, &pmcEvent) == 0) {
-		assert(pmcEvent.pl_state == PMCLOG_OK);
+	for (auto & thread : workers)
+		thread.join();
+}
+
+bool
+EventFactory::processLog(Profiler& profiler, const char *buf, size_t len)
+{
+	PmcLogReader reader(buf, len);
+	PmcLogRecord record;
+
+	while (reader.next(record))
+		processRecord(profiler, record);
+
+	return (!reader.failed());
+}
+
+/*
+ * Process only the samples taken between fromTsc and toTsc.  Records that
+ * change process state are always processed, so that samples in the window
+ * are still resolved against the right mappings, but the samples in blocks
+ * that lie wholly outside of the window are never looked at.
+ */
+bool
+EventFactory::processLog(Profiler& profiler, const PmcLogIndex& index,
+    uint64_t fromTsc, uint64_t toTsc)
+{
+	PmcLogRecord record;
+
+	for (const auto & block : index.getBlocks()) {
+		if (block.maxTsc < fromTsc || block.minTsc > toTsc) {
+			for (size_t i = block.firstEvent; i < block.lastEvent; ++i)
+				processRecord(profiler, index.getEvent(i));
+			continue;
+		}
+
+		PmcLogReader reader(index.getData() + block.offset,
+		    block.length);
+		while (reader.next(record)) {
+			if (record.getType() == PMCLOG_TYPE_CALLCHAIN &&
+			    (record.getTimestamp() < fromTsc ||
+			    record.getTimestamp() > toTsc))
+				continue;
+			processRecord(profiler, record);
+		}
+
+		if (reader.failed())
+			return (false);
+	}
+
+	return (true);
+}
 
-		switch (pmcEvent.pl_type) {
-			case PMCLOG_TYPE_CLOSELOG:
-			case PMCLOG_TYPE_DROPNOTIFY:
-			case PMCLOG_TYPE_INITIALIZE:
+void
+EventFactory::processRecord(Profiler& profiler, const PmcLogRecord& record)
+{
+	switch (record.getType()) {
+		case PMCLOG_TYPE_CLOSELOG:
+		case PMCLOG_TYPE_DROPNOTIFY:
+		case PMCLOG_TYPE_INITIALIZE:
 #ifdef PMCLOG_TYPE_MAPPINGCHANGE
-			case PMCLOG_TYPE_MAPPINGCHANGE:
+		case PMCLOG_TYPE_MAPPINGCHANGE:
 #endif
-			case PMCLOG_TYPE_PMCALLOCATE:
-			case PMCLOG_TYPE_PMCATTACH:
-			case PMCLOG_TYPE_PMCDETACH:
-			case PMCLOG_TYPE_PROCCSW:
-			case PMCLOG_TYPE_PROCEXIT:
-			case PMCLOG_TYPE_PROCFORK:
-			case PMCLOG_TYPE_USERDATA:
-			case PMCLOG_TYPE_SYSEXIT:
-				break;
+		case PMCLOG_TYPE_PMCALLOCATE:
+#ifdef PMCLOG_TYPE_PMCALLOCATEDYN
+		case PMCLOG_TYPE_PMCALLOCATEDYN:
+#endif
+		case PMCLOG_TYPE_PMCATTACH:
+		case PMCLOG_TYPE_PMCDETACH:
+		case PMCLOG_TYPE_PROCCSW:
+		case PMCLOG_TYPE_USERDATA:
+			break;
 
-			case PMCLOG_TYPE_MAP_IN:
-				profiler.processMapIn(pmcEvent.pl_u.pl_mi.pl_pid, pmcEvent.pl_u.pl_mi.pl_start,
-						      pmcEvent.pl_u.pl_mi.pl_pathname);
-				break;
+		case PMCLOG_TYPE_PROCFORK: {
+			const auto & fork = record.get<PmcLogProcFork>();
+			profiler.processFork(fork.oldpid, fork.newpid);
+			break;
+		}
 
-			case PMCLOG_TYPE_MAP_OUT:
-				/* XXX Should handle this type of event. */
-				break;
+		case PMCLOG_TYPE_PROCEXIT:
+			profiler.processExit(record.get<PmcLogProcExit>().pid);
+			break;
 
-#ifdef PMCLOG_TYPE_PCSAMPLE
-			case PMCLOG_TYPE_PCSAMPLE:
-				profiler.processEvent(Sample(pmcEvent.pl_u.pl_s));
-				break;
-#endif
+		case PMCLOG_TYPE_SYSEXIT:
+			profiler.processExit(record.get<PmcLogSysExit>().pid);
+			break;
+
+		case PMCLOG_TYPE_MAP_IN: {
+			const auto & mapIn = record.get<PmcLogMapIn>();
+			profiler.processMapIn(mapIn.pid, mapIn.start,
+			    record.getPathname());
+			break;
+		}
+
+		case PMCLOG_TYPE_MAP_OUT: {
+			const auto & mapOut = record.get<PmcLogMapOut>();
+			profiler.processMapOut(mapOut.pid, mapOut.start,
+			    mapOut.end);
+			break;
+		}
 
-			case PMCLOG_TYPE_CALLCHAIN:
-				profiler.processEvent(Sample(pmcEvent.pl_u.pl_cc));
+		case PMCLOG_TYPE_CALLCHAIN:
+			if (!profiler.getDecimator().keep(record.getTimestamp(),
+			    record.get<PmcLogCallchain>().cpuflags))
 				break;
+			profiler.processEvent(Sample(
+			    record.get<PmcLogCallchain>().pid,
+			    record.getCallchainPCs(),
+			    record.getCallchainDepth()));
+			break;
+
+		case PMCLOG_TYPE_PROCEXEC: {
+			const auto & exec = record.get<PmcLogProcExec>();
+			profiler.processEvent(ProcessExec(exec.pid,
+			    std::string(record.getPathname()),
+			    exec.dynaddr));
+			break;
+		}
+
+		default:
+			warnx("unknown pmc event type %d", record.getType());
 
-			case PMCLOG_TYPE_PROCEXEC:
-				profiler.processEvent(ProcessExec(pmcEvent.pl_u.pl_x.pl_pid,
-				    std::string(pmcEvent.pl_u.pl_x.pl_pathname),
-				    pmcEvent.pl_u.pl_x.pl_dynaddr));
+	}
+}
+
+static volatile sig_atomic_t followInterrupted;
+
+static void
+followInterrupt(int)
+{
+	followInterrupted = 1;
+}
+
+static uint64_t
+monotonicSeconds()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec);
+}
+
+void
+EventFactory::followEvents(Profiler& profiler, const FollowOptions& opts,
+    const std::function<void()>& emit)
+{
+	std::vector<char> buf(FOLLOW_BUFFER_SIZE);
+	struct sigaction sa = {}, oldInt, oldTerm;
+	struct stat sb;
+	size_t have;
+	uint64_t lastEmit;
+	uint64_t lastSamples;
+	bool closed, dirty, isFile;
+	ssize_t len;
+	int fd;
+
+	if (profiler.getDataFile() == "-")
+		fd = STDIN_FILENO;
+	else
+		fd = open(profiler.getDataFile().c_str(), O_RDONLY);
+	if (fd < 0) {
+		warn("Could not open data file %s\n",
+		     profiler.getDataFile().c_str());
+		usage();
+		return;
+	}
+
+	/*
+	 * Running out of data in a regular file just means that pmcstat hasn't
+	 * written any more yet; the log only ends when pmcstat closes it.  A
+	 * pipe ends when the writer goes away.
+	 */
+	isFile = fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode);
+
+	/*
+	 * Without SA_RESTART, a read() that is blocked on an idle pipe fails
+	 * with EINTR, so the loop sees the signal.
+	 */
+	followInterrupted = 0;
+	sa.sa_handler = followInterrupt;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGINT, &sa, &oldInt);
+	sigaction(SIGTERM, &sa, &oldTerm);
+
+	have = 0;
+	closed = false;
+	dirty = false;
+	lastEmit = monotonicSeconds();
+	lastSamples = profiler.getSampleCount();
+	while (!closed && !followInterrupted) {
+		len = read(fd, buf.data() + have, buf.size() - have);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			err(1, "Could not read from samples file");
+		}
+
+		if (len == 0) {
+			if (!isFile)
 				break;
+			usleep(FOLLOW_POLL_USEC);
+		} else {
+			PmcLogReader reader(buf.data(), have + len, true);
+			PmcLogRecord record;
 
-			default:
-				warnx("unknown pmc event type %d", pmcEvent.pl_type);
+			while (reader.next(record)) {
+				if (record.getType() == PMCLOG_TYPE_CLOSELOG)
+					closed = true;
+				processRecord(profiler, record);
+				dirty = true;
+			}
 
+			if (reader.failed())
+				errx(1, "Got error reading from samples file");
+
+			have = have + len - reader.getOffset();
+			memmove(buf.data(), buf.data() + reader.getOffset(), have);
 		}
-	}
 
-	if (pmcEvent.pl_state != PMCLOG_EOF) {
-		err(1, "Got error reading from samples file");
+		if (!dirty)
+			continue;
+
+		if ((opts.everySamples != 0 &&
+		    profiler.getSampleCount() - lastSamples >= opts.everySamples) ||
+		    (opts.interval != 0 &&
+		    monotonicSeconds() - lastEmit >= opts.interval)) {
+			emit();
+			dirty = false;
+			lastEmit = monotonicSeconds();
+			lastSamples = profiler.getSampleCount();
+		}
 	}
 
-	pmclog_close(logCookie);
-	close(fd);
+	sigaction(SIGINT, &oldInt, NULL);
+	sigaction(SIGTERM, &oldTerm, NULL);
+
+	/* Always finish with a profile that covers everything seen. */
+	emit();
+
+	if (fd != STDIN_FILENO)
+		close(fd);
 }
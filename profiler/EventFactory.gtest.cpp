@@ -24,6 +24,7 @@
 #include "EventFactory.h"
 
 #include "Callframe.h"
+#include "PmcLogIndex.h"
 #include "ProcessState.h"
 #include "Profiler.h"
 #include "ProfilerTypes.h"
@@ -34,6 +35,7 @@
 #include "mock/MockImageFactory.h"
 #include "mock/MockOpen.h"
 #include "mock/MockSampleAggregationFactory.h"
+#include "mock/PmcLogBuilder.h"
 
 #include <err.h>
 #include <fcntl.h>
@@ -53,6 +55,9 @@ public:
 	MOCK_METHOD1(processSample, void (const Sample &));
 	MOCK_METHOD3(processMapIn, void (int, TargetAddr, std::string));
 	MOCK_METHOD1(processExec, void (const ProcessExec &));
+	MOCK_METHOD3(processMapOut, void (pid_t, TargetAddr, TargetAddr));
+	MOCK_METHOD2(processFork, void (pid_t, pid_t));
+	MOCK_METHOD1(processExit, void (pid_t));
 };
 
 void
@@ -62,65 +67,65 @@ Profiler::processEvent(const ProcessExec& processExec)
 }
 
 void
-Profiler::processEvent(const Sample& sample)
+Profiler::processEvent(const Sample& sample, uint64_t count)
 {
 	ProfilerMocker::MockObj().processSample(sample);
 }
 
-void
-Profiler::processMapIn(pid_t pid, TargetAddr map_start, const char * image)
+static CallchainStore chainStore;
+
+CallchainStore *
+Profiler::getCallchainStore()
 {
-	ProfilerMocker::MockObj().processMapIn(pid, map_start, image);
+	return &chainStore;
 }
 
-class LibpmcMocker : public GlobalMockBase<LibpmcMocker>
+void
+Profiler::processChain(const CallchainStore & store, pid_t pid, ChainId id,
+    uint64_t count)
 {
-public:
-	MOCK_METHOD1(pmclog_open, void *(int));
-	MOCK_METHOD2(pmclog_read, int (void *, pmclog_ev *));
-	MOCK_METHOD1(pmclog_close, void (void *));
-};
+	ProfilerMocker::MockObj().processSample(store.getSample(pid, id));
+}
 
-class GlobalLibpmcMock : public GlobalMock<LibpmcMocker>
+void
+Profiler::processMapIn(pid_t pid, TargetAddr map_start, const char * image)
 {
-public:
-	GlobalLibpmcMock()
-	{
-		// Ensure that the test doesn't get stuck in an infinite loop
-		// if it calls us with something we don't expect.
-		ON_CALL(**this, pmclog_read(_, _)).WillByDefault(Return(-1));
-	}
-};
+	ProfilerMocker::MockObj().processMapIn(pid, map_start, image);
+}
 
-void *
-pmclog_open(int fd)
+void
+Profiler::processMapOut(pid_t pid, TargetAddr start, TargetAddr end)
 {
-	return LibpmcMocker::MockObj().pmclog_open(fd);
+	ProfilerMocker::MockObj().processMapOut(pid, start, end);
 }
 
-int
-pmclog_read(void *cookie, pmclog_ev *ev)
+void
+Profiler::processFork(pid_t parent, pid_t child)
 {
-	return LibpmcMocker::MockObj().pmclog_read(cookie, ev);
+	ProfilerMocker::MockObj().processFork(parent, child);
 }
 
 void
-pmclog_close(void * cookie)
+Profiler::processExit(pid_t pid)
 {
-	return LibpmcMocker::MockObj().pmclog_close(cookie);
+	ProfilerMocker::MockObj().processExit(pid);
 }
 
 // Stubs
 void usage() {}
 void warn(const char *, ...) {}
-Image::Image(SharedString) {}
+Image::Image(SharedString, Arena *) {}
 Image::~Image() {}
+DwarfResolver::~DwarfResolver() {}
 Callframe::~Callframe() {}
 
 Profiler::Profiler(const std::string& dataFile, bool showlines,
-    const char* modulePathStr, AddressSpaceFactory & asFactory,
+    ModulePathIndex & moduleIndex, AddressSpaceFactory & asFactory,
     SampleAggregationFactory & aggFactory, ImageFactory & imgFactory)
   : m_dataFile(dataFile),
+    m_jobs(1),
+    m_maxSamples(0),
+    moduleIndex(moduleIndex),
     asFactory(asFactory),
     aggFactory(aggFactory),
     imgFactory(imgFactory)
@@ -128,18 +133,6 @@ Profiler::Profiler(const std::string& dataFile, bool showlines,
 }
 
 // Support code for individual test cases
-template <int depth>
-class SampleAddress
-{
-public:
-	typedef uintptr_t result_type;
-
-	result_type operator()(const Sample & s) const
-	{
-		return s.getAddress(depth);
-	}
-};
-
 class SampleCallchainMatcher
 {
 private:
@@ -172,55 +165,15 @@ public:
 	MockImageFactory imgFactory;
 	MockAddressSpaceFactory asFactory;
 	MockSampleAggregationFactory aggFactory;
-	GlobalLibpmcMock libpmcMock;
+	ModulePathIndex moduleIndex;
 	GlobalMock<ProfilerMocker> profilerMock;
-
-#ifdef PMCLOG_TYPE_PCSAMPLE
-	void
-	AddSampleExpectation(void * cookie, bool usermode, pid_t pid, TargetAddr pc)
-	{
-		pmclog_ev event = {
-			.pl_state = PMCLOG_OK,
-			.pl_type = PMCLOG_TYPE_PCSAMPLE,
-			.pl_u.pl_s = {
-				.pl_usermode = usermode,
-				.pl_pid = pid,
-				.pl_pc = pc + 1,
-			},
-		};
-		EXPECT_CALL(*libpmcMock, pmclog_read(cookie, _))
-		    .Times(1)
-		    .WillOnce(DoAll(
-		        SetArgPointee<1>(event),
-		        Return(0)
-		    )
-		);
-
-		EXPECT_CALL(*profilerMock, processSample(AllOf(
-			Property(&Sample::getProcessID, pid),
-			Property(&Sample::getChainDepth, 1),
-			Property(&Sample::isKernel, !usermode),
-			ResultOf(SampleAddress<0>(), pc))))
-		    .Times(1);
-
-	}
-#endif
+	PmcLogBuilder log;
 
 	void
-	AddCallchainExpectation(void * cookie, bool usermode,
-	    pid_t pid, std::vector<TargetAddr> chain)
+	AddCallchainExpectation(bool usermode, pid_t pid,
+	    std::vector<TargetAddr> chain)
 	{
-		pmclog_ev event = {
-			.pl_state = PMCLOG_OK,
-			.pl_type = PMCLOG_TYPE_CALLCHAIN,
-			.pl_u = {
-				.pl_cc = {
-					.pl_pid = static_cast<uint32_t>(pid),
-					.pl_cpuflags = usermode ? PMC_CC_F_USERSPACE : 0u,
-					.pl_npc = static_cast<uint32_t>(chain.size()),
-				},
-			},
-		};
+		std::vector<uintptr_t> pcs;
 
 		for (int i = 0; i < chain.size(); ++i) {
 			/*
@@ -233,16 +186,10 @@ public:
 			if (!usermode) {
 				chain[i] |= 0xffffffff00000000ULL;
 			}
-			event.pl_u.pl_cc.pl_pc[i] = chain[i] + 1;
+			pcs.push_back(chain[i] + 1);
 		}
 
-		EXPECT_CALL(*libpmcMock, pmclog_read(cookie, _))
-		    .Times(1)
-		    .WillOnce(DoAll(
-		        SetArgPointee<1>(event),
-		        Return(0)
-		    )
-		);
+		log.AddCallchain(pid, usermode, pcs);
 
 		EXPECT_CALL(*profilerMock, processSample(AllOf(
 			Property(&Sample::getProcessID, pid),
@@ -254,55 +201,17 @@ public:
 	}
 
 	void
-	AddMapInExpectation(void * cookie, pid_t pid, TargetAddr start, const char * file)
+	AddMapInExpectation(pid_t pid, TargetAddr start, const char * file)
 	{
-		pmclog_ev event = {
-			.pl_state = PMCLOG_OK,
-			.pl_type = PMCLOG_TYPE_MAP_IN,
-			.pl_u = {
-				.pl_mi = {
-					.pl_pid = pid,
-					.pl_start = start,
-				},
-			}
-		};
-
-		strlcpy(event.pl_u.pl_mi.pl_pathname, file, sizeof(event.pl_u.pl_mi.pl_pathname));
-
-		EXPECT_CALL(*libpmcMock, pmclog_read(cookie, _))
-		    .Times(1)
-		    .WillOnce(DoAll(
-		        SetArgPointee<1>(event),
-		        Return(0)
-		    )
-		);
+		log.AddMapIn(pid, start, file);
 
 		EXPECT_CALL(*profilerMock, processMapIn(pid, start, StrEq(file)));
 	}
 
 	void
-	AddExecExpectation(void * cookie, pid_t pid, std::string execname, TargetAddr start)
+	AddExecExpectation(pid_t pid, std::string execname, TargetAddr start)
 	{
-		pmclog_ev event = {
-			.pl_state = PMCLOG_OK,
-			.pl_type = PMCLOG_TYPE_PROCEXEC,
-			.pl_u = {
-				.pl_x = {
-					.pl_pid = pid,
-					.pl_dynaddr = start,
-				},
-			}
-		};
-
-		strlcpy(event.pl_u.pl_x.pl_pathname, execname.c_str(), sizeof(event.pl_u.pl_x.pl_pathname));
-
-		EXPECT_CALL(*libpmcMock, pmclog_read(cookie, _))
-		    .Times(1)
-		    .WillOnce(DoAll(
-		        SetArgPointee<1>(event),
-		        Return(0)
-		    )
-		);
+		log.AddExec(pid, execname, start);
 
 		EXPECT_CALL(*profilerMock, processExec(AllOf(
 		    Property(&ProcessExec::getProcessID, pid),
@@ -310,350 +219,281 @@ public:
 		    Property(&ProcessExec::getEntryAddr, start))));
 	}
 
-	void
-	AddUnhandledTypeExpectation(void * cookie, pmclog_type type)
-	{
-		pmclog_ev event = {
-			.pl_state = PMCLOG_OK,
-			.pl_type = type,
-		};
-
-		EXPECT_CALL(*libpmcMock, pmclog_read(cookie, _))
-		    .Times(1)
-		    .WillOnce(DoAll(
-		        SetArgPointee<1>(event),
-		        Return(0)
-		    ));
-	}
-
-	void
-	AddEofExpectation(void * cookie)
+	bool
+	ProcessLog(Profiler & profiler)
 	{
-		pmclog_ev event = {
-			.pl_state = PMCLOG_EOF,
-		};
-
-		EXPECT_CALL(*libpmcMock, pmclog_read(cookie, _))
-		    .Times(1).WillOnce(DoAll(
-		        SetArgPointee<1>(event),
-		        Return(-1)));
+		return EventFactory::processLog(profiler, log.data(),
+		    log.size());
 	}
 };
 
 TEST_F(EventFactoryTestSuite, TestEmptyPmclog)
 {
-	Profiler profiler("/tmp/samples.out", false, "", asFactory, aggFactory,
+	Profiler profiler("/tmp/samples.out", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
 
-	char cookie_val;
-	{
-		InSequence dummy;
+	EXPECT_TRUE(ProcessLog(profiler));
+}
 
-		// Use an arbitrary address for the cookie -- it's opaque
-		// to the user
-		void * cookie = &cookie_val;
+TEST_F(EventFactoryTestSuite, TestSingleCallchain)
+{
+	Profiler profiler("pmcstat.bin", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
 
-		const int fd = 12625;
-		mockOpen.ExpectOpen("/tmp/samples.out", O_RDONLY, fd);
+	AddCallchainExpectation(false, 90746, {0xe569d, 0x54896, 0x49564});
 
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
+	EXPECT_TRUE(ProcessLog(profiler));
+}
 
-		AddEofExpectation(cookie);
+TEST_F(EventFactoryTestSuite, TestMaxDepth)
+{
+	Profiler profiler("pmcstat.bin", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
 
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
-	}
+	AddCallchainExpectation(false, 90746,
+	    {0xf9d2, 0x296487, 0xefe892, 0x59dab});
 
-	EventFactory::createEvents(profiler);
+	EXPECT_TRUE(ProcessLog(profiler));
 }
 
-#ifdef PMCLOG_TYPE_PCSAMPLE
-TEST_F(EventFactoryTestSuite, TestSingleSample)
+TEST_F(EventFactoryTestSuite, TestKernelToUser)
 {
-	Profiler profiler("/root/pmc.log", false, "", asFactory, aggFactory,
+	Profiler profiler("pmcstat.bin", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
 
-	{
-		InSequence dummy;
-		char cookie_val;
+	// The userland part of a kernel callchain is cut off.
+	log.AddCallchain(561, false,
+	    {0xffffffff80001235, 0xffffffff80004568, 0x401001, 0x402001});
 
-		// Use an arbitrary address for the cookie -- it's opaque
-		// to the user
-		void * cookie = &cookie_val;
+	EXPECT_CALL(*profilerMock, processSample(AllOf(
+		Property(&Sample::getProcessID, 561),
+		Property(&Sample::isKernel, true),
+		ResultOf(SampleCallchainMatcher(
+		    {0xffffffff80001234, 0xffffffff80004567}), true))))
+	    .Times(1);
 
-		const int fd = 9628;
-		mockOpen.ExpectOpen("/root/pmc.log", O_RDONLY, fd);
+	EXPECT_TRUE(ProcessLog(profiler));
+}
 
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
+TEST_F(EventFactoryTestSuite, TestMapIn)
+{
+	Profiler profiler("./output/callchains", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
 
-		AddSampleExpectation(cookie, true, 17498, 0xbadd);
+	AddMapInExpectation(231, 0xfffe9398, "/lib/libthr.so.3");
 
-		AddEofExpectation(cookie);
+	EXPECT_TRUE(ProcessLog(profiler));
+}
 
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
-	}
+TEST_F(EventFactoryTestSuite, TestExec)
+{
+	Profiler profiler("./output/callchains", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
 
-	EventFactory::createEvents(profiler);
+	AddExecExpectation(1654, "/usr/bin/c++", 0xfed0);
 
+	EXPECT_TRUE(ProcessLog(profiler));
 }
-#endif
 
-TEST_F(EventFactoryTestSuite, TestSingleCallchain)
+TEST_F(EventFactoryTestSuite, TestExit)
 {
-	Profiler profiler("pmcstat.bin", false, "", asFactory, aggFactory,
+	Profiler profiler("/tmp/samples.out", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
+
+	log.AddExit(9016);
+	log.AddSysExit(9017);
 
 	{
-		InSequence dummy;
+		InSequence seq;
 
-		// Use an arbitrary address for the cookie -- it's opaque
-		// to the user
-		void * cookie = &dummy;
+		EXPECT_CALL(*profilerMock, processExit(9016));
+		EXPECT_CALL(*profilerMock, processExit(9017));
+	}
 
-		const int fd = 1750;
-		mockOpen.ExpectOpen("pmcstat.bin", O_RDONLY, fd);
+	EXPECT_TRUE(ProcessLog(profiler));
+}
 
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
+TEST_F(EventFactoryTestSuite, TestMapOut)
+{
+	Profiler profiler("/tmp/samples.out", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
 
-		AddCallchainExpectation(cookie, false, 90746, {0xe569d, 0x54896, 0x49564});
+	log.AddMapOut(4562, 0x1000, 0x2000);
+	log.AddMapOut(-1, 0xffff1000, 0xffff8000);
 
-		AddEofExpectation(cookie);
+	{
+		InSequence seq;
 
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
+		EXPECT_CALL(*profilerMock, processMapOut(4562, 0x1000, 0x2000));
+		EXPECT_CALL(*profilerMock,
+		    processMapOut(-1, 0xffff1000, 0xffff8000));
 	}
 
-	EventFactory::createEvents(profiler);
-
+	EXPECT_TRUE(ProcessLog(profiler));
 }
 
-TEST_F(EventFactoryTestSuite, TestMaxDepth)
+TEST_F(EventFactoryTestSuite, TestFork)
 {
-	Profiler profiler("pmcstat.bin", false, "", asFactory, aggFactory,
+	Profiler profiler("/tmp/samples.out", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
 
-	{
-		InSequence dummy;
-		char cookie_val;
-
-		// Use an arbitrary address for the cookie -- it's opaque
-		// to the user
-		void * cookie = &cookie_val;
+	log.AddFork(4561, 4562);
 
-		const int fd = INT_MAX;
-		mockOpen.ExpectOpen("pmcstat.bin", O_RDONLY, fd);
+	EXPECT_CALL(*profilerMock, processFork(4561, 4562));
 
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
+	EXPECT_TRUE(ProcessLog(profiler));
+}
 
-		AddCallchainExpectation(cookie, false, 90746,
-		    {0xf9d2, 0x296487, 0xefe892, 0x59dab});
+TEST_F(EventFactoryTestSuite, TestTimeWindow)
+{
+	Profiler profiler("/tmp/samples.out", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
 
-		AddEofExpectation(cookie);
+	log.AddInitialize(1000);
 
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
+	// Mappings before the window are still needed to resolve the samples
+	// inside of it.
+	AddMapInExpectation(7, 0x400000, "/bin/cat");
+	for (int i = 0; i < 20000; ++i) {
+		log.SetTimestamp(i);
+		log.AddCallchain(7, true, {0x401001});
 	}
 
-	EventFactory::createEvents(profiler);
+	log.SetTimestamp(30000);
+	AddCallchainExpectation(true, 7, {0x401100});
+	log.SetTimestamp(30500);
+	AddCallchainExpectation(true, 7, {0x401200});
+	log.SetTimestamp(31001);
+	log.AddCallchain(7, true, {0x401301});
+
+	PmcLogIndex index(log.data(), log.size());
+	ASSERT_TRUE(index.build());
 
+	EXPECT_TRUE(EventFactory::processLog(profiler, index, 30000, 31000));
 }
 
-TEST_F(EventFactoryTestSuite, TestMapIn)
+TEST_F(EventFactoryTestSuite, TestOpenFail)
 {
-	Profiler profiler("./output/callchains", false, "", asFactory, aggFactory,
+	Profiler profiler("./output/callchains", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
 	GlobalMockOpen mockOpen;
 
-	{
-		InSequence dummy;
-		const int fd = INT_MAX - 1;
-
-		// Use an arbitrary address for the cookie -- it's opaque
-		// to the user
-		void *cookie = &mockOpen;
-
-		mockOpen.ExpectOpen("./output/callchains", O_RDONLY, fd);
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
-
-		AddMapInExpectation(cookie, 231, 0xfffe9398, "/lib/libthr.so.3");
-
-		AddEofExpectation(cookie);
-
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
-	}
+	mockOpen.ExpectOpen("./output/callchains", O_RDONLY, -1);
 
 	EventFactory::createEvents(profiler);
 }
 
-TEST_F(EventFactoryTestSuite, TestExec)
+TEST_F(EventFactoryTestSuite, TestMultipleFiles)
 {
-	Profiler profiler("./output/callchains", false, "", asFactory, aggFactory,
+	Profiler first("/tmp/host1.out", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
+	Profiler second("/tmp/host2.out", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
 	GlobalMockOpen mockOpen;
+	std::vector<FILE *> files;
 
-	{
-		InSequence dummy;
-		const int fd = 0;
-
-		// Use an arbitrary address for the cookie -- it's opaque
-		// to the user
-		void *cookie = &mockOpen;
-
-		mockOpen.ExpectOpen("./output/callchains", O_RDONLY, fd);
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
+	// Both files use the same pid; each is decoded on its own.
+	AddMapInExpectation(5, 0x400000, "/bin/sh");
+	AddCallchainExpectation(true, 5, {0x401000});
+	files.push_back(tmpfile());
+	fwrite(log.data(), 1, log.size(), files.back());
 
-		AddExecExpectation(cookie, 1654, "/usr/bin/c++", 0xfed0);
+	log = PmcLogBuilder();
+	AddExecExpectation(5, "/bin/ls", 0x400000);
+	AddCallchainExpectation(true, 5, {0x402000, 0x403000});
+	files.push_back(tmpfile());
+	fwrite(log.data(), 1, log.size(), files.back());
 
-		AddEofExpectation(cookie);
+	for (auto * file : files)
+		fflush(file);
 
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
-	}
+	mockOpen.ExpectOpen("/tmp/host1.out", O_RDONLY, fileno(files.at(0)));
+	mockOpen.ExpectClose(fileno(files.at(0)));
+	mockOpen.ExpectOpen("/tmp/host2.out", O_RDONLY, fileno(files.at(1)));
+	mockOpen.ExpectClose(fileno(files.at(1)));
 
-	EventFactory::createEvents(profiler);
+	EventFactory::createEvents(std::vector<Profiler *>{&first, &second});
 
+	for (auto * file : files)
+		fclose(file);
 }
 
-TEST_F(EventFactoryTestSuite, TestOpenFail)
+TEST_F(EventFactoryTestSuite, TestCorruptLog)
 {
-	Profiler profiler("./output/callchains", false, "", asFactory, aggFactory,
+	Profiler profiler("./output/callchains", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
 
-	mockOpen.ExpectOpen("./output/callchains", O_RDONLY, -1);
+	AddMapInExpectation(231, 0xfffe9398, "/lib/libthr.so.3");
+	log.AddGarbage(64);
 
-	EventFactory::createEvents(profiler);
+	EXPECT_FALSE(ProcessLog(profiler));
 }
 
-TEST_F(EventFactoryTestSuite, TestLogOpenFail)
+TEST_F(EventFactoryTestSuite, TestUnterminatedPathname)
 {
-	Profiler profiler("./output/callchains", false, "", asFactory, aggFactory,
+	Profiler profiler("./output/callchains", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
 
-	{
-		InSequence dummy;
-		const int fd = 4841;
-		mockOpen.ExpectOpen("./output/callchains", O_RDONLY, fd);
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(nullptr));
-		mockOpen.ExpectClose(fd, 0);
-	}
+	char *rec = log.AddRecord(PMCLOG_TYPE_MAP_IN, sizeof(PmcLogMapIn) + 8);
+	memset(rec + sizeof(PmcLogMapIn), 'a', 8);
 
-	EventFactory::createEvents(profiler);
+	EXPECT_FALSE(ProcessLog(profiler));
 }
 
 TEST_F(EventFactoryTestSuite, TestUnhandledEvents)
 {
-	Profiler profiler("./output/callchains", false, "", asFactory, aggFactory,
+	Profiler profiler("./output/callchains", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
-
-	// Use an arbitrary address for the cookie -- it's opaque
-	// to the user
-	void * cookie = &profiler;
 
-	{
-		InSequence dummy;
-		const int fd = INT_MAX - 1;
-		mockOpen.ExpectOpen("./output/callchains", O_RDONLY, fd);
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
-
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_CLOSELOG);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_DROPNOTIFY);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_INITIALIZE);
+	log.AddRecord(PMCLOG_TYPE_CLOSELOG, sizeof(PmcLogHeader));
+	log.AddRecord(PMCLOG_TYPE_DROPNOTIFY, sizeof(PmcLogHeader));
+	log.AddInitialize(2000000000);
 #ifdef PMCLOG_TYPE_MAPPINGCHANGE
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_MAPPINGCHANGE);
+	log.AddRecord(PMCLOG_TYPE_MAPPINGCHANGE, sizeof(PmcLogHeader));
 #endif
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_PMCALLOCATE);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_PMCATTACH);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_PMCDETACH);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_PROCCSW);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_PROCEXIT);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_PROCFORK);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_SYSEXIT);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_USERDATA);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_MAP_OUT);
-		AddUnhandledTypeExpectation(cookie, PMCLOG_TYPE_PMCALLOCATEDYN);
-		AddUnhandledTypeExpectation(cookie, static_cast<pmclog_type>(1000));
-
-		AddEofExpectation(cookie);
-
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
-	}
-
-	EventFactory::createEvents(profiler);
+	log.AddRecord(PMCLOG_TYPE_PMCALLOCATE, 32);
+	log.AddRecord(PMCLOG_TYPE_PMCATTACH, 32);
+	log.AddRecord(PMCLOG_TYPE_PMCDETACH, 32);
+	log.AddRecord(PMCLOG_TYPE_PROCCSW, 32);
+	log.AddRecord(PMCLOG_TYPE_USERDATA, 24);
+	log.AddRecord(PMCLOG_TYPE_PMCALLOCATEDYN, 64);
+	log.AddRecord(0xfe, sizeof(PmcLogHeader));
+
+	EXPECT_TRUE(ProcessLog(profiler));
 }
 
 TEST_F(EventFactoryTestSuite, TestMultipleCallchains)
 {
-	Profiler profiler("./output/callchains", false, "", asFactory, aggFactory,
+	Profiler profiler("./output/callchains", false, moduleIndex, asFactory, aggFactory,
 	    imgFactory);
-	GlobalMockOpen mockOpen;
-
-	// Use an arbitrary address for the cookie -- it's opaque
-	// to the user
-	void * cookie = this;
 
 	{
 		InSequence dummy;
-		const int fd = 25;
-		mockOpen.ExpectOpen("./output/callchains", O_RDONLY, fd);
-		EXPECT_CALL(*libpmcMock, pmclog_open(fd))
-		    .Times(1).WillOnce(Return(cookie));
-
 
-		AddMapInExpectation(cookie, -1, 0xfffe9398, "/boot/kernel/kernel");
-		AddMapInExpectation(cookie, -1, 0xffff1040, "/boot/kernel/hwpmc.ko");
-		AddMapInExpectation(cookie, 1, 0x1000, "/sbin/init");
-		AddMapInExpectation(cookie, 2, 0x5540, "/bin/sh");
-		AddMapInExpectation(cookie, 2, 0x100000, "/lib/libc.so.7");
+		AddMapInExpectation(-1, 0xfffe9398, "/boot/kernel/kernel");
+		AddMapInExpectation(-1, 0xffff1040, "/boot/kernel/hwpmc.ko");
+		AddMapInExpectation(1, 0x1000, "/sbin/init");
+		AddMapInExpectation(2, 0x5540, "/bin/sh");
+		AddMapInExpectation(2, 0x100000, "/lib/libc.so.7");
 
-		AddCallchainExpectation(cookie, true, 2,
+		AddCallchainExpectation(true, 2,
 		    {0xfffe7838, 0xffff2300, 0xfffe8632});
-		AddCallchainExpectation(cookie, false, 2,
+		AddCallchainExpectation(false, 2,
 		    {1, 2, 3, 4});
-		AddCallchainExpectation(cookie, false, 1,
+		AddCallchainExpectation(false, 1,
 		    {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
 		     17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32});
-		AddCallchainExpectation(cookie, true, 1,
+		AddCallchainExpectation(true, 1,
 		    {0xfffe0001, 4, 2, 5, 2});
-		AddExecExpectation(cookie, 3, "/bin/dd", 0x9000);
-		AddCallchainExpectation(cookie, true, 3,
+		AddExecExpectation(3, "/bin/dd", 0x9000);
+		AddCallchainExpectation(true, 3,
 		    {454, 1564, 1478, 18794, 1684, 154, 14});
-		AddCallchainExpectation(cookie, true, 3,
+		AddCallchainExpectation(true, 3,
 		    {454, 1564, 1478, 18794, 1684, 154, 14});
-		AddCallchainExpectation(cookie, false, 1,
+		AddCallchainExpectation(false, 1,
 		    {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
 		     17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32});
-
-		AddEofExpectation(cookie);
-
-		EXPECT_CALL(*libpmcMock, pmclog_close(cookie))
-		    .Times(1);
-		mockOpen.ExpectClose(fd, 0);
 	}
 
-	EventFactory::createEvents(profiler);
+	EXPECT_TRUE(ProcessLog(profiler));
 }
@@ -24,17 +24,48 @@
 #if !defined(EVENTFACTORY_H)
 #define EVENTFACTORY_H
 
+#include <sys/types.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include <functional>
+#include <string>
+#include <vector>
+
+class MappedLog;
+class PmcLogIndex;
+class PmcLogRecord;
 class Profiler;
 
 class EventFactory
 {
+private:
+	static const size_t FOLLOW_BUFFER_SIZE = 1024 * 1024;
+	static const useconds_t FOLLOW_POLL_USEC = 100000;
+
+	static void processRecord(Profiler& profiler, const PmcLogRecord& record);
+	static bool mapSamplesFile(const std::string& path, MappedLog& log);
+
 public:
+	struct FollowOptions
+	{
+		/* Emit a profile every interval seconds (0 to disable). */
+		unsigned interval;
+
+		/* Emit a profile every everySamples samples (0 to disable). */
+		unsigned everySamples;
+	};
+
 	EventFactory(const EventFactory&) = delete;
 	EventFactory& operator=(const EventFactory &) = delete;
 
 	static void createEvents(Profiler& profiler);
+	static void createEvents(const std::vector<Profiler *>& profilers);
+	static bool processLog(Profiler& profiler, const char *buf, size_t len);
+	static bool processLog(Profiler& profiler, const PmcLogIndex& index,
+	    uint64_t fromTsc, uint64_t toTsc);
+	static void followEvents(Profiler& profiler, const FollowOptions& opts,
+	    const std::function<void()>& emit);
 };
 
 #endif // #if !defined(EVENTFACTORY_H)
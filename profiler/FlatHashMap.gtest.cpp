@@ -0,0 +1,158 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "FlatHashMap.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+using namespace testing;
+
+TEST(FlatHashMapTestSuite, TestInsertFind)
+{
+	FlatHashMap<int, std::string> map;
+
+	EXPECT_TRUE(map.empty());
+	EXPECT_EQ(map.find(5), map.end());
+
+	auto [it, inserted] = map.insert(std::make_pair(5, std::string("five")));
+	EXPECT_TRUE(inserted);
+	EXPECT_EQ(it->first, 5);
+	EXPECT_EQ(it->second, "five");
+
+	auto dup = map.insert(std::make_pair(5, std::string("cinq")));
+	EXPECT_FALSE(dup.second);
+	EXPECT_EQ(dup.first->second, "five");
+
+	map[7] = "seven";
+	EXPECT_EQ(map.size(), 2);
+	EXPECT_EQ(map.count(7), 1);
+	EXPECT_EQ(map.count(6), 0);
+	EXPECT_EQ(map.find(7)->second, "seven");
+	EXPECT_EQ(map[8], "");
+	EXPECT_EQ(map.size(), 3);
+
+	std::vector<int> keys;
+	for (const auto & pair : map)
+		keys.push_back(pair.first);
+	EXPECT_THAT(keys, UnorderedElementsAre(5, 7, 8));
+}
+
+TEST(FlatHashMapTestSuite, TestErase)
+{
+	FlatHashMap<int, std::unique_ptr<int>> map;
+
+	for (int i = 0; i < 100; ++i)
+		map.emplace(i, std::make_unique<int>(i * 2));
+
+	EXPECT_EQ(map.erase(1000), 0);
+	for (int i = 0; i < 100; i += 2)
+		EXPECT_EQ(map.erase(i), 1);
+	map.erase(map.find(1));
+
+	EXPECT_EQ(map.size(), 49);
+	EXPECT_EQ(map.find(1), map.end());
+	for (int i = 3; i < 100; i += 2) {
+		auto it = map.find(i);
+		ASSERT_NE(it, map.end());
+		EXPECT_EQ(*it->second, i * 2);
+	}
+
+	map.clear();
+	EXPECT_TRUE(map.empty());
+	EXPECT_EQ(map.begin(), map.end());
+	EXPECT_EQ(map.find(3), map.end());
+}
+
+/* A moved-from map must behave as an empty map. */
+TEST(FlatHashMapTestSuite, TestMovedFrom)
+{
+	FlatHashMap<int, std::string> map;
+
+	for (int i = 0; i < 20; ++i)
+		map[i] = std::to_string(i);
+
+	FlatHashMap<int, std::string> moved(std::move(map));
+	EXPECT_EQ(moved.size(), 20);
+	EXPECT_EQ(moved.find(7)->second, "7");
+
+	EXPECT_TRUE(map.empty());
+	EXPECT_EQ(map.begin(), map.end());
+	EXPECT_EQ(map.find(7), map.end());
+	EXPECT_EQ(map.erase(7), 0);
+
+	map[3] = "three";
+	EXPECT_EQ(map.size(), 1);
+	EXPECT_EQ(map.find(3)->second, "three");
+
+	FlatHashMap<int, std::string> assigned;
+	assigned[100] = "old";
+	assigned = std::move(moved);
+	EXPECT_EQ(assigned.size(), 20);
+	EXPECT_EQ(assigned.find(100), assigned.end());
+	EXPECT_EQ(assigned.find(19)->second, "19");
+
+	EXPECT_TRUE(moved.empty());
+	EXPECT_EQ(moved.find(19), moved.end());
+	moved.emplace(5, "five");
+	EXPECT_EQ(moved.size(), 1);
+	EXPECT_EQ(moved.find(5)->second, "five");
+}
+
+/* Compare against std::unordered_map over a mix of inserts and erases. */
+TEST(FlatHashMapTestSuite, TestRandom)
+{
+	FlatHashMap<uint64_t, uint64_t> map;
+	std::unordered_map<uint64_t, uint64_t> expected;
+	uint64_t state = 1;
+
+	for (int i = 0; i < 100000; ++i) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint64_t key = (state >> 33) % 5000;
+
+		if ((state >> 20) % 3 == 0) {
+			EXPECT_EQ(map.erase(key), expected.erase(key));
+		} else {
+			map[key] = i;
+			expected[key] = i;
+		}
+	}
+
+	ASSERT_EQ(map.size(), expected.size());
+	for (const auto & pair : expected) {
+		auto it = map.find(pair.first);
+		ASSERT_NE(it, map.end());
+		EXPECT_EQ(it->second, pair.second);
+	}
+
+	size_t visited = 0;
+	for (const auto & pair : map) {
+		EXPECT_EQ(expected.at(pair.first), pair.second);
+		visited++;
+	}
+	EXPECT_EQ(visited, expected.size());
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "MappingTable.h"
+#include "MapUtil.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+using namespace testing;
+
+TEST(MappingTableTestSuite, TestFind)
+{
+	MappingTable<uint64_t, std::string> table;
+
+	EXPECT_TRUE(table.empty());
+	EXPECT_EQ(table.find(0), nullptr);
+
+	EXPECT_TRUE(table.insert(0x4000, "libc"));
+	EXPECT_TRUE(table.insert(0x1000, "exe"));
+	EXPECT_TRUE(table.insert(0x9000, "libthr"));
+	EXPECT_FALSE(table.insert(0x4000, "libm"));
+	EXPECT_EQ(table.size(), 3);
+
+	EXPECT_EQ(table.find(0xfff), nullptr);
+	EXPECT_EQ(*table.find(0x1000), "exe");
+	EXPECT_EQ(*table.find(0x3fff), "exe");
+	EXPECT_EQ(*table.find(0x4000), "libc");
+	EXPECT_EQ(*table.find(0x4001), "libc");
+	EXPECT_EQ(*table.find(0x8fff), "libc");
+	EXPECT_EQ(*table.find(0x9000), "libthr");
+	EXPECT_EQ(*table.find(UINT64_MAX), "libthr");
+	EXPECT_EQ(table.find(0), nullptr);
+
+	EXPECT_TRUE(table.erase(0x4000));
+	EXPECT_FALSE(table.erase(0x4000));
+	EXPECT_FALSE(table.erase(0x4001));
+	EXPECT_EQ(table.size(), 2);
+	EXPECT_EQ(*table.find(0x4000), "exe");
+	EXPECT_EQ(*table.find(0x9000), "libthr");
+
+	table.insert(0x4000, "libc");
+	table.insert(0x5000, "libm");
+	EXPECT_EQ(table.countRange(0x4000, 0x9000), 2);
+	EXPECT_EQ(table.countRange(0x4001, 0x9001), 2);
+	EXPECT_EQ(table.countRange(0x9000, 0x4000), 0);
+	EXPECT_EQ(*table.ceiling(0x4000), 0x4000);
+	EXPECT_EQ(*table.ceiling(0x4001), 0x5000);
+	EXPECT_EQ(*table.ceiling(0), 0x1000);
+	EXPECT_EQ(table.ceiling(0x9001), nullptr);
+	EXPECT_EQ(table.eraseRange(0x4000, 0x9000), 2);
+	EXPECT_EQ(table.eraseRange(0x4000, 0x9000), 0);
+	EXPECT_EQ(table.size(), 2);
+	EXPECT_EQ(*table.find(0x5000), "exe");
+	EXPECT_EQ(*table.find(0x9000), "libthr");
+
+	table.clear();
+	EXPECT_TRUE(table.empty());
+	EXPECT_EQ(table.find(0x9000), nullptr);
+}
+
+/*
+ * Compare lookups against LastSmallerThan on a std::map for a range of
+ * table sizes, including the last-hit shortcut being right and wrong.
+ */
+TEST(MappingTableTestSuite, TestMatchesMap)
+{
+	uint64_t state = 1;
+
+	auto random = [&state]() {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (state >> 16);
+	};
+
+	for (int entries = 1; entries < 300; entries += 7) {
+		MappingTable<uint64_t, int> table;
+		std::map<uint64_t, int> map;
+
+		for (int i = 0; i < entries; ++i) {
+			uint64_t key = random() % (1 << 20);
+			bool inserted = map.insert(std::make_pair(key, i)).second;
+			EXPECT_EQ(table.insert(key, int(i)), inserted);
+		}
+
+		for (int i = 0; i < 1000; ++i) {
+			uint64_t addr = random() % (1 << 20);
+			auto it = LastSmallerThan(map, addr);
+			int *value = table.find(addr);
+
+			if (it == map.end()) {
+				EXPECT_EQ(value, nullptr);
+			} else {
+				ASSERT_NE(value, nullptr);
+				EXPECT_EQ(*value, it->second);
+			}
+
+			/* Look up a nearby address, which should hit the cache. */
+			addr += random() % 64;
+			it = LastSmallerThan(map, addr);
+			value = table.find(addr);
+			if (it == map.end()) {
+				EXPECT_EQ(value, nullptr);
+			} else {
+				ASSERT_NE(value, nullptr);
+				EXPECT_EQ(*value, it->second);
+			}
+		}
+	}
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "MemoryEventSource.h"
+
+#include "ProcessState.h"
+#include "Profiler.h"
+#include "Sample.h"
+
+size_t
+MemoryEventSource::AddPath(const std::string & path)
+{
+	paths.push_back(path);
+	return (paths.size() - 1);
+}
+
+void
+MemoryEventSource::AddSample(pid_t pid, const uintptr_t *pc, uint32_t npc)
+{
+	events.push_back({Event::SAMPLE, pid, npc, pcs.size(), 0});
+	pcs.insert(pcs.end(), pc, pc + npc);
+}
+
+void
+MemoryEventSource::AddMapIn(pid_t pid, TargetAddr start,
+    const std::string & path)
+{
+	events.push_back({Event::MAP_IN, pid, 0, AddPath(path), start});
+}
+
+void
+MemoryEventSource::AddExec(pid_t pid, const std::string & path,
+    TargetAddr entry)
+{
+	events.push_back({Event::EXEC, pid, 0, AddPath(path), entry});
+}
+
+bool
+MemoryEventSource::Feed(Profiler & profiler)
+{
+	for (const Event & ev : events) {
+		switch (ev.type) {
+		case Event::SAMPLE:
+			profiler.processEvent(Sample(ev.pid, &pcs[ev.index],
+			    ev.npc));
+			break;
+		case Event::MAP_IN:
+			profiler.processMapIn(ev.pid, ev.addr,
+			    paths[ev.index].c_str());
+			break;
+		case Event::EXEC:
+			profiler.processEvent(ProcessExec(ev.pid,
+			    paths[ev.index], ev.addr));
+			break;
+		}
+	}
+
+	return (true);
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "PerfDataEventSource.h"
+
+#include "PerfDataReader.h"
+#include "ProcessState.h"
+#include "Profiler.h"
+#include "Sample.h"
+
+#include <sys/mman.h>
+
+#include <string.h>
+
+static_assert(sizeof(uintptr_t) == sizeof(uint64_t),
+    "perf.data callchains are only passed through on 64-bit hosts");
+
+PerfDataEventSource::PerfDataEventSource(const char *buf, size_t len,
+    const SampleDecimator & decimator)
+  : buf(buf), len(len), decimator(decimator)
+{
+}
+
+/*
+ * perf reports the kernel as [kernel.kallsyms], with a suffix naming the
+ * symbol that the mapping starts at, and each module by the path to its
+ * file, if it could find it, or as [name].  The kernel is looked up as
+ * vmlinux in the module path; as it is mapped at its link address, that
+ * only works for a kernel that wasn't relocated by KASLR.  Modules whose file
+ * perf couldn't find are left unmapped.
+ */
+void
+PerfDataEventSource::processKernelMmap(Profiler & profiler, TargetAddr addr,
+    const char *path)
+{
+	static const char KALLSYMS[] = "[kernel.kallsyms]";
+
+	if (strncmp(path, KALLSYMS, sizeof(KALLSYMS) - 1) == 0)
+		profiler.processMapIn(-1, addr, "vmlinux");
+	else if (path[0] == '/')
+		profiler.processMapIn(-1, addr, path);
+}
+
+void
+PerfDataEventSource::processMmap(Profiler & profiler, pid_t pid,
+    TargetAddr addr, const char *path)
+{
+	if (pid == -1) {
+		processKernelMmap(profiler, addr, path);
+		return;
+	}
+
+	/* Skip anonymous memory, [vdso], [stack] and the like. */
+	if (path[0] != '/')
+		return;
+
+	/*
+	 * processExec() maps the executable at its link address, which is
+	 * wrong for a PIE, so it is mapped in again where it really is.
+	 */
+	if (pendingExec.erase(pid) != 0)
+		profiler.processEvent(ProcessExec(pid, path, addr));
+
+	/*
+	 * Like a pmclog map-in, this is the address of the executable
+	 * segment, which the AddressSpace works out the load offset from.
+	 */
+	profiler.processMapIn(pid, addr, path);
+}
+
+void
+PerfDataEventSource::processSample(Profiler & profiler,
+    const PerfSample & sample)
+{
+	const uint64_t *ips;
+	const uintptr_t *pcs;
+	uint64_t ctx, start, end;
+
+	/*
+	 * A callchain is a series of contexts, each introduced by a
+	 * PERF_CONTEXT_* marker: normally the kernel frames followed by the
+	 * user frames.  Like a pmclog callchain, a Sample only describes the
+	 * first kernel or user context.
+	 */
+	ips = sample.ips;
+	ctx = 0;
+	start = 0;
+	while (start < sample.nr) {
+		if (PerfDataReader::IsContext(ips[start]))
+			ctx = ips[start];
+		else if (ctx == 0 || ctx == PerfDataReader::CONTEXT_KERNEL ||
+		    ctx == PerfDataReader::CONTEXT_USER)
+			break;
+		start++;
+	}
+
+	end = start;
+	while (end < sample.nr && !PerfDataReader::IsContext(ips[end]))
+		end++;
+
+	if (end == start) {
+		if (sample.ip == NULL)
+			return;
+		ips = sample.ip;
+		start = 0;
+		end = 1;
+	}
+
+	if (reinterpret_cast<uintptr_t>(ips) % alignof(uintptr_t) == 0)
+		pcs = reinterpret_cast<const uintptr_t *>(ips + start);
+	else {
+		scratch.resize(end - start);
+		memcpy(scratch.data(), ips + start,
+		    (end - start) * sizeof(uintptr_t));
+		pcs = scratch.data();
+	}
+
+	profiler.processEvent(Sample(sample.pid, pcs, end - start));
+}
+
+bool
+PerfDataEventSource::Feed(Profiler & profiler)
+{
+	PerfDataReader reader(buf, len);
+	PerfDataRecord record;
+	PerfSample sample;
+
+	if (!reader.open())
+		return (false);
+
+	while (reader.next(record)) {
+		switch (record.getType()) {
+		case PerfDataRecord::SAMPLE:
+			/* The record's offset is a unique, stable key. */
+			if (!decimator.keep(record.getData() - buf))
+				break;
+			if (!reader.parseSample(record, sample))
+				return (false);
+			processSample(profiler, sample);
+			break;
+
+		case PerfDataRecord::MMAP: {
+			if (record.getMisc() & PerfDataRecord::MISC_MMAP_DATA)
+				break;
+
+			const auto & mmap = record.get<PerfRecordMmap>();
+			processMmap(profiler, mmap.pid, mmap.addr,
+			    record.getString());
+			break;
+		}
+
+		case PerfDataRecord::MMAP2: {
+			const auto & mmap = record.get<PerfRecordMmap2>();
+			if ((record.getMisc() & PerfDataRecord::MISC_MMAP_DATA) ||
+			    !(mmap.prot & PROT_EXEC))
+				break;
+
+			processMmap(profiler, mmap.pid, mmap.addr,
+			    record.getString());
+			break;
+		}
+
+		case PerfDataRecord::COMM:
+			if (record.getMisc() & PerfDataRecord::MISC_COMM_EXEC)
+				pendingExec.insert(record.get<PerfRecordComm>().pid);
+			break;
+
+		case PerfDataRecord::FORK: {
+			/* Thread creation is logged as a fork too. */
+			const auto & fork = record.get<PerfRecordFork>();
+			if (fork.pid == fork.tid && fork.pid != fork.ppid)
+				profiler.processFork(fork.ppid, fork.pid);
+			break;
+		}
+
+		case PerfDataRecord::EXIT: {
+			/* perf also logs the exit of every thread. */
+			const auto & exit = record.get<PerfRecordExit>();
+			if (exit.pid == exit.tid) {
+				pendingExec.erase(exit.pid);
+				profiler.processExit(exit.pid);
+			}
+			break;
+		}
+
+		default:
+			/* Everything else is irrelevant to a profile. */
+			break;
+		}
+	}
+
+	return (!reader.failed());
+}
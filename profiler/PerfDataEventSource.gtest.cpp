@@ -0,0 +1,340 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "PerfDataEventSource.h"
+
+#include "PerfDataReader.h"
+#include "ProcessState.h"
+#include "Profiler.h"
+#include "Sample.h"
+
+#include "mock/GlobalMock.h"
+#include "mock/PerfDataBuilder.h"
+
+#include <sys/mman.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+class ProfilerMocker : public GlobalMockBase<ProfilerMocker>
+{
+public:
+	MOCK_METHOD2(processSample, void (pid_t, std::vector<TargetAddr>));
+	MOCK_METHOD3(processMapIn, void (int, TargetAddr, std::string));
+	MOCK_METHOD3(processExec, void (pid_t, std::string, TargetAddr));
+	MOCK_METHOD2(processFork, void (pid_t, pid_t));
+	MOCK_METHOD1(processExit, void (pid_t));
+};
+
+void
+Profiler::processEvent(const ProcessExec& processExec)
+{
+	ProfilerMocker::MockObj().processExec(processExec.getProcessID(),
+	    processExec.getProcessName(), processExec.getEntryAddr());
+}
+
+void
+Profiler::processEvent(const Sample& sample, uint64_t count)
+{
+	std::vector<TargetAddr> chain;
+
+	for (int i = 0; i < sample.getChainDepth(); ++i)
+		chain.push_back(sample.getAddress(i));
+	ProfilerMocker::MockObj().processSample(sample.getProcessID(), chain);
+}
+
+void
+Profiler::processMapIn(pid_t pid, TargetAddr map_start, const char * image)
+{
+	ProfilerMocker::MockObj().processMapIn(pid, map_start, image);
+}
+
+void
+Profiler::processFork(pid_t parent, pid_t child)
+{
+	ProfilerMocker::MockObj().processFork(parent, child);
+}
+
+void
+Profiler::processExit(pid_t pid)
+{
+	ProfilerMocker::MockObj().processExit(pid);
+}
+
+class PerfDataEventSourceTestSuite : public ::testing::Test
+{
+public:
+	GlobalMock<ProfilerMocker> profilerMock;
+	Profiler *profiler = nullptr;
+
+	static const uint64_t KERNEL_PC = 0xffffffff81001001;
+
+	bool
+	Feed(const PerfDataBuilder & perf)
+	{
+		PerfDataEventSource source(perf.data(), perf.size());
+
+		return (source.Feed(*profiler));
+	}
+};
+
+TEST_F(PerfDataEventSourceTestSuite, TestIsPerfData)
+{
+	PerfDataBuilder perf;
+
+	EXPECT_TRUE(PerfDataReader::IsPerfData(perf.data(), perf.size()));
+	EXPECT_FALSE(PerfDataReader::IsPerfData("PERF", 4));
+	EXPECT_FALSE(PerfDataReader::IsPerfData("\0\0\0\0\0\0\0\0", 8));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestEmpty)
+{
+	PerfDataBuilder perf;
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestUserCallchain)
+{
+	PerfDataBuilder perf;
+
+	perf.AddSample(77, 0x401001, {PerfDataReader::CONTEXT_USER, 0x401001,
+	    0x402001, 0x403001});
+
+	EXPECT_CALL(*profilerMock, processSample(77,
+	    std::vector<TargetAddr>{0x401000, 0x402000, 0x403000}))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestKernelThenUser)
+{
+	PerfDataBuilder perf;
+
+	// Only the kernel part of the callchain makes it into the Sample.
+	perf.AddSample(5, KERNEL_PC, {PerfDataReader::CONTEXT_KERNEL,
+	    KERNEL_PC, KERNEL_PC + 0x1000, PerfDataReader::CONTEXT_USER,
+	    0x401001});
+
+	EXPECT_CALL(*profilerMock, processSample(5,
+	    std::vector<TargetAddr>{KERNEL_PC - 1, KERNEL_PC + 0xfff}))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestSkipHypervisor)
+{
+	PerfDataBuilder perf;
+
+	perf.AddSample(5, 0x401001, {PerfDataReader::CONTEXT_HV, 0x9001,
+	    PerfDataReader::CONTEXT_USER, 0x401001});
+
+	EXPECT_CALL(*profilerMock, processSample(5,
+	    std::vector<TargetAddr>{0x401000}))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestNoCallchain)
+{
+	PerfDataBuilder perf(PerfDataReader::SAMPLE_IP |
+	    PerfDataReader::SAMPLE_TID | PerfDataReader::SAMPLE_PERIOD);
+
+	perf.AddSample(9, 0x401001, {});
+
+	EXPECT_CALL(*profilerMock, processSample(9,
+	    std::vector<TargetAddr>{0x401000}))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestExec)
+{
+	PerfDataBuilder perf;
+
+	perf.AddComm(42, "ls", true);
+	perf.AddMmap2(42, 0x401000, 0x1000, PROT_READ | PROT_EXEC, "/bin/ls");
+	perf.AddMmap2(42, 0x800601000, 0x1000, PROT_READ | PROT_EXEC,
+	    "/lib/libc.so.6");
+
+	InSequence seq;
+	EXPECT_CALL(*profilerMock, processExec(42, "/bin/ls", 0x401000))
+	  .Times(1);
+	EXPECT_CALL(*profilerMock, processMapIn(42, 0x401000, "/bin/ls"))
+	  .Times(1);
+	EXPECT_CALL(*profilerMock, processMapIn(42, 0x800601000,
+	    "/lib/libc.so.6"))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestExecPie)
+{
+	PerfDataBuilder perf;
+
+	perf.AddComm(42, "ls", true);
+	perf.AddMmap2(42, 0x555555556000, 0x2000, PROT_READ | PROT_EXEC,
+	    "/bin/ls");
+
+	// The executable is mapped in where it was really loaded as well
+	// as at its link address, which is 0 for a PIE.
+	InSequence seq;
+	EXPECT_CALL(*profilerMock, processExec(42, "/bin/ls", 0x555555556000))
+	  .Times(1);
+	EXPECT_CALL(*profilerMock, processMapIn(42, 0x555555556000,
+	    "/bin/ls"))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestMmap)
+{
+	PerfDataBuilder perf;
+
+	// A thread renaming itself is not an exec.
+	perf.AddComm(42, "worker", false);
+	perf.AddMmap(42, 0x800601000, 0x1000, "/lib/libm.so.6");
+	perf.AddMmap(-1, 0xffffffff81000000, 0xffffffff81000000,
+	    "[kernel.kallsyms]_text");
+	perf.AddMmap(-1, 0xffffffffc0001000, 0, "/lib/modules/e1000e.ko");
+	perf.AddMmap(-1, 0xffffffffc0100000, 0, "[nvidia]");
+	perf.AddMmap2(42, 0x7fff0000, 0, PROT_READ | PROT_EXEC, "[vdso]");
+	perf.AddMmap2(42, 0x800700000, 0, PROT_READ | PROT_WRITE,
+	    "/lib/libz.so");
+
+	InSequence seq;
+	EXPECT_CALL(*profilerMock, processMapIn(42, 0x800601000,
+	    "/lib/libm.so.6"))
+	  .Times(1);
+	EXPECT_CALL(*profilerMock, processMapIn(-1, 0xffffffff81000000,
+	    "vmlinux"))
+	  .Times(1);
+	EXPECT_CALL(*profilerMock, processMapIn(-1, 0xffffffffc0001000,
+	    "/lib/modules/e1000e.ko"))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestExit)
+{
+	PerfDataBuilder perf;
+
+	// Only the exit of the main thread ends the process.
+	perf.AddExit(42, 43);
+	perf.AddExit(42, 42);
+
+	EXPECT_CALL(*profilerMock, processExit(42))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestFork)
+{
+	PerfDataBuilder perf;
+
+	// Only a new main thread in a new process is a fork.
+	perf.AddFork(42, 42, 43);
+	perf.AddFork(42, 50, 51);
+	perf.AddFork(42, 50, 50);
+
+	EXPECT_CALL(*profilerMock, processFork(42, 50))
+	  .Times(1);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestUnhandledRecords)
+{
+	PerfDataBuilder perf;
+
+	perf.AddRecord(PerfDataRecord::LOST, 0, 24);
+	perf.AddRecord(68 /* PERF_RECORD_FINISHED_ROUND */, 0, 8);
+
+	EXPECT_TRUE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestCorrupt)
+{
+	PerfDataBuilder perf;
+
+	perf.AddSample(1, 0x401001, {0x401001});
+	perf.AddGarbage(4);
+
+	EXPECT_CALL(*profilerMock, processSample(1, _))
+	  .Times(1);
+
+	EXPECT_FALSE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestTruncatedSample)
+{
+	PerfDataBuilder perf;
+
+	// A callchain that claims more entries than the record holds.
+	char *rec = perf.AddRecord(PerfDataRecord::SAMPLE, 0, 8 + 6 * 8 + 8);
+	uint64_t nr = 100;
+	memcpy(rec + 8 + 6 * 8, &nr, sizeof(nr));
+
+	EXPECT_FALSE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestUnterminatedPath)
+{
+	PerfDataBuilder perf;
+
+	char *rec = perf.AddRecord(PerfDataRecord::MMAP, 0,
+	    sizeof(PerfRecordMmap) + 8);
+	memset(rec + sizeof(PerfRecordMmap), 'a', 8);
+
+	EXPECT_FALSE(Feed(perf));
+}
+
+TEST_F(PerfDataEventSourceTestSuite, TestUnsupported)
+{
+	PerfDataBuilder mixed;
+	mixed.AddAttr(PerfDataReader::SAMPLE_IP | PerfDataReader::SAMPLE_TID);
+	EXPECT_FALSE(Feed(mixed));
+
+	PerfDataBuilder read(PerfDataBuilder::DEFAULT_SAMPLE_TYPE |
+	    PerfDataReader::SAMPLE_READ);
+	EXPECT_FALSE(Feed(read));
+
+	// Pipe mode files only have the magic and a 16-byte header.
+	std::vector<char> pipe = {'P', 'E', 'R', 'F', 'I', 'L', 'E', '2',
+	    16, 0, 0, 0, 0, 0, 0, 0};
+	PerfDataEventSource source(pipe.data(), pipe.size());
+	EXPECT_FALSE(source.Feed(*profiler));
+}
@@ -0,0 +1,269 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "PerfDataReader.h"
+
+#include <err.h>
+#include <string.h>
+
+static const char PERF_MAGIC[8] = { 'P', 'E', 'R', 'F', 'I', 'L', 'E', '2' };
+static const char PERF_MAGIC_SWAPPED[8] = { '2', 'E', 'L', 'I', 'F', 'R', 'E', 'P' };
+
+const char *
+PerfDataRecord::getString() const
+{
+	size_t fixed;
+
+	switch (getType()) {
+	case MMAP:
+		fixed = sizeof(PerfRecordMmap);
+		break;
+	case MMAP2:
+		fixed = sizeof(PerfRecordMmap2);
+		break;
+	case COMM:
+		fixed = sizeof(PerfRecordComm);
+		break;
+	default:
+		return (NULL);
+	}
+
+	if (getLength() <= fixed ||
+	    memchr(data + fixed, '\0', getLength() - fixed) == NULL)
+		return (NULL);
+
+	return (data + fixed);
+}
+
+bool
+PerfDataReader::IsPerfData(const char *buf, size_t len)
+{
+	if (len < sizeof(PERF_MAGIC))
+		return (false);
+
+	return (memcmp(buf, PERF_MAGIC, sizeof(PERF_MAGIC)) == 0 ||
+	    memcmp(buf, PERF_MAGIC_SWAPPED, sizeof(PERF_MAGIC_SWAPPED)) == 0);
+}
+
+/*
+ * Returns true if the section lies entirely inside of a buffer of length len.
+ */
+static bool
+SectionValid(const PerfFileSection & section, size_t len)
+{
+	return (section.offset <= len && section.size <= len - section.offset);
+}
+
+bool
+PerfDataReader::readAttrs(const PerfFileHeader & header)
+{
+	uint64_t type;
+	size_t i, nattrs;
+
+	if (header.attrSize < ATTR_SAMPLE_TYPE_OFFSET + sizeof(type) ||
+	    !SectionValid(header.attrs, len) ||
+	    header.attrs.size % header.attrSize != 0) {
+		warnx("perf.data event attributes are corrupt");
+		return (false);
+	}
+
+	nattrs = header.attrs.size / header.attrSize;
+	if (nattrs == 0) {
+		warnx("perf.data file has no events");
+		return (false);
+	}
+
+	/*
+	 * Every event has to lay out its samples in the same way; otherwise
+	 * we would have to look up each sample's event by its ID.
+	 */
+	for (i = 0; i < nattrs; ++i) {
+		memcpy(&type, buf + header.attrs.offset + i * header.attrSize +
+		    ATTR_SAMPLE_TYPE_OFFSET, sizeof(type));
+		if (i == 0)
+			sampleType = type;
+		else if (type != sampleType) {
+			warnx("perf.data events with different sample types "
+			    "are not supported");
+			return (false);
+		}
+	}
+
+	if (sampleType & SAMPLE_READ) {
+		warnx("perf.data samples with counter values are not supported");
+		return (false);
+	}
+
+	if (!(sampleType & SAMPLE_TID) ||
+	    !(sampleType & (SAMPLE_IP | SAMPLE_CALLCHAIN))) {
+		warnx("perf.data samples have no thread ID or addresses");
+		return (false);
+	}
+
+	return (true);
+}
+
+bool
+PerfDataReader::open()
+{
+	PerfFileHeader header;
+
+	if (!IsPerfData(buf, len)) {
+		warnx("not a perf.data file");
+		return (false);
+	}
+
+	if (memcmp(buf, PERF_MAGIC_SWAPPED, sizeof(PERF_MAGIC_SWAPPED)) == 0) {
+		warnx("big-endian perf.data files are not supported");
+		return (false);
+	}
+
+	if (len < sizeof(header)) {
+		warnx("perf.data in pipe mode is not supported");
+		return (false);
+	}
+
+	memcpy(&header, buf, sizeof(header));
+	if (header.size < sizeof(header)) {
+		warnx("perf.data in pipe mode is not supported");
+		return (false);
+	}
+
+	if (!readAttrs(header))
+		return (false);
+
+	if (!SectionValid(header.data, len)) {
+		warnx("perf.data data section is truncated");
+		return (false);
+	}
+
+	off = header.data.offset;
+	end = header.data.offset + header.data.size;
+	return (true);
+}
+
+bool
+PerfDataReader::next(PerfDataRecord &record)
+{
+	PerfEventHeader header;
+
+	if (off == end || error)
+		return (false);
+
+	if (end - off < sizeof(header)) {
+		error = true;
+		return (false);
+	}
+
+	memcpy(&header, buf + off, sizeof(header));
+	if (header.size < sizeof(header) || header.size > end - off) {
+		error = true;
+		return (false);
+	}
+
+	record = PerfDataRecord(buf + off);
+	off += header.size;
+
+	switch (header.type) {
+	case PerfDataRecord::MMAP:
+	case PerfDataRecord::MMAP2:
+	case PerfDataRecord::COMM:
+		if (record.getString() == NULL) {
+			error = true;
+			return (false);
+		}
+		break;
+	case PerfDataRecord::EXIT:
+		if (header.size < sizeof(PerfRecordExit)) {
+			error = true;
+			return (false);
+		}
+		break;
+	}
+
+	return (true);
+}
+
+/*
+ * The fields of a sample appear in a fixed order, each one present only if
+ * its bit is set in sample_type.  Everything up to the callchain is a single
+ * u64 (or a pair of u32s).
+ */
+bool
+PerfDataReader::parseSample(const PerfDataRecord &record,
+    PerfSample &sample) const
+{
+	static const uint64_t fixedFields[] = {
+		SAMPLE_IDENTIFIER,
+		SAMPLE_IP,
+		SAMPLE_TID,
+		SAMPLE_TIME,
+		SAMPLE_ADDR,
+		SAMPLE_ID,
+		SAMPLE_STREAM_ID,
+		SAMPLE_CPU,
+		SAMPLE_PERIOD,
+	};
+	const char *p, *recEnd;
+
+	p = record.getData() + sizeof(PerfEventHeader);
+	recEnd = record.getData() + record.getLength();
+
+	sample.ip = NULL;
+	sample.ips = NULL;
+	sample.nr = 0;
+
+	for (uint64_t field : fixedFields) {
+		if (!(sampleType & field))
+			continue;
+
+		if (recEnd - p < static_cast<ptrdiff_t>(sizeof(uint64_t)))
+			return (false);
+
+		if (field == SAMPLE_IP)
+			sample.ip = reinterpret_cast<const uint64_t *>(p);
+		else if (field == SAMPLE_TID) {
+			memcpy(&sample.pid, p, sizeof(sample.pid));
+			memcpy(&sample.tid, p + sizeof(sample.pid),
+			    sizeof(sample.tid));
+		}
+		p += sizeof(uint64_t);
+	}
+
+	if (sampleType & SAMPLE_CALLCHAIN) {
+		if (recEnd - p < static_cast<ptrdiff_t>(sizeof(uint64_t)))
+			return (false);
+
+		memcpy(&sample.nr, p, sizeof(sample.nr));
+		p += sizeof(uint64_t);
+		if (sample.nr > (recEnd - p) / sizeof(uint64_t))
+			return (false);
+
+		sample.ips = reinterpret_cast<const uint64_t *>(p);
+	}
+
+	return (true);
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "PmcLogEventSource.h"
+
+#include "EventFactory.h"
+#include "PmcLogIndex.h"
+#include "Profiler.h"
+#include "ShardDecoder.h"
+
+#include <err.h>
+
+PmcLogEventSource::PmcLogEventSource(const char *buf, size_t len, unsigned jobs,
+    const TimeWindow & window)
+  : buf(buf), len(len), jobs(jobs), window(window)
+{
+}
+
+bool
+PmcLogEventSource::Feed(Profiler & profiler)
+{
+	uint64_t fromTsc, toTsc;
+
+	if (!window.isSet()) {
+		if (jobs > 1) {
+			ShardDecoder decoder(buf, len, 0, UINT64_MAX,
+			    profiler.getDecimator());
+			decoder.decode(profiler, jobs);
+			return (true);
+		}
+
+		return (EventFactory::processLog(profiler, buf, len));
+	}
+
+	PmcLogIndex index(buf, len);
+	if (!index.build())
+		return (false);
+
+	if (!index.resolve(window, fromTsc, toTsc))
+		errx(1, "--from and --to need a log that records its TSC frequency");
+
+	if (jobs > 1) {
+		ShardDecoder decoder(buf, len, fromTsc, toTsc,
+		    profiler.getDecimator());
+		decoder.decode(profiler, jobs);
+		return (true);
+	}
+
+	return (EventFactory::processLog(profiler, index, fromTsc, toTsc));
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "PmcLogIndex.h"
+
+#include "TimeWindow.h"
+
+#include <pmc.h>
+#include <pmclog.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+PmcLogIndex::PmcLogIndex(const char *buf, size_t len)
+  : buf(buf), len(len), firstTsc(0), haveInit(false)
+{
+}
+
+bool
+PmcLogIndex::IsStateEvent(uint32_t type)
+{
+	switch (type) {
+	case PMCLOG_TYPE_MAP_IN:
+	case PMCLOG_TYPE_MAP_OUT:
+	case PMCLOG_TYPE_PROCEXEC:
+	case PMCLOG_TYPE_PROCEXIT:
+	case PMCLOG_TYPE_PROCFORK:
+	case PMCLOG_TYPE_SYSEXIT:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+bool
+PmcLogIndex::build()
+{
+	size_t off, reclen;
+	Block *block;
+
+	block = NULL;
+	off = 0;
+	while ((reclen = PmcLogReader::RecordLength(buf, off, len)) != 0) {
+		PmcLogRecord record(buf + off);
+		uint64_t tsc = record.getTimestamp();
+
+		if (off == 0)
+			firstTsc = tsc;
+
+		if (block == NULL || block->length + reclen > BLOCK_SIZE) {
+			blocks.push_back(Block{
+				.offset = off,
+				.length = 0,
+				.minTsc = tsc,
+				.maxTsc = tsc,
+				.firstEvent = events.size(),
+				.lastEvent = events.size(),
+			});
+			block = &blocks.back();
+		}
+
+		block->length += reclen;
+		block->minTsc = std::min(block->minTsc, tsc);
+		block->maxTsc = std::max(block->maxTsc, tsc);
+
+		if (IsStateEvent(record.getType())) {
+			events.push_back(off);
+			block->lastEvent = events.size();
+		} else if (record.getType() == PMCLOG_TYPE_INITIALIZE &&
+		    !haveInit) {
+			memcpy(&init, buf + off, sizeof(init));
+			haveInit = true;
+		}
+
+		off += reclen;
+	}
+
+	return (off == len);
+}
+
+uint64_t
+PmcLogIndex::secondsToTsc(double seconds, bool absolute) const
+{
+	double tsc;
+
+	if (absolute)
+		tsc = init.hdr.tsc + (seconds - init.tsSec - init.tsNsec / 1e9) *
+		    init.tscFreq;
+	else
+		tsc = firstTsc + seconds * init.tscFreq;
+
+	if (tsc <= 0)
+		return (0);
+	if (tsc >= static_cast<double>(std::numeric_limits<uint64_t>::max()))
+		return (std::numeric_limits<uint64_t>::max());
+	return (static_cast<uint64_t>(tsc));
+}
+
+bool
+PmcLogIndex::resolve(const TimeWindow & window, uint64_t &fromTsc,
+    uint64_t &toTsc) const
+{
+	fromTsc = 0;
+	toTsc = std::numeric_limits<uint64_t>::max();
+
+	if (!window.isSet())
+		return (true);
+
+	if (!haveInit || init.tscFreq == 0)
+		return (false);
+
+	if (window.from.set)
+		fromTsc = secondsToTsc(window.from.seconds, window.from.absolute);
+	if (window.to.set)
+		toTsc = secondsToTsc(window.to.seconds, window.to.absolute);
+	return (true);
+}
@@ -0,0 +1,161 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "PmcLogIndex.h"
+
+#include "TimeWindow.h"
+
+#include "mock/PmcLogBuilder.h"
+
+#include <pmc.h>
+#include <pmclog.h>
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+using namespace testing;
+
+TEST(PmcLogIndexTestSuite, TestEmpty)
+{
+	PmcLogIndex index(NULL, 0);
+
+	EXPECT_TRUE(index.build());
+	EXPECT_TRUE(index.getBlocks().empty());
+}
+
+TEST(PmcLogIndexTestSuite, TestBlocks)
+{
+	PmcLogBuilder log;
+
+	log.SetTimestamp(100);
+	log.AddInitialize(1000);
+	for (int i = 0; i < 20000; ++i) {
+		log.SetTimestamp(200 + i);
+		log.AddCallchain(5, true, {0x401001, 0x402001});
+		if (i % 5000 == 0)
+			log.AddMapIn(5, 0x800000000 + i, "/lib/libc.so.7");
+	}
+	log.AddExit(5);
+
+	PmcLogIndex index(log.data(), log.size());
+	ASSERT_TRUE(index.build());
+
+	const auto & blocks = index.getBlocks();
+	ASSERT_GT(blocks.size(), 1);
+
+	size_t offset = 0;
+	size_t events = 0;
+	uint64_t lastMax = 0;
+	for (const auto & block : blocks) {
+		EXPECT_EQ(block.offset, offset);
+		EXPECT_LE(block.minTsc, block.maxTsc);
+		EXPECT_GE(block.minTsc, lastMax);
+		EXPECT_EQ(block.firstEvent, events);
+		offset += block.length;
+		events = block.lastEvent;
+		lastMax = block.maxTsc;
+	}
+	EXPECT_EQ(offset, log.size());
+	EXPECT_EQ(events, 5);
+
+	EXPECT_EQ(index.getEvent(0).getType(), PMCLOG_TYPE_MAP_IN);
+	EXPECT_EQ(index.getEvent(4).getType(), PMCLOG_TYPE_PROCEXIT);
+}
+
+TEST(PmcLogIndexTestSuite, TestResolveRelative)
+{
+	PmcLogBuilder log;
+	TimeWindow window;
+	uint64_t from, to;
+
+	log.SetTimestamp(5000);
+	log.AddInitialize(1000);
+	log.SetTimestamp(9000);
+	log.AddCallchain(5, true, {0x401001});
+
+	PmcLogIndex index(log.data(), log.size());
+	ASSERT_TRUE(index.build());
+
+	ASSERT_TRUE(index.resolve(window, from, to));
+	EXPECT_EQ(from, 0);
+	EXPECT_EQ(to, std::numeric_limits<uint64_t>::max());
+
+	window.from.set = true;
+	window.from.seconds = 2;
+	ASSERT_TRUE(index.resolve(window, from, to));
+	EXPECT_EQ(from, 7000);
+	EXPECT_EQ(to, std::numeric_limits<uint64_t>::max());
+
+	window.to.set = true;
+	window.to.seconds = 3.5;
+	ASSERT_TRUE(index.resolve(window, from, to));
+	EXPECT_EQ(from, 7000);
+	EXPECT_EQ(to, 8500);
+}
+
+TEST(PmcLogIndexTestSuite, TestResolveAbsolute)
+{
+	PmcLogBuilder log;
+	TimeWindow window;
+	uint64_t from, to;
+
+	log.SetTimestamp(5000);
+	log.AddInitialize(1000, 1700000000);
+
+	PmcLogIndex index(log.data(), log.size());
+	ASSERT_TRUE(index.build());
+
+	window.from = { .set = true, .absolute = true, .seconds = 1700000002 };
+	window.to = { .set = true, .absolute = true, .seconds = 1600000000 };
+	ASSERT_TRUE(index.resolve(window, from, to));
+	EXPECT_EQ(from, 7000);
+	EXPECT_EQ(to, 0);
+}
+
+TEST(PmcLogIndexTestSuite, TestNoFrequency)
+{
+	PmcLogBuilder log;
+	TimeWindow window;
+	uint64_t from, to;
+
+	log.AddCallchain(5, true, {0x401001});
+
+	PmcLogIndex index(log.data(), log.size());
+	ASSERT_TRUE(index.build());
+
+	window.to.set = true;
+	window.to.seconds = 1;
+	EXPECT_FALSE(index.resolve(window, from, to));
+}
+
+TEST(PmcLogIndexTestSuite, TestCorrupt)
+{
+	PmcLogBuilder log;
+
+	log.AddInitialize(1000);
+	log.AddGarbage(64);
+
+	PmcLogIndex index(log.data(), log.size());
+	EXPECT_FALSE(index.build());
+}
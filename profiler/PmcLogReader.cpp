@@ -0,0 +1,177 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "PmcLogReader.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <pmc.h>
+#include <pmclog.h>
+#include <string.h>
+
+const char *
+PmcLogRecord::getPathname() const
+{
+	if (getType() == PMCLOG_TYPE_MAP_IN)
+		return (data + sizeof(PmcLogMapIn));
+	else
+		return (data + sizeof(PmcLogProcExec));
+}
+
+size_t
+PmcLogReader::MinLength(uint32_t type)
+{
+	switch (type) {
+	case PMCLOG_TYPE_CALLCHAIN:
+		return (sizeof(PmcLogCallchain) + sizeof(uintptr_t));
+	case PMCLOG_TYPE_INITIALIZE:
+		return (sizeof(PmcLogInitialize));
+	case PMCLOG_TYPE_MAP_IN:
+		return (sizeof(PmcLogMapIn) + 1);
+	case PMCLOG_TYPE_MAP_OUT:
+		return (sizeof(PmcLogMapOut));
+	case PMCLOG_TYPE_PROCEXEC:
+		return (sizeof(PmcLogProcExec) + 1);
+	case PMCLOG_TYPE_PROCEXIT:
+		return (sizeof(PmcLogProcExit));
+	case PMCLOG_TYPE_PROCFORK:
+		return (sizeof(PmcLogProcFork));
+	case PMCLOG_TYPE_SYSEXIT:
+		return (sizeof(PmcLogSysExit));
+	default:
+		return (sizeof(PmcLogHeader));
+	}
+}
+
+/*
+ * Returns true if the data that remains could be the start of a valid record
+ * that has not been completely read in yet.
+ */
+bool
+PmcLogReader::Truncated(const char *rec, size_t avail)
+{
+	uint32_t header;
+
+	if (avail < sizeof(header))
+		return (true);
+
+	memcpy(&header, rec, sizeof(header));
+	return (PmcLogRecord::HeaderToMagic(header) == PmcLogRecord::HEADER_MAGIC &&
+	    PmcLogRecord::HeaderToLength(header) > avail);
+}
+
+size_t
+PmcLogReader::RecordLength(const char *buf, size_t off, size_t len)
+{
+	uint32_t header;
+
+	if (off + sizeof(PmcLogHeader) > len)
+		return (0);
+
+	memcpy(&header, buf + off, sizeof(header));
+	if (PmcLogRecord::HeaderToMagic(header) != PmcLogRecord::HEADER_MAGIC)
+		return (0);
+
+	size_t reclen = PmcLogRecord::HeaderToLength(header);
+	if (reclen < MinLength(PmcLogRecord::HeaderToType(header)) ||
+	    off + reclen > len)
+		return (0);
+
+	return (reclen);
+}
+
+bool
+PmcLogReader::next(PmcLogRecord &record)
+{
+	size_t reclen;
+
+	if (off == len || error)
+		return (false);
+
+	reclen = RecordLength(buf, off, len);
+	if (reclen == 0) {
+		if (!partial || !Truncated(buf + off, len - off))
+			error = true;
+		return (false);
+	}
+
+	record = PmcLogRecord(buf + off);
+	off += reclen;
+
+	switch (record.getType()) {
+	case PMCLOG_TYPE_MAP_IN:
+	case PMCLOG_TYPE_PROCEXEC: {
+		/*
+		 * The pathname must be terminated inside the record.  hwpmc
+		 * pads the record out to a word without zeroing the padding,
+		 * so the NUL need not be the last byte.
+		 */
+		const char *path = record.getPathname();
+		if (memchr(path, '\0', buf + off - path) == NULL) {
+			error = true;
+			return (false);
+		}
+		break;
+	}
+	}
+
+	return (true);
+}
+
+MappedLog::MappedLog()
+  : buf(NULL), len(0)
+{
+}
+
+MappedLog::~MappedLog()
+{
+	if (buf != NULL)
+		munmap(buf, len);
+}
+
+bool
+MappedLog::map(int fd)
+{
+	struct stat sb;
+
+	if (fstat(fd, &sb) != 0)
+		return (false);
+
+	len = sb.st_size;
+	if (len == 0)
+		return (true);
+
+	buf = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (buf == MAP_FAILED) {
+		buf = NULL;
+		len = 0;
+		return (false);
+	}
+
+	madvise(buf, len, MADV_SEQUENTIAL);
+	return (true);
+}
@@ -0,0 +1,207 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "PmcLogReader.h"
+
+#include "mock/PmcLogBuilder.h"
+
+#include <pmc.h>
+#include <pmclog.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace testing;
+
+TEST(PmcLogReaderTestSuite, TestEmpty)
+{
+	PmcLogReader reader(NULL, 0);
+	PmcLogRecord record;
+
+	EXPECT_FALSE(reader.next(record));
+	EXPECT_FALSE(reader.failed());
+}
+
+TEST(PmcLogReaderTestSuite, TestRecords)
+{
+	PmcLogBuilder log;
+	PmcLogRecord record;
+
+	log.SetTimestamp(1000);
+	log.AddInitialize(2400000000);
+	log.SetTimestamp(1001);
+	log.AddMapIn(45, 0x800200000, "/lib/libc.so.7");
+	log.SetTimestamp(1002);
+	log.AddCallchain(45, true, {0x800201234, 0x800205678, 0x400123});
+	log.SetTimestamp(1003);
+	log.AddExec(46, "/usr/bin/make", 0x800000000);
+	log.AddExit(46);
+
+	PmcLogReader reader(log.data(), log.size());
+
+	ASSERT_TRUE(reader.next(record));
+	EXPECT_EQ(record.getType(), PMCLOG_TYPE_INITIALIZE);
+	EXPECT_EQ(record.getTimestamp(), 1000);
+	EXPECT_EQ(record.get<PmcLogInitialize>().tscFreq, 2400000000);
+
+	ASSERT_TRUE(reader.next(record));
+	EXPECT_EQ(record.getType(), PMCLOG_TYPE_MAP_IN);
+	EXPECT_EQ(record.getTimestamp(), 1001);
+	EXPECT_EQ(record.get<PmcLogMapIn>().pid, 45);
+	EXPECT_EQ(record.get<PmcLogMapIn>().start, 0x800200000);
+	EXPECT_STREQ(record.getPathname(), "/lib/libc.so.7");
+
+	ASSERT_TRUE(reader.next(record));
+	EXPECT_EQ(record.getType(), PMCLOG_TYPE_CALLCHAIN);
+	EXPECT_EQ(record.get<PmcLogCallchain>().pid, 45);
+	EXPECT_EQ(record.get<PmcLogCallchain>().cpuflags, PMC_CC_F_USERSPACE);
+	ASSERT_EQ(record.getCallchainDepth(), 3);
+	EXPECT_EQ(record.getCallchainPCs()[0], 0x800201234);
+	EXPECT_EQ(record.getCallchainPCs()[1], 0x800205678);
+	EXPECT_EQ(record.getCallchainPCs()[2], 0x400123);
+
+	ASSERT_TRUE(reader.next(record));
+	EXPECT_EQ(record.getType(), PMCLOG_TYPE_PROCEXEC);
+	EXPECT_EQ(record.get<PmcLogProcExec>().pid, 46);
+	EXPECT_EQ(record.get<PmcLogProcExec>().dynaddr, 0x800000000);
+	EXPECT_STREQ(record.getPathname(), "/usr/bin/make");
+
+	ASSERT_TRUE(reader.next(record));
+	EXPECT_EQ(record.getType(), PMCLOG_TYPE_PROCEXIT);
+	EXPECT_EQ(record.get<PmcLogProcExit>().pid, 46);
+
+	EXPECT_FALSE(reader.next(record));
+	EXPECT_FALSE(reader.failed());
+	EXPECT_EQ(reader.getOffset(), log.size());
+}
+
+TEST(PmcLogReaderTestSuite, TestBadMagic)
+{
+	PmcLogBuilder log;
+	PmcLogRecord record;
+
+	log.AddExit(46);
+	log.AddGarbage(32);
+
+	PmcLogReader reader(log.data(), log.size());
+
+	EXPECT_TRUE(reader.next(record));
+	EXPECT_FALSE(reader.next(record));
+	EXPECT_TRUE(reader.failed());
+
+	// Once the reader has failed it stays failed.
+	EXPECT_FALSE(reader.next(record));
+}
+
+TEST(PmcLogReaderTestSuite, TestTruncatedRecord)
+{
+	PmcLogBuilder log;
+	PmcLogRecord record;
+
+	log.AddCallchain(45, true, {0x800201234, 0x800205678, 0x400123});
+
+	PmcLogReader reader(log.data(), log.size() - 8);
+
+	EXPECT_FALSE(reader.next(record));
+	EXPECT_TRUE(reader.failed());
+}
+
+TEST(PmcLogReaderTestSuite, TestShortRecord)
+{
+	PmcLogBuilder log;
+	PmcLogRecord record;
+
+	// A callchain record with no room for a single PC.
+	log.AddRecord(PMCLOG_TYPE_CALLCHAIN, sizeof(PmcLogCallchain));
+
+	PmcLogReader reader(log.data(), log.size());
+
+	EXPECT_FALSE(reader.next(record));
+	EXPECT_TRUE(reader.failed());
+	EXPECT_EQ(PmcLogReader::RecordLength(log.data(), 0, log.size()), 0);
+}
+
+TEST(PmcLogReaderTestSuite, TestPartialRecord)
+{
+	PmcLogBuilder log;
+	PmcLogRecord record;
+
+	log.AddExit(46);
+	log.AddCallchain(45, true, {0x800201234, 0x800205678, 0x400123});
+
+	// A record cut off by the end of the buffer is left for later.
+	PmcLogReader reader(log.data(), log.size() - 8, true);
+
+	EXPECT_TRUE(reader.next(record));
+	EXPECT_FALSE(reader.next(record));
+	EXPECT_FALSE(reader.failed());
+	EXPECT_EQ(reader.getOffset(), sizeof(PmcLogProcExit));
+
+	// So is a partial header.
+	PmcLogReader header(log.data() + sizeof(PmcLogProcExit), 2, true);
+	EXPECT_FALSE(header.next(record));
+	EXPECT_FALSE(header.failed());
+
+	// Garbage is still garbage.
+	log.AddGarbage(32);
+	PmcLogReader garbage(log.data(), log.size(), true);
+	EXPECT_TRUE(garbage.next(record));
+	EXPECT_TRUE(garbage.next(record));
+	EXPECT_FALSE(garbage.next(record));
+	EXPECT_TRUE(garbage.failed());
+}
+
+TEST(PmcLogReaderTestSuite, TestUnzeroedPadding)
+{
+	PmcLogBuilder log;
+	PmcLogRecord record;
+
+	// hwpmc doesn't zero the padding after the pathname.
+	log.AddMapIn(45, 0x800200000, "/lib/libc.so.7");
+	log.AddExec(46, "/bin/csh", 0x800000000);
+
+	std::vector<char> buf(log.data(), log.data() + log.size());
+	size_t mapIn = sizeof(PmcLogMapIn) + strlen("/lib/libc.so.7") + 1;
+	size_t exec = sizeof(PmcLogMapIn) + 16 + sizeof(PmcLogProcExec) +
+	    strlen("/bin/csh") + 1;
+	memset(&buf[mapIn], 0x5a, sizeof(PmcLogMapIn) + 16 - mapIn);
+	memset(&buf[exec], 0x5a, buf.size() - exec);
+	ASSERT_EQ(buf.back(), 0x5a);
+
+	PmcLogReader reader(buf.data(), buf.size());
+
+	ASSERT_TRUE(reader.next(record));
+	EXPECT_STREQ(record.getPathname(), "/lib/libc.so.7");
+	ASSERT_TRUE(reader.next(record));
+	EXPECT_STREQ(record.getPathname(), "/bin/csh");
+	EXPECT_FALSE(reader.next(record));
+	EXPECT_FALSE(reader.failed());
+
+	// A pathname with no NUL at all is still rejected.
+	memset(&buf[sizeof(PmcLogMapIn)], 'a', 16);
+	PmcLogReader bad(buf.data(), buf.size());
+	EXPECT_FALSE(bad.next(record));
+	EXPECT_TRUE(bad.failed());
+}
@@ -0,0 +1,395 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "ProfileFile.h"
+
+#include "Callchain.h"
+#include "Callframe.h"
+#include "CallframeMapper.h"
+#include "Image.h"
+#include "ImageFactory.h"
+#include "Profiler.h"
+#include "Sample.h"
+#include "SampleAggregation.h"
+#include "SharedString.h"
+#include "Varint.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+
+const char ProfileFile::MAGIC[8] = { 'P', 'M', 'C', 'P', 'R', 'O', 'F', '\0' };
+
+namespace
+{
+	/* A frame's address, image name and offset within the image. */
+	typedef std::tuple<TargetAddr, size_t, TargetAddr> FrameKey;
+
+	class StringTable
+	{
+		std::unordered_map<std::string, size_t> index;
+		std::vector<const std::string *> strings;
+
+	public:
+		size_t Add(const std::string & str)
+		{
+			auto [it, inserted] = index.emplace(str, strings.size());
+			if (inserted)
+				strings.push_back(&it->first);
+			return (it->second);
+		}
+
+		void Write(VarintWriter & out) const
+		{
+			out.put(strings.size());
+			for (auto str : strings)
+				out.putString(*str);
+		}
+	};
+
+	struct SpaceTable
+	{
+		size_t executable;
+
+		/* Maps each frame to its index in the table. */
+		std::map<FrameKey, size_t> frames;
+
+		/*
+		 * Whether adding keys would map an address to two different
+		 * frames, e.g. because a library was mapped out and another
+		 * loaded at the same address.
+		 */
+		bool conflicts(const std::vector<FrameKey> & keys) const
+		{
+			for (const auto & key : keys) {
+				auto it = frames.lower_bound(
+				    FrameKey(std::get<0>(key), 0, 0));
+				if (it != frames.end() &&
+				    std::get<0>(it->first) == std::get<0>(key) &&
+				    it->first != key)
+					return (true);
+			}
+			return (false);
+		}
+
+		bool contains(const std::vector<FrameKey> & keys) const
+		{
+			for (const auto & key : keys) {
+				if (frames.count(key) == 0)
+					return (false);
+			}
+			return (true);
+		}
+	};
+
+	/* (aggregation, executable name) */
+	typedef std::pair<size_t, size_t> SpaceKey;
+
+	/*
+	 * Stands in for the address spaces of one executable that saved
+	 * callchains were originally mapped with.  It only knows the frames
+	 * that were saved.
+	 */
+	class SavedAddressSpace : public CallframeMapper
+	{
+		SharedString executable;
+		Image & unmapped;
+		std::vector<TargetAddr> addrs;
+		std::vector<const Callframe *> frames;
+
+	public:
+		SavedAddressSpace(SharedString exe, Image & unmapped)
+		  : executable(exe), unmapped(unmapped)
+		{
+		}
+
+		void addFrame(TargetAddr addr, const Callframe & frame)
+		{
+			addrs.push_back(addr);
+			frames.push_back(&frame);
+		}
+
+		size_t getNumFrames() const
+		{
+			return (addrs.size());
+		}
+
+		TargetAddr getAddress(size_t index) const
+		{
+			return (addrs[index]);
+		}
+
+		const Callframe & mapFrame(TargetAddr addr) override
+		{
+			auto it = std::lower_bound(addrs.begin(), addrs.end(),
+			    addr);
+			if (it == addrs.end() || *it != addr)
+				return (unmapped.GetFrame(addr));
+
+			return (*frames[it - addrs.begin()]);
+		}
+
+		SharedString getExecutableName() const override
+		{
+			return (executable);
+		}
+	};
+}
+
+bool
+ProfileFile::Write(const std::string & path, const AggregationList & aggList)
+{
+	std::map<SpaceKey, std::vector<size_t>> spaceIndex;
+	std::vector<SpaceTable> spaces;
+	std::vector<FrameKey> keys;
+	std::vector<uint8_t> body;
+	VarintWriter out(body);
+	StringTable strings;
+	Header header;
+	FILE *file;
+
+	auto getKeys = [&](const Callchain & chain) {
+		keys.clear();
+		for (const auto & frame : chain.getRecords()) {
+			const Callframe & cf = frame.getFrame();
+			keys.emplace_back(frame.getAddress(),
+			    strings.Add(*cf.getImageName()), cf.getOffset());
+		}
+	};
+
+	/*
+	 * Collect every string and every frame first, so that the tables can
+	 * be written ahead of the callchains that refer to them.  Each
+	 * aggregation gets its own address spaces: processes running the same
+	 * executable may have their images loaded at different addresses.
+	 */
+	for (size_t i = 0; i < aggList.size(); ++i) {
+		auto agg = aggList[i];
+		strings.Add(agg->getExecutable());
+
+		agg->forEachCallchain([&](const Callchain & chain) {
+			size_t exe = strings.Add(*chain.getExecutableName());
+			auto & candidates = spaceIndex[SpaceKey(i, exe)];
+
+			getKeys(chain);
+			auto it = std::find_if(candidates.begin(),
+			    candidates.end(), [&](size_t candidate) {
+				return (!spaces.at(candidate).conflicts(keys));
+			});
+			if (it == candidates.end()) {
+				it = candidates.insert(it, spaces.size());
+				spaces.push_back({exe, {}});
+			}
+
+			auto & space = spaces.at(*it);
+			for (const auto & key : keys)
+				space.frames.emplace(key, 0);
+		});
+	}
+
+	strings.Write(out);
+
+	out.put(spaces.size());
+	for (auto & space : spaces) {
+		TargetAddr prevAddr = 0, prevLoad = 0;
+		size_t next = 0;
+
+		out.put(space.executable);
+		out.put(space.frames.size());
+		for (auto & [key, index] : space.frames) {
+			auto [addr, image, offset] = key;
+
+			index = next++;
+			out.put(addr - prevAddr);
+			out.put(image);
+			out.putSigned(static_cast<int64_t>(addr - offset - prevLoad));
+			prevAddr = addr;
+			prevLoad = addr - offset;
+		}
+	}
+
+	out.put(aggList.size());
+	for (size_t i = 0; i < aggList.size(); ++i) {
+		auto agg = aggList[i];
+		out.putSigned(agg->getPid());
+		out.put(strings.Add(agg->getExecutable()));
+
+		/*
+		 * Spilled chains are streamed from disk, so they aren't counted
+		 * until they have all been written.
+		 */
+		std::vector<uint8_t> chainBody;
+		VarintWriter chainOut(chainBody);
+		size_t numChains = 0;
+
+		agg->forEachCallchain([&](const Callchain & chain) {
+			size_t exe = strings.Add(*chain.getExecutableName());
+			const auto & candidates = spaceIndex.at(SpaceKey(i, exe));
+
+			getKeys(chain);
+			size_t index = *std::find_if(candidates.begin(),
+			    candidates.end(), [&](size_t candidate) {
+				return (spaces.at(candidate).contains(keys));
+			});
+			const auto & space = spaces.at(index);
+			int64_t prev = 0;
+
+			chainOut.put(index);
+			chainOut.put(chain.getSampleCount());
+			chainOut.put(keys.size());
+			for (const auto & key : keys) {
+				int64_t cur = space.frames.at(key);
+
+				chainOut.putSigned(cur - prev);
+				prev = cur;
+			}
+			numChains++;
+		});
+
+		out.put(numChains);
+		body.insert(body.end(), chainBody.begin(), chainBody.end());
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(header.magic));
+	header.version = VERSION;
+
+	file = fopen(path.c_str(), "w");
+	if (file == NULL)
+		return (false);
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+	    fwrite(body.data(), 1, body.size(), file) != body.size()) {
+		fclose(file);
+		return (false);
+	}
+
+	return (fclose(file) == 0);
+}
+
+bool
+ProfileFile::Read(const char *buf, size_t len, Profiler & profiler,
+    ImageFactory & imgFactory, MapperList & spaces)
+{
+	std::vector<SavedAddressSpace *> saved;
+	std::vector<std::string_view> strings;
+	std::vector<Image *> images;
+	std::vector<uintptr_t> pcs;
+	Header header;
+
+	if (len < sizeof(header))
+		return (false);
+
+	memcpy(&header, buf, sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 ||
+	    header.version != VERSION)
+		return (false);
+
+	VarintReader in(buf + sizeof(header), len - sizeof(header));
+
+	strings.resize(in.getCount());
+	for (auto & str : strings)
+		str = in.getString();
+	if (in.failed())
+		return (false);
+
+	images.resize(strings.size(), NULL);
+	saved.resize(in.getCount(2));
+	for (auto & space : saved) {
+		TargetAddr addr = 0, load = 0;
+
+		uint64_t exe = in.get();
+		if (in.failed() || exe >= strings.size())
+			return (false);
+
+		auto ptr = std::make_unique<SavedAddressSpace>(
+		    std::string(strings[exe]), imgFactory.GetUnmappedImage());
+		space = ptr.get();
+		spaces.push_back(std::move(ptr));
+
+		uint64_t nframes = in.getCount(3);
+		for (uint64_t i = 0; i < nframes; ++i) {
+			addr += in.get();
+			uint64_t image = in.get();
+			load += in.getSigned();
+			if (in.failed() || image >= strings.size())
+				return (false);
+
+			if (images[image] == NULL) {
+				if (strings[image].empty())
+					images[image] = &imgFactory.GetUnmappedImage();
+				else
+					images[image] = imgFactory.GetImage(
+					    std::string(strings[image]));
+			}
+
+			space->addFrame(addr, images[image]->GetFrame(addr - load));
+		}
+	}
+
+	uint64_t naggs = in.getCount(3);
+	for (uint64_t i = 0; i < naggs; ++i) {
+		pid_t pid = in.getSigned();
+		uint64_t exe = in.get();
+		if (in.failed() || exe >= strings.size())
+			return (false);
+
+		profiler.startAggregation(pid, std::string(strings[exe]));
+
+		uint64_t nchains = in.getCount(4);
+		for (uint64_t j = 0; j < nchains; ++j) {
+			uint64_t index = in.get();
+			uint64_t count = in.get();
+			uint64_t depth = in.getCount();
+			if (in.failed() || index >= saved.size() || depth == 0)
+				return (false);
+
+			const auto & space = *saved[index];
+			int64_t frame = 0;
+
+			pcs.resize(depth);
+			for (auto & pc : pcs) {
+				frame += in.getSigned();
+				if (frame < 0 ||
+				    static_cast<size_t>(frame) >= space.getNumFrames())
+					return (false);
+
+				/* Samples hold return addresses. */
+				pc = space.getAddress(frame) + 1;
+			}
+
+			profiler.processEvent(*saved[index],
+			    Sample(pid, pcs.data(), depth), count);
+		}
+	}
+
+	return (!in.failed() && in.atEnd());
+}
@@ -0,0 +1,383 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "ProfileFile.h"
+
+#include "Callchain.h"
+#include "Callframe.h"
+#include "CallframeMapper.h"
+#include "DefaultCallchainFactory.h"
+#include "DefaultImageFactory.h"
+#include "Image.h"
+#include "Profiler.h"
+#include "Sample.h"
+#include "SampleAggregation.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Stubs
+const Callframe &
+Image::GetFrame(TargetAddr offset)
+{
+	auto & frame = frameMap[offset];
+	if (!frame)
+		frame = std::make_unique<Callframe>(offset, imageFile);
+	return *frame;
+}
+
+Image::Image(SharedString n, Arena *)
+  : imageFile(n)
+{}
+
+Image::~Image() {}
+void Image::MapAllFrames(bool) {}
+void Image::MapAllAsUnmapped() {}
+DwarfResolver::~DwarfResolver() {}
+
+/*
+ * Describes a callchain by what a printer would see: the executable, and the
+ * image and offset of each frame.
+ */
+static std::string
+DescribeChain(const CallframeMapper & space, const Sample & sample,
+    CallframeMapper & mapper, size_t count)
+{
+	std::ostringstream str;
+
+	str << *space.getExecutableName() << " x" << count << std::hex;
+	for (int i = 0; i < sample.getChainDepth(); ++i) {
+		const Callframe & frame = mapper.mapFrame(sample.getAddress(i));
+		str << " " << sample.getAddress(i) << "=" <<
+		    *frame.getImageName() << "+" << frame.getOffset();
+	}
+	return (str.str());
+}
+
+struct LoadedAggregation
+{
+	pid_t pid;
+	std::string executable;
+	std::vector<std::string> chains;
+};
+
+static std::vector<LoadedAggregation> loaded;
+
+void
+Profiler::startAggregation(pid_t pid, const std::string & executable)
+{
+	loaded.push_back({pid, executable, {}});
+}
+
+void
+Profiler::processEvent(CallframeMapper & space, const Sample& sample,
+    uint64_t count)
+{
+	loaded.back().chains.push_back(DescribeChain(space, sample, space,
+	    count));
+}
+
+/*
+ * Maps everything above the library's base (LIB_BASE unless given) into a
+ * shared library and everything else into the executable, or into the
+ * unmapped image if there is no executable.
+ */
+class TestSpace : public CallframeMapper
+{
+	ImageFactory & factory;
+	SharedString executable;
+	SharedString library;
+	TargetAddr libBase;
+
+public:
+	static const TargetAddr LIB_BASE = 0x800000000;
+
+	TestSpace(ImageFactory & f, SharedString exe, SharedString lib,
+	    TargetAddr base = LIB_BASE)
+	  : factory(f), executable(exe), library(lib), libBase(base)
+	{
+	}
+
+	const Callframe & mapFrame(TargetAddr addr) override
+	{
+		if (addr >= libBase)
+			return factory.GetImage(library)->GetFrame(addr - libBase);
+		if (executable->empty())
+			return factory.GetUnmappedImage().GetFrame(addr);
+		return factory.GetImage(executable)->GetFrame(addr);
+	}
+
+	SharedString getExecutableName() const override
+	{
+		if (executable->empty())
+			return "<unknown>";
+		return executable;
+	}
+};
+
+class ProfileFileTestSuite : public ::testing::Test
+{
+public:
+	DefaultImageFactory imgFactory;
+	DefaultCallchainFactory ccFactory;
+	CallchainStore chainStore;
+	Profiler *profiler = nullptr;
+	std::string path;
+
+	ProfileFileTestSuite()
+	{
+		char tmp[] = "/tmp/profilefile.XXXXXX";
+		int fd = mkstemp(tmp);
+		if (fd >= 0)
+			close(fd);
+		path = tmp;
+		loaded.clear();
+	}
+
+	~ProfileFileTestSuite()
+	{
+		unlink(path.c_str());
+	}
+
+	std::vector<char>
+	ReadFile()
+	{
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(in),
+		    std::istreambuf_iterator<char>());
+	}
+
+	static std::vector<std::string>
+	Describe(const SampleAggregation & agg)
+	{
+		std::vector<std::string> chains;
+		CallchainList list;
+
+		agg.getCallchainList(list);
+		for (const auto & rec : list) {
+			std::ostringstream str;
+			const Callchain & chain = *rec.chain;
+
+			str << *chain.getExecutableName() << " x" <<
+			    chain.getSampleCount() << std::hex;
+			for (const auto & frame : chain.getRecords()) {
+				str << " " << frame.getAddress() << "=" <<
+				    *frame.getFrame().getImageName() << "+" <<
+				    frame.getFrame().getOffset();
+			}
+			chains.push_back(str.str());
+		}
+
+		std::sort(chains.begin(), chains.end());
+		return chains;
+	}
+};
+
+TEST_F(ProfileFileTestSuite, TestRoundTrip)
+{
+	TestSpace shSpace(imgFactory, "/bin/sh", "/lib/libc.so.7");
+	TestSpace kernSpace(imgFactory, "/boot/kernel/kernel",
+	    "/boot/kernel/zfs.ko");
+	TestSpace anonSpace(imgFactory, "", "/lib/libthr.so.3");
+	SampleAggregation sh(ccFactory, chainStore, "/bin/sh", 10);
+	SampleAggregation anon(ccFactory, chainStore, "", 20);
+	AggregationList aggs = { &sh, &anon };
+
+	uintptr_t user1[] = { 0x800001235, 0x400101, 0x400001 };
+	uintptr_t user2[] = { 0x400201, 0x400001 };
+	uintptr_t kern[] = { 0x800123001, 0x1001 };
+	uintptr_t anon1[] = { 0x1234567, 0x800000100 };
+
+	// kern is a kernel-mode sample only as far as TestSpace is concerned.
+	sh.addSample(shSpace, Sample(10, user1, 3), 5);
+	sh.addSample(shSpace, Sample(10, user2, 2), 1);
+	sh.addSample(kernSpace, Sample(10, kern, 2), 7);
+	anon.addSample(anonSpace, Sample(20, anon1, 2), 2);
+
+	ASSERT_TRUE(ProfileFile::Write(path, aggs));
+
+	auto file = ReadFile();
+	ProfileFile::MapperList spaces;
+	ASSERT_TRUE(ProfileFile::Read(file.data(), file.size(), *profiler,
+	    imgFactory, spaces));
+
+	ASSERT_EQ(loaded.size(), 2);
+	EXPECT_EQ(loaded.at(0).pid, 10);
+	EXPECT_EQ(loaded.at(0).executable, "/bin/sh");
+	EXPECT_EQ(loaded.at(1).pid, 20);
+	EXPECT_EQ(loaded.at(1).executable, "");
+	EXPECT_EQ(spaces.size(), 3);
+
+	for (auto & agg : loaded)
+		std::sort(agg.chains.begin(), agg.chains.end());
+	EXPECT_EQ(loaded.at(0).chains, Describe(sh));
+	EXPECT_EQ(loaded.at(1).chains, Describe(anon));
+}
+
+TEST_F(ProfileFileTestSuite, TestLargeCount)
+{
+	TestSpace space(imgFactory, "/bin/sh", "/lib/libc.so.7");
+	SampleAggregation sh(ccFactory, chainStore, "/bin/sh", 10);
+	AggregationList aggs = { &sh };
+
+	uintptr_t user[] = { 0x400201, 0x400001 };
+
+	// More samples than a 32-bit count holds.
+	sh.addSample(space, Sample(10, user, 2), 5000000000);
+
+	ASSERT_TRUE(ProfileFile::Write(path, aggs));
+
+	auto file = ReadFile();
+	ProfileFile::MapperList spaces;
+	ASSERT_TRUE(ProfileFile::Read(file.data(), file.size(), *profiler,
+	    imgFactory, spaces));
+
+	ASSERT_EQ(loaded.size(), 1);
+	EXPECT_EQ(loaded.at(0).chains, Describe(sh));
+}
+
+TEST_F(ProfileFileTestSuite, TestAslr)
+{
+	// Two processes of one executable with libc loaded at different
+	// addresses, and a third that replaced its library while it ran.
+	TestSpace space1(imgFactory, "/bin/sh", "/lib/libc.so.7");
+	TestSpace space2(imgFactory, "/bin/sh", "/lib/libc.so.7",
+	    TestSpace::LIB_BASE + 0x100000);
+	TestSpace space3(imgFactory, "/bin/sh", "/lib/libthr.so.3",
+	    TestSpace::LIB_BASE + 0x100000);
+	SampleAggregation sh1(ccFactory, chainStore, "/bin/sh", 10);
+	SampleAggregation sh2(ccFactory, chainStore, "/bin/sh", 11);
+	SampleAggregation sh3(ccFactory, chainStore, "/bin/sh", 12);
+	AggregationList aggs = { &sh1, &sh2, &sh3 };
+
+	uintptr_t pcs1[] = { 0x800101235, 0x400101 };
+	uintptr_t pcs2[] = { 0x800101235, 0x400201 };
+
+	sh1.addSample(space1, Sample(10, pcs1, 2), 3);
+	sh2.addSample(space2, Sample(11, pcs1, 2), 4);
+	sh3.addSample(space2, Sample(12, pcs1, 2), 5);
+	sh3.addSample(space3, Sample(12, pcs2, 2), 6);
+
+	ASSERT_TRUE(ProfileFile::Write(path, aggs));
+
+	auto file = ReadFile();
+	ProfileFile::MapperList spaces;
+	ASSERT_TRUE(ProfileFile::Read(file.data(), file.size(), *profiler,
+	    imgFactory, spaces));
+
+	// The same address is in a different image or at a different offset
+	// in each chain.
+	ASSERT_EQ(loaded.size(), 3);
+	for (auto & agg : loaded)
+		std::sort(agg.chains.begin(), agg.chains.end());
+	EXPECT_EQ(loaded.at(0).chains, Describe(sh1));
+	EXPECT_EQ(loaded.at(1).chains, Describe(sh2));
+	EXPECT_EQ(loaded.at(2).chains, Describe(sh3));
+	EXPECT_NE(loaded.at(0).chains, loaded.at(1).chains);
+	EXPECT_EQ(spaces.size(), 4);
+}
+
+TEST_F(ProfileFileTestSuite, TestSpilled)
+{
+	TestSpace space(imgFactory, "/bin/sh", "/lib/libc.so.7");
+	SpillBudget budget(1);
+	SampleAggregation spilled(ccFactory, chainStore, "/bin/sh", 10, false,
+	    0, &budget);
+	SampleAggregation inMemory(ccFactory, chainStore, "/bin/sh", 10);
+	AggregationList aggs = { &spilled };
+
+	uintptr_t user1[] = { 0x800001235, 0x400101, 0x400001 };
+	uintptr_t user2[] = { 0x400201, 0x400001 };
+
+	// Every sample spills a run, and the runs stay on disk at exit.
+	for (auto agg : { &spilled, &inMemory }) {
+		agg->addSample(space, Sample(10, user1, 3), 5);
+		agg->addSample(space, Sample(10, user2, 2), 1);
+		agg->addSample(space, Sample(10, user1, 3), 2);
+		agg->finalize();
+	}
+
+	CallchainList list;
+	spilled.getCallchainList(list);
+	EXPECT_TRUE(list.empty());
+
+	ASSERT_TRUE(ProfileFile::Write(path, aggs));
+
+	auto file = ReadFile();
+	ProfileFile::MapperList spaces;
+	ASSERT_TRUE(ProfileFile::Read(file.data(), file.size(), *profiler,
+	    imgFactory, spaces));
+
+	// The runs of a chain are merged as they are written.
+	ASSERT_EQ(loaded.size(), 1);
+	std::sort(loaded.at(0).chains.begin(), loaded.at(0).chains.end());
+	EXPECT_EQ(loaded.at(0).chains, Describe(inMemory));
+}
+
+TEST_F(ProfileFileTestSuite, TestEmpty)
+{
+	ASSERT_TRUE(ProfileFile::Write(path, AggregationList()));
+
+	auto file = ReadFile();
+	ProfileFile::MapperList spaces;
+	EXPECT_TRUE(ProfileFile::Read(file.data(), file.size(), *profiler,
+	    imgFactory, spaces));
+	EXPECT_TRUE(loaded.empty());
+}
+
+TEST_F(ProfileFileTestSuite, TestCorrupt)
+{
+	TestSpace space(imgFactory, "/bin/sh", "/lib/libc.so.7");
+	SampleAggregation sh(ccFactory, chainStore, "/bin/sh", 10);
+	AggregationList aggs = { &sh };
+	uintptr_t pcs[] = { 0x800001235, 0x400101, 0x400001 };
+
+	sh.addSample(space, Sample(10, pcs, 3), 3);
+	ASSERT_TRUE(ProfileFile::Write(path, aggs));
+
+	auto file = ReadFile();
+	ProfileFile::MapperList spaces;
+
+	// Every truncation of the file has to be rejected.
+	for (size_t len = 0; len < file.size(); ++len)
+		EXPECT_FALSE(ProfileFile::Read(file.data(), len, *profiler,
+		    imgFactory, spaces)) << "len " << len;
+
+	file.push_back(0);
+	EXPECT_FALSE(ProfileFile::Read(file.data(), file.size(), *profiler,
+	    imgFactory, spaces));
+
+	file.pop_back();
+	file.at(0) = 'X';
+	EXPECT_FALSE(ProfileFile::Read(file.data(), file.size(), *profiler,
+	    imgFactory, spaces));
+}
@@ -29,89 +29,283 @@ __FBSDID("$FreeBSD$");
 #include "AddressSpace.h"
 #include "AddressSpaceFactory.h"
 #include "EventFactory.h"
+#include "EventSource.h"
 #include "ImageFactory.h"
+#include "PmcLogReader.h"
 #include "ProcessState.h"
 #include "Sample.h"
+#include "ProfileFile.h"
 #include "ProfilePrinter.h"
 #include "SampleAggregation.h"
 #include "SampleAggregationFactory.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <memory>
 
+#include <err.h>
+#include <fcntl.h>
 #include <paths.h>
 #include <libgen.h>
-#include <sys/sysctl.h>
+#include <unistd.h>
 
 Profiler::Profiler(const std::string& dataFile, bool showlines,
-    const char* modulePathStr, AddressSpaceFactory & asFactory,
+    ModulePathIndex & moduleIndex, AddressSpaceFactory & asFactory,
     SampleAggregationFactory & aggFactory, ImageFactory & imgFactory)
   : m_sampleCount(0),
+    m_sampleSeq(0),
     m_dataFile(dataFile),
     m_showlines(showlines),
+    m_jobs(1),
+    m_maxSamples(0),
+    moduleIndex(moduleIndex),
     asFactory(asFactory),
     aggFactory(aggFactory),
     imgFactory(imgFactory)
 {
-	if (modulePathStr != NULL)
-		overrideModulePath(modulePathStr);
-	else
-		getLocalModulePath();
 }
 
 void
 Profiler::MapSamples()
+{
+	ReadSamples();
+	MapImages();
+}
+
+void
+Profiler::MapSamples(EventSource & source)
+{
+	m_sampleCount = 0;
+
+	if (!source.Feed(*this))
+		errx(1, "Got error reading events");
+	moduleIndex.ReportMissing();
+	MapImages();
+}
+
+/*
+ * Decode and aggregate the samples file without symbolizing anything.
+ */
+void
+Profiler::ReadSamples()
 {
 	m_sampleCount = 0;
 
 	EventFactory::createEvents(*this);
+	moduleIndex.ReportMissing();
+}
+
+/*
+ * Read this Profiler's samples file along with those of others, decoding
+ * them in parallel.  Each of the others must have its own address space and
+ * aggregation factories, so that pids from different files never mix, but
+ * should share this Profiler's ImageFactory.  Their profiles are merged into
+ * this one.
+ */
+void
+Profiler::ReadSamples(const std::vector<Profiler *> & others)
+{
+	std::vector<Profiler *> all;
+
+	all.push_back(this);
+	all.insert(all.end(), others.begin(), others.end());
+	for (Profiler * profiler : all)
+		profiler->m_sampleCount = 0;
+
+	EventFactory::createEvents(all);
+	moduleIndex.ReportMissing();
+
+	for (Profiler * other : others) {
+		m_sampleCount += other->m_sampleCount;
+		merged.push_back(other);
+	}
+}
+
+void
+Profiler::MapImages()
+{
 	imgFactory.MapAll();
 }
 
+/*
+ * Load a profile that was written by SaveProfile() in place of reading the
+ * samples file.  Like ReadSamples(), nothing is symbolized yet.
+ */
+void
+Profiler::LoadProfile(const std::string & path)
+{
+	MappedLog file;
+	int fd;
+
+	fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		err(1, "Could not open profile %s", path.c_str());
+
+	if (!file.map(fd))
+		err(1, "Could not map profile %s", path.c_str());
+
+	m_sampleCount = 0;
+	if (!ProfileFile::Read(file.getData(), file.getLength(), *this,
+	    imgFactory, savedSpaces))
+		errx(1, "%s is not a valid profile", path.c_str());
+
+	close(fd);
+}
+
+void
+Profiler::SaveProfile(const std::string & path)
+{
+	AggregationList aggregations;
+	getAggregations(aggregations);
+
+	if (!ProfileFile::Write(path, aggregations))
+		err(1, "Could not write profile %s", path.c_str());
+}
+
+/*
+ * Process a log that is still being written, calling emit with an up-to-date
+ * profile every interval seconds and/or every everySamples samples.  Only
+ * frames that first appeared since the last emission are symbolized.
+ */
+void
+Profiler::FollowSamples(unsigned interval, unsigned everySamples,
+    const std::function<void()> & emit)
+{
+	EventFactory::FollowOptions opts = {
+		.interval = interval,
+		.everySamples = everySamples,
+	};
+
+	m_sampleCount = 0;
+
+	EventFactory::followEvents(*this, opts, [this, &emit]() {
+		moduleIndex.ReportMissing();
+		imgFactory.MapAll(true);
+		emit();
+	});
+}
+
 void
 Profiler::createProfile(ProfilePrinter & printer)
 {
 	AggregationList aggregations;
-	aggFactory.GetAggregationList(aggregations);
+	getAggregations(aggregations);
 
 	printer.printProfile(*this, aggregations);
 }
 
+void
+Profiler::getAggregations(AggregationList & list) const
+{
+	aggFactory.GetAggregationList(list);
+	if (merged.empty())
+		return;
+
+	for (const Profiler * other : merged)
+		other->aggFactory.GetAggregationList(list);
+	std::sort(list.rbegin(), list.rend(), SampleAggregation::NumSampleComp());
+}
+
 void
 Profiler::processEvent(const ProcessExec& processExec)
 {
+	finishExits();
+	reusePid(processExec.getProcessID());
+
 	aggFactory.HandleExec(processExec);
 	auto & space = asFactory.ReplaceAddressSpace(processExec.getProcessID());
 	space.processExec(processExec);
 }
 
-void
-Profiler::processEvent(const Sample& sample)
+bool
+Profiler::filterSample(const Sample& sample) const
 {
 	if (!pid_filter.empty() && pid_filter.count(sample.getProcessID()) == 0)
-		return;
+		return false;
 
 	bool kernel = sample.isKernel();
 	if (kernel && !(g_filterFlags & PROFILE_KERN))
-		return;
+		return false;
 	if (!kernel && !(g_filterFlags & PROFILE_USER))
+		return false;
+
+	return true;
+}
+
+void
+Profiler::processEvent(const Sample& sample, uint64_t count)
+{
+	addSample(sample, count, NO_CHAIN);
+}
+
+CallchainStore *
+Profiler::getCallchainStore()
+{
+	return aggFactory.GetCallchainStore();
+}
+
+void
+Profiler::processChain(const CallchainStore & store, pid_t pid, ChainId id,
+    uint64_t count)
+{
+	Sample sample = store.getSample(pid, id);
+
+	/* The aggregations only know the ids of the shared store. */
+	addSample(sample, count, &store == getCallchainStore() ? id : NO_CHAIN);
+}
+
+void
+Profiler::addSample(const Sample& sample, uint64_t count, ChainId id)
+{
+	/*
+	 * Exits are delayed by a number of records in the log, however many
+	 * samples each one stands for.
+	 */
+	advanceSamples(count);
+
+	if (!filterSample(sample))
+		return;
+
+	/* Each sample that survived decimation stands in for rate samples. */
+	count *= m_decimator.getRate();
+
+	AddressSpace &space = GetAddressSpace(sample.isKernel(),
+	    sample.getProcessID());
+
+	aggFactory.GetAggregation(sample).addSample(space, sample, count, id);
+	m_sampleCount += count;
+}
+
+void
+Profiler::processEvent(CallframeMapper & space, const Sample& sample,
+    uint64_t count)
+{
+	if (!filterSample(sample))
 		return;
 
-	AddressSpace &space = GetAddressSpace(kernel, sample.getProcessID());
+	aggFactory.GetAggregation(sample).addSample(space, sample, count);
+	m_sampleCount += count;
+}
 
-	aggFactory.GetAggregation(sample).addSample(space, sample);
-	m_sampleCount++;
+void
+Profiler::startAggregation(pid_t pid, const std::string & executable)
+{
+	aggFactory.HandleExec(ProcessExec(pid, executable, 0));
 }
 
 void
 Profiler::processMapIn(pid_t pid, TargetAddr map_start, const char * image)
 {
+	finishExits();
+
 	/* a pid of -1 indicates that this is for the kernel */
 	if (pid == -1) {
 		AddressSpace &space = asFactory.GetKernelAddressSpace();
-		space.findAndMap(map_start, modulePath, image);
+		space.findAndMap(map_start, moduleIndex, image);
 	} else {
+		reusePid(pid);
+
 		AddressSpace &space = asFactory.GetProcessAddressSpace(pid);
 		space.mapIn(map_start, image);
 	}
@@ -120,44 +314,105 @@ Profiler::processMapIn(pid_t pid, TargetAddr map_start, const char * image)
 }
 
 void
-Profiler::parseModulePath(char * pathBuf, std::vector<std::string> & vec)
+Profiler::processMapOut(pid_t pid, TargetAddr start, TargetAddr end)
 {
-	char * path;
-	char * next = pathBuf;
+	finishExits();
 
-	vec.clear();
+	/* a pid of -1 indicates that this is for the kernel */
+	if (pid == -1)
+		asFactory.GetKernelAddressSpace().mapOut(start, end);
+	else
+		asFactory.GetProcessAddressSpace(pid).mapOut(start, end);
+}
 
-	while ((path = strsep(&next, ";")) != NULL) {
-		if (*path == '\0')
-			continue;
+/*
+ * The child of a fork isn't sent the mappings that it inherited, so it
+ * starts out with its parent's.
+ */
+void
+Profiler::processFork(pid_t parent, pid_t child)
+{
+	finishExits();
+	reusePid(child);
 
-		vec.push_back(path);
-	}
+	aggFactory.HandleFork(parent, child);
+	asFactory.ForkAddressSpace(parent, child);
 }
 
+/*
+ * Once a process has exited its aggregation no longer needs a lookup table
+ * for new samples.  Its address space is kept until the pid is reused, so
+ * that a sample that turns up later still maps to the right frames; memory
+ * use follows the number of pids in use rather than the number of processes
+ * that were ever seen.
+ */
 void
-Profiler::getLocalModulePath()
+Profiler::processExit(pid_t pid)
 {
-	std::unique_ptr<char[]> pathBuf;
-	size_t path_len = 0;
-	int error;
+	finishExits();
 
-	sysctlbyname("kern.module_path", NULL, &path_len, NULL, 0);
-	pathBuf = std::make_unique<char[]>(path_len+1);
+	/* Every PMC attached to a process logs its own exit record. */
+	if (exitingPids.count(pid) != 0)
+		return;
 
-	error = sysctlbyname("kern.module_path", pathBuf.get(), &path_len, NULL, 0);
-	if (error == 0)
-		parseModulePath(pathBuf.get(), modulePath);
+	uint64_t due = m_sampleSeq + EXIT_DELAY;
+	exitingPids[pid] = due;
+	pendingExits.push_back(PendingExit{pid, due});
+}
+
+void
+Profiler::advanceSamples(uint64_t count)
+{
+	m_sampleSeq += count;
 }
 
+/*
+ * Finish the processes whose exits have come due.  This is only done when a
+ * mapping or process event is handled, never between two samples: the
+ * parallel decoder replays the samples between two such events as one count
+ * per chain, so this is the only point at which it and a sequential decode
+ * agree on which samples a process has seen.
+ */
 void
-Profiler::overrideModulePath(const char* modulePathStr)
+Profiler::finishExits()
 {
-	size_t len = strlen(modulePathStr) + 1;
-	std::unique_ptr<char[]> pathBuf = std::make_unique<char[]>(len);
-	memcpy(pathBuf.get(), modulePathStr, len);
+	while (!pendingExits.empty() && pendingExits.front().due <= m_sampleSeq) {
+		PendingExit exit = pendingExits.front();
+		pendingExits.pop_front();
 
-	parseModulePath(pathBuf.get(), modulePath);
+		/* Skip entries that reusePid() has already dealt with. */
+		auto it = exitingPids.find(exit.pid);
+		if (it == exitingPids.end() || it->second != exit.due)
+			continue;
+
+		exitingPids.erase(it);
+		finishProcess(exit.pid);
+	}
+}
+
+/*
+ * A process is starting up with the pid of one that exited.  Finish the old
+ * process now if it exited recently so that the two are not merged, and drop
+ * the address space that was kept for its late samples.
+ */
+void
+Profiler::reusePid(pid_t pid)
+{
+	auto it = exitingPids.find(pid);
+	if (it != exitingPids.end()) {
+		exitingPids.erase(it);
+		finishProcess(pid);
+	}
+
+	if (exitedPids.erase(pid) != 0)
+		asFactory.ReleaseAddressSpace(pid);
+}
+
+void
+Profiler::finishProcess(pid_t pid)
+{
+	aggFactory.HandleExit(pid);
+	exitedPids.insert(pid);
 }
 
 AddressSpace &
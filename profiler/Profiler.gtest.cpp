@@ -0,0 +1,203 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "Profiler.h"
+
+#include "AddressSpace.h"
+#include "Callframe.h"
+#include "EventFactory.h"
+#include "PmcLogReader.h"
+#include "ProcessState.h"
+#include "ProfileFile.h"
+#include "ProfilerTypes.h"
+#include "Sample.h"
+
+#include "mock/MockAddressSpaceFactory.h"
+#include "mock/MockImageFactory.h"
+#include "mock/MockSampleAggregationFactory.h"
+
+#include <pmc.h>
+#include <pmclog.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+using namespace testing;
+
+bool g_quitOnError = false;
+uint32_t g_filterFlags;
+std::unordered_set<pid_t> pid_filter;
+
+// Stubs
+Image::Image(SharedString, Arena *) {}
+Image::~Image() {}
+DwarfResolver::~DwarfResolver() {}
+
+void EventFactory::createEvents(Profiler &) {}
+void EventFactory::createEvents(const std::vector<Profiler *> &) {}
+void EventFactory::followEvents(Profiler &, const FollowOptions &,
+    const std::function<void()> &) {}
+
+MappedLog::MappedLog() {}
+MappedLog::~MappedLog() {}
+bool MappedLog::map(int) { return (false); }
+
+bool ProfileFile::Read(const char *, size_t, Profiler &, ImageFactory &,
+    std::vector<std::unique_ptr<CallframeMapper>> &) { return (false); }
+bool ProfileFile::Write(const std::string &, const AggregationList &)
+    { return (false); }
+
+AddressSpace::AddressSpace(ImageFactory &f)
+  : imgFactory(f), executable(nullptr), pendingExec(nullptr), epochBase(0)
+{
+}
+
+const Callframe &
+AddressSpace::mapFrame(TargetAddr addr)
+{
+	static Callframe frame(addr, "");
+	return (frame);
+}
+
+SharedString AddressSpace::getExecutableName() const { return (""); }
+bool AddressSpace::isStale(const Sample &, uint64_t) const { return (false); }
+void AddressSpace::mapIn(TargetAddr, SharedString) {}
+void AddressSpace::mapOut(TargetAddr, TargetAddr) {}
+void AddressSpace::findAndMap(TargetAddr, ModulePathIndex &, SharedString) {}
+void AddressSpace::processExec(const ProcessExec &) {}
+
+class ProfilerTestSuite : public ::testing::Test
+{
+public:
+	MockAddressSpaceFactory asFactory;
+	MockSampleAggregationFactory aggFactory;
+	MockImageFactory imgFactory;
+	ModulePathIndex moduleIndex;
+	Profiler profiler;
+
+	ProfilerTestSuite()
+	  : profiler("pmc.out", false, moduleIndex, asFactory, aggFactory,
+	        imgFactory)
+	{
+		/*
+		 * Filter out every sample, so that they only move the
+		 * profiler through the log.
+		 */
+		g_filterFlags = 0;
+	}
+
+	void AddSamples(pid_t pid, unsigned count)
+	{
+		uintptr_t pc = 0x1000;
+		Sample sample(pid, &pc, 1);
+
+		for (unsigned i = 0; i < count; ++i)
+			profiler.processEvent(sample);
+	}
+};
+
+TEST_F(ProfilerTestSuite, TestExitDelayWithSampleRate)
+{
+	profiler.setSampleRate(8);
+
+	{
+		InSequence seq;
+
+		EXPECT_CALL(asFactory, ReleaseAddressSpace(_)).Times(0);
+		EXPECT_CALL(aggFactory, HandleExit(_)).Times(0);
+	}
+
+	/*
+	 * Each sample stands for 8, but the exit must still wait for the
+	 * same number of records as with every sample kept.
+	 */
+	profiler.processExit(5);
+	AddSamples(5, 4095);
+	Mock::VerifyAndClearExpectations(&aggFactory);
+	Mock::VerifyAndClearExpectations(&asFactory);
+
+	EXPECT_CALL(aggFactory, HandleExit(5)).Times(1);
+	AddSamples(5, 1);
+	profiler.processExit(6);
+}
+
+TEST_F(ProfilerTestSuite, TestExitAtEventBoundary)
+{
+	EXPECT_CALL(aggFactory, HandleExit(_)).Times(0);
+
+	/*
+	 * The parallel decoder replays the samples between two events as a
+	 * count per chain, so an exit that comes due partway through them is
+	 * only acted on at the next event, in either decoder.
+	 */
+	profiler.processExit(5);
+	AddSamples(5, 3000);
+	profiler.processExit(6);
+	AddSamples(5, 5000);
+	Mock::VerifyAndClearExpectations(&aggFactory);
+
+	{
+		InSequence seq;
+
+		EXPECT_CALL(aggFactory, HandleExit(5)).Times(1);
+		EXPECT_CALL(aggFactory, HandleExit(6)).Times(1);
+	}
+	profiler.processExit(7);
+}
+
+TEST_F(ProfilerTestSuite, TestSampleAfterExitDelay)
+{
+	AddressSpace space(imgFactory);
+
+	EXPECT_CALL(aggFactory, HandleExit(5)).Times(1);
+	EXPECT_CALL(asFactory, ReleaseAddressSpace(_)).Times(0);
+
+	/*
+	 * A sample can turn up even after the exit delay.  The process's
+	 * mappings are kept for it until the pid is reused.
+	 */
+	profiler.processExit(5);
+	AddSamples(5, 4096);
+	profiler.processExit(6);
+	AddSamples(5, 1);
+	Mock::VerifyAndClearExpectations(&aggFactory);
+	Mock::VerifyAndClearExpectations(&asFactory);
+
+	{
+		InSequence seq;
+
+		EXPECT_CALL(asFactory, ReleaseAddressSpace(5)).Times(1);
+		EXPECT_CALL(asFactory, GetProcessAddressSpace(5))
+		    .WillOnce(ReturnRef(space));
+		EXPECT_CALL(aggFactory, HandleMapIn(5, _)).Times(1);
+	}
+	profiler.processMapIn(5, 0x400000, "/bin/sh");
+	Mock::VerifyAndClearExpectations(&asFactory);
+
+	/* The new process's mappings aren't dropped by the old exit. */
+	EXPECT_CALL(asFactory, ReleaseAddressSpace(_)).Times(0);
+	EXPECT_CALL(asFactory, GetProcessAddressSpace(5))
+	    .WillOnce(ReturnRef(space));
+	EXPECT_CALL(aggFactory, HandleMapIn(5, _)).Times(1);
+	profiler.processMapIn(5, 0x800000, "/lib/libc.so.7");
+}
@@ -19,17 +19,28 @@ PROG_STDLIBS:= \
 	pmc \
 	elf \
 	dwarf \
+	pthread \
 
 LIB:= pmcprofiler
 
 SRCS :=	\
 	EventFactory.cpp \
 	main.cpp \
+	MemoryEventSource.cpp \
+	PerfDataEventSource.cpp \
+	PerfDataReader.cpp \
+	PmcLogEventSource.cpp \
+	PmcLogIndex.cpp \
+	PmcLogReader.cpp \
+	ProfileFile.cpp \
 	Profiler.cpp \
+	ShardDecoder.cpp \
+	SyntheticEventSource.cpp \
 
 SUBDIRS := \
 	abi \
 	addr2line \
+	bench \
 	dwarf \
 	frame \
 	image \
@@ -39,19 +50,111 @@ SUBDIRS := \
 
 TESTS := \
 	EventFactory \
+	FlatHashMap \
+	MappingTable \
+	PerfDataEventSource \
+	PmcLogIndex \
+	PmcLogReader \
+	ProfileFile \
+	Profiler \
+	ShardDecoder \
+	SyntheticEventSource \
 
 TEST_EVENTFACTORY_SRCS := \
 	EventFactory.cpp \
+	PerfDataEventSource.cpp \
+	PerfDataReader.cpp \
+	PmcLogEventSource.cpp \
+	PmcLogIndex.cpp \
+	PmcLogReader.cpp \
+	ShardDecoder.cpp \
 
 TEST_EVENTFACTORY_WRAPFUNCS := \
 	open=mock_open \
 	close=mock_close \
 
 TEST_EVENTFACTORY_LIBS := \
+	samples \
 	sharedptr \
 
 TEST_EVENTFACTORY_STDLIBS := \
 	gmock \
+	pthread \
+
+TEST_FLATHASHMAP_STDLIBS := \
+	gmock \
+
+TEST_MAPPINGTABLE_STDLIBS := \
+	gmock \
+
+TEST_PERFDATAEVENTSOURCE_SRCS := \
+	PerfDataEventSource.cpp \
+	PerfDataReader.cpp \
+
+TEST_PERFDATAEVENTSOURCE_LIBS := \
+	sharedptr \
+
+TEST_PERFDATAEVENTSOURCE_STDLIBS := \
+	gmock \
+
+TEST_PMCLOGINDEX_SRCS := \
+	PmcLogIndex.cpp \
+	PmcLogReader.cpp \
+
+TEST_PMCLOGINDEX_STDLIBS := \
+	gmock \
+
+TEST_PMCLOGREADER_SRCS := \
+	PmcLogReader.cpp \
+
+TEST_PMCLOGREADER_STDLIBS := \
+	gmock \
+
+TEST_PROFILEFILE_SRCS := \
+	ProfileFile.cpp \
+
+TEST_PROFILEFILE_LIBS := \
+	samples \
+	callchainFactory \
+	frame \
+	imagefactory \
+	sharedptr \
+
+TEST_PROFILEFILE_STDLIBS := \
+	gmock \
+
+TEST_PROFILER_SRCS := \
+	Profiler.cpp \
+
+TEST_PROFILER_LIBS := \
+	samples \
+	frame \
+	sharedptr \
+
+TEST_PROFILER_STDLIBS := \
+	gmock \
+
+TEST_SHARDDECODER_SRCS := \
+	PmcLogReader.cpp \
+	ShardDecoder.cpp \
+
+TEST_SHARDDECODER_LIBS := \
+	samples \
+	sharedptr \
+
+TEST_SHARDDECODER_STDLIBS := \
+	gmock \
+	pthread \
+
+TEST_SYNTHETICEVENTSOURCE_SRCS := \
+	MemoryEventSource.cpp \
+	SyntheticEventSource.cpp \
+
+TEST_SYNTHETICEVENTSOURCE_LIBS := \
+	sharedptr \
+
+TEST_SYNTHETICEVENTSOURCE_STDLIBS := \
+	gmock \
 
 #DWARFINSTALLDIR=/home/rstone/src/dwarf-20170709/libdwarf
 
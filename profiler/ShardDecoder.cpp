@@ -0,0 +1,320 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "ShardDecoder.h"
+
+#include "PmcLogReader.h"
+#include "ProcessState.h"
+#include "Profiler.h"
+
+#include <err.h>
+#include <pmc.h>
+#include <pmclog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	struct ShardResult
+	{
+		ShardDecoder::SegmentList segments;
+
+		/* The shard's own store, if the profiler has none to share. */
+		std::unique_ptr<CallchainStore> store;
+		bool done;
+		bool ok;
+
+		ShardResult()
+		  : done(false), ok(false)
+		{
+		}
+	};
+}
+
+void
+ShardDecoder::Segment::addSample(pid_t pid, ChainId id)
+{
+	uint64_t key = (uint64_t(uint32_t(pid)) << 32) | id;
+
+	auto [it, inserted] = index.insert(std::make_pair(key, counts.size()));
+	if (inserted)
+		counts.push_back(ChainCount{pid, id, 0});
+
+	counts[it->second].count++;
+}
+
+void
+ShardDecoder::Segment::replay(Profiler &profiler,
+    const CallchainStore &store) const
+{
+	for (const auto & entry : counts)
+		profiler.processChain(store, entry.pid, entry.id, entry.count);
+
+	if (!event)
+		return;
+
+	switch (event->type) {
+	case MappingEvent::MAP_IN:
+		profiler.processMapIn(event->pid, event->addr,
+		    event->path.c_str());
+		break;
+	case MappingEvent::MAP_OUT:
+		profiler.processMapOut(event->pid, event->addr, event->end);
+		break;
+	case MappingEvent::PROCEXEC:
+		profiler.processEvent(ProcessExec(event->pid, event->path,
+		    event->addr));
+		break;
+	case MappingEvent::PROCEXIT:
+		profiler.processExit(event->pid);
+		break;
+	case MappingEvent::PROCFORK:
+		profiler.processFork(event->parent, event->pid);
+		break;
+	}
+}
+
+ShardDecoder::ShardDecoder(const char *buf, size_t len, uint64_t fromTsc,
+    uint64_t toTsc, const SampleDecimator & decimator)
+  : buf(buf), len(len), fromTsc(fromTsc), toTsc(toTsc), decimator(decimator)
+{
+}
+
+void
+ShardDecoder::FindShards(const char *buf, size_t len, size_t target,
+    std::vector<Shard> &shards)
+{
+	size_t start, off, reclen;
+
+	target = std::clamp(target, MIN_SHARD_SIZE, MAX_SHARD_SIZE);
+
+	start = 0;
+	off = 0;
+	while ((reclen = PmcLogReader::RecordLength(buf, off, len)) != 0) {
+		if (off != start && off - start + reclen > target) {
+			shards.emplace_back(start, off - start);
+			start = off;
+		}
+		off += reclen;
+	}
+
+	/*
+	 * Anything after a corrupt header goes into the last shard so that
+	 * the worker that decodes it reports the error.
+	 */
+	if (start < len)
+		shards.emplace_back(start, len - start);
+}
+
+void
+ShardDecoder::decodeShard(const Shard &shard, SegmentList &segments,
+    CallchainStore &store) const
+{
+	PmcLogReader reader(buf + shard.offset, shard.length);
+	PmcLogRecord record;
+
+	auto segment = std::make_unique<Segment>();
+	while (reader.next(record)) {
+		switch (record.getType()) {
+			case PMCLOG_TYPE_MAP_IN:
+				segment->setEvent(std::make_unique<MappingEvent>(
+				    MappingEvent::MAP_IN,
+				    record.get<PmcLogMapIn>().pid,
+				    record.get<PmcLogMapIn>().start,
+				    record.getPathname()));
+				segments.push_back(std::move(segment));
+				segment = std::make_unique<Segment>();
+				break;
+
+			case PMCLOG_TYPE_MAP_OUT:
+				segment->setEvent(std::make_unique<MappingEvent>(
+				    MappingEvent::MAP_OUT,
+				    record.get<PmcLogMapOut>().pid,
+				    record.get<PmcLogMapOut>().start, "", -1,
+				    record.get<PmcLogMapOut>().end));
+				segments.push_back(std::move(segment));
+				segment = std::make_unique<Segment>();
+				break;
+
+			case PMCLOG_TYPE_PROCEXEC:
+				segment->setEvent(std::make_unique<MappingEvent>(
+				    MappingEvent::PROCEXEC,
+				    record.get<PmcLogProcExec>().pid,
+				    record.get<PmcLogProcExec>().dynaddr,
+				    record.getPathname()));
+				segments.push_back(std::move(segment));
+				segment = std::make_unique<Segment>();
+				break;
+
+			case PMCLOG_TYPE_PROCEXIT:
+			case PMCLOG_TYPE_SYSEXIT:
+				segment->setEvent(std::make_unique<MappingEvent>(
+				    MappingEvent::PROCEXIT,
+				    record.getType() == PMCLOG_TYPE_PROCEXIT ?
+				    record.get<PmcLogProcExit>().pid :
+				    record.get<PmcLogSysExit>().pid,
+				    0, ""));
+				segments.push_back(std::move(segment));
+				segment = std::make_unique<Segment>();
+				break;
+
+			case PMCLOG_TYPE_PROCFORK:
+				segment->setEvent(std::make_unique<MappingEvent>(
+				    MappingEvent::PROCFORK,
+				    record.get<PmcLogProcFork>().newpid, 0, "",
+				    record.get<PmcLogProcFork>().oldpid));
+				segments.push_back(std::move(segment));
+				segment = std::make_unique<Segment>();
+				break;
+
+			case PMCLOG_TYPE_CALLCHAIN:
+				if (record.getTimestamp() < fromTsc ||
+				    record.getTimestamp() > toTsc)
+					break;
+				if (!decimator.keep(record.getTimestamp(),
+				    record.get<PmcLogCallchain>().cpuflags))
+					break;
+			{
+				pid_t pid = record.get<PmcLogCallchain>().pid;
+
+				segment->addSample(pid, store.intern(Sample(pid,
+				    record.getCallchainPCs(),
+				    record.getCallchainDepth())));
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	if (reader.failed()) {
+		segments.clear();
+		return;
+	}
+
+	segments.push_back(std::move(segment));
+}
+
+/*
+ * Decode the whole buffer on the calling thread, leaving the segments for the
+ * caller to replay.  Returns false if the log is corrupt.
+ */
+bool
+ShardDecoder::decodeSegments(SegmentList &segments, CallchainStore &store) const
+{
+	decodeShard(Shard(0, len), segments, store);
+
+	return (!segments.empty());
+}
+
+void
+ShardDecoder::decode(Profiler &profiler, unsigned jobs)
+{
+	std::vector<Shard> shards;
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable cv;
+	std::atomic<size_t> next(0);
+	size_t replayed = 0;
+	CallchainStore *shared = profiler.getCallchainStore();
+	size_t target = len / (jobs * SHARDS_PER_JOB);
+
+	/*
+	 * Without a shared store, each shard interns its chains in a store of
+	 * its own that is freed once the shard is replayed.  The shards are
+	 * kept small, and only a few are decoded ahead of the replay, so that
+	 * those stores stay small too.
+	 */
+	if (shared == nullptr)
+		target = std::min(target, PRIVATE_SHARD_SIZE);
+
+	FindShards(buf, len, target, shards);
+	std::vector<ShardResult> results(shards.size());
+
+	auto worker = [&]() {
+		size_t i;
+
+		while ((i = next++) < shards.size()) {
+			SegmentList segments;
+			std::unique_ptr<CallchainStore> own;
+			CallchainStore *store = shared;
+
+			if (store == nullptr) {
+				std::unique_lock<std::mutex> guard(lock);
+				cv.wait(guard, [&]() {
+					return (i < replayed + 2 * jobs);
+				});
+				guard.unlock();
+
+				own = std::make_unique<CallchainStore>();
+				store = own.get();
+			}
+			decodeShard(shards[i], segments, *store);
+
+			std::lock_guard<std::mutex> guard(lock);
+			results[i].segments = std::move(segments);
+			results[i].store = std::move(own);
+			results[i].ok = !results[i].segments.empty();
+			results[i].done = true;
+			cv.notify_all();
+		}
+	};
+
+	jobs = std::min<size_t>(jobs, shards.size());
+	for (unsigned j = 0; j < jobs; ++j)
+		workers.emplace_back(worker);
+
+	/*
+	 * Replay each shard as soon as it is decoded, strictly in file order,
+	 * while the workers carry on with the shards after it.
+	 */
+	for (auto & result : results) {
+		std::unique_lock<std::mutex> guard(lock);
+		cv.wait(guard, [&result]() { return result.done; });
+		SegmentList segments = std::move(result.segments);
+		std::unique_ptr<CallchainStore> own = std::move(result.store);
+		bool ok = result.ok;
+		guard.unlock();
+
+		if (!ok)
+			errx(1, "Got error reading from samples file");
+
+		for (const auto & segment : segments)
+			segment->replay(profiler, own ? *own : *shared);
+
+		guard.lock();
+		replayed++;
+		cv.notify_all();
+	}
+
+	for (auto & thread : workers)
+		thread.join();
+}
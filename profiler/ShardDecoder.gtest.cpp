@@ -0,0 +1,339 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "ShardDecoder.h"
+
+#include "ProcessState.h"
+#include "Profiler.h"
+#include "Sample.h"
+
+#include "mock/GlobalMock.h"
+#include "mock/PmcLogBuilder.h"
+
+#include <pmc.h>
+#include <pmclog.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <vector>
+
+using namespace testing;
+
+class ProfilerMocker : public GlobalMockBase<ProfilerMocker>
+{
+public:
+	MOCK_METHOD2(processSample, void (pid_t, uint64_t));
+	MOCK_METHOD3(processMapIn, void (int, TargetAddr, std::string));
+	MOCK_METHOD2(processExec, void (pid_t, std::string));
+	MOCK_METHOD3(processMapOut, void (pid_t, TargetAddr, TargetAddr));
+	MOCK_METHOD2(processFork, void (pid_t, pid_t));
+	MOCK_METHOD1(processExit, void (pid_t));
+};
+
+void
+Profiler::processEvent(const ProcessExec& processExec)
+{
+	ProfilerMocker::MockObj().processExec(processExec.getProcessID(),
+	    processExec.getProcessName());
+}
+
+void
+Profiler::processEvent(const Sample& sample, uint64_t count)
+{
+	ProfilerMocker::MockObj().processSample(sample.getProcessID(), count);
+}
+
+static CallchainStore chainStore;
+static CallchainStore *sharedStore = &chainStore;
+
+CallchainStore *
+Profiler::getCallchainStore()
+{
+	return sharedStore;
+}
+
+void
+Profiler::processChain(const CallchainStore & store, pid_t pid, ChainId id,
+    uint64_t count)
+{
+	ProfilerMocker::MockObj().processSample(pid, count);
+}
+
+void
+Profiler::processMapIn(pid_t pid, TargetAddr map_start, const char * image)
+{
+	ProfilerMocker::MockObj().processMapIn(pid, map_start, image);
+}
+
+void
+Profiler::processMapOut(pid_t pid, TargetAddr start, TargetAddr end)
+{
+	ProfilerMocker::MockObj().processMapOut(pid, start, end);
+}
+
+void
+Profiler::processFork(pid_t parent, pid_t child)
+{
+	ProfilerMocker::MockObj().processFork(parent, child);
+}
+
+void
+Profiler::processExit(pid_t pid)
+{
+	ProfilerMocker::MockObj().processExit(pid);
+}
+
+class ShardDecoderTestSuite : public ::testing::Test
+{
+public:
+	PmcLogBuilder log;
+
+	void
+	AddRecord(pmclog_type type, size_t len)
+	{
+		log.AddRecord(type, len);
+	}
+};
+
+TEST_F(ShardDecoderTestSuite, TestSingleShard)
+{
+	std::vector<ShardDecoder::Shard> shards;
+
+	AddRecord(PMCLOG_TYPE_INITIALIZE, 64);
+	for (int i = 0; i < 100; ++i)
+		log.AddCallchain(1, true, {0x1001});
+
+	ShardDecoder::FindShards(log.data(), log.size(), 0, shards);
+
+	ASSERT_EQ(shards.size(), 1);
+	EXPECT_EQ(shards.at(0).offset, 0);
+	EXPECT_EQ(shards.at(0).length, log.size());
+}
+
+TEST_F(ShardDecoderTestSuite, TestRecordBoundaries)
+{
+	std::vector<ShardDecoder::Shard> shards;
+	const size_t recLen = 0x7ff8;
+
+	AddRecord(PMCLOG_TYPE_INITIALIZE, 64);
+	for (int i = 0; i < 100; ++i)
+		AddRecord(PMCLOG_TYPE_CALLCHAIN, recLen);
+
+	ShardDecoder::FindShards(log.data(), log.size(), 1024 * 1024, shards);
+
+	ASSERT_EQ(shards.size(), 4);
+
+	size_t expected = 0;
+	for (const auto & shard : shards) {
+		EXPECT_EQ(shard.offset, expected);
+		EXPECT_LE(shard.length, 1024 * 1024);
+		expected += shard.length;
+	}
+	EXPECT_EQ(expected, log.size());
+
+	// Every shard after the first has to start on a record header.
+	for (size_t i = 1; i < shards.size(); ++i)
+		EXPECT_EQ((shards.at(i).offset - 64) % recLen, 0);
+}
+
+TEST_F(ShardDecoderTestSuite, TestCorruptTail)
+{
+	std::vector<ShardDecoder::Shard> shards;
+
+	AddRecord(PMCLOG_TYPE_INITIALIZE, 64);
+	for (int i = 0; i < 64; ++i)
+		AddRecord(PMCLOG_TYPE_CALLCHAIN, 0x8000);
+	log.AddGarbage(128);
+
+	ShardDecoder::FindShards(log.data(), log.size(), 0, shards);
+
+	ASSERT_EQ(shards.size(), 3);
+	EXPECT_EQ(shards.back().offset + shards.back().length, log.size());
+}
+
+TEST_F(ShardDecoderTestSuite, TestSegmentReplay)
+{
+	GlobalMock<ProfilerMocker> profilerMock;
+	ShardDecoder::Segment segment;
+
+	pmclog_ev_callchain event = {
+		.pl_pid = 46,
+		.pl_cpuflags = PMC_CC_F_USERSPACE,
+		.pl_npc = 2,
+		.pl_pc = { 0x1234, 0x5678 },
+	};
+	Sample sample1(event);
+
+	event.pl_pid = 12;
+	Sample sample2(event);
+
+	/* The same chain in two processes is counted separately. */
+	ChainId id = chainStore.intern(sample1);
+	ASSERT_EQ(chainStore.intern(sample2), id);
+
+	segment.addSample(46, id);
+	segment.addSample(12, id);
+	segment.addSample(46, id);
+	segment.addSample(46, id);
+	segment.setEvent(std::make_unique<ShardDecoder::MappingEvent>(
+	    ShardDecoder::MappingEvent::MAP_IN, 46, 0x1000, "/lib/libc.so.7"));
+
+	Profiler *profiler = nullptr;
+	{
+		InSequence seq;
+
+		EXPECT_CALL(*profilerMock, processSample(46, 3));
+		EXPECT_CALL(*profilerMock, processSample(12, 1));
+		EXPECT_CALL(*profilerMock, processMapIn(46, 0x1000, "/lib/libc.so.7"));
+	}
+
+	segment.replay(*profiler, chainStore);
+}
+
+TEST_F(ShardDecoderTestSuite, TestDecodeOrdering)
+{
+	GlobalMock<ProfilerMocker> profilerMock;
+	const int samples = 40000;
+	unsigned count5 = 0;
+	unsigned count6 = 0;
+
+	log.AddInitialize(1000000);
+	log.AddMapIn(5, 0x400000, "/bin/sh");
+	for (int i = 0; i < samples; ++i)
+		log.AddCallchain(5, true, {0x401001, 0x402001});
+	log.AddMapOut(5, 0x400000, 0x500000);
+	log.AddSysExit(5);
+	log.AddExec(6, "/bin/ls", 0x800000);
+	for (int i = 0; i < samples; ++i)
+		log.AddCallchain(6, true, {0x401001, 0x402001});
+	log.AddFork(6, 7);
+
+	// The log spans several shards, but the mapping events must still be
+	// replayed between the samples that surround them.
+	ASSERT_GT(log.size(), 2 * 1024 * 1024);
+	{
+		InSequence seq;
+
+		EXPECT_CALL(*profilerMock, processMapIn(5, 0x400000, "/bin/sh"));
+		EXPECT_CALL(*profilerMock, processSample(5, _))
+		    .Times(AtLeast(1))
+		    .WillRepeatedly([&count5](pid_t, unsigned c) { count5 += c; });
+		EXPECT_CALL(*profilerMock, processMapOut(5, 0x400000, 0x500000));
+		EXPECT_CALL(*profilerMock, processExit(5));
+		EXPECT_CALL(*profilerMock, processExec(6, "/bin/ls"));
+		EXPECT_CALL(*profilerMock, processSample(6, _))
+		    .Times(AtLeast(1))
+		    .WillRepeatedly([&count6](pid_t, unsigned c) { count6 += c; });
+		EXPECT_CALL(*profilerMock, processFork(6, 7));
+	}
+
+	Profiler *profiler = nullptr;
+	ShardDecoder decoder(log.data(), log.size());
+	decoder.decode(*profiler, 4);
+
+	EXPECT_EQ(count5, samples);
+	EXPECT_EQ(count6, samples);
+}
+
+TEST_F(ShardDecoderTestSuite, TestPrivateStores)
+{
+	GlobalMock<ProfilerMocker> profilerMock;
+	const int samples = 200000;
+	unsigned count = 0;
+
+	log.AddInitialize(1000000);
+	for (int i = 0; i < samples; ++i)
+		log.AddCallchain(5, true, {0x401001, 0x402001 + 16 * uintptr_t(i % 64)});
+	ASSERT_GT(log.size(), 8 * 1024 * 1024);
+
+	EXPECT_CALL(*profilerMock, processSample(5, _))
+	    .WillRepeatedly([&count](pid_t, unsigned c) { count += c; });
+
+	// Without a shared store, the chains are interned in the shards' own
+	// stores, which are all dropped by the end.
+	size_t interned = chainStore.size();
+	sharedStore = nullptr;
+	Profiler *profiler = nullptr;
+	ShardDecoder decoder(log.data(), log.size());
+	decoder.decode(*profiler, 2);
+	sharedStore = &chainStore;
+
+	EXPECT_EQ(count, samples);
+	EXPECT_EQ(chainStore.size(), interned);
+}
+
+TEST_F(ShardDecoderTestSuite, TestTimeWindow)
+{
+	GlobalMock<ProfilerMocker> profilerMock;
+
+	log.SetTimestamp(10);
+	log.AddMapIn(5, 0x400000, "/bin/sh");
+	log.AddCallchain(5, true, {0x401001});
+	log.SetTimestamp(20);
+	log.AddCallchain(5, true, {0x401001});
+	log.AddCallchain(5, true, {0x401001});
+	log.SetTimestamp(30);
+	log.AddCallchain(5, true, {0x401001});
+
+	{
+		InSequence seq;
+
+		EXPECT_CALL(*profilerMock, processMapIn(5, 0x400000, "/bin/sh"));
+		EXPECT_CALL(*profilerMock, processSample(5, 2));
+	}
+
+	Profiler *profiler = nullptr;
+	ShardDecoder decoder(log.data(), log.size(), 15, 25);
+	decoder.decode(*profiler, 2);
+}
+
+TEST_F(ShardDecoderTestSuite, TestDecimation)
+{
+	GlobalMock<ProfilerMocker> profilerMock;
+	SampleDecimator decimator(8);
+	const int samples = 40000;
+	unsigned expected = 0;
+	unsigned count = 0;
+
+	log.AddInitialize(1000000);
+	for (int i = 0; i < samples; ++i) {
+		log.SetTimestamp(1000 + 17 * i);
+		log.AddCallchain(5, true, {0x401001, 0x402001});
+		if (decimator.keep(1000 + 17 * i, PMC_CC_F_USERSPACE))
+			expected++;
+	}
+
+	// The sharded decoder must keep exactly the samples that the serial
+	// decoder would.
+	EXPECT_CALL(*profilerMock, processSample(5, _))
+	    .WillRepeatedly([&count](pid_t, unsigned c) { count += c; });
+
+	Profiler *profiler = nullptr;
+	ShardDecoder decoder(log.data(), log.size(), 0, UINT64_MAX, decimator);
+	decoder.decode(*profiler, 4);
+
+	EXPECT_EQ(count, expected);
+	EXPECT_GT(expected, samples / 8 - samples / 40);
+	EXPECT_LT(expected, samples / 8 + samples / 40);
+}
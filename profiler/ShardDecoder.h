@@ -0,0 +1,156 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#if !defined(SHARDDECODER_H)
+#define SHARDDECODER_H
+
+#include "ProfilerTypes.h"
+#include "CallchainStore.h"
+#include "FlatHashMap.h"
+#include "Sample.h"
+#include "SampleDecimator.h"
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class Profiler;
+
+/*
+ * Decodes a pmclog file on several worker threads.  The file is cut into
+ * shards at record boundaries.  Each worker decodes a shard into a list of
+ * segments: the samples seen between two mapping events are interned in the
+ * profiler's CallchainStore, which the workers share, and counted in a
+ * per-segment table keyed by pid and ChainId.  The mapping event that ends
+ * the segment is recorded as-is.  If the profiler has no store to share,
+ * each shard gets a small one of its own instead.  The main thread replays
+ * the shards in file order, so every sample is still resolved against the
+ * AddressSpace state that was current when it was taken.  Merging a segment costs a lookup per
+ * distinct chain in it; hashing and comparing the chains' addresses was all
+ * done by the workers.
+ */
+class ShardDecoder
+{
+public:
+	struct Shard
+	{
+		size_t offset;
+		size_t length;
+
+		Shard(size_t off, size_t len)
+		  : offset(off), length(len)
+		{
+		}
+	};
+
+	struct MappingEvent
+	{
+		enum Type { MAP_IN, MAP_OUT, PROCEXEC, PROCEXIT, PROCFORK };
+
+		Type type;
+		pid_t pid;
+		TargetAddr addr;
+		std::string path;
+
+		/* For PROCFORK, the process that pid was forked from. */
+		pid_t parent;
+
+		/* For MAP_OUT, the end of the range starting at addr. */
+		TargetAddr end;
+
+		MappingEvent(Type t, pid_t p, TargetAddr a, const char *image,
+		    pid_t ppid = -1, TargetAddr e = 0)
+		  : type(t), pid(p), addr(a), path(image), parent(ppid), end(e)
+		{
+		}
+	};
+
+	class Segment
+	{
+		struct ChainCount
+		{
+			pid_t pid;
+			ChainId id;
+			uint64_t count;
+		};
+
+		/* Index in counts of each pid and ChainId. */
+		FlatHashMap<uint64_t, size_t> index;
+
+		/* In the order that the chains were first seen. */
+		std::vector<ChainCount> counts;
+		std::unique_ptr<MappingEvent> event;
+
+	public:
+		void addSample(pid_t, ChainId);
+
+		void setEvent(std::unique_ptr<MappingEvent> ev)
+		{
+			event = std::move(ev);
+		}
+
+		/* store is the one that the segment's chains are in. */
+		void replay(Profiler &, const CallchainStore & store) const;
+	};
+
+	typedef std::vector<std::unique_ptr<Segment>> SegmentList;
+
+private:
+	static constexpr size_t MIN_SHARD_SIZE = 1024 * 1024;
+
+	static constexpr size_t MAX_SHARD_SIZE = 1024 * 1024 * 1024;
+
+	/* The most that a shard with its own CallchainStore is cut to. */
+	static constexpr size_t PRIVATE_SHARD_SIZE = 16 * 1024 * 1024;
+
+	static const int SHARDS_PER_JOB = 4;
+
+	const char *buf;
+	size_t len;
+
+	/* Samples outside of this range of timestamps are dropped. */
+	uint64_t fromTsc;
+	uint64_t toTsc;
+	SampleDecimator decimator;
+
+	void decodeShard(const Shard &, SegmentList &, CallchainStore &) const;
+
+public:
+	ShardDecoder(const char *buf, size_t len, uint64_t fromTsc = 0,
+	    uint64_t toTsc = UINT64_MAX,
+	    const SampleDecimator & decimator = SampleDecimator());
+
+	ShardDecoder(const ShardDecoder&) = delete;
+	ShardDecoder& operator=(const ShardDecoder &) = delete;
+
+	static void FindShards(const char *buf, size_t len, size_t target,
+	    std::vector<Shard> &);
+
+	void decode(Profiler &, unsigned jobs);
+	bool decodeSegments(SegmentList &, CallchainStore &) const;
+};
+
+#endif // #if !defined(SHARDDECODER_H)
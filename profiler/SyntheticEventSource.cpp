@@ -0,0 +1,198 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "SyntheticEventSource.h"
+
+#include "MemoryEventSource.h"
+#include "ProcessState.h"
+#include "Profiler.h"
+#include "Sample.h"
+
+#include <algorithm>
+#include <vector>
+
+const SyntheticEventSource::Params SyntheticEventSource::DEFAULT_PARAMS = {
+	.pids = 16,
+	.depth = 16,
+	.uniqueRatio = 0.05,
+	.images = 8,
+	.samples = 1000000,
+	.seed = 1,
+};
+
+namespace
+{
+	/* splitmix64; small, fast and the same on every platform. */
+	uint64_t
+	Mix(uint64_t x)
+	{
+		x += 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return (x ^ (x >> 31));
+	}
+
+	class Random
+	{
+		uint64_t state;
+
+	public:
+		explicit Random(uint64_t seed)
+		  : state(seed)
+		{
+		}
+
+		uint64_t Next()
+		{
+			state += 0x9e3779b97f4a7c15ULL;
+			return (Mix(state));
+		}
+
+		/* A value in [0, 1). */
+		double NextDouble()
+		{
+			return ((Next() >> 11) * 0x1.0p-53);
+		}
+	};
+
+	struct ProfilerSink
+	{
+		Profiler & profiler;
+
+		void MapIn(pid_t pid, TargetAddr start, const std::string &path)
+		{
+			profiler.processMapIn(pid, start, path.c_str());
+		}
+
+		void Exec(pid_t pid, const std::string &path, TargetAddr entry)
+		{
+			profiler.processEvent(ProcessExec(pid, path, entry));
+		}
+
+		void AddSample(pid_t pid, const uintptr_t *pc, uint32_t npc)
+		{
+			profiler.processEvent(Sample(pid, pc, npc));
+		}
+	};
+
+	struct MemorySink
+	{
+		MemoryEventSource & source;
+
+		void MapIn(pid_t pid, TargetAddr start, const std::string &path)
+		{
+			source.AddMapIn(pid, start, path);
+		}
+
+		void Exec(pid_t pid, const std::string &path, TargetAddr entry)
+		{
+			source.AddExec(pid, path, entry);
+		}
+
+		void AddSample(pid_t pid, const uintptr_t *pc, uint32_t npc)
+		{
+			source.AddSample(pid, pc, npc);
+		}
+	};
+}
+
+SyntheticEventSource::SyntheticEventSource(const Params & p)
+  : params(p)
+{
+	params.pids = std::max(params.pids, 1U);
+	params.depth = std::max(params.depth, 1U);
+	params.images = std::max(params.images, 1U);
+	params.uniqueRatio = std::clamp(params.uniqueRatio, 0.0, 1.0);
+}
+
+std::string
+SyntheticEventSource::LibraryPath(unsigned image)
+{
+	return ("/synthetic/lib/lib" + std::to_string(image) + ".so");
+}
+
+template <typename Sink>
+void
+SyntheticEventSource::Generate(Sink & sink) const
+{
+	Random rand(params.seed);
+	std::vector<uintptr_t> pcs(params.depth);
+	uint64_t chains, i, chain, h;
+	unsigned level, image;
+	pid_t pid;
+
+	for (unsigned p = 0; p < params.pids; ++p) {
+		pid = FIRST_PID + p;
+		sink.Exec(pid, "/synthetic/bin/prog", EXEC_BASE);
+		for (image = 1; image < params.images; ++image)
+			sink.MapIn(pid, LIB_BASE + (image - 1) * IMAGE_SPAN,
+			    LibraryPath(image));
+	}
+
+	/*
+	 * Rather than storing every callchain generated so far, a callchain's
+	 * frames are a pure function of its index, so a repeat only has to
+	 * pick an earlier index.
+	 */
+	chains = 0;
+	for (i = 0; i < params.samples; ++i) {
+		pid = FIRST_PID + rand.Next() % params.pids;
+		if (chains == 0 || rand.NextDouble() < params.uniqueRatio)
+			chain = chains++;
+		else
+			chain = rand.Next() % chains;
+
+		for (level = 0; level < params.depth; ++level) {
+			h = Mix(params.seed ^ Mix(chain * params.depth + level));
+			image = h % params.images;
+			/* Return addresses; the Sample subtracts one. */
+			if (image == 0)
+				pcs[level] = EXEC_BASE + (h >> 32) % IMAGE_SPAN + 1;
+			else
+				pcs[level] = LIB_BASE + (image - 1) * IMAGE_SPAN +
+				    (h >> 32) % IMAGE_SPAN + 1;
+		}
+
+		sink.AddSample(pid, pcs.data(), params.depth);
+	}
+}
+
+void
+SyntheticEventSource::Record(MemoryEventSource & source) const
+{
+	MemorySink sink{source};
+
+	Generate(sink);
+}
+
+bool
+SyntheticEventSource::Feed(Profiler & profiler)
+{
+	ProfilerSink sink{profiler};
+
+	Generate(sink);
+	return (true);
+}
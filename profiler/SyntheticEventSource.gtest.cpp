@@ -0,0 +1,186 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "SyntheticEventSource.h"
+
+#include "MemoryEventSource.h"
+#include "ProcessState.h"
+#include "Profiler.h"
+#include "Sample.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Rather than mocking the Profiler, record a textual trace of every event that
+ * it is fed so that two runs can be compared.
+ */
+static std::vector<std::string> trace;
+
+void
+Profiler::processEvent(const ProcessExec& processExec)
+{
+	std::ostringstream str;
+
+	str << "exec " << processExec.getProcessID() << " " <<
+	    processExec.getProcessName() << " " << std::hex <<
+	    processExec.getEntryAddr();
+	trace.push_back(str.str());
+}
+
+void
+Profiler::processEvent(const Sample& sample, uint64_t count)
+{
+	std::ostringstream str;
+
+	str << "sample " << sample.getProcessID() << std::hex;
+	for (int i = 0; i < sample.getChainDepth(); ++i)
+		str << " " << sample.getAddress(i);
+	trace.push_back(str.str());
+}
+
+void
+Profiler::processMapIn(pid_t pid, TargetAddr map_start, const char * image)
+{
+	std::ostringstream str;
+
+	str << "mapin " << pid << " " << std::hex << map_start << " " << image;
+	trace.push_back(str.str());
+}
+
+class SyntheticEventSourceTestSuite : public ::testing::Test
+{
+public:
+	Profiler *profiler = nullptr;
+
+	SyntheticEventSourceTestSuite()
+	{
+		trace.clear();
+	}
+
+	static SyntheticEventSource::Params
+	SmallParams()
+	{
+		SyntheticEventSource::Params p = SyntheticEventSource::DEFAULT_PARAMS;
+
+		p.pids = 3;
+		p.depth = 4;
+		p.images = 3;
+		p.samples = 1000;
+		p.uniqueRatio = 0.1;
+		p.seed = 42;
+		return (p);
+	}
+
+	std::vector<std::string>
+	Run(const SyntheticEventSource::Params & p)
+	{
+		SyntheticEventSource source(p);
+
+		trace.clear();
+		EXPECT_TRUE(source.Feed(*profiler));
+		return (trace);
+	}
+};
+
+TEST_F(SyntheticEventSourceTestSuite, TestDeterministic)
+{
+	auto p = SmallParams();
+
+	auto first = Run(p);
+	auto second = Run(p);
+	EXPECT_EQ(first, second);
+
+	p.seed = 43;
+	auto other = Run(p);
+	EXPECT_NE(first, other);
+}
+
+TEST_F(SyntheticEventSourceTestSuite, TestSetup)
+{
+	auto p = SmallParams();
+
+	auto events = Run(p);
+
+	// One exec plus images - 1 libraries per process, then the samples.
+	ASSERT_EQ(events.size(), p.pids * p.images + p.samples);
+	EXPECT_EQ(events.at(0), "exec 100 /synthetic/bin/prog 400000");
+	EXPECT_EQ(events.at(1), "mapin 100 800000000 /synthetic/lib/lib1.so");
+	EXPECT_EQ(events.at(2), "mapin 100 801000000 /synthetic/lib/lib2.so");
+	EXPECT_EQ(events.at(3), "exec 101 /synthetic/bin/prog 400000");
+}
+
+TEST_F(SyntheticEventSourceTestSuite, TestUniqueRatio)
+{
+	auto p = SmallParams();
+	std::set<std::string> chains;
+
+	p.pids = 1;
+	p.uniqueRatio = 0;
+	auto events = Run(p);
+	chains.insert(events.begin() + p.images, events.end());
+	EXPECT_EQ(chains.size(), 1);
+
+	chains.clear();
+	p.uniqueRatio = 1;
+	events = Run(p);
+	chains.insert(events.begin() + p.images, events.end());
+	EXPECT_EQ(chains.size(), p.samples);
+}
+
+TEST_F(SyntheticEventSourceTestSuite, TestMemoryReplay)
+{
+	auto p = SmallParams();
+	SyntheticEventSource synthetic(p);
+	MemoryEventSource memory;
+
+	synthetic.Record(memory);
+	EXPECT_EQ(memory.GetNumEvents(), p.pids * p.images + p.samples);
+
+	auto expected = Run(p);
+
+	for (int i = 0; i < 2; ++i) {
+		trace.clear();
+		EXPECT_TRUE(memory.Feed(*profiler));
+		EXPECT_EQ(trace, expected);
+	}
+}
+
+TEST_F(SyntheticEventSourceTestSuite, TestMemoryKernelSample)
+{
+	MemoryEventSource memory;
+	uintptr_t pcs[] = { 0xffffffff80001001, 0xffffffff80002001, 0x1001 };
+
+	memory.AddMapIn(-1, 0xffffffff80000000, "/boot/kernel/kernel");
+	memory.AddSample(5, pcs, 3);
+
+	EXPECT_TRUE(memory.Feed(*profiler));
+	ASSERT_EQ(trace.size(), 2);
+	EXPECT_EQ(trace.at(0), "mapin -1 ffffffff80000000 /boot/kernel/kernel");
+	// The user-mode part of the callchain is dropped.
+	EXPECT_EQ(trace.at(1), "sample 5 ffffffff80001000 ffffffff80002000");
+}
@@ -0,0 +1,28 @@
+
+PROG:=	bin/pmcbench
+PROG_LIBS := \
+	pmcbench \
+	pmcprofiler \
+	aggfactory \
+	callchainFactory \
+	printers \
+	spacefactory \
+	samples \
+	imagefactory \
+	image \
+	dwarf \
+	abi \
+	frame \
+	sharedptr \
+
+PROG_STDLIBS := \
+	pmc \
+	elf \
+	dwarf \
+	pthread \
+
+LIB:=	pmcbench
+
+SRCS:=	\
+	main.cpp \
+
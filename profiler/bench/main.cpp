@@ -0,0 +1,461 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "DefaultAddressSpaceFactory.h"
+#include "DefaultCallchainFactory.h"
+#include "DefaultImageFactory.h"
+#include "DefaultSampleAggregationFactory.h"
+#include "FlatHashMap.h"
+#include "MapUtil.h"
+#include "MappingTable.h"
+#include "MemoryEventSource.h"
+#include "ModulePathIndex.h"
+#include "PerfDataEventSource.h"
+#include "PerfDataReader.h"
+#include "PmcLogEventSource.h"
+#include "PmcLogReader.h"
+#include "Profiler.h"
+#include "SampleAggregation.h"
+#include "SharedPtr.h"
+#include "SharedString.h"
+#include "SyntheticEventSource.h"
+
+#include <err.h>
+#include <fcntl.h>
+#include <libelf.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * pmcbench drives the Profiler's ingest path from an EventSource and reports
+ * how quickly it was able to consume events.  The symbolization pass is timed
+ * separately, as it is dominated by DWARF parsing and not by ingest.
+ */
+
+void usage(void);
+
+/* Globals normally provided by pmcprofiler's main.cpp. */
+std::unordered_set<pid_t> pid_filter;
+bool g_quitOnError = false;
+bool g_includeTemplates = false;
+uint32_t g_filterFlags = PROFILE_USER | PROFILE_KERN;
+
+static double
+now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static unsigned long long
+parseNumber(const char *arg)
+{
+	char *end;
+	unsigned long long val;
+
+	val = strtoull(arg, &end, 0);
+	if (*end != '\0' || *arg == '\0')
+		usage();
+
+	return (val);
+}
+
+static size_t
+countCallchains(SampleAggregationFactory & aggFactory)
+{
+	AggregationList aggregations;
+	size_t total;
+
+	aggFactory.GetAggregationList(aggregations);
+
+	total = 0;
+	for (auto agg : aggregations)
+		agg->forEachCallchain([&total](const Callchain &) { total++; });
+
+	return (total);
+}
+
+/*
+ * Time lookups of keys that are all in the table, as the ingest path does
+ * for every sample.  Only the table is timed; the values aren't dereferenced.
+ * Returns nanoseconds per lookup.
+ */
+template <typename Map>
+static double
+timeLookups(const std::vector<uint32_t> & insertOrder,
+    const std::vector<uint32_t> & stream)
+{
+	Map map;
+	double start;
+	uintptr_t sum;
+
+	for (uint32_t k : insertOrder)
+		map[k] = std::make_unique<uint64_t>(k);
+
+	sum = 0;
+	start = now();
+	for (uint32_t key : stream)
+		sum += reinterpret_cast<uintptr_t>(map.find(key)->second.get());
+
+	/* Keep the loop from being optimized away. */
+	if (sum == 1)
+		printf("\n");
+
+	return ((now() - start) * 1e9 / stream.size());
+}
+
+/*
+ * Compare FlatHashMap against std::unordered_map with the shapes of the
+ * ingest path's tables: a few pids, and many callchain ids.
+ */
+static void
+benchMaps(const SyntheticEventSource::Params & params)
+{
+	typedef std::unique_ptr<uint64_t> Value;
+	uint32_t chains = std::max(1.0, params.samples * params.uniqueRatio);
+	uint32_t sizes[] = { params.pids, chains };
+	const char *names[] = { "pids", "callchains" };
+	std::vector<uint32_t> stream(params.samples);
+	std::vector<uint32_t> insertOrder;
+	uint64_t state = params.seed;
+
+	auto random = [&state]() {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (state >> 32);
+	};
+
+	for (int i = 0; i < 2; ++i) {
+		/* Don't let the nodes be allocated in the order they're read. */
+		insertOrder.resize(sizes[i]);
+		for (uint32_t k = 0; k < sizes[i]; ++k)
+			insertOrder[k] = k;
+		for (uint32_t k = sizes[i]; k > 1; --k)
+			std::swap(insertOrder[k - 1], insertOrder[random() % k]);
+
+		for (auto & key : stream)
+			key = random() % sizes[i];
+
+		double flat = timeLookups<FlatHashMap<uint32_t, Value>>(
+		    insertOrder, stream);
+		double node = timeLookups<std::unordered_map<uint32_t, Value>>(
+		    insertOrder, stream);
+
+		printf("%s: %u keys  FlatHashMap: %.1f ns/lookup  "
+		    "unordered_map: %.1f ns/lookup\n", names[i], sizes[i], flat,
+		    node);
+	}
+}
+
+/*
+ * Compare the address-to-image lookup done for every frame of a new
+ * callchain against LastSmallerThan on the std::map that it replaced, with
+ * -i images laid out like shared libraries.  Each callchain has -d frames
+ * that mostly stay within an image from one frame to the next.
+ */
+static void
+benchMappings(const SyntheticEventSource::Params & params)
+{
+	MappingTable<TargetAddr, uint32_t> table;
+	std::map<TargetAddr, uint32_t> map;
+	std::vector<TargetAddr> addrs(params.samples);
+	uint32_t images = std::max(1U, params.images);
+	uint32_t depth = std::max(1U, params.depth);
+	uint64_t state = params.seed;
+	uintptr_t sum;
+	double start, flat, tree;
+
+	auto random = [&state]() {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return (state >> 32);
+	};
+
+	for (uint32_t i = 0; i < images; ++i) {
+		TargetAddr base = 0x800000000ULL + TargetAddr(i) * 0x200000;
+
+		table.insert(base, uint32_t(i));
+		map.insert(std::make_pair(base, i));
+	}
+
+	TargetAddr image = 0;
+	for (size_t i = 0; i < addrs.size(); ++i) {
+		if (i % depth == 0 || random() % 4 == 0)
+			image = random() % images;
+		addrs[i] = 0x800000000ULL + image * 0x200000 +
+		    random() % 0x200000;
+	}
+
+	sum = 0;
+	start = now();
+	for (TargetAddr addr : addrs)
+		sum += *table.find(addr);
+	flat = (now() - start) * 1e9 / addrs.size();
+
+	start = now();
+	for (TargetAddr addr : addrs)
+		sum += LastSmallerThan(map, addr)->second;
+	tree = (now() - start) * 1e9 / addrs.size();
+
+	/* Keep the loops from being optimized away. */
+	if (sum == 1)
+		printf("\n");
+
+	printf("images: %u  MappingTable: %.1f ns/lookup  "
+	    "map: %.1f ns/lookup\n", images, flat, tree);
+}
+
+/*
+ * Time replacing a reference with another copy of the same value, which
+ * drops one reference and takes another.  Returns nanoseconds per copy.
+ */
+template <typename Ptr>
+static double
+timeCopies(const Ptr & orig, uint32_t count)
+{
+	std::vector<Ptr> copies(64, orig);
+	double start;
+
+	start = now();
+	for (uint32_t i = 0; i < count; ++i)
+		copies[i % copies.size()] = orig;
+
+	return ((now() - start) * 1e9 / count);
+}
+
+/*
+ * Compare the single-threaded reference counts used on the ingest and
+ * symbolization paths with their thread-safe counterparts.
+ */
+static void
+benchRefCounts(const SyntheticEventSource::Params & params)
+{
+	typedef SharedPtr<uint64_t> Ptr;
+	typedef SharedPtr<uint64_t, AtomicRefCount> AtomicPtr;
+
+	double str = timeCopies(SharedString("bench"), params.samples);
+	double atomicStr = timeCopies(ConcurrentSharedString("bench"),
+	    params.samples);
+	double ptr = timeCopies(Ptr::make(0), params.samples);
+	double atomicPtr = timeCopies(AtomicPtr::make(0), params.samples);
+
+	printf("SharedString: %.1f ns/copy  "
+	    "ConcurrentSharedString: %.1f ns/copy\n", str, atomicStr);
+	printf("SharedPtr: %.1f ns/copy  atomic SharedPtr: %.1f ns/copy\n",
+	    ptr, atomicPtr);
+}
+
+static void
+runOnce(EventSource & source, unsigned jobs, bool symbolize)
+{
+	DefaultCallchainFactory ccFactory;
+	DefaultImageFactory imgFactory;
+	DefaultAddressSpaceFactory asFactory(imgFactory);
+	DefaultSampleAggregationFactory aggFactory(ccFactory);
+	ModulePathIndex moduleIndex;
+	Profiler profiler("", false, moduleIndex, asFactory, aggFactory,
+	    imgFactory);
+	double start, ingested, mapped;
+
+	profiler.setJobs(jobs);
+
+	start = now();
+	if (!source.Feed(profiler))
+		errx(1, "Error reading events");
+	ingested = now();
+
+	mapped = ingested;
+	if (symbolize) {
+		imgFactory.MapAll();
+		mapped = now();
+	}
+
+	printf("samples: %ju  callchains: %zu  ingest: %.3fs (%.0f samples/s)",
+	    (uintmax_t)profiler.getSampleCount(), countCallchains(aggFactory),
+	    ingested - start, profiler.getSampleCount() / (ingested - start));
+	if (symbolize)
+		printf("  symbolize: %.3fs", mapped - ingested);
+	printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	SyntheticEventSource::Params params = SyntheticEventSource::DEFAULT_PARAMS;
+	std::unique_ptr<EventSource> logSource;
+	MappedLog log;
+	std::unique_ptr<SyntheticEventSource> synthetic;
+	std::unique_ptr<MemoryEventSource> memory;
+	EventSource *source;
+	const char *logFile = NULL;
+	unsigned jobs = 1;
+	unsigned repeat = 1;
+	bool record = false;
+	bool symbolize = false;
+	bool maps = false;
+	bool refCounts = false;
+	bool mappings = false;
+	char *end;
+	int ch;
+
+	if (elf_version(EV_CURRENT) == EV_NONE)
+		err(1, "libelf incompatible");
+
+	while ((ch = getopt(argc, argv, "d:f:Hi:j:Lmn:p:Rr:s:Su:")) != -1) {
+		switch (ch) {
+			case 'd':
+				params.depth = parseNumber(optarg);
+				break;
+			case 'f':
+				logFile = optarg;
+				break;
+			case 'H':
+				maps = true;
+				break;
+			case 'i':
+				params.images = parseNumber(optarg);
+				break;
+			case 'j':
+				jobs = parseNumber(optarg);
+				if (jobs < 1)
+					usage();
+				break;
+			case 'L':
+				mappings = true;
+				break;
+			case 'm':
+				record = true;
+				break;
+			case 'n':
+				params.samples = parseNumber(optarg);
+				break;
+			case 'p':
+				params.pids = parseNumber(optarg);
+				break;
+			case 'R':
+				refCounts = true;
+				break;
+			case 'r':
+				repeat = parseNumber(optarg);
+				break;
+			case 's':
+				params.seed = parseNumber(optarg);
+				break;
+			case 'S':
+				symbolize = true;
+				break;
+			case 'u':
+				params.uniqueRatio = strtod(optarg, &end);
+				if (*end != '\0' || *optarg == '\0')
+					usage();
+				break;
+			case '?':
+			default:
+				usage();
+		}
+	}
+
+	if (maps) {
+		for (unsigned i = 0; i < repeat; ++i)
+			benchMaps(params);
+		return (0);
+	}
+
+	if (mappings) {
+		for (unsigned i = 0; i < repeat; ++i)
+			benchMappings(params);
+		return (0);
+	}
+
+	if (refCounts) {
+		for (unsigned i = 0; i < repeat; ++i)
+			benchRefCounts(params);
+		return (0);
+	}
+
+	if (logFile != NULL) {
+		int fd = open(logFile, O_RDONLY);
+		if (fd < 0 || !log.map(fd))
+			err(1, "Could not open data file %s", logFile);
+
+		if (PerfDataReader::IsPerfData(log.getData(), log.getLength()))
+			logSource = std::make_unique<PerfDataEventSource>(
+			    log.getData(), log.getLength());
+		else
+			logSource = std::make_unique<PmcLogEventSource>(
+			    log.getData(), log.getLength(), jobs);
+		source = logSource.get();
+	} else {
+		synthetic = std::make_unique<SyntheticEventSource>(params);
+		source = synthetic.get();
+		if (record) {
+			/* Take event generation out of the measurement. */
+			memory = std::make_unique<MemoryEventSource>();
+			synthetic->Record(*memory);
+			source = memory.get();
+		}
+	}
+
+	for (unsigned i = 0; i < repeat; ++i)
+		runOnce(*source, jobs, symbolize);
+
+	return (0);
+}
+
+void
+usage()
+{
+	fprintf(stderr,
+		"usage: pmcbench [-HLmRS] [-f samplefile] [-j jobs] [-r repeat]\n"
+		"    [-p pids] [-d depth] [-u unique_ratio] [-i images] [-n samples]\n"
+		"    [-s seed]\n"
+		"    f - replay a pmclog or perf.data file instead of synthetic events\n"
+		"    j - number of threads used to decode the samplefile\n"
+		"    H - time the ingest path's hash table lookups instead, with\n"
+		"        -p pids and -n times -u callchains\n"
+		"    L - time -n address-to-image lookups instead, with -i images\n"
+		"        and -d frames per callchain\n"
+		"    m - generate the synthetic events into memory before timing\n"
+		"    R - time -n copies of SharedStrings and SharedPtrs instead\n"
+		"    r - number of times to run the benchmark\n"
+		"    S - also time symbolization of the sampled addresses\n"
+		"    p - number of synthetic processes\n"
+		"    d - depth of every synthetic callchain\n"
+		"    u - fraction of samples that start a new callchain\n"
+		"    i - number of images mapped into each process\n"
+		"    n - number of synthetic samples\n"
+		"    s - seed for the synthetic event generator\n");
+	exit(1);
+}
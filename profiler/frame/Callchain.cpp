@@ -25,12 +25,23 @@
 
 #include "AddressSpace.h"
 #include "Callframe.h"
+#include "CallchainTrie.h"
 #include "CallframeMapper.h"
 #include "Sample.h"
 
-Callchain::Callchain(CallframeMapper & space, const Sample& sample)
-  : space(space), sampleCount(0), kernel(sample.isKernel())
+Callchain::Callchain(CallframeMapper & space, const Sample& sample,
+    CallchainTrie *t)
+  : executable(space.getExecutableName()),
+    trie(t),
+    trieNode(CallchainTrie::ROOT),
+    sampleCount(0),
+    kernel(sample.isKernel())
 {
+	if (trie != nullptr) {
+		trieNode = trie->insert(space, sample);
+		return;
+	}
+
 	for (int i = 0; i < sample.getChainDepth(); ++i) {
 		TargetAddr addr = sample.getAddress(i);
 		const Callframe &fr = space.mapFrame(addr);
@@ -40,43 +51,117 @@ Callchain::Callchain(CallframeMapper & space, const Sample& sample)
 }
 
 void
-Callchain::addSample()
+Callchain::addSample(size_t count)
+{
+	sampleCount += count;
+	if (trie != nullptr)
+		trie->addSample(trieNode, count);
+}
+
+Callchain::RecordChain
+Callchain::getRecords() const
 {
-	sampleCount++;
+	if (trie == nullptr)
+		return callframes;
+
+	RecordChain records;
+	trie->getRecords(trieNode, records);
+	return records;
 }
 
 void
 Callchain::flatten(std::vector<const InlineFrame*> &frameList) const
 {
-	for (const auto & rec : callframes) {
-		for (const auto & frame : rec.frame.getInlineFrames()) {
+	if (trie == nullptr) {
+		for (const auto & rec : callframes) {
+			for (const auto & frame : rec.frame.getInlineFrames()) {
+				frameList.push_back(&frame);
+			}
+		}
+		return;
+	}
+
+	uint32_t id = trieNode;
+	for (; id != CallchainTrie::ROOT; id = trie->getParent(id)) {
+		for (const auto & frame : trie->getFrame(id).getInlineFrames()) {
 			frameList.push_back(&frame);
 		}
 	}
 }
 
+const Callframe &
+Callchain::getLeafCallframe() const
+{
+	if (trie != nullptr)
+		return trie->getFrame(trieNode);
+
+	return callframes.front().frame;
+}
+
+TargetAddr
+Callchain::getAddress() const
+{
+	if (trie != nullptr)
+		return trie->getAddress(trieNode);
+
+	return callframes.front().addr;
+}
+
 const InlineFrame&
 Callchain::getLeafFrame() const
 {
-	return callframes.front().frame.getInlineFrames().front();
+	return getLeafCallframe().getInlineFrames().front();
 }
 
 bool
 Callchain::isMapped() const
 {
-	return !callframes.front().frame.isUnmapped();
+	return !getLeafCallframe().isUnmapped();
 }
 
-const InlineFrame *
-Callchain::getSelfFrame(const InlineFrame & prototype)
+bool
+Callchain::isMappedBy(CallframeMapper & space) const
 {
-	if (selfFrame)
-		return selfFrame.get();
+	if (trie == nullptr) {
+		for (const auto & rec : callframes) {
+			if (&space.mapFrame(rec.addr) != &rec.frame)
+				return false;
+		}
+		return true;
+	}
 
-	SharedString self("[self]");
-	selfFrame = std::make_unique<InlineFrame>(prototype.getFile(),
-	    self, self, prototype.getOffset(), prototype.getCodeLine(),
-	    prototype.getFuncLine(), 0, getLeafFrame().getImageName());
+	uint32_t id = trieNode;
+	for (; id != CallchainTrie::ROOT; id = trie->getParent(id)) {
+		if (&space.mapFrame(trie->getAddress(id)) != &trie->getFrame(id))
+			return false;
+	}
+	return true;
+}
 
-	return selfFrame.get();
+bool
+Callchain::matches(const Sample & sample) const
+{
+	size_t depth = sample.getChainDepth();
+
+	if (kernel != sample.isKernel())
+		return false;
+
+	if (trie == nullptr) {
+		if (callframes.size() != depth)
+			return false;
+		for (size_t i = 0; i < depth; ++i) {
+			if (callframes[i].addr != sample.getAddress(i))
+				return false;
+		}
+		return true;
+	}
+
+	if (trie->getDepth(trieNode) != depth)
+		return false;
+	uint32_t id = trieNode;
+	for (size_t i = 0; i < depth; ++i, id = trie->getParent(id)) {
+		if (trie->getAddress(id) != sample.getAddress(i))
+			return false;
+	}
+	return true;
 }
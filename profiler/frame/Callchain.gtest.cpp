@@ -51,6 +51,8 @@ TEST(CallchainTestSuite, TestGetters)
 	MockFrameMapper mapper;
 
 	EXPECT_CALL(mapper, mapFrame(0x543)).WillOnce(ReturnRef(cf));
+	EXPECT_CALL(mapper, getExecutableName())
+	    .WillOnce(Return(SharedString("/bin/sh")));
 
 	pmclog_ev_pcsample event = {
 		.pl_pc = 0x544,
@@ -61,7 +63,7 @@ TEST(CallchainTestSuite, TestGetters)
 	Sample s(event);
 	Callchain chain(mapper, s);
 
-	EXPECT_EQ(&chain.getMapper(), &mapper);
+	EXPECT_EQ(chain.getExecutableName(), "/bin/sh");
 	EXPECT_EQ(chain.getAddress(), 0x543);
 	EXPECT_TRUE(chain.isKernel());
 	EXPECT_EQ(chain.getSampleCount(), 0);
@@ -72,48 +74,6 @@ TEST(CallchainTestSuite, TestGetters)
 	EXPECT_FALSE(ifr.isMapped());
 }
 
-TEST(CallchainTestSuite, TestGetSelfFrame)
-{
-	SharedString imageName("a.out");
-	TargetAddr off = 0xbad;
-	Callframe cf(off, imageName);
-
-	SharedString file("main.cpp");
-	SharedString func("DoFoobar");
-	SharedString demangled(func);
-	int codeLine = 101;
-	int funcLine = 94;
-	cf.addFrame(file, func, demangled, codeLine, funcLine, 0x2896);
-
-	MockFrameMapper mapper;
-
-	EXPECT_CALL(mapper, mapFrame(off)).WillOnce(ReturnRef(cf));
-
-	pmclog_ev_pcsample event = {
-		.pl_pc = off + 1,
-		.pl_pid = 123,
-		.pl_usermode = 0,
-	};
-
-	Sample s(event);
-	Callchain chain(mapper, s);
-	const InlineFrame & frame = chain.getLeafFrame();
-
-	const InlineFrame * self = chain.getSelfFrame(frame);
-	ASSERT_TRUE(self);
-	EXPECT_EQ(self->getFile(), file);
-	EXPECT_EQ(self->getFunc(), "[self]");
-	EXPECT_EQ(self->getDemangled(), "[self]");
-	EXPECT_EQ(self->getCodeLine(), codeLine);
-	EXPECT_EQ(self->getFuncLine(), funcLine);
-	EXPECT_EQ(self->getOffset(), off);
-	EXPECT_EQ(self->getImageName(), imageName);
-
-	// The callchain should cache the self frame and re-return it if we callchain
-	// this a second time.
-	EXPECT_EQ(self, chain.getSelfFrame(frame));
-}
-
 TEST(CallchainTestSuite, TestFlatten)
 {
 	SharedString imageName("a.out");
@@ -0,0 +1,177 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "CallchainTrie.h"
+
+#include "CallframeMapper.h"
+#include "Sample.h"
+
+#include <err.h>
+
+CallchainTrie::CallchainTrie()
+{
+	nodes.push_back(Node{
+		.addr = 0,
+		.frame = nullptr,
+		.parent = NONE,
+		.firstChild = NONE,
+		.nextSibling = NONE,
+		.depth = 0,
+		.fanout = 0,
+		.count = 0,
+	});
+}
+
+CallchainTrie::NodeId
+CallchainTrie::findChild(NodeId parent, TargetAddr addr) const
+{
+	const Node & p = nodes.at(parent);
+
+	if (p.fanout > INDEX_FANOUT) {
+		auto it = children.find(ChildKey{parent, addr});
+		if (it == children.end())
+			return (NONE);
+		return (it->second);
+	}
+
+	/* Newer siblings come first, so a remapped node shadows the old one. */
+	NodeId id = p.firstChild;
+	for (; id != NONE; id = nodes.at(id).nextSibling) {
+		if (nodes.at(id).addr == addr)
+			break;
+	}
+
+	return (id);
+}
+
+void
+CallchainTrie::indexChild(NodeId parent, NodeId child)
+{
+	Node & p = nodes.at(parent);
+
+	if (p.fanout > INDEX_FANOUT) {
+		children[ChildKey{parent, nodes.at(child).addr}] = child;
+		return;
+	}
+
+	p.fanout++;
+	if (p.fanout <= INDEX_FANOUT)
+		return;
+
+	/*
+	 * Index the list oldest first, so that where a remapped address has
+	 * two nodes the newest one is left in the table.
+	 */
+	std::vector<NodeId> list;
+	for (NodeId id = p.firstChild; id != NONE; id = nodes.at(id).nextSibling)
+		list.push_back(id);
+	for (auto it = list.rbegin(); it != list.rend(); ++it)
+		children[ChildKey{parent, nodes.at(*it).addr}] = *it;
+}
+
+CallchainTrie::NodeId
+CallchainTrie::getChild(CallframeMapper & space, NodeId parent,
+    TargetAddr addr)
+{
+	const Callframe *frame = nullptr;
+
+	NodeId existing = findChild(parent, addr);
+	if (existing != NONE) {
+		/*
+		 * Once an image has been mapped out, addr may map to a
+		 * different frame than when the node was made.  The old node
+		 * keeps its samples and a new sibling takes its place.
+		 */
+		if (space.getEpoch() == 0)
+			return (existing);
+		frame = &space.mapFrame(addr);
+		if (frame == nodes.at(existing).frame)
+			return (existing);
+	} else
+		frame = &space.mapFrame(addr);
+
+	if (nodes.size() >= NONE)
+		errx(1, "Too many callchain trie nodes");
+	if (nodes.at(parent).depth == UINT16_MAX)
+		errx(1, "Callchain too deep for the trie");
+
+	NodeId id = nodes.size();
+	Node & p = nodes.at(parent);
+	Node node = {
+		.addr = addr,
+		.frame = frame,
+		.parent = parent,
+		.firstChild = NONE,
+		.nextSibling = p.firstChild,
+		.depth = static_cast<uint16_t>(p.depth + 1),
+		.fanout = 0,
+		.count = 0,
+	};
+	p.firstChild = id;
+	nodes.push_back(node);
+	indexChild(parent, id);
+
+	return (id);
+}
+
+CallchainTrie::NodeId
+CallchainTrie::insert(CallframeMapper & space, const Sample & sample)
+{
+	NodeId node = ROOT;
+
+	for (int i = sample.getChainDepth() - 1; i >= 0; --i)
+		node = getChild(space, node, sample.getAddress(i));
+
+	return (node);
+}
+
+void
+CallchainTrie::finalize()
+{
+	decltype(children)().swap(children);
+	nodes.shrink_to_fit();
+
+	/*
+	 * Samples may still turn up for an exited process.  Its wide nodes
+	 * fall back to their sibling lists, and are indexed again as soon as
+	 * another child is added to them.
+	 */
+	for (auto & node : nodes) {
+		if (node.fanout > INDEX_FANOUT)
+			node.fanout = INDEX_FANOUT;
+	}
+}
+
+void
+CallchainTrie::getRecords(NodeId id, Callchain::RecordChain & records) const
+{
+	records.reserve(records.size() + nodes.at(id).depth);
+	for (; id != ROOT; id = nodes.at(id).parent) {
+		const Node & node = nodes.at(id);
+		records.push_back(Callchain::CallchainRecord(node.addr,
+		    *node.frame));
+	}
+}
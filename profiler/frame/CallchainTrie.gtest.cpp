@@ -0,0 +1,265 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "CallchainTrie.h"
+
+#include "Callchain.h"
+#include "Callframe.h"
+#include "CallframeMapper.h"
+#include "InlineFrame.h"
+#include "Sample.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <map>
+
+using namespace testing;
+
+class TestMapper : public CallframeMapper
+{
+	std::map<TargetAddr, std::unique_ptr<Callframe>> frames;
+	std::vector<std::unique_ptr<Callframe>> unmapped;
+
+public:
+	int mapped = 0;
+	uint64_t epoch = 0;
+
+	/* As if the image under addr were replaced by another. */
+	void remap(TargetAddr addr)
+	{
+		unmapped.push_back(std::move(frames[addr]));
+		epoch++;
+	}
+
+	uint64_t getEpoch() const override
+	{
+		return epoch;
+	}
+
+	const Callframe & mapFrame(TargetAddr addr) override
+	{
+		auto & frame = frames[addr];
+		if (!frame) {
+			frame = std::make_unique<Callframe>(addr,
+			    SharedString("a.out"));
+			frame->addFrame("", "", "", 1, 1, addr);
+			mapped++;
+		}
+		return *frame;
+	}
+
+	SharedString getExecutableName() const override
+	{
+		return SharedString("/bin/sh");
+	}
+};
+
+static Sample
+MakeSample(std::vector<uintptr_t> & pcs)
+{
+	return Sample(123, pcs.data(), pcs.size());
+}
+
+TEST(CallchainTrieTestSuite, TestSharedSuffix)
+{
+	TestMapper mapper;
+	CallchainTrie trie;
+	std::vector<uintptr_t> pc1 = { 0x501, 0x401, 0x301, 0x201 };
+	std::vector<uintptr_t> pc2 = { 0x601, 0x301, 0x201 };
+	std::vector<uintptr_t> pc3 = { 0x301, 0x201 };
+
+	CallchainTrie::NodeId n1 = trie.insert(mapper, MakeSample(pc1));
+	CallchainTrie::NodeId n2 = trie.insert(mapper, MakeSample(pc2));
+	CallchainTrie::NodeId n3 = trie.insert(mapper, MakeSample(pc3));
+
+	/* The root, 0x200, 0x300, 0x400, 0x500 and 0x600. */
+	EXPECT_EQ(trie.size(), 6);
+	EXPECT_EQ(mapper.mapped, 5);
+
+	EXPECT_EQ(trie.getDepth(n1), 4);
+	EXPECT_EQ(trie.getDepth(n2), 3);
+	EXPECT_EQ(trie.getDepth(n3), 2);
+	EXPECT_EQ(trie.getParent(n2), n3);
+	EXPECT_EQ(trie.getParent(trie.getParent(n1)), n3);
+	EXPECT_EQ(trie.getAddress(n2), 0x600);
+	EXPECT_EQ(trie.getFrame(n2).getOffset(), 0x600);
+
+	EXPECT_EQ(trie.insert(mapper, MakeSample(pc1)), n1);
+	EXPECT_EQ(trie.size(), 6);
+
+	Callchain::RecordChain records;
+	trie.getRecords(n1, records);
+	ASSERT_EQ(records.size(), 4);
+	EXPECT_EQ(records.at(0).getAddress(), 0x500);
+	EXPECT_EQ(records.at(1).getAddress(), 0x400);
+	EXPECT_EQ(records.at(2).getAddress(), 0x300);
+	EXPECT_EQ(records.at(3).getAddress(), 0x200);
+
+	/* Both 0x400 and 0x600 were called from 0x300. */
+	std::vector<TargetAddr> callees;
+	CallchainTrie::NodeId child = trie.getFirstChild(n3);
+	for (; child != CallchainTrie::NONE; child = trie.getNextSibling(child))
+		callees.push_back(trie.getAddress(child));
+	EXPECT_THAT(callees, UnorderedElementsAre(0x400, 0x600));
+}
+
+TEST(CallchainTrieTestSuite, TestCallchain)
+{
+	TestMapper mapper;
+	CallchainTrie trie;
+	std::vector<uintptr_t> pc1 = { 0x501, 0x401, 0x301 };
+	std::vector<uintptr_t> pc2 = { 0x601, 0x401, 0x301 };
+
+	Callchain chain1(mapper, MakeSample(pc1), &trie);
+	Callchain chain2(mapper, MakeSample(pc2), &trie);
+
+	EXPECT_EQ(trie.size(), 5);
+	EXPECT_EQ(chain1.getTrie(), &trie);
+	EXPECT_EQ(chain1.getExecutableName(), "/bin/sh");
+	EXPECT_EQ(chain1.getAddress(), 0x500);
+	EXPECT_EQ(chain2.getAddress(), 0x600);
+	EXPECT_FALSE(chain1.isKernel());
+	EXPECT_TRUE(chain1.isMapped());
+
+	chain1.addSample(3);
+	chain2.addSample();
+	EXPECT_EQ(chain1.getSampleCount(), 3);
+	EXPECT_EQ(trie.getSampleCount(chain1.getTrieNode()), 3);
+	EXPECT_EQ(trie.getSampleCount(chain2.getTrieNode()), 1);
+	EXPECT_EQ(trie.getSampleCount(trie.getParent(chain1.getTrieNode())), 0);
+
+	auto records = chain2.getRecords();
+	ASSERT_EQ(records.size(), 3);
+	EXPECT_EQ(records.at(0).getAddress(), 0x600);
+	EXPECT_EQ(records.at(2).getAddress(), 0x300);
+
+	trie.finalize();
+
+	std::vector<const InlineFrame*> ifl;
+	chain1.flatten(ifl);
+	ASSERT_EQ(ifl.size(), 3);
+	EXPECT_EQ(ifl.at(0)->getOffset(), 0x500);
+	EXPECT_EQ(ifl.at(1)->getOffset(), 0x400);
+	EXPECT_EQ(ifl.at(2)->getOffset(), 0x300);
+}
+
+TEST(CallchainTrieTestSuite, TestRemapped)
+{
+	TestMapper mapper;
+	CallchainTrie trie;
+	std::vector<uintptr_t> pc1 = { 0x501, 0x401, 0x301 };
+	std::vector<uintptr_t> pc2 = { 0x601, 0x301 };
+
+	Callchain chain1(mapper, MakeSample(pc1), &trie);
+	Callchain chain2(mapper, MakeSample(pc2), &trie);
+	EXPECT_EQ(trie.size(), 5);
+	EXPECT_TRUE(chain1.isMappedBy(mapper));
+
+	mapper.remap(0x400);
+	EXPECT_FALSE(chain1.isMappedBy(mapper));
+	EXPECT_TRUE(chain2.isMappedBy(mapper));
+
+	/*
+	 * 0x400 now maps to a new frame, so it and 0x500 under it get new
+	 * nodes.  The old nodes keep the old frames.
+	 */
+	Callchain chain3(mapper, MakeSample(pc1), &trie);
+	EXPECT_EQ(trie.size(), 7);
+	EXPECT_NE(chain3.getTrieNode(), chain1.getTrieNode());
+	EXPECT_EQ(trie.getParent(trie.getParent(chain3.getTrieNode())),
+	    trie.getParent(trie.getParent(chain1.getTrieNode())));
+	EXPECT_NE(&trie.getFrame(trie.getParent(chain3.getTrieNode())),
+	    &trie.getFrame(trie.getParent(chain1.getTrieNode())));
+	EXPECT_TRUE(chain3.isMappedBy(mapper));
+
+	/* Chains that didn't go through 0x400 keep their nodes. */
+	EXPECT_EQ(trie.insert(mapper, MakeSample(pc2)), chain2.getTrieNode());
+	EXPECT_EQ(trie.insert(mapper, MakeSample(pc1)), chain3.getTrieNode());
+	EXPECT_EQ(trie.size(), 7);
+}
+
+TEST(CallchainTrieTestSuite, TestWideNode)
+{
+	TestMapper mapper;
+	CallchainTrie trie;
+	std::vector<CallchainTrie::NodeId> leaves;
+
+	/* Enough callees under 0x300 that its children get indexed. */
+	for (uintptr_t i = 0; i < 20; ++i) {
+		std::vector<uintptr_t> pcs = { 0x1001 + i * 0x100, 0x301 };
+		leaves.push_back(trie.insert(mapper, MakeSample(pcs)));
+	}
+	EXPECT_EQ(trie.size(), 22);
+
+	for (uintptr_t i = 0; i < 20; ++i) {
+		std::vector<uintptr_t> pcs = { 0x1001 + i * 0x100, 0x301 };
+		EXPECT_EQ(trie.insert(mapper, MakeSample(pcs)), leaves.at(i));
+	}
+	EXPECT_EQ(trie.size(), 22);
+
+	size_t count = 0;
+	CallchainTrie::NodeId parent = trie.getParent(leaves.at(0));
+	CallchainTrie::NodeId child = trie.getFirstChild(parent);
+	for (; child != CallchainTrie::NONE; child = trie.getNextSibling(child))
+		count++;
+	EXPECT_EQ(count, 20);
+
+	mapper.remap(0x1300);
+	std::vector<uintptr_t> pcs = { 0x1301, 0x301 };
+	CallchainTrie::NodeId remapped = trie.insert(mapper, MakeSample(pcs));
+	EXPECT_NE(remapped, leaves.at(3));
+	EXPECT_EQ(trie.insert(mapper, MakeSample(pcs)), remapped);
+	EXPECT_EQ(trie.size(), 23);
+}
+
+TEST(CallchainTrieTestSuite, TestInsertAfterFinalize)
+{
+	TestMapper mapper;
+	CallchainTrie trie;
+	std::vector<CallchainTrie::NodeId> leaves;
+
+	for (uintptr_t i = 0; i < 20; ++i) {
+		std::vector<uintptr_t> pcs = { 0x1001 + i * 0x100, 0x301 };
+		leaves.push_back(trie.insert(mapper, MakeSample(pcs)));
+	}
+	trie.finalize();
+
+	/* The wide node's children are still found once its index is gone. */
+	for (uintptr_t i = 0; i < 20; ++i) {
+		std::vector<uintptr_t> pcs = { 0x1001 + i * 0x100, 0x301 };
+		EXPECT_EQ(trie.insert(mapper, MakeSample(pcs)), leaves.at(i));
+	}
+	EXPECT_EQ(trie.size(), 22);
+
+	/* A new child indexes them again. */
+	std::vector<uintptr_t> pcs = { 0x9001, 0x301 };
+	CallchainTrie::NodeId added = trie.insert(mapper, MakeSample(pcs));
+	EXPECT_EQ(trie.size(), 23);
+	EXPECT_EQ(trie.insert(mapper, MakeSample(pcs)), added);
+	for (uintptr_t i = 0; i < 20; ++i) {
+		std::vector<uintptr_t> pcs = { 0x1001 + i * 0x100, 0x301 };
+		EXPECT_EQ(trie.insert(mapper, MakeSample(pcs)), leaves.at(i));
+	}
+	EXPECT_EQ(trie.size(), 23);
+}
@@ -23,14 +23,26 @@
 
 #include "Callframe.h"
 
+#include "FlatHashMap.h"
 #include "InlineFrame.h"
 #include "SharedString.h"
 
+#include <functional>
+
 Callframe::Callframe(TargetAddr off, SharedString imageName)
   : offset(off), imageName(imageName), unmapped(false)
 {
 }
 
+// The moved frames must refer to their new owner.
+Callframe::Callframe(Callframe &&other) noexcept
+  : offset(other.offset), imageName(std::move(other.imageName)),
+    inlineFrames(std::move(other.inlineFrames)), unmapped(other.unmapped)
+{
+	for (auto & frame : inlineFrames)
+		frame.callframe = this;
+}
+
 // This is defined for the benefit of a unit test that wants to intercept
 // calls to ~Callframe() to track Callframe lifecycles
 Callframe::~Callframe()
@@ -41,18 +53,88 @@ void
 Callframe::addFrame(SharedString file, SharedString func,
      SharedString demangled, int codeLine, int funcLine, uint64_t dwarfDieOffset)
 {
-	inlineFrames.emplace_back(file, func, demangled, offset, codeLine,
-	    funcLine, dwarfDieOffset, imageName);
+	inlineFrames.emplace_back(*this, file, func, demangled, codeLine,
+	    funcLine, dwarfDieOffset);
 }
 
-
 void
 Callframe::setUnmapped()
 {
 	SharedString unmapped_function("[unmapped_function]");
 	inlineFrames.clear();
-	inlineFrames.emplace_back(imageName, unmapped_function,
-	    unmapped_function, offset, -1, -1, 0, imageName);
+	inlineFrames.emplace_back(*this, imageName, unmapped_function,
+	    unmapped_function, -1, -1, 0);
 
 	unmapped = true;
 }
+
+/*
+ * The table is never destroyed, as InlineFrames may be referenced until
+ * exit.
+ */
+StringIdTable &
+InlineFrame::GetStrings()
+{
+	static StringIdTable *strings = new StringIdTable;
+
+	return *strings;
+}
+
+size_t
+InlineFrame::FunctionHash::operator()(const Function & f) const
+{
+	size_t hash = std::hash<uint64_t>()(f.dwarfDieOffset);
+
+	hash = hash * 31 + f.file;
+	hash = hash * 31 + f.func;
+	hash = hash * 31 + f.demangledFunc;
+	return hash * 31 + f.funcLine;
+}
+
+struct InlineFrame::FunctionTable
+{
+	std::vector<Function> functions;
+	FlatHashMap<Function, FunctionId, FunctionHash> ids;
+};
+
+/* Like the string table, this only grows and is never destroyed. */
+InlineFrame::FunctionTable &
+InlineFrame::GetFunctions()
+{
+	static FunctionTable *table = new FunctionTable;
+
+	return *table;
+}
+
+InlineFrame::FunctionId
+InlineFrame::InternFunction(const Function & function)
+{
+	FunctionTable & table = GetFunctions();
+
+	auto it = table.ids.find(function);
+	if (it != table.ids.end())
+		return it->second;
+
+	FunctionId id = table.functions.size();
+	table.functions.push_back(function);
+	table.ids.emplace(function, FunctionId(id));
+	return id;
+}
+
+const InlineFrame::Function &
+InlineFrame::GetFunction(FunctionId id)
+{
+	return GetFunctions().functions[id];
+}
+
+SharedString
+InlineFrame::getImageName() const
+{
+	return callframe->getImageName();
+}
+
+TargetAddr
+InlineFrame::getOffset() const
+{
+	return callframe->getOffset();
+}
@@ -23,6 +23,7 @@
 
 #include <gtest/gtest.h>
 
+#include "Callframe.h"
 #include "InlineFrame.h"
 #include "TestPrinter/SharedString.h"
 
@@ -38,8 +39,9 @@ TEST(InlineFrameSuite, TestGetters)
 	const uint64_t dwarfDieOffset = 0x18749d;
 	const SharedString imageName("rstone.so.4");
 
-	InlineFrame frame(file, func, demangled, off, codeLine, funcLine,
-		dwarfDieOffset, imageName);
+	Callframe callframe(off, imageName);
+	InlineFrame frame(callframe, file, func, demangled, codeLine, funcLine,
+		dwarfDieOffset);
 
 	EXPECT_EQ(file, frame.getFile());
 	EXPECT_EQ(func, frame.getFunc());
@@ -63,8 +65,9 @@ void TestMoveConstructor()
 	const uint64_t dwarfDieOffset = 0xdeadc0de;
 	const SharedString imageName("dd");
 
-	InlineFrame first(file, func, demangled, off, codeLine, funcLine,
-		dwarfDieOffset, imageName);
+	Callframe callframe(off, imageName);
+	InlineFrame first(callframe, file, func, demangled, codeLine, funcLine,
+		dwarfDieOffset);
 
 	InlineFrame frame(std::move(first));
 
@@ -81,8 +84,39 @@ void TestMoveConstructor()
 
 void TestUnmapped()
 {
-	InlineFrame frame("", "", "", 0, -1, -1, 0, "");
+	Callframe callframe(0, "");
+	InlineFrame frame(callframe, "", "", "", -1, -1, 0);
 
 	ASSERT_TRUE(!frame.isMapped());
 }
 
+
+TEST(InlineFrameSuite, TestSharedStrings)
+{
+	Callframe callframe(0x1234, "rstone.so.4");
+	InlineFrame first(callframe, "foo.cpp", "bar", "bar", 10, 8, 0);
+	InlineFrame second(callframe, "foo.cpp", "baz", "baz", 20, 18, 0);
+
+	// Repeated strings are stored once, and resolve to the same value.
+	EXPECT_EQ(&*first.getFile(), &*second.getFile());
+	EXPECT_EQ(&*first.getFunc(), &*first.getDemangled());
+	EXPECT_EQ(first.getImageName(), second.getImageName());
+	EXPECT_LE(sizeof(InlineFrame), 16);
+}
+
+TEST(InlineFrameSuite, TestSharedFunction)
+{
+	Callframe callframe(0x1234, "rstone.so.4");
+	InlineFrame first(callframe, "foo.cpp", "bar", "bar", 10, 8, 0x40);
+	InlineFrame second(callframe, "foo.cpp", "bar", "bar", 12, 8, 0x40);
+	InlineFrame other(callframe, "foo.cpp", "bar", "bar", 10, 8, 0x80);
+
+	// Lines differ, but everything else is shared.
+	EXPECT_EQ(first.getCodeLine(), 10);
+	EXPECT_EQ(second.getCodeLine(), 12);
+	EXPECT_EQ(second.getFuncLine(), 8);
+	EXPECT_EQ(second.getDieOffset(), 0x40);
+	EXPECT_EQ(other.getDieOffset(), 0x80);
+	EXPECT_EQ(other.getCodeLine(), 10);
+	EXPECT_EQ(other.getFunc(), first.getFunc());
+}
@@ -6,15 +6,18 @@ LIB :=	frame
 
 SRCS := \
 	Callchain.cpp \
+	CallchainTrie.cpp \
 	Callframe.cpp \
 
 TESTS := \
 	Callchain \
+	CallchainTrie \
 	Callframe \
 	InlineFrame \
 
 TEST_CALLCHAIN_SRCS := \
 	Callchain.cpp \
+	CallchainTrie.cpp \
 	Callframe.cpp \
 
 TEST_CALLCHAIN_LIBS := \
@@ -23,11 +26,25 @@ TEST_CALLCHAIN_LIBS := \
 TEST_CALLCHAIN_STDLIBS := \
 	gmock \
 
+TEST_CALLCHAINTRIE_SRCS := \
+	Callchain.cpp \
+	CallchainTrie.cpp \
+	Callframe.cpp \
+
+TEST_CALLCHAINTRIE_LIBS := \
+	sharedptr \
+
+TEST_CALLCHAINTRIE_STDLIBS := \
+	gmock \
+
 TEST_CALLFRAME_SRCS := \
 	Callframe.cpp \
 
 TEST_CALLFRAME_LIBS := \
 	sharedptr \
 
+TEST_INLINEFRAME_SRCS := \
+	Callframe.cpp \
+
 TEST_INLINEFRAME_LIBS := \
 	sharedptr \
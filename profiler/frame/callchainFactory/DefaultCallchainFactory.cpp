@@ -25,8 +25,12 @@
 
 #include "Callchain.h"
 
-std::unique_ptr<Callchain>
-DefaultCallchainFactory::MakeCallchain(CallframeMapper & space, const Sample & sample)
+CallchainPtr
+DefaultCallchainFactory::MakeCallchain(CallframeMapper & space,
+    const Sample & sample, CallchainTrie *trie)
 {
-	return std::make_unique<Callchain>(space, sample);
+	if (!useArena)
+		return std::make_unique<Callchain>(space, sample, trie);
+
+	return arena.make<Callchain>(space, sample, trie);
 }
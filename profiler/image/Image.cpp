@@ -30,8 +30,19 @@ __FBSDID("$FreeBSD$");
 #include "DwarfResolver.h"
 #include "SharedString.h"
 
-Image::Image(SharedString imageName)
-  : imageFile(imageName)
+static std::pmr::memory_resource *
+FrameResource(Arena *arena)
+{
+	if (arena == nullptr)
+		return (std::pmr::new_delete_resource());
+	return (arena->getResource());
+}
+
+Image::Image(SharedString imageName, Arena *arena)
+  : imageFile(imageName),
+    arena(arena),
+    frameMap(FrameResource(arena)),
+    pendingFrames(FrameResource(arena))
 {
 }
 
@@ -47,25 +58,44 @@ Image::GetFrame(TargetAddr offset)
 	if (it != frameMap.end())
 		return *it->second;
 
-	auto ptr = std::make_unique<Callframe>(offset, imageFile);
+	it = pendingFrames.find(offset);
+	if (it != pendingFrames.end())
+		return *it->second;
+
+	ArenaPtr<Callframe> ptr;
+	if (arena != nullptr)
+		ptr = arena->make<Callframe>(offset, imageFile);
+	else
+		ptr = std::make_unique<Callframe>(offset, imageFile);
 	Callframe & frame = *ptr;
-	frameMap.insert(std::make_pair(offset, std::move(ptr)));
+	pendingFrames.insert(std::make_pair(offset, std::move(ptr)));
 	return frame;
 }
 
+/*
+ * Only frames that haven't been mapped yet are resolved, so this can be
+ * called repeatedly as new samples come in.  If more frames are expected,
+ * keepResolver keeps the image's ELF and DWARF data loaded until the next
+ * call; otherwise they are freed as soon as the frames are resolved.
+ */
 void
-Image::MapAllFrames()
+Image::MapAllFrames(bool keepResolver)
 {
-	if (frameMap.empty())
-		return;
+	if (!pendingFrames.empty()) {
+		if (!resolver)
+			resolver = std::make_unique<DwarfResolver>(imageFile);
+		resolver->Resolve(pendingFrames);
+		frameMap.merge(pendingFrames);
+	}
 
-	DwarfResolver resolver(imageFile);
-	resolver.Resolve(frameMap);
+	if (!keepResolver)
+		resolver.reset();
 }
 
 void
 Image::MapAllAsUnmapped()
 {
-	for (auto & [offset, frame] : frameMap)
+	for (auto & [offset, frame] : pendingFrames)
 		frame->setUnmapped();
+	frameMap.merge(pendingFrames);
 }
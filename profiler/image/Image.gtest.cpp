@@ -62,6 +62,7 @@ class DwarfResolverMock : public GlobalMockBase<DwarfResolverMock>
 public:
 	MOCK_METHOD1(Construct, void (SharedString));
 	MOCK_METHOD1(Resolve, void (const FrameMap &));
+	MOCK_METHOD0(Destruct, void ());
 };
 
 DwarfResolver::DwarfResolver(SharedString name)
@@ -69,8 +70,10 @@ DwarfResolver::DwarfResolver(SharedString name)
 	DwarfResolverMock::MockObj().Construct(name);
 }
 
-// Leave this as a stub because we don't care when the resolver is destructed
-DwarfResolver::~DwarfResolver() {}
+DwarfResolver::~DwarfResolver()
+{
+	DwarfResolverMock::MockObj().Destruct();
+}
 
 void
 DwarfResolver::Resolve(const FrameMap &frames)
@@ -206,10 +209,13 @@ TEST(ImageTestSuite, TestMapAll)
 		EXPECT_CALL(*resolverMock, Resolve(
 			ResultOf(FrameListMatcher(frameList), true)))
 		    .Times(1);
-// 		EXPECT_CALL(*resolverMock, Resolve(_))
-// 		    .Times(1);
+
+		// Nothing more will be mapped, so the DWARF data is freed.
+		EXPECT_CALL(*resolverMock, Destruct())
+		    .Times(1);
 
 		img->MapAllFrames();
+		Mock::VerifyAndClearExpectations(&*resolverMock);
 
 		// The Callframes should be destructed as the image is destroyed,
 		// when the factory goes out of scope.
@@ -220,6 +226,60 @@ TEST(ImageTestSuite, TestMapAll)
 
 }
 
+// Frames that were already mapped must not be handed to the resolver again,
+// and the resolver is only constructed once while frames keep coming in.
+TEST(ImageTestSuite, TestMapAllIncremental)
+{
+	GlobalMock<CallframeMock> cfMock;
+	GlobalMock<DwarfResolverMock> resolverMock;
+	SharedString execname("/usr/local/bin/nginx");
+
+	EXPECT_CALL(*cfMock, Construct(_, execname))
+	  .Times(3);
+
+	{
+		DefaultImageFactory factory;
+		Image *img = factory.GetImage(execname);
+		std::unordered_set<const Callframe *> first, second;
+
+		first.insert(&img->GetFrame(0x1234));
+		first.insert(&img->GetFrame(0x5678));
+
+		EXPECT_CALL(*resolverMock, Construct(execname))
+		    .Times(1);
+		EXPECT_CALL(*resolverMock, Resolve(AllOf(
+			SizeIs(2),
+			ResultOf(FrameListMatcher(first), true))))
+		    .Times(1);
+
+		img->MapAllFrames(true);
+
+		// An existing frame is found whether or not it has been mapped.
+		EXPECT_EQ(first.count(&img->GetFrame(0x1234)), 1);
+
+		second.insert(&img->GetFrame(0x9abc));
+
+		EXPECT_CALL(*resolverMock, Resolve(AllOf(
+			SizeIs(1),
+			ResultOf(FrameListMatcher(second), true))))
+		    .Times(1);
+
+		img->MapAllFrames(true);
+
+		// Nothing new, so nothing to resolve.
+		img->MapAllFrames(true);
+		Mock::VerifyAndClearExpectations(&*resolverMock);
+
+		EXPECT_CALL(*resolverMock, Destruct())
+		    .Times(1);
+		img->MapAllFrames();
+		Mock::VerifyAndClearExpectations(&*resolverMock);
+
+		EXPECT_CALL(*cfMock, Destruct(_))
+		    .Times(3);
+	}
+}
+
 TEST(ImageTestSuite, TestMapAllAsUnMapped)
 {
 	GlobalMock<CallframeMock> cfMock;
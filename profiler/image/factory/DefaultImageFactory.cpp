@@ -26,9 +26,10 @@
 #include "Image.h"
 
 DefaultImageFactory::DefaultImageFactory()
-  : unmappedImage(AllocImage(""))
+  : unmappedImage(AllocImage("", &arena))
 {
-
+	/* There is no file behind the unmapped image to read this from. */
+	unmappedImage->SetLoadInfo({0, false});
 }
 
 DefaultImageFactory::~DefaultImageFactory()
@@ -41,7 +42,7 @@ DefaultImageFactory::GetImage(SharedString name)
 {
 	ImageMap::iterator it = imageMap.find(name);
 	if (it == imageMap.end()) {
-		auto ptr = AllocImage(name);
+		auto ptr = AllocImage(name, &arena);
 		Image *image = ptr.get();
 		imageMap.insert(std::make_pair(name, std::move(ptr)));
 		return image;
@@ -57,10 +58,10 @@ DefaultImageFactory::GetUnmappedImage()
 }
 
 void
-DefaultImageFactory::MapAll()
+DefaultImageFactory::MapAll(bool more)
 {
 	for (auto & [name, image] : imageMap)
-		image->MapAllFrames();
+		image->MapAllFrames(more);
 
 	unmappedImage->MapAllAsUnmapped();
 }
@@ -26,7 +26,7 @@
 #include "Image.h"
 
 std::unique_ptr<Image>
-ImageFactory::AllocImage(SharedString name)
+ImageFactory::AllocImage(SharedString name, Arena *arena)
 {
-	return std::unique_ptr<Image>(new Image(name));
+	return std::unique_ptr<Image>(new Image(name, arena));
 }
\ No newline at end of file
@@ -28,12 +28,17 @@ __FBSDID("$FreeBSD$");
 #include "DefaultCallchainFactory.h"
 #include "DefaultImageFactory.h"
 #include "DefaultSampleAggregationFactory.h"
+#include "ModulePathIndex.h"
 #include "Profiler.h"
 #include "ProfilePrinter.h"
 #include "CallchainProfilePrinter.h"
+#include "SampleAggregation.h"
 #include "SharedString.h"
+#include "TimeWindow.h"
 
 #include <err.h>
+#include <getopt.h>
+#include <limits.h>
 #include <libelf.h>
 #include <sys/param.h>
 #include <pmclog.h>
@@ -42,10 +47,14 @@ __FBSDID("$FreeBSD$");
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 void usage(void);
 
-std::string samplefile("/tmp/samples.out");
+static const unsigned DEFAULT_FOLLOW_INTERVAL = 10;
+
+std::vector<std::string> samplefiles;
 
 std::unordered_set<pid_t> pid_filter;
 
@@ -58,6 +67,100 @@ bool g_includeTemplates = false;
 
 uint32_t g_filterFlags = PROFILE_USER | PROFILE_KERN;
 
+enum {
+	OPT_FOLLOW = 256,
+	OPT_INTERVAL,
+	OPT_EVERY,
+	OPT_FROM,
+	OPT_TO,
+	OPT_SAMPLE_RATE,
+	OPT_MAX_SAMPLES,
+	OPT_TRIE,
+	OPT_TOP_CHAINS,
+	OPT_SPILL,
+};
+
+static const struct option longopts[] = {
+	{ "follow",	no_argument,		NULL,	OPT_FOLLOW },
+	{ "interval",	required_argument,	NULL,	OPT_INTERVAL },
+	{ "every",	required_argument,	NULL,	OPT_EVERY },
+	{ "from",	required_argument,	NULL,	OPT_FROM },
+	{ "to",		required_argument,	NULL,	OPT_TO },
+	{ "sample-rate",	required_argument,	NULL,	OPT_SAMPLE_RATE },
+	{ "max-samples",	required_argument,	NULL,	OPT_MAX_SAMPLES },
+	{ "trie",	no_argument,		NULL,	OPT_TRIE },
+	{ "top-chains",	required_argument,	NULL,	OPT_TOP_CHAINS },
+	{ "spill",	required_argument,	NULL,	OPT_SPILL },
+	{ NULL,		0,			NULL,	0 }
+};
+
+static unsigned
+parseUnsigned(const char *arg)
+{
+	char *end;
+	unsigned long val;
+
+	val = strtoul(arg, &end, 0);
+	if (*end != '\0' || *arg == '\0' || val > UINT_MAX)
+		usage();
+
+	return (val);
+}
+
+/*
+ * A time is seconds from the start of the log, or seconds since the epoch if
+ * it starts with '@'.
+ */
+static void
+parseTime(const char *arg, TimeWindow::Bound &bound)
+{
+	char *end;
+
+	bound.absolute = (*arg == '@');
+	if (bound.absolute)
+		arg++;
+
+	bound.seconds = strtod(arg, &end);
+	if (*end != '\0' || *arg == '\0' || bound.seconds < 0)
+		usage();
+	bound.set = true;
+}
+
+/*
+ * The state for each samples file after the first.  Every file gets its own
+ * address spaces and aggregations, as the pids in one mean nothing in
+ * another.
+ */
+struct ExtraInput
+{
+	DefaultAddressSpaceFactory asFactory;
+	DefaultSampleAggregationFactory aggFactory;
+	Profiler profiler;
+
+	ExtraInput(const std::string & file, bool showlines,
+	    ModulePathIndex & moduleIndex, ImageFactory & imgFactory,
+	    CallchainFactory & ccFactory, bool useTrie, size_t maxChains,
+	    SpillBudget *spillBudget)
+	  : asFactory(imgFactory),
+	    aggFactory(ccFactory, useTrie, maxChains, spillBudget),
+	    profiler(file, showlines, moduleIndex, asFactory, aggFactory,
+	        imgFactory)
+	{
+	}
+};
+
+/*
+ * Exit without running any destructors.  A large profile holds tens of
+ * millions of frames and callchains, and destroying them one by one only
+ * delays the exit.
+ */
+static void
+fastExit()
+{
+	fflush(NULL);
+	_exit(0);
+}
+
 FILE * openOutFile(const char * path)
 {
 	FILE * file;
@@ -88,6 +191,19 @@ main(int argc, char *argv[])
 	std::vector<std::unique_ptr<ProfilePrinter> > printers;
 	const char *modulePath = NULL;
 	pid_t pid;
+	unsigned jobs = 1;
+	bool follow = false;
+	unsigned interval = 0;
+	unsigned everySamples = 0;
+	const char *readProfile = NULL;
+	const char *writeProfile = NULL;
+	bool printersRequested;
+	TimeWindow window;
+	unsigned sampleRate = 1;
+	unsigned maxSamples = 0;
+	bool useTrie = false;
+	unsigned maxChains = 0;
+	size_t spillBudget = 0;
 
 	if (elf_version(EV_CURRENT) == EV_NONE)
 		err(1, "libelf incompatible");
@@ -95,13 +211,14 @@ main(int argc, char *argv[])
 	/* Workaround for libdwarf crash when processing some KLD modules. */
 	//dwarf_set_reloc_application(0);
 
-	while ((ch = getopt(argc, argv, "bf:F:G:Klm:o:p:qr:t:TU")) != -1) {
+	while ((ch = getopt_long(argc, argv, "bf:F:G:j:Klm:o:p:qr:R:t:TUW:",
+	    longopts, NULL)) != -1) {
 		switch (ch) {
 			case 'b':
 				printBoring = false;
 				break;
 			case 'f':
-				samplefile = optarg;
+				samplefiles.push_back(optarg);
 				break;
 			case 'F':
 				file = openOutFile(optarg);
@@ -111,6 +228,12 @@ main(int argc, char *argv[])
 				file = openOutFile(optarg);
 				printers.push_back(std::make_unique<LeafProfilePrinter>(file, threshold, printBoring));
 				break;
+			case 'j':
+				jobs = strtoul(optarg, &temp, 0);
+
+				if (*temp != '\0' || jobs < 1)
+					usage();
+				break;
 			case 'K':
 				g_filterFlags = PROFILE_KERN;
 				break;
@@ -138,6 +261,9 @@ main(int argc, char *argv[])
 				file = openOutFile(optarg);
 				printers.push_back(std::make_unique<RootProfilePrinter>(file, threshold, true));
 				break;
+			case 'R':
+				readProfile = optarg;
+				break;
 			case 't':
 				threshold = strtol(optarg, &temp, 0);
 
@@ -151,6 +277,48 @@ main(int argc, char *argv[])
 			case 'U':
 				g_filterFlags = PROFILE_USER;
 				break;
+			case 'W':
+				writeProfile = optarg;
+				break;
+			case OPT_FOLLOW:
+				follow = true;
+				break;
+			case OPT_INTERVAL:
+				interval = parseUnsigned(optarg);
+				break;
+			case OPT_EVERY:
+				everySamples = parseUnsigned(optarg);
+				break;
+			case OPT_FROM:
+				parseTime(optarg, window.from);
+				break;
+			case OPT_TO:
+				parseTime(optarg, window.to);
+				break;
+			case OPT_SAMPLE_RATE:
+				sampleRate = parseUnsigned(optarg);
+				if (sampleRate < 1)
+					usage();
+				break;
+			case OPT_MAX_SAMPLES:
+				maxSamples = parseUnsigned(optarg);
+				if (maxSamples < 1)
+					usage();
+				break;
+			case OPT_TRIE:
+				useTrie = true;
+				break;
+			case OPT_TOP_CHAINS:
+				maxChains = parseUnsigned(optarg);
+				if (maxChains < 1)
+					usage();
+				break;
+			case OPT_SPILL:
+				spillBudget = parseUnsigned(optarg);
+				if (spillBudget < 1)
+					usage();
+				spillBudget *= 1024 * 1024;
+				break;
 			case '?':
 			default:
 				usage();
@@ -160,31 +328,134 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
+	if (follow && (readProfile != NULL || writeProfile != NULL))
+		usage();
+
+	if (window.isSet() && (follow || readProfile != NULL))
+		usage();
+
+	if ((sampleRate > 1 || maxSamples != 0) && readProfile != NULL)
+		usage();
+
+	/* The number of samples in a log that is still growing isn't known. */
+	if (maxSamples != 0 && follow)
+		usage();
+
+	/* A log that is still growing is decoded serially as it arrives. */
+	if (jobs > 1 && follow)
+		usage();
+
+	/* A trie can't give back the nodes of chains that are evicted. */
+	if (useTrie && (maxChains != 0 || spillBudget != 0))
+		usage();
+
+	if (maxChains != 0 && spillBudget != 0)
+		usage();
+
+	if (samplefiles.empty())
+		samplefiles.push_back("/tmp/samples.out");
+
+	if (samplefiles.size() > 1 && (follow || readProfile != NULL))
+		usage();
+
+	if (window.from.set && window.to.set &&
+	    window.from.absolute == window.to.absolute &&
+	    window.from.seconds > window.to.seconds)
+		usage();
+
+	printersRequested = !printers.empty();
 	if (printers.empty())
 		printers.push_back(std::make_unique<FlatProfilePrinter>(stdout));
 
-	DefaultCallchainFactory ccFactory;
+	if (follow && interval == 0 && everySamples == 0)
+		interval = DEFAULT_FOLLOW_INTERVAL;
+
+	/* Shared by every input, so that all of their chains fit in it. */
+	std::unique_ptr<SpillBudget> spill;
+	if (spillBudget != 0)
+		spill = std::make_unique<SpillBudget>(spillBudget);
+
+	/* The module path is only scanned once for every input. */
+	ModulePathIndex moduleIndex;
+	if (modulePath != NULL)
+		moduleIndex.SetPathList(modulePath);
+	else
+		moduleIndex.SetLocalPath();
+
+	DefaultCallchainFactory ccFactory(maxChains == 0 && spillBudget == 0);
 	DefaultImageFactory imgFactory;
 	DefaultAddressSpaceFactory asFactory(imgFactory);
-	DefaultSampleAggregationFactory aggFactory(ccFactory);
-	Profiler profiler(samplefile, showlines, modulePath, asFactory,
+	DefaultSampleAggregationFactory aggFactory(ccFactory, useTrie,
+	    maxChains, spill.get());
+	Profiler profiler(samplefiles.front(), showlines, moduleIndex, asFactory,
 	    aggFactory, imgFactory);
+	std::vector<std::unique_ptr<ExtraInput>> extraInputs;
+	std::vector<Profiler *> others;
+
+	auto configure = [&](Profiler & p) {
+		p.setJobs(jobs);
+		p.setTimeWindow(window);
+		p.setSampleRate(sampleRate);
+		p.setMaxSamples(maxSamples);
+	};
+
+	configure(profiler);
+	for (size_t i = 1; i < samplefiles.size(); ++i) {
+		extraInputs.push_back(std::make_unique<ExtraInput>(
+		    samplefiles.at(i), showlines, moduleIndex, imgFactory,
+		    ccFactory, useTrie, maxChains, spill.get()));
+		configure(extraInputs.back()->profiler);
+		others.push_back(&extraInputs.back()->profiler);
+	}
+
+	if (follow) {
+		profiler.FollowSamples(interval, everySamples, [&]() {
+			for (const auto & printer : printers) {
+				printer->resetOutput();
+				profiler.createProfile(*printer);
+			}
+			fflush(stdout);
+		});
+		fastExit();
+	}
+
+	if (readProfile != NULL)
+		profiler.LoadProfile(readProfile);
+	else if (!others.empty())
+		profiler.ReadSamples(others);
+	else
+		profiler.ReadSamples();
+
+	if (writeProfile != NULL) {
+		profiler.SaveProfile(writeProfile);
+
+		/* Don't pay for symbolization if nothing will be printed. */
+		if (!printersRequested)
+			fastExit();
+	}
 
-	profiler.MapSamples();
+	profiler.MapImages();
 	for (const auto & printer : printers)
 		profiler.createProfile(*printer);
 
-	return 0;
+	fastExit();
 }
 
 void
 usage()
 {
 	fprintf(stderr,
-		"usage: pmcprofiler [-lqb] [-f samplefile] [-o flat_output] [-G leaf_output]\n"
+		"usage: pmcprofiler [-lqb] [-f samplefile ...] [-j jobs] [-o flat_output] [-G leaf_output]\n"
 		"[-r root_output] [-d <max depth>] [-t theshold] \n"
+		"[-W profile_output] [-R profile_input]\n"
+		"[--follow [--interval seconds] [--every samples]]\n"
+		"[--from time] [--to time] [--sample-rate n] [--max-samples n]\n"
+		"[--trie | --top-chains n | --spill megabytes]\n"
 		"    l - show line numbers\n"
 		"    q - quit on error\n"
+		"    j - number of threads used to decode each pmclog samplefile\n"
+		"        (perf.data files are decoded serially; not allowed with\n"
+		"        --follow)\n"
 		"    b - exclude \"boring\" call frames in subsequent leaf-up profiles\n"
 		"    o - file to print flat profile information to(- for stdout)\n"
 		"    F - file to print FlameGraph output to(- for stdout)\n"
@@ -192,7 +463,36 @@ usage()
 		"    r - file to print root-down callchain profile to(- for stdout)\n"
 		"    d - maximum depth to go to in subsequent leaf-up callchain profiles\n"
 		"    t - print only entries greater than threshold in subsequent profiles\n"
+		"    W - write the aggregated profile to a file that -R can read\n"
+		"        (nothing else is printed unless asked for)\n"
+		"    R - read an aggregated profile written by -W instead of a samplefile\n"
+		"    follow - keep reading a samplefile that is still being written\n"
+		"             (- for stdin) and print updated profiles as it grows\n"
+		"    interval - print an updated profile every this many seconds\n"
+		"               (default 10)\n"
+		"    every - print an updated profile every this many samples\n"
+		"    from, to - only profile samples taken in this window; a time\n"
+		"               is seconds from the start of the samplefile, or\n"
+		"               @seconds since the epoch\n"
+		"    sample-rate - only process about 1 in n samples and scale the\n"
+		"                  counts to match\n"
+		"    max-samples - pick a sample rate that processes at most about\n"
+		"                  n samples\n"
+		"    trie - share the common root-side frames of callchains in a\n"
+		"           prefix tree, which saves memory on deep stacks\n"
+		"    top-chains - keep only about the n heaviest callchains of each\n"
+		"                 process and count the rest as \"[other]\", which\n"
+		"                 bounds memory when most callchains are unique\n"
+		"    spill - once the callchains of all processes use about this\n"
+		"            many megabytes, write the largest processes' chains to\n"
+		"            temporary files and merge them back as they are printed\n"
 		"    default samplefile is /tmp/samples.out\n"
+		"    -f may be given more than once to merge the profiles of several\n"
+		"    samplefiles, each decoded on its own thread\n"
+		"    samplefile may also be a Linux perf.data file (perf record -g);\n"
+		"    its kernel is looked up as vmlinux in the module path and must\n"
+		"    not have been relocated by KASLR, and modules that perf did not\n"
+		"    record the path of are left unmapped\n"
 		"    default output is flat profile to standard out\n");
 	exit(1);
 }
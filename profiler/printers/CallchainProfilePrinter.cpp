@@ -124,7 +124,11 @@ CallchainProfilePrinter<ProcessStrategy, PrintStrategy>::printProfile(const Prof
 void
 PrintCallchainStrategy::printFileHeader(FILE *outfile, const Profiler &profiler) const
 {
-	fprintf(outfile, "Events processed: %u\n", profiler.getSampleCount());
+	fprintf(outfile, "Events processed: %ju\n",
+	    (uintmax_t)profiler.getSampleCount());
+	if (profiler.getDecimator().getRate() > 1)
+		fprintf(outfile, "Estimated from 1 in %ju samples\n",
+		    (uintmax_t)profiler.getDecimator().getRate());
 }
 
 void
@@ -132,6 +136,7 @@ PrintCallchainStrategy::printProcessHeader(FILE *outfile, const Profiler &profil
 {
 	fprintf(outfile, "\nProcess: %6u, %s, total: %zu (%6.2f%%)\n", agg.getPid(), agg.getExecutable().c_str(),
 		agg.getSampleCount(), (agg.getSampleCount() * 100.0) / profiler.getSampleCount());
+	ProfilePrinter::printOtherChains(outfile, agg);
 }
 
 void
@@ -34,13 +34,153 @@ __FBSDID("$FreeBSD$");
 #include "SampleAggregation.h"
 #include "SharedString.h"
 
+#include <err.h>
 #include <paths.h>
 #include <libgen.h>
+#include <unistd.h>
 
 #include <cassert>
 #include <functional>
+#include <queue>
 #include <unordered_map>
 
+namespace
+{
+/*
+ * Sorts the lines of the flat profile's callchain list, heaviest first,
+ * without holding all of them at once.  Once the lines use more than the
+ * budget, they are sorted and written to a temporary file as a run, and the
+ * runs are merged as the lines are printed.
+ */
+class ChainLineSorter
+{
+	struct Line
+	{
+		uint64_t count;
+		std::string text;
+
+		bool operator<(const Line & other) const
+		{
+			return (count > other.count);
+		}
+	};
+
+	/* A cursor over one run, which is only ever read front to back. */
+	struct Run
+	{
+		FILE *file;
+		Line line;
+
+		bool next()
+		{
+			uint64_t len;
+
+			if (fread(&line.count, sizeof(line.count), 1, file) != 1)
+				return (false);
+			if (fread(&len, sizeof(len), 1, file) != 1)
+				errx(1, "Sorted callchains are corrupt");
+
+			line.text.resize(len);
+			if (fread(line.text.data(), 1, len, file) != len)
+				errx(1, "Sorted callchains are corrupt");
+			return (true);
+		}
+	};
+
+	size_t budget;
+	size_t bytes;
+	std::vector<Line> lines;
+	std::vector<FILE *> runs;
+
+	void writeRun()
+	{
+		FILE *file;
+
+		/* The file is unlinked, so it goes away with the process. */
+		file = tmpfile();
+		if (file == NULL)
+			err(1, "Could not create a file to sort callchains in");
+
+		std::sort(lines.begin(), lines.end());
+		for (const auto & line : lines) {
+			uint64_t len = line.text.size();
+
+			if (fwrite(&line.count, sizeof(line.count), 1, file) != 1 ||
+			    fwrite(&len, sizeof(len), 1, file) != 1 ||
+			    fwrite(line.text.data(), 1, len, file) != len)
+				err(1, "Could not sort callchains");
+		}
+
+		if (fflush(file) != 0)
+			err(1, "Could not sort callchains");
+		rewind(file);
+
+		runs.push_back(file);
+		std::vector<Line>().swap(lines);
+		bytes = 0;
+	}
+
+public:
+	explicit ChainLineSorter(size_t budget)
+	  : budget(budget), bytes(0)
+	{
+	}
+
+	~ChainLineSorter()
+	{
+		for (FILE *file : runs)
+			fclose(file);
+	}
+
+	ChainLineSorter(const ChainLineSorter &) = delete;
+	ChainLineSorter & operator=(const ChainLineSorter &) = delete;
+
+	void add(uint64_t count, std::string text)
+	{
+		bytes += sizeof(Line) + text.size();
+		lines.push_back(Line{count, std::move(text)});
+		if (bytes > budget)
+			writeRun();
+	}
+
+	void forEach(const std::function<void(uint64_t,
+	    const std::string &)> & func)
+	{
+		if (runs.empty()) {
+			std::sort(lines.begin(), lines.end());
+			for (const auto & line : lines)
+				func(line.count, line.text);
+			return;
+		}
+
+		if (!lines.empty())
+			writeRun();
+
+		/* (count, run) */
+		typedef std::pair<uint64_t, size_t> HeapEntry;
+		std::priority_queue<HeapEntry> heap;
+		std::vector<Run> cursors;
+
+		for (FILE *file : runs) {
+			cursors.push_back(Run{file, Line()});
+			if (cursors.back().next())
+				heap.emplace(cursors.back().line.count,
+				    cursors.size() - 1);
+		}
+
+		while (!heap.empty()) {
+			size_t index = heap.top().second;
+			Run & run = cursors[index];
+
+			heap.pop();
+			func(run.line.count, run.line.text);
+			if (run.next())
+				heap.emplace(run.line.count, index);
+		}
+	}
+};
+}
+
 ProfilePrinter::FuncLocKey::FuncLocKey(SharedString file, SharedString func)
 : file(file), func(func)
 {
@@ -71,6 +211,26 @@ ProfilePrinter::printLineNumbers(const Profiler & profiler, const LineLocationLi
 	}
 }
 
+/*
+ * Prepare to print a new profile over a previous one.  A regular output file
+ * is truncated so that it only ever holds the latest profile; anything else
+ * (e.g. stdout) just gets the new profile appended to it.
+ */
+void
+ProfilePrinter::resetOutput()
+{
+	fflush(m_outfile);
+	if (m_outfile == stdout)
+		return;
+
+	/* Not seekable, so there's nothing to overwrite. */
+	if (fseeko(m_outfile, 0, SEEK_SET) != 0)
+		return;
+
+	if (ftruncate(fileno(m_outfile), 0) != 0)
+		warn("Could not truncate profile output");
+}
+
 std::string
 ProfilePrinter::getBasename(const std::string&file)
 {
@@ -99,10 +259,7 @@ void
 ProfilePrinter::getFunctionLocations(const SampleAggregation &agg,
     FunctionLocationList &list, StringChainMap *chainMap)
 {
-	CallchainList callchainList;
-	agg.getCallchainList(callchainList);
-
-	size_t mapSize = 4 * callchainList.size() / 3;
+	size_t mapSize = 4 * agg.getCallchainBound() / 3;
 	FuncLocMap locMap(mapSize);
 
 	if (chainMap != NULL)
@@ -110,19 +267,20 @@ ProfilePrinter::getFunctionLocations(const SampleAggregation &agg,
 
 	Strategy strategy;
 
-	for (auto & chainRec : callchainList) {
+	/* Spilled chains are streamed from disk rather than all read back. */
+	agg.forEachCallchain([&](const Callchain & callchain) {
 		std::vector<const InlineFrame*> frameList;
 
-		auto chain = chainRec.chain;
+		auto chain = &callchain;
 		const InlineFrame & leaf = chain->getLeafFrame();
-		strategy.insertSelfFrame(frameList, *chain, leaf);
+		strategy.insertSelfFrame(frameList, *this, leaf);
 		chain->flatten(frameList);
 
 		auto jt = strategy.begin(frameList);
 		auto jt_end = strategy.end(frameList);
 
 		if (jt == jt_end)
-			continue;
+			return;
 
 		insertFuncLoc(locMap, **jt, *chain);
 
@@ -142,7 +300,7 @@ ProfilePrinter::getFunctionLocations(const SampleAggregation &agg,
 				strChain.push_back(frame);
 			}
 		}
-	}
+	});
 
 	for (auto & pair : locMap) {
 		list.emplace_back(std::move(pair.second));
@@ -154,6 +312,22 @@ ProfilePrinter::getFunctionLocations(const SampleAggregation &agg,
 template void ProfilePrinter::getFunctionLocations<LeafProcessStrategy>(const SampleAggregation &agg, FunctionLocationList &list, StringChainMap *map);
 template void ProfilePrinter::getFunctionLocations<RootProcessStrategy>(const SampleAggregation &agg, FunctionLocationList &list, StringChainMap *map);
 
+const InlineFrame *
+ProfilePrinter::getSelfFrame(const InlineFrame & prototype)
+{
+	auto & selfFrame = selfFrames[&prototype];
+
+	if (!selfFrame) {
+		SharedString self("[self]");
+		selfFrame = std::make_unique<Callframe>(prototype.getOffset(),
+		    prototype.getImageName());
+		selfFrame->addFrame(prototype.getFile(), self, self,
+		    prototype.getCodeLine(), prototype.getFuncLine(), 0);
+	}
+
+	return &selfFrame->getInlineFrames().front();
+}
+
 size_t
 ProfilePrinter::getCallers(const StringChainMap & map, const StringChain & chain,
     FuncLocPtrList & functions)
@@ -189,51 +363,132 @@ ProfilePrinter::SortCallchains(CallchainList & list)
 }
 
 void
-FlatProfilePrinter::printProfile(const Profiler & profiler,
-				 const AggregationList & aggList)
+ProfilePrinter::printOtherChains(FILE *outfile, const SampleAggregation &agg)
 {
-	fprintf(m_outfile, "Events processed: %u\n\n", profiler.getSampleCount());
+	if (agg.getOtherCount() == 0)
+		return;
+
+	fprintf(outfile, "Only the top %zu callchains were kept: %zu samples "
+	    "are in [other], and each callchain may be short by up to %zu\n",
+	    agg.getMaxChains(), agg.getOtherCount(), agg.getErrorBound());
+}
 
+std::string
+FlatProfilePrinter::formatCallchain(const SampleAggregation & agg,
+    const Callchain & chain)
+{
+	const auto & executable = chain.getExecutableName();
+	const auto & frame = chain.getLeafFrame();
+	std::vector<char> buf(256);
+
+	for (;;) {
+		int len = snprintf(buf.data(), buf.size(),
+		    "%s, %6u, %10s, %6zu, 0x%08lx, %s, %s, %s:%u %s 0x%lx",
+		    chain.isKernel() ? "kern" : "user",
+		    agg.getPid(),
+		    getBasename(*executable).c_str(),
+		    chain.getSampleCount(),
+		    chain.getAddress(),
+		    chain.isMapped() ? "mapped  " : "unmapped",
+		    executable->c_str(),
+		    frame.getFile()->c_str(),
+		    frame.getCodeLine(),
+		    frame.getDemangled()->c_str(),
+		    frame.getOffset());
+		if (len < 0)
+			err(1, "Could not format callchain");
+		if (static_cast<size_t>(len) < buf.size())
+			return (std::string(buf.data(), len));
+		buf.resize(len + 1);
+	}
+}
+
+void
+FlatProfilePrinter::printCallchain(const Profiler & profiler, size_t count,
+    size_t cumulative, const std::string & line)
+{
+	fprintf(m_outfile, "%6.2f%% %6.2f%% %s\n",
+	    (count * 100.0) / profiler.getSampleCount(),
+	    (cumulative * 100.0) / profiler.getSampleCount(),
+	    line.c_str());
+}
+
+void
+FlatProfilePrinter::printCallchains(const Profiler & profiler,
+    const AggregationList & aggList)
+{
 	CallchainList callchainList;
 	for (auto agg : aggList)
 		agg->getCallchainList(callchainList);
 
 	SortCallchains(callchainList);
 
-	unsigned cumulative = 0;
+	size_t cumulative = 0;
 	for (const auto & chainRec : callchainList) {
-
 		auto chain = chainRec.chain;
-		const auto & agg = *chainRec.agg;
-		const auto & space = chain->getMapper();
-		const auto & frame = chain->getLeafFrame();
 
 		cumulative += chain->getSampleCount();
-		fprintf(m_outfile, "%6.2f%% %6.2f%% %s, %6u, %10s, %6zu, 0x%08lx, %s, %s, %s:%u %s 0x%lx\n",
-			(chain->getSampleCount() * 100.0) / profiler.getSampleCount(),
-			(cumulative * 100.0) / profiler.getSampleCount(),
-			chain->isKernel() ? "kern" : "user",
-			agg.getPid(),
-			getBasename(*space.getExecutableName()).c_str(),
-			chain->getSampleCount(),
-			chain->getAddress(),
-			chain->isMapped() ? "mapped  " : "unmapped",
-			space.getExecutableName()->c_str(),
-			frame.getFile()->c_str(),
-			frame.getCodeLine(),
-			frame.getDemangled()->c_str(),
-			frame.getOffset());
+		printCallchain(profiler, chain->getSampleCount(), cumulative,
+		    formatCallchain(*chainRec.agg, *chain));
+	}
+}
+
+/*
+ * Spilled chains are streamed from disk, and their lines are sorted in no
+ * more memory than the chains themselves were allowed.
+ */
+void
+FlatProfilePrinter::printSpilledCallchains(const Profiler & profiler,
+    const AggregationList & aggList, size_t budget)
+{
+	ChainLineSorter sorter(budget);
+
+	for (auto agg : aggList) {
+		agg->forEachCallchain([&](const Callchain & chain) {
+			sorter.add(chain.getSampleCount(),
+			    formatCallchain(*agg, chain));
+		});
 	}
 
+	size_t cumulative = 0;
+	sorter.forEach([&](uint64_t count, const std::string & line) {
+		cumulative += count;
+		printCallchain(profiler, count, cumulative, line);
+	});
+}
+
+void
+FlatProfilePrinter::printProfile(const Profiler & profiler,
+				 const AggregationList & aggList)
+{
+	fprintf(m_outfile, "Events processed: %ju\n",
+	    (uintmax_t)profiler.getSampleCount());
+	if (profiler.getDecimator().getRate() > 1)
+		fprintf(m_outfile, "Estimated from 1 in %ju samples\n",
+		    (uintmax_t)profiler.getDecimator().getRate());
+	fprintf(m_outfile, "\n");
+
+	const SpillBudget *spill = nullptr;
+	for (auto agg : aggList) {
+		if (agg->getSpillBudget() != nullptr)
+			spill = agg->getSpillBudget();
+	}
+
+	if (spill != nullptr)
+		printSpilledCallchains(profiler, aggList, spill->getLimit());
+	else
+		printCallchains(profiler, aggList);
+
 	for (auto agg : aggList) {
 		fprintf(m_outfile, "\nProcess: %6u, %s, total: %zu (%6.2f%%)\n", agg->getPid(),
 		    agg->getExecutable().c_str(), agg->getSampleCount(),
 		    (agg->getSampleCount() * 100.0) / profiler.getSampleCount());
+		printOtherChains(m_outfile, *agg);
 
 		     FunctionLocationList functionList;
 		     getFunctionLocations<LeafProcessStrategy>(*agg, functionList);
 
-		     unsigned cumulativeCount = 0;
+		     size_t cumulativeCount = 0;
 		     fprintf(m_outfile, "       time   time-t   samples   env  file / library, line number, function\n");
 		     for (const auto & functionLocation : functionList) {
 			    cumulativeCount += functionLocation.getCount();
@@ -272,7 +527,7 @@ RootProcessStrategy::end(std::vector<const InlineFrame*> & vec) const
 
 void
 RootProcessStrategy::insertSelfFrame(std::vector<const InlineFrame*> & frameList,
-    Callchain &chain, const InlineFrame & prototype) const
+    ProfilePrinter &printer, const InlineFrame & prototype) const
 {
-	frameList.insert(frameList.begin(), chain.getSelfFrame(prototype));
+	frameList.insert(frameList.begin(), printer.getSelfFrame(prototype));
 }
@@ -23,6 +23,9 @@
 
 #include "ProfilePrinter.h"
 
+#include "Callframe.h"
+#include "InlineFrame.h"
+
 #include <gtest/gtest.h>
 
 #include <memory>
@@ -73,3 +76,32 @@ TEST(FuncLocKeyTestSuite, TestHash)
 
 	EXPECT_NE(hash(key1), hash(key4));
 }
+
+TEST(ProfilePrinterTestSuite, TestGetSelfFrame)
+{
+	SharedString imageName("a.out");
+	TargetAddr off = 0xbad;
+	Callframe cf(off, imageName);
+
+	SharedString file("main.cpp");
+	SharedString func("DoFoobar");
+	int codeLine = 101;
+	int funcLine = 94;
+	cf.addFrame(file, func, func, codeLine, funcLine, 0x2896);
+
+	FlatProfilePrinter printer(stdout);
+	const InlineFrame & frame = cf.getInlineFrames().front();
+
+	const InlineFrame * self = printer.getSelfFrame(frame);
+	ASSERT_TRUE(self);
+	EXPECT_EQ(self->getFile(), file);
+	EXPECT_EQ(self->getFunc(), "[self]");
+	EXPECT_EQ(self->getDemangled(), "[self]");
+	EXPECT_EQ(self->getCodeLine(), codeLine);
+	EXPECT_EQ(self->getFuncLine(), funcLine);
+	EXPECT_EQ(self->getOffset(), off);
+	EXPECT_EQ(self->getImageName(), imageName);
+
+	// Every chain with this leaf shares one self frame.
+	EXPECT_EQ(self, printer.getSelfFrame(frame));
+}
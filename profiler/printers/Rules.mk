@@ -12,8 +12,8 @@ TEST_PROFILEPRINTER_SRCS := \
 	ProfilePrinter \
 
 TEST_PROFILEPRINTER_LIBS := \
-	sharedptr \
 	frame \
 	samples \
+	sharedptr \
 
 
@@ -27,36 +27,76 @@
 #include "Callframe.h"
 #include "Image.h"
 #include "ImageFactory.h"
-#include "MapUtil.h"
+#include "ModulePathIndex.h"
 #include "ProcessState.h"
+#include "Sample.h"
 
 #include <elf.h>
 #include <gelf.h>
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <limits>
+
 AddressSpace::AddressSpace(ImageFactory &imgFactory)
-  : imgFactory(imgFactory), executable(NULL)
+  : imgFactory(imgFactory),
+    loadableImageMap(SharedPtr<LoadableImageMap>::make()),
+    executable(NULL),
+    pendingExec(NULL),
+    epochBase(0)
 {
 }
 
-TargetAddr
-AddressSpace::getLoadAddr(const std::string &executable)
+/*
+ * A forked child starts out with the parent's mappings.  Prefork servers
+ * can have thousands of children, so the table is shared rather than copied
+ * until one of the processes changes it.
+ */
+void
+AddressSpace::forkFrom(const AddressSpace &parent)
+{
+	loadableImageMap = parent.loadableImageMap;
+	executable = parent.executable;
+	pendingExec = parent.pendingExec;
+
+	/* The child's chains are all mapped after the fork. */
+	epochBase = parent.getEpoch();
+	unmapped.clear();
+}
+
+AddressSpace::LoadableImageMap &
+AddressSpace::writableImageMap()
+{
+	if (!loadableImageMap.unique())
+		loadableImageMap = SharedPtr<LoadableImageMap>::make(
+		    *loadableImageMap);
+
+	return (*loadableImageMap);
+}
+
+/*
+ * Images are shared by every address space that maps them, so the headers
+ * of a library are only read once however many processes load it.
+ */
+void
+AddressSpace::readLoadInfo(Image &image)
 {
+	Image::LoadInfo info = {0, false};
 	Elf *elf = NULL;
-	TargetAddr addr;
+	GElf_Ehdr ehdr;
 	int fd, error;
 
-	addr = 0;
-
-	fd = open(executable.c_str(), O_RDONLY);
+	fd = open(image.GetImageFile()->c_str(), O_RDONLY);
 	if (fd < 0)
-		return (0);
+		goto done;
 
 	elf = elf_begin(fd, ELF_C_READ, NULL);
 	if (elf == NULL)
 		goto cleanup;
 
+	if (gelf_getehdr(elf, &ehdr) != NULL)
+		info.pie = (ehdr.e_type == ET_DYN);
+
 	size_t phnum;
 	error = elf_getphdrnum(elf, &phnum);
 	if (error != 0)
@@ -76,39 +116,98 @@ AddressSpace::getLoadAddr(const std::string &executable)
 		if ((phdr.p_flags & PF_X) == 0)
 			continue;
 
-		/*
-		 * XXX detect PIE and work out the load address
-		 * the load address should be computable by looking at
-		 * the entry point in the ELF header and comparing that
-		 * to the actual entry point given to hwpmc
-		 */
-		addr = phdr.p_vaddr & (-phdr.p_align);
+		info.loadAddr = phdr.p_vaddr & (-phdr.p_align);
 		goto cleanup;
 	}
 
 cleanup:
 	elf_end(elf);
-	return (addr);
+	close(fd);
+done:
+	image.SetLoadInfo(info);
+}
+
+TargetAddr
+AddressSpace::getLoadAddr(Image &image)
+{
+	if (image.GetLoadInfo() == nullptr)
+		readLoadInfo(image);
+
+	return (image.GetLoadInfo()->loadAddr);
+}
+
+bool
+AddressSpace::isPie(Image &image)
+{
+	if (image.GetLoadInfo() == nullptr)
+		readLoadInfo(image);
+
+	return (image.GetLoadInfo()->pie);
 }
 
 void
 AddressSpace::processExec(const ProcessExec& ev)
 {
-	TargetAddr loadAddr = getLoadAddr(ev.getProcessName());
-	mapIn(loadAddr, ev.getProcessName().c_str());
+	Image *image = imgFactory.GetImage(ev.getProcessName());
+
+	/*
+	 * XXX a PIE executable is placed at its link address, as we aren't
+	 * told where it was really loaded.  Reading that is left until the
+	 * process is sampled.
+	 */
+	executable = image;
+	pendingExec = image;
+}
+
+/*
+ * Only a process that hasn't been sampled since it was forked copies a
+ * shared table here.
+ */
+void
+AddressSpace::mapPendingExec()
+{
+	TargetAddr start = getLoadAddr(*pendingExec);
+
+	LOG("%p: Loaded %s at offset %lx", this,
+	    pendingExec->GetImageFile()->c_str(), start);
+	writableImageMap().insert(start,
+	    LoadedImage(pendingExec, start, true));
+	pendingExec = NULL;
 }
 
 Image &
-AddressSpace::getImage(TargetAddr addr, TargetAddr & loadOffset) const
+AddressSpace::getImage(TargetAddr addr, TargetAddr & loadOffset)
 {
-	auto it = LastSmallerThan(loadableImageMap, addr);
-	if (it == loadableImageMap.end()) {
+	if (pendingExec != NULL)
+		mapPendingExec();
+
+	/*
+	 * This doesn't copy a shared table.  Resolving the load offset gives
+	 * the same answer in every process sharing it.
+	 */
+	LoadedImage *found = loadableImageMap->find(addr);
+	if (found == NULL) {
 		loadOffset = 0;
 		return imgFactory.GetUnmappedImage();
 	}
 
-	loadOffset = it->second.loadOffset;
-	return *it->second.image;
+	LoadedImage & loaded = *found;
+	if (!loaded.resolved) {
+		/*
+		 * Symbols in a fixed-address executable are looked up by
+		 * their address.  Anything else is looked up relative to
+		 * where it was linked.
+		 */
+		if (loaded.isExecutable && !isPie(*loaded.image))
+			loaded.loadOffset = 0;
+		else
+			loaded.loadOffset = loaded.start -
+			    getLoadAddr(*loaded.image);
+		loaded.resolved = true;
+	}
+
+	loadOffset = loaded.loadOffset;
+	return *loaded.image;
 }
 
 void
@@ -121,51 +220,92 @@ AddressSpace::mapIn(TargetAddr start, SharedString imagePath)
 void
 AddressSpace::mapImage(TargetAddr start, Image* image)
 {
-	TargetAddr loadOffset;
+	bool isExecutable;
 
 	/*
 	 * The first image that we need in every address space
 	 * should be the executable.  They are mapped differently
-	 * from libraries/modules and we have to use an offset of
-	 * 0 to find symbols in the executable.
+	 * from libraries/modules; see getImage().
 	 */
-	if (loadableImageMap.empty()) {
-		loadOffset = 0;
+	isExecutable = loadableImageMap->empty() && pendingExec == NULL;
+	if (isExecutable)
 		executable = image;
-	} else {
-		loadOffset = start - getLoadAddr(*image->GetImageFile());
-	}
 
 	LOG("%p: Loaded %s at offset %lx", this, image->GetImageFile()->c_str(), start);
-	loadableImageMap.insert(std::make_pair(start,
-	    LoadedImage(image, loadOffset)));
+	writableImageMap().insert(start,
+	    LoadedImage(image, start, isExecutable));
 }
 
+/*
+ * Unmap every image that was mapped in at an address in [start, end).
+ * Callchains that were already mapped keep their frames.  The addresses that
+ * mapped to those images are remembered, so that the aggregations can tell
+ * with isStale() whether a chain has to be mapped again, in case its
+ * addresses now belong to something else (e.g. a plugin that was dlclose()d
+ * and a different one loaded in its place).
+ */
 void
-AddressSpace::findAndMap(TargetAddr start, const std::vector<std::string> path,
-    SharedString name)
+AddressSpace::mapOut(TargetAddr start, TargetAddr end)
+{
+	if (loadableImageMap->countRange(start, end) == 0)
+		return;
+
+	/*
+	 * The last image mapped out covered everything up to the next image
+	 * that is left.
+	 */
+	const TargetAddr *first = loadableImageMap->ceiling(start);
+	const TargetAddr *next = loadableImageMap->ceiling(end);
+	unmapped.push_back(UnmappedRange{*first,
+	    next != NULL ? *next : std::numeric_limits<TargetAddr>::max()});
+
+	LOG("%p: Unmapped %lx-%lx", this, start, end);
+	writableImageMap().eraseRange(start, end);
+}
+
+bool
+AddressSpace::isStale(const Sample & sample, uint64_t epoch) const
 {
-	for (const auto & pathComp : path) {
-		std::string path(pathComp);
-		path += '/';
-		path += *name;
+	/* The ranges mapped out before a fork aren't kept. */
+	if (epoch < epochBase)
+		return (true);
 
-		int fd = open(path.c_str(), O_RDONLY);
-		if (fd >= 0) {
-			close(fd);
-			mapIn(start, path.c_str());
-			return;
+	for (size_t i = epoch - epochBase; i < unmapped.size(); ++i) {
+		const UnmappedRange & range = unmapped[i];
+
+		for (int j = 0; j < sample.getChainDepth(); ++j) {
+			TargetAddr addr = sample.getAddress(j);
+			if (addr >= range.start && addr < range.end)
+				return (true);
 		}
 	}
 
-	fprintf(stderr, "%s: unable to find file %s\n",
-		g_quitOnError ? "error" : "warning", name->c_str());
-	if (g_quitOnError)
-		exit(5);
-
-	mapImage(start, &imgFactory.GetUnmappedImage());
+	return (false);
 }
 
+/*
+ * Map in a kernel module, given the name of its file, or the full path to it.
+ * A module that isn't in the module path is mapped to the unmapped image; the
+ * index reports it later along with any others that were missing.
+ */
+void
+AddressSpace::findAndMap(TargetAddr start, ModulePathIndex & modules,
+    SharedString name)
+{
+	if (name->c_str()[0] == '/') {
+		mapIn(start, name);
+		return;
+	}
+
+	const SharedString *path = modules.Find(*name);
+
+	if (path == NULL) {
+		mapImage(start, &imgFactory.GetUnmappedImage());
+		return;
+	}
+
+	mapIn(start, *path);
+}
 
 const Callframe &
 AddressSpace::mapFrame(TargetAddr addr)
@@ -28,10 +28,13 @@
 #include "mock/MockImageFactory.h"
 #include "mock/MockLibelf.h"
 #include "mock/MockOpen.h"
+#include "mock/ModuleDirBuilder.h"
 
 #include "Callframe.h"
+#include "ModulePathIndex.h"
 #include "ProcessState.h"
 #include "ProfilerTypes.h"
+#include "Sample.h"
 
 #include "TestPrinter/SharedString.h"
 
@@ -94,8 +97,10 @@ TEST_F(AddressSpaceTestSuite, TestSingleMapIn)
 	MockImageFactory factory;
 	CallframeList frameList;
 	GlobalMockImage mockImage;
+	GlobalMockOpen mockOpen;
 
 	auto * exeImg = factory.ExpectGetImage(executable);
+	mockOpen.ExpectOpen("/bin/init", O_RDONLY, -1);
 	mockImage.ExpectGetFrame(exeImg, 0x5000, frameList);
 
 	AddressSpace space(factory);
@@ -122,6 +127,7 @@ TEST_F(AddressSpaceTestSuite, TestMultiMapIn)
 
 	CallframeList frameList;
 	GlobalMockImage mockImage;
+	GlobalMockOpen mockOpen;
 
 	{
 		InSequence dummy;
@@ -129,8 +135,13 @@ TEST_F(AddressSpaceTestSuite, TestMultiMapIn)
 		auto * lib1Img = factory.ExpectGetImage(lib1Name);
 		auto * lib2Img = factory.ExpectGetImage(lib2Name);
 
+		// The ELF headers of each image are only read once a frame
+		// is mapped out of it.
+		mockOpen.ExpectOpen("/bin/dd", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(exeImg, 0x1040, frameList);
+		mockOpen.ExpectOpen("/lib/libthr.so.3", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib2Img, 0x1955, frameList);
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib1Img, 0x293, frameList);
 
 		// Mapping from lib3's load offset before it is loaded should
@@ -139,6 +150,7 @@ TEST_F(AddressSpaceTestSuite, TestMultiMapIn)
 
 		auto * lib3Img = factory.ExpectGetImage(lib3Name);
 
+		mockOpen.ExpectOpen("/usr/lib/libcam.so.5", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib3Img, 0xab, frameList);
 
 		// Test mapping frames from the boundaries between images
@@ -189,9 +201,10 @@ TEST_F(AddressSpaceTestSuite, TestFindAndMapEmptyPath)
 	MockImageFactory factory;
 	SharedString kernelName("/boot/kernel/kernel");
 	SharedString kldName("hwpmc.ko");
-	std::vector<std::string> modulePath;
+	ModulePathIndex modules;
 	CallframeList frameList;
 	GlobalMockImage mockImage;
+	GlobalMockOpen mockOpen;
 	GlobalMock<MockSyscalls> mockSyscalls;
 
 	const TargetAddr kldAddr = 0x1942;
@@ -199,11 +212,13 @@ TEST_F(AddressSpaceTestSuite, TestFindAndMapEmptyPath)
 	{
 		InSequence dummy;
 		auto * kernImg = factory.ExpectGetImage(kernelName);
+		auto * unmapImg = factory.ExpectGetUnmappedImage();
+
 		EXPECT_CALL(*mockSyscalls, fprintf(stderr))
 		    .Times(1)
 		    .WillOnce(Return(0));
 
-		auto * unmapImg = factory.ExpectGetUnmappedImage();
+		mockOpen.ExpectOpen("/boot/kernel/kernel", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(kernImg, 0x100, frameList);
 		mockImage.ExpectGetFrame(unmapImg, 0, frameList);
 		mockImage.ExpectGetFrame(unmapImg, 0x200, frameList);
@@ -211,7 +226,8 @@ TEST_F(AddressSpaceTestSuite, TestFindAndMapEmptyPath)
 
 	AddressSpace space(factory);
 	space.mapIn(0, kernelName);
-	space.findAndMap(kldAddr, modulePath, kldName);
+	space.findAndMap(kldAddr, modules, kldName);
+	modules.ReportMissing();
 
 	EXPECT_EQ(&space.mapFrame(0x100), frameList.at(0).get());
 	EXPECT_EQ(&space.mapFrame(kldAddr), frameList.at(1).get());
@@ -225,7 +241,22 @@ TEST_F(AddressSpaceTestSuite, TestFindAndMap)
 	SharedString kldName2("if_em.ko");
 	SharedString kldName3("vendor_module.ko");
 	SharedString kldName4("unknown_module.ko");
-	std::vector<std::string> modulePath({"/boot/STOCK", "/boot/modules", "/boot/kernel"});
+	SharedString kldName5("other_module.ko");
+
+	ModuleDirBuilder dirs;
+	dirs.AddDir("STOCK");
+	dirs.AddDir("modules");
+	dirs.AddDir("kernel");
+	SharedString kernelPath(dirs.AddFile("STOCK", "kernel"));
+	SharedString kldPath1(dirs.AddFile("STOCK", "dtrace.ko"));
+	SharedString kldPath2(dirs.AddFile("kernel", "if_em.ko"));
+	SharedString kldPath3(dirs.AddFile("modules", "vendor_module.ko"));
+	dirs.AddFile("kernel", "kernel");
+	dirs.AddFile("kernel", "dtrace.ko");
+
+	ModulePathIndex modules;
+	modules.SetPath({dirs.Dir("STOCK"), dirs.Dir("modules"),
+	    dirs.Dir("kernel")});
 
 	MockImageFactory factory;
 	GlobalMockImage mockImage;
@@ -238,56 +269,51 @@ TEST_F(AddressSpaceTestSuite, TestFindAndMap)
 	const TargetAddr kldAddr2 = 0x3951;
 	const TargetAddr kldAddr3 = 0x9871;
 	const TargetAddr kldAddr4 = 0x4025;
+	const TargetAddr kldAddr5 = 0x5000;
+	const TargetAddr kldAddr6 = 0xf900000;
 
 	{
 		InSequence dummy;
 
-		int fd = 4587;
-		mockOpen.ExpectOpen("/boot/STOCK/kernel", O_RDONLY, fd);
-		mockOpen.ExpectClose(fd);
-		auto * kernImg = factory.ExpectGetImage("/boot/STOCK/kernel");
-
-		fd = 85;
-		mockOpen.ExpectOpen("/boot/STOCK/dtrace.ko", O_RDONLY, fd);
-		mockOpen.ExpectClose(fd);
-		auto * kldImg1 = factory.ExpectGetImage("/boot/STOCK/dtrace.ko");
-
-		fd = 0;
-		mockOpen.ExpectOpen("/boot/STOCK/if_em.ko", O_RDONLY, -1);
-		mockOpen.ExpectOpen("/boot/modules/if_em.ko", O_RDONLY, -1);
-		mockOpen.ExpectOpen("/boot/kernel/if_em.ko", O_RDONLY, fd);
-		mockOpen.ExpectClose(fd);
-		auto * kldImg2 = factory.ExpectGetImage("/boot/kernel/if_em.ko");
-
-		fd = INT_MAX;
-		mockOpen.ExpectOpen("/boot/STOCK/vendor_module.ko", O_RDONLY, -1);
-		mockOpen.ExpectOpen("/boot/modules/vendor_module.ko", O_RDONLY, fd);
-		mockOpen.ExpectClose(fd);
-		auto * kldImg3 = factory.ExpectGetImage("/boot/modules/vendor_module.ko");
+		// The modules are looked up in the index without opening them.
+		auto * kernImg = factory.ExpectGetImage(kernelPath);
+		auto * kldImg1 = factory.ExpectGetImage(kldPath1);
+		auto * kldImg2 = factory.ExpectGetImage(kldPath2);
+		auto * kldImg3 = factory.ExpectGetImage(kldPath3);
 
+		mockOpen.ExpectOpen(*kldPath1, O_RDONLY, -1);
 		mockImage.ExpectGetFrame(kldImg1, 0x10, frameList);
+		mockOpen.ExpectOpen(*kernelPath, O_RDONLY, -1);
 		mockImage.ExpectGetFrame(kernImg, 0x30030, frameList);
+		mockOpen.ExpectOpen(*kldPath3, O_RDONLY, -1);
 		mockImage.ExpectGetFrame(kldImg3, 0x100, frameList);
 		mockImage.ExpectGetFrame(kldImg1, 0x587, frameList);
+		mockOpen.ExpectOpen(*kldPath2, O_RDONLY, -1);
 		mockImage.ExpectGetFrame(kldImg2, 0, frameList);
 
-		mockOpen.ExpectOpen("/boot/STOCK/unknown_module.ko", O_RDONLY, -1);
-		mockOpen.ExpectOpen("/boot/modules/unknown_module.ko", O_RDONLY, -1);
-		mockOpen.ExpectOpen("/boot/kernel/unknown_module.ko", O_RDONLY, -1);
+		auto * unmapImg = factory.ExpectGetUnmappedImage();
+		factory.ExpectGetUnmappedImage();
+		factory.ExpectGetUnmappedImage();
+
+		// Both missing modules are reported together, and only once.
 		EXPECT_CALL(*mockSyscalls, fprintf(stderr))
 		    .Times(1)
 		    .WillOnce(Return(0));
-		auto * unmapImg = factory.ExpectGetUnmappedImage();
 
 		mockImage.ExpectGetFrame(kldImg3, 0x56, frameList);
 		mockImage.ExpectGetFrame(unmapImg, 0x87, frameList);
+
+		// A module given by its full path isn't looked up.
+		auto * kldImg6 = factory.ExpectGetImage("/opt/drivers/vendor.ko");
+		mockOpen.ExpectOpen("/opt/drivers/vendor.ko", O_RDONLY, -1);
+		mockImage.ExpectGetFrame(kldImg6, 0x18, frameList);
 	}
 
 	AddressSpace space(factory);
-	space.findAndMap(0x30030, modulePath, kernelName);
-	space.findAndMap(kldAddr1, modulePath, kldName1);
-	space.findAndMap(kldAddr2, modulePath, kldName2);
-	space.findAndMap(kldAddr3, modulePath, kldName3);
+	space.findAndMap(0x30030, modules, kernelName);
+	space.findAndMap(kldAddr1, modules, kldName1);
+	space.findAndMap(kldAddr2, modules, kldName2);
+	space.findAndMap(kldAddr3, modules, kldName3);
 
 	EXPECT_EQ(&space.mapFrame(kldAddr1 + 0x10), frameList.at(0).get());
 	EXPECT_EQ(&space.mapFrame(0x30030), frameList.at(1).get());
@@ -295,10 +321,17 @@ TEST_F(AddressSpaceTestSuite, TestFindAndMap)
 	EXPECT_EQ(&space.mapFrame(kldAddr1 + 0x587), frameList.at(3).get());
 	EXPECT_EQ(&space.mapFrame(kldAddr2), frameList.at(4).get());
 
-	space.findAndMap(kldAddr4, modulePath, kldName4);
+	space.findAndMap(kldAddr4, modules, kldName4);
+	space.findAndMap(kldAddr5, modules, kldName5);
+	space.findAndMap(kldAddr4, modules, kldName4);
+	modules.ReportMissing();
+	modules.ReportMissing();
 
 	EXPECT_EQ(&space.mapFrame(kldAddr3 + 0x56), frameList.at(5).get());
 	EXPECT_EQ(&space.mapFrame(kldAddr4 + 0x87), frameList.at(6).get());
+
+	space.findAndMap(kldAddr6, modules, "/opt/drivers/vendor.ko");
+	EXPECT_EQ(&space.mapFrame(kldAddr6 + 0x18), frameList.at(7).get());
 }
 
 TEST_F(AddressSpaceTestSuite, TestProcessExecFileNotFound)
@@ -310,11 +343,12 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecFileNotFound)
 	GlobalMockOpen mockOpen;
 	const TargetAddr libLoadAddr = 0x70000;
 
-	mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, -1);
 	auto * img = factory.ExpectGetImage("/usr/bin/top");
+	mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, -1);
 	auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 	mockImage.ExpectGetFrame(img, libLoadAddr - 1, frameList);
 	mockImage.ExpectGetFrame(img, 0, frameList);
+	mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 	mockImage.ExpectGetFrame(lib, 0, frameList);
 
 	AddressSpace space(factory);
@@ -339,17 +373,19 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecElfBeginFailed)
 		InSequence seq;
 
 		const int fd = 128;
+		auto * img = factory.ExpectGetImage("/usr/bin/top");
+		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, 128);
 		EXPECT_CALL(*libelf, elf_begin(fd, ELF_C_READ, nullptr))
 		  .Times(1)
 		  .WillOnce(Return(nullptr));
 		EXPECT_CALL(*libelf, elf_end(nullptr))
 		  .Times(1);
+		mockOpen.ExpectClose(fd);
 
-		auto * img = factory.ExpectGetImage("/usr/bin/top");
-		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockImage.ExpectGetFrame(img, libLoadAddr - 1, frameList);
 		mockImage.ExpectGetFrame(img, 0, frameList);
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib, 0, frameList);
 	}
 
@@ -380,20 +416,25 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecGetPhdrnumFailed)
 	{
 		InSequence seq;
 		const int fd = 128;
+		auto * img = factory.ExpectGetImage("/usr/bin/top");
+		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, 128);
 		EXPECT_CALL(*libelf, elf_begin(fd, ELF_C_READ, nullptr))
 		  .Times(1)
 		  .WillOnce(Return(elf));
+		EXPECT_CALL(*libelf, gelf_getehdr(elf, _))
+		  .Times(1)
+		  .WillOnce(Return(nullptr));
 		EXPECT_CALL(*libelf, elf_getphdrnum(elf, _))
 		  .Times(1)
 		  .WillOnce(Return(EINVAL));
 		EXPECT_CALL(*libelf, elf_end(elf))
 		  .Times(1);
+		mockOpen.ExpectClose(fd);
 
-		auto * img = factory.ExpectGetImage("/usr/bin/top");
-		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockImage.ExpectGetFrame(img, libLoadAddr - 1, frameList);
 		mockImage.ExpectGetFrame(img, 0, frameList);
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib, 0, frameList);
 	}
 
@@ -424,20 +465,25 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecZeroPhdrs)
 	{
 		InSequence seq;
 		const int fd = 128;
+		auto * img = factory.ExpectGetImage("/usr/bin/top");
+		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, 128);
 		EXPECT_CALL(*libelf, elf_begin(fd, ELF_C_READ, nullptr))
 		  .Times(1)
 		  .WillOnce(Return(elf));
+		EXPECT_CALL(*libelf, gelf_getehdr(elf, _))
+		  .Times(1)
+		  .WillOnce(Return(nullptr));
 		EXPECT_CALL(*libelf, elf_getphdrnum(elf, _))
 		  .Times(1)
 		  .WillOnce(DoAll(SetArgPointee<1>(size_t(0)), Return(0)));
 		EXPECT_CALL(*libelf, elf_end(elf))
 		  .Times(1);
+		mockOpen.ExpectClose(fd);
 
-		auto * img = factory.ExpectGetImage("/usr/bin/top");
-		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockImage.ExpectGetFrame(img, libLoadAddr - 1, frameList);
 		mockImage.ExpectGetFrame(img, 0, frameList);
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib, 0, frameList);
 	}
 
@@ -468,10 +514,15 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecGetPhdrFailed)
 	{
 		InSequence seq;
 		const int fd = 128;
+		auto * img = factory.ExpectGetImage("/usr/bin/top");
+		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, 128);
 		EXPECT_CALL(*libelf, elf_begin(fd, ELF_C_READ, nullptr))
 		  .Times(1)
 		  .WillOnce(Return(elf));
+		EXPECT_CALL(*libelf, gelf_getehdr(elf, _))
+		  .Times(1)
+		  .WillOnce(Return(nullptr));
 		EXPECT_CALL(*libelf, elf_getphdrnum(elf, _))
 		  .Times(1)
 		  .WillOnce(DoAll(SetArgPointee<1>(size_t(3)), Return(0)));
@@ -480,11 +531,11 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecGetPhdrFailed)
 		  .WillOnce(Return(nullptr));
 		EXPECT_CALL(*libelf, elf_end(elf))
 		  .Times(1);
+		mockOpen.ExpectClose(fd);
 
-		auto * img = factory.ExpectGetImage("/usr/bin/top");
-		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockImage.ExpectGetFrame(img, libLoadAddr - 1, frameList);
 		mockImage.ExpectGetFrame(img, 0, frameList);
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib, 0, frameList);
 	}
 
@@ -514,10 +565,15 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecNoTextHdr)
 	{
 		InSequence seq;
 		const int fd = 128;
+		auto * img = factory.ExpectGetImage("/usr/bin/top");
+		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, 128);
 		EXPECT_CALL(*libelf, elf_begin(fd, ELF_C_READ, nullptr))
 		  .Times(1)
 		  .WillOnce(Return(elf));
+		EXPECT_CALL(*libelf, gelf_getehdr(elf, _))
+		  .Times(1)
+		  .WillOnce(Return(nullptr));
 		EXPECT_CALL(*libelf, elf_getphdrnum(elf, _))
 		  .Times(1)
 		  .WillOnce(DoAll(SetArgPointee<1>(size_t(4)), Return(0)));
@@ -567,11 +623,11 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecNoTextHdr)
 
 		EXPECT_CALL(*libelf, elf_end(elf))
 		  .Times(1);
+		mockOpen.ExpectClose(fd);
 
-		auto * img = factory.ExpectGetImage("/usr/bin/top");
-		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockImage.ExpectGetFrame(img, libLoadAddr - 1, frameList);
 		mockImage.ExpectGetFrame(img, 0, frameList);
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib, 0, frameList);
 	}
 
@@ -601,10 +657,15 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecTextHdrPresent)
 	{
 		InSequence seq;
 		const int fd = 128;
+		auto * img = factory.ExpectGetImage("/usr/bin/top");
+		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockOpen.ExpectOpen("/usr/bin/top", O_RDONLY, 128);
 		EXPECT_CALL(*libelf, elf_begin(fd, ELF_C_READ, nullptr))
 		  .Times(1)
 		  .WillOnce(Return(elf));
+		EXPECT_CALL(*libelf, gelf_getehdr(elf, _))
+		  .Times(1)
+		  .WillOnce(Return(nullptr));
 		EXPECT_CALL(*libelf, elf_getphdrnum(elf, _))
 		  .Times(1)
 		  .WillOnce(DoAll(SetArgPointee<1>(size_t(4)), Return(0)));
@@ -625,6 +686,7 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecTextHdrPresent)
 			.p_flags = PF_R | PF_X,
 			.p_vaddr = exeLoadAddr,
 			.p_memsz = 0x1000,
+			.p_align = 0x1000,
 		};
 		EXPECT_CALL(*libelf, gelf_getphdr(elf, 1, _))
 		  .Times(1)
@@ -632,9 +694,8 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecTextHdrPresent)
 
 		EXPECT_CALL(*libelf, elf_end(elf))
 		  .Times(1);
+		mockOpen.ExpectClose(fd);
 
-		auto * img = factory.ExpectGetImage("/usr/bin/top");
-		auto * lib = factory.ExpectGetImage("/lib/libc.so.7");
 		mockImage.ExpectGetFrame(img, libLoadAddr - 1, frameList);
 		mockImage.ExpectGetFrame(img, exeLoadAddr, frameList);
 
@@ -644,6 +705,7 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecTextHdrPresent)
 		unmapped = factory.ExpectGetUnmappedImage();
 		mockImage.ExpectGetFrame(unmapped, exeLoadAddr - 1, frameList);
 
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
 		mockImage.ExpectGetFrame(lib, 0, frameList);
 	}
 
@@ -656,3 +718,194 @@ TEST_F(AddressSpaceTestSuite, TestProcessExecTextHdrPresent)
 	EXPECT_EQ(&space.mapFrame(exeLoadAddr - 1), frameList.at(3).get());
 	EXPECT_EQ(&space.mapFrame(libLoadAddr), frameList.at(4).get());
 }
+
+TEST_F(AddressSpaceTestSuite, TestPieLoadInfoShared)
+{
+	SharedString exeName("/usr/bin/pie");
+	MockImageFactory factory;
+	CallframeList frameList;
+	GlobalMockImage mockImage;
+	GlobalMock<MockLibelf> libelf;
+	GlobalMockOpen mockOpen;
+	const TargetAddr linkAddr = 0x1000;
+	const TargetAddr load1 = 0x200000;
+	const TargetAddr load2 = 0x7f0000000;
+
+	Elf * elf = reinterpret_cast<Elf*>(&libelf);
+
+	{
+		InSequence seq;
+		const int fd = 12;
+
+		auto * img = factory.ExpectGetImage(exeName);
+		EXPECT_CALL(factory, GetImage(exeName))
+		  .Times(1)
+		  .WillOnce(Return(img));
+
+		// Both address spaces share the Image, so its headers are
+		// only read the first time that a frame is mapped from it.
+		mockOpen.ExpectOpen("/usr/bin/pie", O_RDONLY, fd);
+		EXPECT_CALL(*libelf, elf_begin(fd, ELF_C_READ, nullptr))
+		  .Times(1)
+		  .WillOnce(Return(elf));
+
+		GElf_Ehdr ehdr = {};
+		ehdr.e_type = ET_DYN;
+		EXPECT_CALL(*libelf, gelf_getehdr(elf, _))
+		  .Times(1)
+		  .WillOnce(DoAll(SetArgPointee<1>(ehdr), ReturnArg<1>()));
+		EXPECT_CALL(*libelf, elf_getphdrnum(elf, _))
+		  .Times(1)
+		  .WillOnce(DoAll(SetArgPointee<1>(size_t(1)), Return(0)));
+
+		GElf_Phdr phdr = {
+			.p_type = PT_LOAD,
+			.p_flags = PF_R | PF_X,
+			.p_vaddr = linkAddr,
+			.p_memsz = 0x1000,
+			.p_align = 0x1000,
+		};
+		EXPECT_CALL(*libelf, gelf_getphdr(elf, 0, _))
+		  .Times(1)
+		  .WillOnce(DoAll(SetArgPointee<2>(phdr), ReturnArg<2>()));
+		EXPECT_CALL(*libelf, elf_end(elf))
+		  .Times(1);
+		mockOpen.ExpectClose(fd);
+
+		mockImage.ExpectGetFrame(img, linkAddr + 0x40, frameList);
+		mockImage.ExpectGetFrame(img, linkAddr + 0x80, frameList);
+	}
+
+	AddressSpace space1(factory);
+	AddressSpace space2(factory);
+	space1.mapIn(load1, exeName);
+	space2.mapIn(load2, exeName);
+
+	EXPECT_EQ(&space1.mapFrame(load1 + 0x40), frameList.at(0).get());
+	EXPECT_EQ(&space2.mapFrame(load2 + 0x80), frameList.at(1).get());
+}
+
+TEST_F(AddressSpaceTestSuite, TestFork)
+{
+	SharedString exeName("/bin/sh");
+	SharedString libcName("/lib/libc.so.7");
+	SharedString libthrName("/lib/libthr.so.3");
+	MockImageFactory factory;
+	CallframeList frameList;
+	GlobalMockImage mockImage;
+	GlobalMockOpen mockOpen;
+	const TargetAddr exeLoad = 0x1000;
+	const TargetAddr libcLoad = 0x100000;
+	const TargetAddr libthrLoad = 0x200000;
+
+	{
+		InSequence seq;
+
+		auto * exeImg = factory.ExpectGetImage(exeName);
+		auto * libcImg = factory.ExpectGetImage(libcName);
+		auto * libthrImg = factory.ExpectGetImage(libthrName);
+
+		// child2 still shares the parent's table, so the executable's
+		// load offset is only worked out once.
+		mockOpen.ExpectOpen("/bin/sh", O_RDONLY, -1);
+		mockImage.ExpectGetFrame(exeImg, 0x1008, frameList);
+		mockImage.ExpectGetFrame(exeImg, 0x1010, frameList);
+
+		// child1 has its own copy since mapping libthr, but the load
+		// info is kept on the shared Image.
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
+		mockImage.ExpectGetFrame(libcImg, 0x20, frameList);
+		mockImage.ExpectGetFrame(libcImg, 0x30, frameList);
+
+		// Only child1 sees libthr.
+		mockImage.ExpectGetFrame(libcImg, 0x100010, frameList);
+		mockOpen.ExpectOpen("/lib/libthr.so.3", O_RDONLY, -1);
+		mockImage.ExpectGetFrame(libthrImg, 0x10, frameList);
+	}
+
+	AddressSpace parent(factory);
+	parent.mapIn(exeLoad, exeName);
+	parent.mapIn(libcLoad, libcName);
+
+	AddressSpace child1(factory);
+	AddressSpace child2(factory);
+	child1.forkFrom(parent);
+	child2.forkFrom(parent);
+	child1.mapIn(libthrLoad, libthrName);
+
+	EXPECT_EQ(child1.getExecutableName(), exeName);
+	EXPECT_EQ(child2.getExecutableName(), exeName);
+
+	EXPECT_EQ(&child2.mapFrame(0x1008), frameList.at(0).get());
+	EXPECT_EQ(&parent.mapFrame(0x1010), frameList.at(1).get());
+	EXPECT_EQ(&parent.mapFrame(libcLoad + 0x20), frameList.at(2).get());
+	EXPECT_EQ(&child1.mapFrame(libcLoad + 0x30), frameList.at(3).get());
+	EXPECT_EQ(&parent.mapFrame(libthrLoad + 0x10), frameList.at(4).get());
+	EXPECT_EQ(&child1.mapFrame(libthrLoad + 0x10), frameList.at(5).get());
+}
+
+TEST_F(AddressSpaceTestSuite, TestMapOut)
+{
+	SharedString exeName("/bin/sh");
+	SharedString libcName("/lib/libc.so.7");
+	SharedString libmName("/lib/libm.so.5");
+	MockImageFactory factory;
+	CallframeList frameList;
+	GlobalMockImage mockImage;
+	GlobalMockOpen mockOpen;
+	const TargetAddr exeLoad = 0x1000;
+	const TargetAddr libLoad = 0x100000;
+
+	{
+		InSequence seq;
+
+		auto * exeImg = factory.ExpectGetImage(exeName);
+		auto * libcImg = factory.ExpectGetImage(libcName);
+
+		mockOpen.ExpectOpen("/lib/libc.so.7", O_RDONLY, -1);
+		mockImage.ExpectGetFrame(libcImg, 0x20, frameList);
+
+		// With libc gone its old range falls back to the executable.
+		mockOpen.ExpectOpen("/bin/sh", O_RDONLY, -1);
+		mockImage.ExpectGetFrame(exeImg, libLoad + 0x20, frameList);
+
+		auto * libmImg = factory.ExpectGetImage(libmName);
+		mockOpen.ExpectOpen("/lib/libm.so.5", O_RDONLY, -1);
+		mockImage.ExpectGetFrame(libmImg, 0x20, frameList);
+	}
+
+	AddressSpace space(factory);
+	space.mapIn(exeLoad, exeName);
+	space.mapIn(libLoad, libcName);
+
+	EXPECT_EQ(&space.mapFrame(libLoad + 0x20), frameList.at(0).get());
+	EXPECT_EQ(space.getEpoch(), 0);
+
+	// Nothing is mapped here, so chains resolved so far stay valid.
+	space.mapOut(0x200000, 0x300000);
+	EXPECT_EQ(space.getEpoch(), 0);
+
+	space.mapOut(libLoad, 0x200000);
+	EXPECT_EQ(space.getEpoch(), 1);
+	EXPECT_EQ(&space.mapFrame(libLoad + 0x20), frameList.at(1).get());
+
+	// Only chains with an address in libc's old range are stale.
+	uintptr_t exePc = exeLoad + 0x11;
+	uintptr_t libPc = libLoad + 0x21;
+	Sample exeSample(7, &exePc, 1);
+	Sample libSample(7, &libPc, 1);
+	EXPECT_FALSE(space.isStale(exeSample, 0));
+	EXPECT_TRUE(space.isStale(libSample, 0));
+	EXPECT_FALSE(space.isStale(libSample, 1));
+
+	// A child doesn't know what was mapped out before the fork.
+	AddressSpace child(factory);
+	child.forkFrom(space);
+	EXPECT_EQ(child.getEpoch(), 1);
+	EXPECT_TRUE(child.isStale(exeSample, 0));
+	EXPECT_FALSE(child.isStale(libSample, 1));
+
+	space.mapIn(libLoad, libmName);
+	EXPECT_EQ(space.getEpoch(), 1);
+	EXPECT_EQ(&space.mapFrame(libLoad + 0x20), frameList.at(2).get());
+}
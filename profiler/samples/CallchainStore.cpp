@@ -0,0 +1,162 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include <sys/cdefs.h>
+__FBSDID("$FreeBSD$");
+
+#include "CallchainStore.h"
+
+#include "Sample.h"
+
+#include <err.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+CallchainStore::Shard::Shard()
+  : slots(INITIAL_SLOTS, EMPTY), mask(INITIAL_SLOTS - 1), blockUsed(0),
+    blockSize(0)
+{
+}
+
+uint64_t
+CallchainStore::Hash(const Sample & sample)
+{
+	return (Sample::HashPCs(sample.getPCs(), sample.getChainDepth(),
+	    sample.isKernel()));
+}
+
+bool
+CallchainStore::Matches(const Entry & entry, uint64_t hash,
+    const Sample & sample)
+{
+	if (entry.hash != hash ||
+	    entry.depth != static_cast<uint32_t>(sample.getChainDepth()) ||
+	    entry.kernel != sample.isKernel())
+		return (false);
+
+	return (memcmp(entry.pcs, sample.getPCs(),
+	    entry.depth * sizeof(uintptr_t)) == 0);
+}
+
+const uintptr_t *
+CallchainStore::Shard::copyPCs(const uintptr_t *pcs, size_t depth)
+{
+	if (blocks.empty() || blockUsed + depth > blockSize) {
+		blockSize = std::max(BLOCK_PCS, depth);
+		blocks.push_back(std::make_unique<uintptr_t[]>(blockSize));
+		blockUsed = 0;
+	}
+
+	uintptr_t *copy = blocks.back().get() + blockUsed;
+	std::copy(pcs, pcs + depth, copy);
+	blockUsed += depth;
+
+	return (copy);
+}
+
+ChainId
+CallchainStore::intern(const Sample & sample)
+{
+	uint64_t hash = Hash(sample);
+	size_t s = ShardOf(hash);
+	Shard & shard = shards[s];
+	size_t i;
+
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	for (i = hash & shard.mask; shard.slots[i] != EMPTY;
+	    i = (i + 1) & shard.mask) {
+		uint32_t index = shard.slots[i] - 1;
+		if (Matches(shard.entries[index], hash, sample))
+			return ((index << SHARD_BITS) | s);
+	}
+
+	if (shard.entries.size() >=
+	    (std::numeric_limits<uint32_t>::max() >> SHARD_BITS) - 1)
+		errx(1, "Too many unique callchains");
+
+	uint32_t index = shard.entries.size();
+	shard.entries.push_back(Entry{
+		.hash = hash,
+		.pcs = shard.copyPCs(sample.getPCs(), sample.getChainDepth()),
+		.depth = static_cast<uint32_t>(sample.getChainDepth()),
+		.kernel = sample.isKernel(),
+	});
+	shard.slots[i] = index + 1;
+
+	/* Keep the table at most half full so that probes stay short. */
+	if (shard.entries.size() * 2 > shard.slots.size())
+		shard.grow();
+
+	return ((index << SHARD_BITS) | s);
+}
+
+void
+CallchainStore::Shard::grow()
+{
+	std::vector<uint32_t> bigger(slots.size() * 2, EMPTY);
+	size_t newMask = bigger.size() - 1;
+
+	for (uint32_t index = 0; index < entries.size(); ++index) {
+		size_t i = entries[index].hash & newMask;
+		while (bigger[i] != EMPTY)
+			i = (i + 1) & newMask;
+		bigger[i] = index + 1;
+	}
+
+	slots.swap(bigger);
+	mask = newMask;
+}
+
+CallchainStore::Entry
+CallchainStore::getEntry(ChainId id) const
+{
+	const Shard & shard = shards[id & (NUM_SHARDS - 1)];
+
+	/* entries may be reallocated by an intern() on another thread. */
+	std::lock_guard<std::mutex> guard(shard.lock);
+	return (shard.entries.at(id >> SHARD_BITS));
+}
+
+size_t
+CallchainStore::size() const
+{
+	size_t total = 0;
+
+	for (const auto & shard : shards) {
+		std::lock_guard<std::mutex> guard(shard.lock);
+		total += shard.entries.size();
+	}
+
+	return (total);
+}
+
+Sample
+CallchainStore::getSample(pid_t pid, ChainId id) const
+{
+	Entry entry = getEntry(id);
+
+	return (Sample(pid, entry.pcs, entry.depth));
+}
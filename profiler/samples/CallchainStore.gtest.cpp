@@ -0,0 +1,141 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "CallchainStore.h"
+
+#include "Sample.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+TEST(CallchainStoreTestSuite, TestInternDuplicate)
+{
+	CallchainStore store;
+	uintptr_t pc[] = { 0x1234, 0x5678, 0x9abc };
+
+	ChainId id = store.intern(Sample(1, pc, 3));
+	EXPECT_EQ(store.intern(Sample(1, pc, 3)), id);
+	EXPECT_EQ(store.size(), 1);
+
+	/* A second copy of the same chain shares the id. */
+	uintptr_t copy[] = { 0x1234, 0x5678, 0x9abc };
+	EXPECT_EQ(store.intern(Sample(2, copy, 3)), id);
+	EXPECT_EQ(store.size(), 1);
+
+	ASSERT_EQ(store.getDepth(id), 3);
+	EXPECT_FALSE(store.isKernel(id));
+	for (int i = 0; i < 3; ++i)
+		EXPECT_EQ(store.getPCs(id)[i], pc[i]);
+}
+
+TEST(CallchainStoreTestSuite, TestInternDistinct)
+{
+	CallchainStore store;
+	uintptr_t pc[] = { 0x1234, 0x5678, 0x9abc };
+	uintptr_t permuted[] = { 0x5678, 0x1234, 0x9abc };
+	uintptr_t kernel[] = { 0xffffffff80001234, 0xffffffff80005678 };
+
+	ChainId id = store.intern(Sample(1, pc, 3));
+	ChainId prefix = store.intern(Sample(1, pc, 2));
+	ChainId perm = store.intern(Sample(1, permuted, 3));
+	ChainId kern = store.intern(Sample(1, kernel, 2));
+
+	EXPECT_NE(id, prefix);
+	EXPECT_NE(id, perm);
+	EXPECT_NE(prefix, perm);
+	EXPECT_NE(kern, prefix);
+	EXPECT_EQ(store.size(), 4);
+
+	EXPECT_EQ(store.getDepth(prefix), 2);
+	EXPECT_TRUE(store.isKernel(kern));
+	EXPECT_EQ(store.getPCs(perm)[0], 0x5678);
+}
+
+TEST(CallchainStoreTestSuite, TestGrow)
+{
+	CallchainStore store;
+	const uintptr_t count = 10000;
+	std::vector<ChainId> ids;
+	uintptr_t pc[2];
+
+	for (uintptr_t i = 0; i < count; ++i) {
+		pc[0] = 0x400000 + i;
+		pc[1] = 0x800000 - i;
+		ids.push_back(store.intern(Sample(1, pc, 2)));
+	}
+
+	EXPECT_EQ(store.size(), count);
+	EXPECT_EQ(std::set<ChainId>(ids.begin(), ids.end()).size(), count);
+
+	for (uintptr_t i = 0; i < count; ++i) {
+		pc[0] = 0x400000 + i;
+		pc[1] = 0x800000 - i;
+		ASSERT_EQ(store.intern(Sample(1, pc, 2)), ids.at(i));
+		ASSERT_EQ(store.getPCs(ids.at(i))[1], 0x800000 - i);
+	}
+
+	EXPECT_EQ(store.size(), count);
+}
+
+TEST(CallchainStoreTestSuite, TestConcurrent)
+{
+	CallchainStore store;
+	const int threads = 8;
+	/* Prime, so that every stride below visits every chain. */
+	const uintptr_t count = 4999;
+	std::vector<std::vector<ChainId>> ids(threads);
+	std::vector<std::thread> workers;
+
+	/* Every thread interns the same chains, in a different order. */
+	for (int t = 0; t < threads; ++t) {
+		workers.emplace_back([&store, &ids, t]() {
+			uintptr_t pc[3];
+
+			ids[t].resize(count);
+			for (uintptr_t n = 0; n < count; ++n) {
+				uintptr_t i = (n * (2 * t + 1)) % count;
+				pc[0] = 0x400000 + i;
+				pc[1] = 0x500000;
+				pc[2] = 0x600000 + i % 7;
+				ids[t][i] = store.intern(Sample(1, pc, 3));
+			}
+		});
+	}
+
+	for (auto & thread : workers)
+		thread.join();
+
+	EXPECT_EQ(store.size(), count);
+	for (int t = 1; t < threads; ++t)
+		EXPECT_EQ(ids[t], ids[0]);
+
+	Sample sample = store.getSample(7, ids[0][42]);
+	EXPECT_EQ(sample.getProcessID(), 7);
+	ASSERT_EQ(sample.getChainDepth(), 3);
+	EXPECT_EQ(sample.getAddress(0), 0x400000 + 42 - 1);
+}
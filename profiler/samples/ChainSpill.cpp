@@ -0,0 +1,278 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "ChainSpill.h"
+
+#include "Callchain.h"
+#include "Callframe.h"
+#include "Sample.h"
+#include "Varint.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <assert.h>
+#include <err.h>
+
+#include <queue>
+#include <utility>
+
+static const char *
+MapRun(FILE *file, size_t &len)
+{
+	struct stat sb;
+	void *buf;
+
+	if (fflush(file) != 0 || fstat(fileno(file), &sb) != 0)
+		err(1, "Could not read back spilled callchains");
+
+	len = sb.st_size;
+	buf = mmap(NULL, len, PROT_READ, MAP_SHARED, fileno(file), 0);
+	if (buf == MAP_FAILED)
+		err(1, "Could not map spilled callchains");
+
+	madvise(buf, len, MADV_SEQUENTIAL);
+	return (static_cast<const char *>(buf));
+}
+
+/* A cursor over one run, which is only ever read front to back. */
+class ChainSpill::Run
+{
+	size_t len;
+	const char *buf;
+	VarintReader in;
+
+public:
+	ChainKey id;
+	uint64_t count;
+	uint64_t executable;
+	std::vector<uint32_t> chain;
+
+	explicit Run(FILE *file)
+	  : len(0), buf(MapRun(file, len)), in(buf, len)
+	{
+	}
+
+	~Run()
+	{
+		munmap(const_cast<char *>(buf), len);
+	}
+
+	Run(const Run &) = delete;
+	Run & operator=(const Run &) = delete;
+
+	bool next(size_t numFrames, size_t numExecutables)
+	{
+		if (in.atEnd())
+			return (false);
+
+		id = in.get();
+		count = in.get();
+		executable = in.get();
+		chain.resize(in.getCount());
+		for (auto & frame : chain) {
+			frame = in.get();
+			if (frame >= numFrames)
+				in.setFailed();
+		}
+
+		if (in.failed() || executable >= numExecutables ||
+		    chain.empty())
+			errx(1, "Spilled callchains are corrupt");
+		return (true);
+	}
+};
+
+/*
+ * Hands a Callchain being rebuilt the frames that its chain was saved with.
+ * A Callchain maps its addresses in order, leaf first.
+ */
+class ChainSpill::ReplayMapper : public CallframeMapper
+{
+	const std::vector<Frame> & frames;
+	const std::vector<uint32_t> *chain;
+	size_t next;
+	SharedString executable;
+
+public:
+	explicit ReplayMapper(const std::vector<Frame> & f)
+	  : frames(f), chain(nullptr), next(0)
+	{
+	}
+
+	void setChain(const std::vector<uint32_t> & c, SharedString exe)
+	{
+		chain = &c;
+		next = 0;
+		executable = exe;
+	}
+
+	const Callframe & mapFrame(TargetAddr addr) override
+	{
+		const Frame & frame = frames[chain->at(next++)];
+
+		assert(frame.addr == addr);
+		(void)addr;
+		return (*frame.frame);
+	}
+
+	SharedString getExecutableName() const override
+	{
+		return (executable);
+	}
+};
+
+ChainSpill::ChainSpill(pid_t pid)
+  : pid(pid), spilledBytes(0), spilledChains(0)
+{
+}
+
+ChainSpill::~ChainSpill()
+{
+	for (FILE *file : runs)
+		fclose(file);
+}
+
+uint32_t
+ChainSpill::getFrameId(TargetAddr addr, const Callframe & frame)
+{
+	auto [it, inserted] = frameIds.emplace(&frame, frames.size());
+	if (inserted)
+		frames.push_back(Frame{addr, &frame});
+
+	return (it->second);
+}
+
+uint32_t
+ChainSpill::getExecutableId(const SharedString & exe)
+{
+	auto [it, inserted] = executableIds.emplace(exe, executables.size());
+	if (inserted)
+		executables.push_back(exe);
+
+	return (it->second);
+}
+
+void
+ChainSpill::writeRun(const ChainList & chains)
+{
+	std::vector<uint8_t> buf;
+	VarintWriter out(buf);
+	FILE *file;
+
+	if (chains.empty())
+		return;
+
+	/* The file is unlinked, so it goes away with the process. */
+	file = tmpfile();
+	if (file == NULL)
+		err(1, "Could not create a file to spill callchains to");
+
+	for (const auto & [id, chain] : chains) {
+		/* Trie chains aren't spilled; a trie never frees its nodes. */
+		assert(chain->getTrie() == nullptr);
+
+		const auto records = chain->getRecords();
+		out.put(id);
+		out.put(chain->getSampleCount());
+		out.put(getExecutableId(chain->getExecutableName()));
+		out.put(records.size());
+		for (const auto & rec : records)
+			out.put(getFrameId(rec.getAddress(), rec.getFrame()));
+
+		if (buf.size() >= 64 * 1024) {
+			if (fwrite(buf.data(), 1, buf.size(), file) != buf.size())
+				err(1, "Could not spill callchains");
+			spilledBytes += buf.size();
+			buf.clear();
+		}
+	}
+
+	if (fwrite(buf.data(), 1, buf.size(), file) != buf.size())
+		err(1, "Could not spill callchains");
+	spilledBytes += buf.size();
+	spilledChains += chains.size();
+	runs.push_back(file);
+}
+
+void
+ChainSpill::merge(const MergeFunc & func) const
+{
+	/* (id, run) */
+	typedef std::pair<ChainKey, size_t> HeapEntry;
+	std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+	    std::greater<HeapEntry>> heap;
+	std::vector<std::unique_ptr<Run>> cursors;
+	std::vector<size_t> same;
+	std::vector<bool> merged;
+	std::vector<uintptr_t> pcs;
+	ReplayMapper mapper(frames);
+
+	for (FILE *file : runs) {
+		cursors.push_back(std::make_unique<Run>(file));
+		if (cursors.back()->next(frames.size(), executables.size()))
+			heap.emplace(cursors.back()->id, cursors.size() - 1);
+	}
+
+	while (!heap.empty()) {
+		ChainKey id = heap.top().first;
+
+		/* An id appears at most once per run. */
+		same.clear();
+		while (!heap.empty() && heap.top().first == id) {
+			same.push_back(heap.top().second);
+			heap.pop();
+		}
+
+		/* Runs with the same id and frames are the same chain. */
+		merged.assign(same.size(), false);
+		for (size_t i = 0; i < same.size(); ++i) {
+			if (merged[i])
+				continue;
+
+			Run & first = *cursors[same[i]];
+			size_t count = first.count;
+			for (size_t j = i + 1; j < same.size(); ++j) {
+				Run & run = *cursors[same[j]];
+				if (!merged[j] && run.chain == first.chain) {
+					count += run.count;
+					merged[j] = true;
+				}
+			}
+
+			pcs.clear();
+			for (uint32_t frame : first.chain)
+				pcs.push_back(frames[frame].addr + 1);
+			mapper.setChain(first.chain,
+			    executables[first.executable]);
+			func(id, count, mapper,
+			    Sample(pid, pcs.data(), pcs.size()));
+		}
+
+		for (size_t index : same) {
+			Run & run = *cursors[index];
+			if (run.next(frames.size(), executables.size()))
+				heap.emplace(run.id, index);
+		}
+	}
+}
@@ -0,0 +1,172 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "ChainSpill.h"
+
+#include "Callchain.h"
+#include "Callframe.h"
+#include "CallframeMapper.h"
+#include "Sample.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+
+using namespace testing;
+
+/* Makes one Callframe per address, the way an Image does. */
+class FrameMapper : public CallframeMapper
+{
+	std::map<TargetAddr, std::unique_ptr<Callframe>> frames;
+
+public:
+	const Callframe & mapFrame(TargetAddr addr) override
+	{
+		auto & frame = frames[addr];
+		if (!frame)
+			frame = std::make_unique<Callframe>(addr, "a.out");
+		return *frame;
+	}
+
+	SharedString getExecutableName() const override
+	{
+		return "a.out";
+	}
+};
+
+struct MergedChain
+{
+	ChainKey id;
+	size_t count;
+	std::vector<TargetAddr> addrs;
+	std::vector<const Callframe *> frames;
+	SharedString executable;
+};
+
+static std::vector<MergedChain>
+MergeAll(ChainSpill & spill)
+{
+	std::vector<MergedChain> merged;
+
+	spill.merge([&merged](ChainKey id, size_t count, CallframeMapper &space,
+	    const Sample &sample) {
+		Callchain chain(space, sample);
+		MergedChain m{id, count, {}, {}, chain.getExecutableName()};
+
+		for (const auto & rec : chain.getRecords()) {
+			m.addrs.push_back(rec.getAddress());
+			m.frames.push_back(&rec.getFrame());
+		}
+		merged.push_back(std::move(m));
+	});
+
+	return merged;
+}
+
+TEST(ChainSpillTestSuite, TestMergeRuns)
+{
+	FrameMapper mapper;
+	ChainSpill spill(12);
+	uintptr_t pc1[] = { 0x1001, 0x2001, 0x3001 };
+	uintptr_t pc2[] = { 0x4001, 0x2001 };
+	uintptr_t pc3[] = { 0x5001 };
+
+	Callchain a(mapper, Sample(12, pc1, 3));
+	Callchain b(mapper, Sample(12, pc2, 2));
+	Callchain c(mapper, Sample(12, pc3, 1));
+	a.addSample(3);
+	b.addSample(5);
+	c.addSample(7);
+
+	// Chain 1 is in both runs; its counts are summed.
+	spill.writeRun({{1, &a}, {4, &b}});
+	spill.writeRun({{1, &a}, {2, &c}});
+	ASSERT_EQ(spill.getNumRuns(), 2);
+	EXPECT_GT(spill.getSpilledBytes(), 0);
+
+	EXPECT_EQ(spill.getSpilledChains(), 4);
+
+	auto merged = MergeAll(spill);
+	ASSERT_EQ(merged.size(), 3);
+	EXPECT_EQ(merged[0].id, 1);
+	EXPECT_EQ(merged[0].count, 6);
+	EXPECT_EQ(merged[1].id, 2);
+	EXPECT_EQ(merged[1].count, 7);
+	EXPECT_EQ(merged[2].id, 4);
+	EXPECT_EQ(merged[2].count, 5);
+
+	// The rebuilt chains have the frames that they were spilled with.
+	auto records = a.getRecords();
+	ASSERT_EQ(merged[0].frames.size(), records.size());
+	for (size_t i = 0; i < records.size(); ++i) {
+		EXPECT_EQ(merged[0].addrs[i], records[i].getAddress());
+		EXPECT_EQ(merged[0].frames[i], &records[i].getFrame());
+	}
+	EXPECT_EQ(merged[0].executable, "a.out");
+	EXPECT_EQ(merged[2].frames.at(1), &b.getRecords().at(1).getFrame());
+
+	// The runs stay on disk, so every printer can stream them.
+	EXPECT_FALSE(spill.empty());
+	auto again = MergeAll(spill);
+	ASSERT_EQ(again.size(), 3);
+	EXPECT_EQ(again[0].count, 6);
+	EXPECT_EQ(again[0].frames, merged[0].frames);
+}
+
+TEST(ChainSpillTestSuite, TestMergeRemapped)
+{
+	FrameMapper mapper, remapped;
+	ChainSpill spill(12);
+	uintptr_t pc[] = { 0x1001, 0x2001 };
+
+	Callchain a(mapper, Sample(12, pc, 2));
+	Callchain b(remapped, Sample(12, pc, 2));
+	a.addSample(3);
+	b.addSample(5);
+
+	// Chain 1 was mapped again after an image was mapped out, so its
+	// runs have two different sets of frames.  Only the runs with the
+	// same frames are summed.
+	spill.writeRun({{1, &a}});
+	spill.writeRun({{1, &b}});
+	spill.writeRun({{1, &a}});
+
+	auto merged = MergeAll(spill);
+	ASSERT_EQ(merged.size(), 2);
+	EXPECT_EQ(merged[0].id, 1);
+	EXPECT_EQ(merged[0].count, 6);
+	EXPECT_EQ(merged[0].frames.at(0), &a.getRecords().at(0).getFrame());
+	EXPECT_EQ(merged[1].id, 1);
+	EXPECT_EQ(merged[1].count, 5);
+	EXPECT_EQ(merged[1].frames.at(0), &b.getRecords().at(0).getFrame());
+}
+
+TEST(ChainSpillTestSuite, TestMergeNothing)
+{
+	ChainSpill spill(12);
+
+	spill.writeRun({});
+	EXPECT_TRUE(spill.empty());
+	EXPECT_TRUE(MergeAll(spill).empty());
+}
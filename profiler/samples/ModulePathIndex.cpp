@@ -0,0 +1,160 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "ModulePathIndex.h"
+
+#include "ProfilerTypes.h"
+
+#include <sys/types.h>
+#include <sys/sysctl.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+
+void
+ModulePathIndex::SetPath(const std::vector<std::string> & dirs)
+{
+	path = dirs;
+	modules.clear();
+	notFound.clear();
+	scanned = false;
+}
+
+void
+ModulePathIndex::parsePath(char * pathBuf, std::vector<std::string> & vec)
+{
+	char * path;
+	char * next = pathBuf;
+
+	vec.clear();
+
+	while ((path = strsep(&next, ";")) != NULL) {
+		if (*path == '\0')
+			continue;
+
+		vec.push_back(path);
+	}
+}
+
+void
+ModulePathIndex::SetLocalPath()
+{
+	std::vector<std::string> modulePath;
+	std::unique_ptr<char[]> pathBuf;
+	size_t path_len = 0;
+	int error;
+
+	sysctlbyname("kern.module_path", NULL, &path_len, NULL, 0);
+	pathBuf = std::make_unique<char[]>(path_len+1);
+
+	error = sysctlbyname("kern.module_path", pathBuf.get(), &path_len, NULL, 0);
+	if (error == 0)
+		parsePath(pathBuf.get(), modulePath);
+	SetPath(modulePath);
+}
+
+void
+ModulePathIndex::SetPathList(const char* dirs)
+{
+	std::vector<std::string> modulePath;
+	size_t len = strlen(dirs) + 1;
+	std::unique_ptr<char[]> pathBuf = std::make_unique<char[]>(len);
+	memcpy(pathBuf.get(), dirs, len);
+
+	parsePath(pathBuf.get(), modulePath);
+	SetPath(modulePath);
+}
+
+void
+ModulePathIndex::scanDir(const std::string & dir)
+{
+	DIR *dirp;
+	struct dirent *ent;
+
+	dirp = opendir(dir.c_str());
+	if (dirp == NULL)
+		return;
+
+	while ((ent = readdir(dirp)) != NULL) {
+		if (ent->d_type == DT_DIR)
+			continue;
+
+		/* Earlier directories in the path take precedence. */
+		std::string name(ent->d_name);
+		if (modules.count(name) != 0)
+			continue;
+
+		modules.emplace(name, SharedString(dir + '/' + name));
+	}
+
+	closedir(dirp);
+}
+
+void
+ModulePathIndex::scan()
+{
+	for (const auto & dir : path)
+		scanDir(dir);
+	scanned = true;
+}
+
+const SharedString *
+ModulePathIndex::Find(const std::string & name)
+{
+	if (!scanned)
+		scan();
+
+	auto it = modules.find(name);
+	if (it != modules.end())
+		return (&it->second);
+
+	if (notFound.insert(name).second)
+		missing.push_back(name);
+	return (NULL);
+}
+
+void
+ModulePathIndex::ReportMissing()
+{
+	std::string names;
+
+	if (missing.empty())
+		return;
+
+	for (const auto & name : missing) {
+		names += ' ';
+		names += name;
+	}
+
+	fprintf(stderr, "%s: unable to find file%s%s\n",
+		g_quitOnError ? "error" : "warning",
+		missing.size() > 1 ? "s" : "", names.c_str());
+	if (g_quitOnError)
+		exit(5);
+
+	missing.clear();
+}
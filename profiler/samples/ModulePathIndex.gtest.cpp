@@ -0,0 +1,93 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+#include "ModulePathIndex.h"
+
+#include "mock/ModuleDirBuilder.h"
+
+#include "ProfilerTypes.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+bool g_quitOnError = false;
+
+TEST(ModulePathIndexTestSuite, TestFind)
+{
+	ModuleDirBuilder builder;
+	builder.AddDir("STOCK");
+	builder.AddDir("kernel");
+	builder.AddDir("kernel/subdir.ko");
+
+	std::string stockKernel = builder.AddFile("STOCK", "kernel");
+	std::string stockDtrace = builder.AddFile("STOCK", "dtrace.ko");
+	builder.AddFile("kernel", "kernel");
+	std::string ifEm = builder.AddFile("kernel", "if_em.ko");
+
+	ModulePathIndex index;
+	index.SetPath({builder.Dir("STOCK"), builder.Dir("missing"),
+	    builder.Dir("kernel")});
+
+	const SharedString *path = index.Find("kernel");
+	ASSERT_NE(path, nullptr);
+	EXPECT_EQ(**path, stockKernel);
+
+	path = index.Find("dtrace.ko");
+	ASSERT_NE(path, nullptr);
+	EXPECT_EQ(**path, stockDtrace);
+
+	path = index.Find("if_em.ko");
+	ASSERT_NE(path, nullptr);
+	EXPECT_EQ(**path, ifEm);
+
+	EXPECT_EQ(index.Find("subdir.ko"), nullptr);
+	EXPECT_EQ(index.Find("unknown.ko"), nullptr);
+	EXPECT_EQ(index.Find("/kernel"), nullptr);
+
+	// The path was already scanned, so modules added since aren't seen.
+	builder.AddFile("kernel", "late.ko");
+	EXPECT_EQ(index.Find("late.ko"), nullptr);
+
+	// Setting the path again starts over.
+	index.SetPath({builder.Dir("kernel")});
+	path = index.Find("kernel");
+	ASSERT_NE(path, nullptr);
+	EXPECT_EQ(**path, builder.Dir("kernel") + "/kernel");
+	EXPECT_NE(index.Find("late.ko"), nullptr);
+	EXPECT_EQ(index.Find("dtrace.ko"), nullptr);
+}
+
+TEST(ModulePathIndexTestSuite, TestEmptyPath)
+{
+	ModulePathIndex index;
+
+	EXPECT_EQ(index.Find("kernel"), nullptr);
+
+	index.SetPath({});
+	EXPECT_EQ(index.Find("kernel"), nullptr);
+}
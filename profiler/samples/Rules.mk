@@ -3,6 +3,9 @@ LIB :=	samples
 
 SRCS :=	\
 	AddressSpace.cpp \
+	CallchainStore.cpp \
+	ChainSpill.cpp \
+	ModulePathIndex.cpp \
 	SampleAggregation.cpp \
 
 SUBDIRS := \
@@ -11,10 +14,14 @@ SUBDIRS := \
 
 TESTS := \
 	AddressSpace \
+	CallchainStore \
+	ChainSpill \
+	ModulePathIndex \
 	SampleAggregation
 
 TEST_ADDRESSSPACE_SRCS := \
 	AddressSpace.cpp \
+	ModulePathIndex.cpp \
 
 TEST_ADDRESSSPACE_LIBS := \
 	frame \
@@ -30,7 +37,35 @@ TEST_ADDRESSSPACE_WRAPFUNCS= \
 TEST_ADDRESSSPACE_STDLIBS= \
 	gmock \
 
+TEST_CALLCHAINSTORE_SRCS := \
+	CallchainStore.cpp \
+
+TEST_CALLCHAINSTORE_STDLIBS= \
+	gmock \
+	pthread \
+
+TEST_CHAINSPILL_SRCS := \
+	ChainSpill.cpp \
+
+TEST_CHAINSPILL_LIBS := \
+	frame \
+	sharedptr \
+
+TEST_CHAINSPILL_STDLIBS= \
+	gmock \
+
+TEST_MODULEPATHINDEX_SRCS := \
+	ModulePathIndex.cpp \
+
+TEST_MODULEPATHINDEX_LIBS := \
+	sharedptr \
+
+TEST_MODULEPATHINDEX_STDLIBS= \
+	gmock \
+
 TEST_SAMPLEAGGREGATION_SRCS := \
+	CallchainStore.cpp \
+	ChainSpill.cpp \
 	SampleAggregation.cpp \
 
 TEST_SAMPLEAGGREGATION_LIBS := \
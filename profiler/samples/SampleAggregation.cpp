@@ -26,60 +26,435 @@
 #include "AddressSpace.h"
 #include "Callchain.h"
 #include "CallchainFactory.h"
+#include "CallchainTrie.h"
+#include "ChainSpill.h"
+#include "Callframe.h"
+#include "CallframeMapper.h"
 #include "ProcessState.h"
 #include "Sample.h"
 
+#include <assert.h>
+
 #include <algorithm>
 #include <memory>
 #include <sstream>
 
-SampleAggregation::SampleAggregation(CallchainFactory & f, const std::string &name, pid_t pid)
+namespace
+{
+/*
+ * Maps every address to a single "[other]" frame.  Used to build the chain
+ * that stands in for all of the chains a bounded aggregation didn't keep.
+ */
+class OtherMapper : public CallframeMapper
+{
+	SharedString executable;
+	Callframe frame;
+
+public:
+	OtherMapper(const std::string & exe)
+	  : executable(exe), frame(0, "[other]")
+	{
+		frame.addFrame("[other]", "[other]", "[other]", 0, 0, 0);
+	}
+
+	const Callframe & mapFrame(TargetAddr) override
+	{
+		return frame;
+	}
+
+	SharedString getExecutableName() const override
+	{
+		return executable;
+	}
+};
+}
+
+SpillBudget::SpillBudget(size_t limit)
+  : limit(limit),
+    used(0)
+{
+}
+
+void
+SpillBudget::add(SampleAggregation *agg)
+{
+	aggregations.push_back(agg);
+}
+
+void
+SpillBudget::remove(SampleAggregation *agg)
+{
+	auto it = std::find(aggregations.begin(), aggregations.end(), agg);
+
+	if (it != aggregations.end()) {
+		*it = aggregations.back();
+		aggregations.pop_back();
+	}
+}
+
+void
+SpillBudget::charge(size_t bytes)
+{
+	used += bytes;
+}
+
+void
+SpillBudget::release(size_t bytes)
+{
+	used -= bytes;
+}
+
+/*
+ * Spilling the aggregations that hold the most first frees the memory in the
+ * fewest runs, and spilling down to half of the limit leaves room for the
+ * next chains before anything has to be spilled again.
+ */
+void
+SpillBudget::enforce()
+{
+	if (used <= limit)
+		return;
+
+	std::vector<SampleAggregation *> largest(aggregations);
+	std::sort(largest.begin(), largest.end(),
+	    [](const SampleAggregation *l, const SampleAggregation *r) {
+		return l->chainBytes > r->chainBytes;
+	});
+
+	for (SampleAggregation *agg : largest) {
+		if (used <= limit / 2 || agg->chainBytes == 0)
+			break;
+		agg->spillChains();
+	}
+}
+
+SampleAggregation::SampleAggregation(CallchainFactory & f, CallchainStore & s,
+    const std::string &name, pid_t pid, bool useTrie, size_t maxChains,
+    SpillBudget *spillBudget)
  : executableName(name),
    pid(pid),
    sampleCount(0),
    userlandSampleCount(0),
-   factory(f)
+   factory(f),
+   store(s),
+   maxChains(maxChains),
+   errorBound(0),
+   spillBudget(spillBudget),
+   chainBytes(0)
 {
+	/* A trie never frees the nodes of evicted or spilled chains. */
+	assert(!(useTrie && (maxChains != 0 || spillBudget != nullptr)));
+	assert(!(maxChains != 0 && spillBudget != nullptr));
+
+	if (useTrie)
+		trie = std::make_unique<CallchainTrie>();
+	if (spillBudget != nullptr)
+		spillBudget->add(this);
 }
 
 SampleAggregation::~SampleAggregation()
 {
+	if (spillBudget != nullptr) {
+		spillBudget->release(chainBytes);
+		spillBudget->remove(this);
+	}
+}
 
+/*
+ * An aggregation that doesn't intern keys a chain on its hash.  A chain
+ * whose hash is taken by a different tracked chain takes the next free key.
+ * If that other chain is evicted or spilled, the chain may later be tracked
+ * again under its own hash, as if it had been evicted itself.
+ */
+ChainKey
+SampleAggregation::getKey(const Sample & sample, ChainId id)
+{
+	if (internsChains())
+		return (id == NO_CHAIN ? store.intern(sample) : id);
+
+	ChainKey key = Sample::HashPCs(sample.getPCs(), sample.getChainDepth(),
+	    sample.isKernel());
+	for (;; ++key) {
+		auto it = frameMap.find(key);
+		if (it == frameMap.end() || it->second.chain->matches(sample))
+			return key;
+	}
 }
 
 Callchain *
-SampleAggregation::addFrame(CallframeMapper &space, const Sample & sample)
+SampleAggregation::addFrame(CallframeMapper &space, const Sample & sample,
+    ChainKey id)
 {
-	auto ptr = factory.MakeCallchain(space, sample);
+	auto ptr = factory.MakeCallchain(space, sample, trie.get());
 	Callchain * cc = ptr.get();
-	frameMap.insert(std::make_pair(sample, std::move(ptr)));
+	LiveChain & live = frameMap[id];
+
+	/* Keep the samples of a chain that was spilled with other frames. */
+	if (live.chain)
+		finalChains.push_back({id, std::move(live.chain)});
+	live.chain = std::move(ptr);
+	live.epoch = space.getEpoch();
+	addChainBytes(sample);
 
 	return cc;
 }
 
+/*
+ * An image has been mapped out since the live chain was mapped.  The chain
+ * is kept unless one of its addresses was in that image and now maps to a
+ * different frame.  The samples that it already has stay with the frames
+ * that they were taken in.
+ */
+Callchain *
+SampleAggregation::remapChain(CallframeMapper &space, const Sample & sample,
+    ChainKey key, LiveChain & live)
+{
+	uint64_t epoch = live.epoch;
+
+	live.epoch = space.getEpoch();
+	if (!space.isStale(sample, epoch) || live.chain->isMappedBy(space))
+		return live.chain.get();
+
+	CallchainPtr old = std::move(live.chain);
+	live.chain = factory.MakeCallchain(space, sample, trie.get());
+	if (maxChains != 0) {
+		/*
+		 * Only one chain per id is tracked; the rest is [other].  The
+		 * new frames haven't missed any samples.
+		 */
+		addOther(old->getSampleCount());
+		chainErrors[key] = 0;
+	} else {
+		finalChains.push_back({key, std::move(old)});
+		addChainBytes(sample);
+	}
+
+	return live.chain.get();
+}
+
 void
-SampleAggregation::addSample(CallframeMapper &space, const Sample &sample)
+SampleAggregation::addChainBytes(const Sample & sample)
 {
-	auto it = frameMap.find(sample);
+	if (spillBudget == nullptr)
+		return;
+
+	/* A rough count of the heap that the chain and its slot use. */
+	size_t bytes = sizeof(Callchain) + 2 * sizeof(ChainKey) +
+	    2 * sizeof(CallchainPtr) +
+	    sample.getChainDepth() * sizeof(Callchain::CallchainRecord);
+
+	chainBytes += bytes;
+	spillBudget->charge(bytes);
+}
+
+void
+SampleAggregation::addSample(CallframeMapper &space, const Sample &sample,
+    size_t count, ChainId id)
+{
+	/* Every sample in an aggregation has the same pid. */
+	ChainKey key = getKey(sample, id);
+	auto it = frameMap.find(key);
 
 	Callchain *cc;
-	if (it == frameMap.end())
-		cc = addFrame(space, sample);
-	else
-		cc = it->second.get();
+	if (it != frameMap.end()) {
+		if (it->second.epoch == space.getEpoch())
+			cc = it->second.chain.get();
+		else
+			cc = remapChain(space, sample, key, it->second);
+	} else if (maxChains == 0) {
+		cc = addFrame(space, sample, key);
+	} else {
+		if (frameMap.size() >= maxChains)
+			evictChains();
+		cc = addFrame(space, sample, key);
+		chainErrors[key] = errorBound;
+	}
 
-	cc->addSample();
-	sampleCount++;
+	cc->addSample(count);
+	sampleCount += count;
 	if (!sample.isKernel())
-		userlandSampleCount++;
+		userlandSampleCount += count;
+
+	if (spillBudget != nullptr)
+		spillBudget->enforce();
+}
+
+/*
+ * Writes out every chain in memory, tracked or final.  A run holds a key at
+ * most once, but a chain whose frames changed shares its key with the chain
+ * that replaced it; the later ones with a key go to runs of their own.
+ */
+void
+SampleAggregation::spillChains()
+{
+	ChainSpill::ChainList chains, dups;
+
+	if (!spill)
+		spill = std::make_unique<ChainSpill>(pid);
+
+	chains.reserve(frameMap.size() + finalChains.size());
+	for (const auto & [id, live] : frameMap)
+		chains.push_back({id, live.chain.get()});
+	for (const auto & old : finalChains)
+		chains.push_back({old.key, old.chain.get()});
+	std::sort(chains.begin(), chains.end());
+
+	while (!chains.empty()) {
+		size_t kept = 0;
+
+		dups.clear();
+		for (const auto & chain : chains) {
+			if (kept != 0 && chains[kept - 1].id == chain.id)
+				dups.push_back(chain);
+			else
+				chains[kept++] = chain;
+		}
+		chains.resize(kept);
+		spill->writeRun(chains);
+		chains.swap(dups);
+	}
+
+	frameMap.clear();
+	ChainList().swap(finalChains);
+	spillBudget->release(chainBytes);
+	chainBytes = 0;
+}
+
+void
+SampleAggregation::flushSpill()
+{
+	if (spill && (!frameMap.empty() || !finalChains.empty()))
+		spillChains();
+}
+
+/*
+ * Evict the lighter half of the tracked chains, ranked by the most samples
+ * each could have had.  Evicting in batches keeps the cost per new chain
+ * constant, at the price of a looser bound than evicting one at a time.
+ */
+void
+SampleAggregation::evictChains()
+{
+	std::vector<std::pair<size_t, ChainKey>> estimates;
+	size_t evict;
+
+	estimates.reserve(frameMap.size());
+	for (const auto & pair : frameMap)
+		estimates.emplace_back(pair.second.chain->getSampleCount() +
+		    chainErrors[pair.first], pair.first);
+
+	evict = estimates.size() - maxChains / 2;
+	std::nth_element(estimates.begin(), estimates.begin() + (evict - 1),
+	    estimates.end());
+
+	for (size_t i = 0; i < evict; ++i) {
+		ChainKey id = estimates[i].second;
+		auto it = frameMap.find(id);
+
+		errorBound = std::max(errorBound, estimates[i].first);
+		addOther(it->second.chain->getSampleCount());
+		frameMap.erase(it);
+		chainErrors.erase(id);
+	}
+}
+
+void
+SampleAggregation::addOther(size_t count)
+{
+	if (!otherChain) {
+		uintptr_t pc = 0;
+
+		otherMapper = std::make_unique<OtherMapper>(executableName);
+		otherChain = factory.MakeCallchain(*otherMapper,
+		    Sample(pid, &pc, 1), nullptr);
+	}
+
+	otherChain->addSample(count);
+}
+
+size_t
+SampleAggregation::getOtherCount() const
+{
+	if (!otherChain)
+		return 0;
+
+	return otherChain->getSampleCount();
 }
 
 void
 SampleAggregation::getCallchainList(CallchainList &list) const
 {
 	for (const auto & pair : frameMap) {
-		list.emplace_back(this, pair.second.get());
+		list.emplace_back(this, pair.second.chain.get());
+	}
+
+	for (const auto & old : finalChains) {
+		list.emplace_back(this, old.chain.get());
+	}
+
+	if (otherChain)
+		list.emplace_back(this, otherChain.get());
+}
+
+void
+SampleAggregation::forEachCallchain(
+    const std::function<void(const Callchain &)> & func) const
+{
+	for (const auto & pair : frameMap)
+		func(*pair.second.chain);
+
+	for (const auto & old : finalChains)
+		func(*old.chain);
+
+	if (otherChain)
+		func(*otherChain);
+
+	if (!spill)
+		return;
+
+	spill->merge([this, &func](ChainKey, size_t count,
+	    CallframeMapper &space, const Sample & sample) {
+		auto chain = factory.MakeCallchain(space, sample, nullptr);
+		chain->addSample(count);
+		func(*chain);
+	});
+}
+
+size_t
+SampleAggregation::getCallchainBound() const
+{
+	size_t bound = frameMap.size() + finalChains.size();
+
+	if (otherChain)
+		bound++;
+	if (spill)
+		bound += spill->getSpilledChains();
+	return bound;
+}
+
+void
+SampleAggregation::finalize()
+{
+	/*
+	 * Once some chains are on disk, the rest follow them so that they
+	 * don't stay in memory until the profile is written.
+	 */
+	if (spill) {
+		spillChains();
+	} else {
+		finalChains.reserve(finalChains.size() + frameMap.size());
+		for (auto & pair : frameMap) {
+			finalChains.push_back({pair.first,
+			    std::move(pair.second.chain)});
+		}
+
+		frameMap.clear();
+		finalChains.shrink_to_fit();
 	}
+
+	chainErrors.clear();
+	if (trie)
+		trie->finalize();
 }
 
 bool
@@ -25,6 +25,7 @@
 
 #include "Callchain.h"
 #include "CallchainFactory.h"
+#include "CallchainTrie.h"
 #include "Callframe.h"
 #include "CallframeMapper.h"
 #include "Sample.h"
@@ -40,28 +41,78 @@ class MockFrameMapper : public CallframeMapper
 public:
 	MOCK_METHOD1(mapFrame, const Callframe & (TargetAddr));
 	MOCK_CONST_METHOD0(getExecutableName, SharedString ());
+	MOCK_CONST_METHOD0(getEpoch, uint64_t ());
+	MOCK_CONST_METHOD2(isStale, bool (const Sample &, uint64_t));
 };
 
 class CallchainMocker : public GlobalMockBase<CallchainMocker>
 {
 public:
 	MOCK_METHOD1(addSample, void (const Callchain *));
+	MOCK_METHOD1(isMappedBy, bool (const Callchain *));
+	MOCK_METHOD1(matches, bool (const Callchain *));
 };
 
-Callchain::Callchain(CallframeMapper &mapper, const Sample &sample)
-  : space(mapper)
+Callchain::Callchain(CallframeMapper &mapper, const Sample &sample,
+    CallchainTrie *trie)
+  : trie(trie),
+    sampleCount(0)
 {
 }
 
-void Callchain::addSample()
+Callframe::Callframe(TargetAddr off, SharedString imageName)
+  : offset(off), imageName(imageName), unmapped(false)
 {
+}
+
+Callframe::~Callframe()
+{
+}
+
+void
+Callframe::addFrame(SharedString, SharedString, SharedString, int, int,
+    uint64_t)
+{
+}
+
+Callchain::RecordChain
+Callchain::getRecords() const
+{
+	return callframes;
+}
+
+void Callchain::addSample(size_t count)
+{
+	sampleCount += count;
 	CallchainMocker::MockObj().addSample(this);
 }
 
+bool
+Callchain::isMappedBy(CallframeMapper &) const
+{
+	return CallchainMocker::MockObj().isMappedBy(this);
+}
+
+bool
+Callchain::matches(const Sample &) const
+{
+	return CallchainMocker::MockObj().matches(this);
+}
+
+CallchainTrie::CallchainTrie()
+{
+}
+
+void
+CallchainTrie::finalize()
+{
+}
+
 class MockCallchainFactory : public CallchainFactory
 {
 public:
-	MOCK_METHOD2(MakeCallchain, std::unique_ptr<Callchain>(CallframeMapper &space, const Sample & sample));
+	MOCK_METHOD3(MakeCallchain, CallchainPtr(CallframeMapper &space,
+	    const Sample & sample, CallchainTrie *trie));
 };
 
 void PrintTo(const Sample & s, std::ostream* os)
@@ -80,7 +131,8 @@ void PrintTo(const Sample & s, std::ostream* os)
 TEST(SampleAggregationTestSuite, TestGetters)
 {
 	MockCallchainFactory ccFactory;
-	SampleAggregation agg(ccFactory, "/usr/bin/pmcstat", 866);
+	CallchainStore store;
+	SampleAggregation agg(ccFactory, store, "/usr/bin/pmcstat", 866);
 
 	EXPECT_EQ(agg.getExecutable(), "/usr/bin/pmcstat");
 	EXPECT_EQ(agg.getDisplayName(), "/usr/bin/pmcstat (866)");
@@ -91,17 +143,18 @@ TEST(SampleAggregationTestSuite, TestGetters)
 TEST(SampleAggregationTestSuite, TestAddSingleSample)
 {
 	MockCallchainFactory ccFactory;
+	CallchainStore store;
 	std::string imageName("sbin/ifconfig");
-	SampleAggregation agg(ccFactory, imageName, 156);
+	SampleAggregation agg(ccFactory, store, imageName, 156);
 	MockFrameMapper mapper;
 	GlobalMock<CallchainMocker> callchainMock;
 
 	pmclog_ev_callchain pmc_cc{ .pl_npc = 1, .pl_pc = {0x123}};
 	Sample sample(pmc_cc);
 
-	auto ccRet = std::make_unique<Callchain>(mapper, sample);
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample);
 	Callchain * callchain = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 	EXPECT_CALL(*callchainMock, addSample(callchain)).Times(1);
@@ -112,17 +165,18 @@ TEST(SampleAggregationTestSuite, TestAddSingleSample)
 TEST(SampleAggregationTestSuite, TestAddSingleSampleMultipleTimes)
 {
 	MockCallchainFactory ccFactory;
+	CallchainStore store;
 	std::string imageName("sbin/ifconfig");
-	SampleAggregation agg(ccFactory, imageName, 156);
+	SampleAggregation agg(ccFactory, store, imageName, 156);
 	MockFrameMapper mapper;
 	GlobalMock<CallchainMocker> callchainMock;
 
 	pmclog_ev_callchain pmc_cc{ .pl_npc = 1, .pl_pc = {0x123}};
 	Sample sample(pmc_cc);
 
-	auto ccRet = std::make_unique<Callchain>(mapper, sample);
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample);
 	Callchain * callchain = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 	EXPECT_CALL(*callchainMock, addSample(callchain)).Times(3);
@@ -140,8 +194,9 @@ TEST(SampleAggregationTestSuite, TestAddSingleSampleMultipleTimes)
 TEST(SampleAggregationTestSuite, TestAddMultipleSamples)
 {
 	MockCallchainFactory ccFactory;
+	CallchainStore store;
 	std::string imageName("sbin/ifconfig");
-	SampleAggregation agg(ccFactory, imageName, 156);
+	SampleAggregation agg(ccFactory, store, imageName, 156);
 	MockFrameMapper mapper;
 	GlobalMock<CallchainMocker> callchainMock;
 
@@ -149,21 +204,21 @@ TEST(SampleAggregationTestSuite, TestAddMultipleSamples)
 	Sample sample2(pmclog_ev_pcsample { .pl_pc = 10});
 	Sample sample3(pmclog_ev_callchain { .pl_npc = 4, .pl_pc = {1, 2, 3, 4}});
 
-	auto ccRet = std::make_unique<Callchain>(mapper, sample1);
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample1);
 	Callchain * cc1 = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample1))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample1, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 
 	ccRet = std::make_unique<Callchain>(mapper, sample2);
 	Callchain * cc2 = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample2))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample2, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 
 	ccRet = std::make_unique<Callchain>(mapper, sample3);
 	Callchain * cc3 = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample3))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample3, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 
@@ -181,11 +236,149 @@ TEST(SampleAggregationTestSuite, TestAddMultipleSamples)
 	agg.addSample(mapper, sample2);
 }
 
+TEST(SampleAggregationTestSuite, TestEpochChange)
+{
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	std::string imageName("sbin/ifconfig");
+	SampleAggregation agg(ccFactory, store, imageName, 156);
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+
+	Sample sample(pmclog_ev_callchain { .pl_npc = 2, .pl_pc = {0x123, 0x456}});
+
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample);
+	Callchain * cc1 = ccRet.get();
+	CallchainPtr ccRet2 = std::make_unique<Callchain>(mapper, sample);
+	Callchain * cc2 = ccRet2.get();
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample, nullptr))
+	    .Times(2)
+	    .WillOnce(Return(ByMove(std::move(ccRet))))
+	    .WillOnce(Return(ByMove(std::move(ccRet2))));
+
+	// An image under the chain is mapped out and its addresses now map
+	// to other frames, so the chain is mapped again.
+	EXPECT_CALL(mapper, getEpoch())
+	    .WillOnce(Return(0))
+	    .WillOnce(Return(0))
+	    .WillRepeatedly(Return(1));
+	EXPECT_CALL(mapper, isStale(sample, 0)).WillOnce(Return(true));
+	EXPECT_CALL(*callchainMock, isMappedBy(cc1)).WillOnce(Return(false));
+	EXPECT_CALL(*callchainMock, addSample(cc1)).Times(2);
+	EXPECT_CALL(*callchainMock, addSample(cc2)).Times(2);
+
+	agg.addSample(mapper, sample);
+	agg.addSample(mapper, sample);
+	agg.addSample(mapper, sample);
+	agg.addSample(mapper, sample);
+
+	CallchainList ccList;
+	agg.getCallchainList(ccList);
+
+	EXPECT_EQ(agg.getSampleCount(), 4);
+	EXPECT_THAT(ccList, UnorderedElementsAre(AggCallChain(&agg, cc1),
+						 AggCallChain(&agg, cc2)));
+}
+
+TEST(SampleAggregationTestSuite, TestEpochChangeSameFrames)
+{
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	std::string imageName("sbin/ifconfig");
+	SampleAggregation agg(ccFactory, store, imageName, 156);
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+
+	Sample sample1(pmclog_ev_callchain { .pl_npc = 2, .pl_pc = {0x123, 0x456}});
+	Sample sample2(pmclog_ev_callchain { .pl_npc = 2, .pl_pc = {0x789, 0x456}});
+
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample1);
+	Callchain * cc1 = ccRet.get();
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample1, nullptr))
+	    .WillOnce(Return(ByMove(std::move(ccRet))));
+	CallchainPtr ccRet2 = std::make_unique<Callchain>(mapper, sample2);
+	Callchain * cc2 = ccRet2.get();
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample2, nullptr))
+	    .WillOnce(Return(ByMove(std::move(ccRet2))));
+
+	// Neither chain gets a new frame: sample1 had no address in the image
+	// mapped out, and sample2's addresses still map to the same frames.
+	// Both keep every one of their samples.
+	EXPECT_CALL(mapper, getEpoch())
+	    .WillOnce(Return(0))
+	    .WillOnce(Return(0))
+	    .WillRepeatedly(Return(1));
+	EXPECT_CALL(mapper, isStale(sample1, 0)).WillOnce(Return(false));
+	EXPECT_CALL(mapper, isStale(sample2, 0)).WillOnce(Return(true));
+	EXPECT_CALL(*callchainMock, isMappedBy(cc2)).WillOnce(Return(true));
+	EXPECT_CALL(*callchainMock, addSample(cc1)).Times(3);
+	EXPECT_CALL(*callchainMock, addSample(cc2)).Times(3);
+
+	agg.addSample(mapper, sample1);
+	agg.addSample(mapper, sample2);
+	agg.addSample(mapper, sample1);
+	agg.addSample(mapper, sample2);
+	agg.addSample(mapper, sample1);
+	agg.addSample(mapper, sample2);
+
+	CallchainList ccList;
+	agg.getCallchainList(ccList);
+
+	EXPECT_EQ(agg.getSampleCount(), 6);
+	EXPECT_THAT(ccList, UnorderedElementsAre(AggCallChain(&agg, cc1),
+						 AggCallChain(&agg, cc2)));
+}
+
+TEST(SampleAggregationTestSuite, TestEpochChangeBounded)
+{
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	SampleAggregation agg(ccFactory, store, "/usr/bin/jit", 158, false, 4);
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+
+	EXPECT_CALL(ccFactory, MakeCallchain(_, _, nullptr))
+	    .WillRepeatedly([](CallframeMapper &space, const Sample &sample,
+	        CallchainTrie *) {
+		return CallchainPtr(std::make_unique<Callchain>(space, sample));
+	    });
+	EXPECT_CALL(*callchainMock, addSample(_)).Times(AnyNumber());
+	EXPECT_CALL(*callchainMock, isMappedBy(_)).WillOnce(Return(false));
+	EXPECT_CALL(*callchainMock, matches(_)).WillRepeatedly(Return(true));
+
+	Sample sample(pmclog_ev_pcsample { .pl_pc = 0x1000 });
+
+	EXPECT_CALL(mapper, getEpoch())
+	    .WillOnce(Return(0))
+	    .WillRepeatedly(Return(1));
+	EXPECT_CALL(mapper, isStale(sample, 0)).WillOnce(Return(true));
+
+	// Only one chain per id is tracked, so the samples taken with the
+	// old frames are counted as [other].
+	agg.addSample(mapper, sample, 7);
+	agg.addSample(mapper, sample, 2);
+
+	EXPECT_EQ(agg.getSampleCount(), 9);
+	EXPECT_EQ(agg.getOtherCount(), 7);
+
+	CallchainList ccList;
+	agg.getCallchainList(ccList);
+
+	std::vector<size_t> counts;
+	for (const auto & rec : ccList)
+		counts.push_back(rec.chain->getSampleCount());
+	EXPECT_THAT(counts, UnorderedElementsAre(2, 7));
+
+	// Bounded aggregations don't intern their chains.
+	EXPECT_EQ(store.size(), 0);
+}
+
 TEST(SampleAggregationTestSuite, TestGetCallchainList)
 {
 	MockCallchainFactory ccFactory;
+	CallchainStore store;
 	std::string imageName("sbin/ifconfig");
-	SampleAggregation agg(ccFactory, imageName, 156);
+	SampleAggregation agg(ccFactory, store, imageName, 156);
 	MockFrameMapper mapper;
 	GlobalMock<CallchainMocker> callchainMock;
 
@@ -193,21 +386,21 @@ TEST(SampleAggregationTestSuite, TestGetCallchainList)
 	Sample sample2(pmclog_ev_pcsample { .pl_pc = 10});
 	Sample sample3(pmclog_ev_callchain { .pl_npc = 4, .pl_pc = {1, 2, 3, 4}});
 
-	auto ccRet = std::make_unique<Callchain>(mapper, sample1);
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample1);
 	Callchain * cc1 = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample1))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample1, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 
 	ccRet = std::make_unique<Callchain>(mapper, sample2);
 	Callchain * cc2 = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample2))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample2, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 
 	ccRet = std::make_unique<Callchain>(mapper, sample3);
 	Callchain * cc3 = ccRet.get();
-	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample3))
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample3, nullptr))
 	    .Times(1)
 	    .WillOnce(Return(ByMove(std::move(ccRet))));
 
@@ -227,3 +420,252 @@ TEST(SampleAggregationTestSuite, TestGetCallchainList)
 						 AggCallChain(&agg, cc2),
 						 AggCallChain(&agg, cc3)));
 }
+
+TEST(SampleAggregationTestSuite, TestFinalize)
+{
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	std::string imageName("/usr/bin/make");
+	SampleAggregation agg(ccFactory, store, imageName, 157);
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+
+	Sample sample1(pmclog_ev_callchain { .pl_npc = 2, .pl_pc = {5, 6}});
+	Sample sample2(pmclog_ev_pcsample { .pl_pc = 11});
+
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample1);
+	Callchain * cc1 = ccRet.get();
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample1, nullptr))
+	    .Times(1)
+	    .WillOnce(Return(ByMove(std::move(ccRet))));
+
+	ccRet = std::make_unique<Callchain>(mapper, sample2);
+	Callchain * cc2 = ccRet.get();
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample2, nullptr))
+	    .Times(1)
+	    .WillOnce(Return(ByMove(std::move(ccRet))));
+
+	EXPECT_CALL(*callchainMock, addSample(cc1)).Times(2);
+	EXPECT_CALL(*callchainMock, addSample(cc2)).Times(1);
+
+	agg.addSample(mapper, sample1);
+	agg.addSample(mapper, sample2);
+	agg.addSample(mapper, sample1);
+
+	agg.finalize();
+
+	CallchainList ccList;
+	agg.getCallchainList(ccList);
+
+	EXPECT_EQ(agg.getSampleCount(), 3);
+	EXPECT_THAT(ccList, UnorderedElementsAre(AggCallChain(&agg, cc1),
+						 AggCallChain(&agg, cc2)));
+}
+
+TEST(SampleAggregationTestSuite, TestTrie)
+{
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	std::string imageName("/usr/sbin/nginx");
+	SampleAggregation agg(ccFactory, store, imageName, 158, true);
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+
+	ASSERT_NE(agg.getTrie(), nullptr);
+	CallchainTrie * trie = const_cast<CallchainTrie *>(agg.getTrie());
+
+	Sample sample(pmclog_ev_callchain { .pl_npc = 2, .pl_pc = {5, 6}});
+
+	CallchainPtr ccRet = std::make_unique<Callchain>(mapper, sample);
+	Callchain * cc = ccRet.get();
+	EXPECT_CALL(ccFactory, MakeCallchain(Ref(mapper), sample, trie))
+	    .Times(1)
+	    .WillOnce(Return(ByMove(std::move(ccRet))));
+	EXPECT_CALL(*callchainMock, addSample(cc)).Times(2);
+
+	agg.addSample(mapper, sample);
+	agg.addSample(mapper, sample);
+	agg.finalize();
+
+	EXPECT_EQ(agg.getSampleCount(), 2);
+}
+
+TEST(SampleAggregationTestSuite, TestBoundedChains)
+{
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	SampleAggregation agg(ccFactory, store, "/usr/bin/jit", 158, false, 4);
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+
+	EXPECT_CALL(ccFactory, MakeCallchain(_, _, nullptr))
+	    .WillRepeatedly([](CallframeMapper &space, const Sample &sample,
+	        CallchainTrie *) {
+		return CallchainPtr(std::make_unique<Callchain>(space, sample));
+	    });
+	EXPECT_CALL(*callchainMock, addSample(_)).Times(AnyNumber());
+
+	std::vector<Sample> samples;
+	for (uintptr_t pc = 1; pc <= 5; ++pc)
+		samples.emplace_back(pmclog_ev_pcsample { .pl_pc = pc });
+
+	// The first four chains fill the table; the fifth evicts the two
+	// lightest, whose samples move to [other].
+	agg.addSample(mapper, samples[0], 10);
+	agg.addSample(mapper, samples[1], 5);
+	agg.addSample(mapper, samples[2], 3);
+	agg.addSample(mapper, samples[3], 1);
+	agg.addSample(mapper, samples[4], 1);
+
+	EXPECT_EQ(agg.getSampleCount(), 20);
+	EXPECT_EQ(agg.getOtherCount(), 4);
+	EXPECT_EQ(agg.getErrorBound(), 3);
+
+	CallchainList ccList;
+	agg.getCallchainList(ccList);
+
+	std::vector<size_t> counts;
+	for (const auto & rec : ccList)
+		counts.push_back(rec.chain->getSampleCount());
+	EXPECT_THAT(counts, UnorderedElementsAre(10, 5, 4, 1));
+}
+
+TEST(SampleAggregationTestSuite, TestBoundedHashCollision)
+{
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	SampleAggregation agg(ccFactory, store, "/usr/bin/jit", 158, false, 4);
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+
+	EXPECT_CALL(ccFactory, MakeCallchain(_, _, nullptr))
+	    .Times(2)
+	    .WillRepeatedly([](CallframeMapper &space, const Sample &sample,
+	        CallchainTrie *) {
+		return CallchainPtr(std::make_unique<Callchain>(space, sample));
+	    });
+	EXPECT_CALL(*callchainMock, addSample(_)).Times(AnyNumber());
+	EXPECT_CALL(mapper, getEpoch()).WillRepeatedly(Return(0));
+
+	Sample sample(pmclog_ev_pcsample { .pl_pc = 0x1000 });
+
+	// A chain whose hash is taken by another chain gets its own entry.
+	agg.addSample(mapper, sample, 3);
+	EXPECT_CALL(*callchainMock, matches(_))
+	    .WillOnce(Return(false))
+	    .WillRepeatedly(Return(true));
+	agg.addSample(mapper, sample, 4);
+	agg.addSample(mapper, sample, 5);
+
+	CallchainList ccList;
+	agg.getCallchainList(ccList);
+
+	std::vector<size_t> counts;
+	for (const auto & rec : ccList)
+		counts.push_back(rec.chain->getSampleCount());
+	EXPECT_THAT(counts, UnorderedElementsAre(8, 4));
+	EXPECT_EQ(store.size(), 0);
+}
+
+class SpillTestSuite : public ::testing::Test
+{
+protected:
+	MockCallchainFactory ccFactory;
+	CallchainStore store;
+	MockFrameMapper mapper;
+	GlobalMock<CallchainMocker> callchainMock;
+	uint64_t epoch = 0;
+
+	void SetUp() override
+	{
+		EXPECT_CALL(ccFactory, MakeCallchain(_, _, nullptr))
+		    .WillRepeatedly([](CallframeMapper &space,
+		        const Sample &sample, CallchainTrie *) {
+			return CallchainPtr(
+			    std::make_unique<Callchain>(space, sample));
+		    });
+		EXPECT_CALL(*callchainMock, addSample(_)).Times(AnyNumber());
+		EXPECT_CALL(*callchainMock, matches(_))
+		    .WillRepeatedly(Return(true));
+		EXPECT_CALL(mapper, getEpoch())
+		    .WillRepeatedly(ReturnPointee(&epoch));
+	}
+
+	// The bytes that one chain of a single frame is charged.
+	size_t getChainBytes()
+	{
+		SpillBudget probe(SIZE_MAX);
+		SampleAggregation agg(ccFactory, store, "/bin/sh", 1, false, 0,
+		    &probe);
+
+		agg.addSample(mapper, Sample(pmclog_ev_pcsample { .pl_pc = 1 }));
+		return probe.getUsed();
+	}
+
+	static size_t countChains(const SampleAggregation & agg)
+	{
+		CallchainList ccList;
+
+		agg.getCallchainList(ccList);
+		return ccList.size();
+	}
+};
+
+TEST_F(SpillTestSuite, TestSharedBudget)
+{
+	size_t chainBytes = getChainBytes();
+	SpillBudget budget(3 * chainBytes);
+	SampleAggregation big(ccFactory, store, "/bin/sh", 10, false, 0,
+	    &budget);
+	SampleAggregation small(ccFactory, store, "/bin/ls", 11, false, 0,
+	    &budget);
+
+	big.addSample(mapper, Sample(pmclog_ev_pcsample { .pl_pc = 0x1000 }));
+	big.addSample(mapper, Sample(pmclog_ev_pcsample { .pl_pc = 0x2000 }));
+	small.addSample(mapper, Sample(pmclog_ev_pcsample { .pl_pc = 0x3000 }));
+	EXPECT_EQ(budget.getUsed(), 3 * chainBytes);
+	EXPECT_EQ(countChains(big), 2);
+
+	// Neither aggregation is over the budget alone, but together they
+	// are.  Spilling the larger one is enough to get back under half.
+	big.addSample(mapper, Sample(pmclog_ev_pcsample { .pl_pc = 0x4000 }));
+	EXPECT_EQ(budget.getUsed(), chainBytes);
+	EXPECT_EQ(countChains(big), 0);
+	EXPECT_EQ(big.getCallchainBound(), 3);
+	EXPECT_EQ(countChains(small), 1);
+
+	// Spilling aggregations don't intern their chains.
+	EXPECT_EQ(store.size(), 0);
+}
+
+TEST_F(SpillTestSuite, TestSpillFinalChains)
+{
+	size_t chainBytes = getChainBytes();
+	SpillBudget budget(2 * chainBytes + chainBytes / 2);
+	SampleAggregation agg(ccFactory, store, "/bin/sh", 10, false, 0,
+	    &budget);
+	Sample sample(pmclog_ev_pcsample { .pl_pc = 0x1000 });
+
+	agg.addSample(mapper, sample);
+	agg.addSample(mapper, Sample(pmclog_ev_pcsample { .pl_pc = 0x2000 }));
+	agg.addSample(mapper, Sample(pmclog_ev_pcsample { .pl_pc = 0x3000 }));
+	EXPECT_EQ(budget.getUsed(), 0);
+	EXPECT_EQ(agg.getCallchainBound(), 3);
+
+	// The chain's image is mapped out, so its old frames become a final
+	// chain with the same key as its new ones.
+	agg.addSample(mapper, sample);
+	epoch = 1;
+	EXPECT_CALL(mapper, isStale(sample, 0)).WillOnce(Return(true));
+	EXPECT_CALL(*callchainMock, isMappedBy(_)).WillOnce(Return(false));
+	agg.addSample(mapper, sample);
+	EXPECT_EQ(countChains(agg), 2);
+	EXPECT_EQ(budget.getUsed(), 2 * chainBytes);
+
+	// Once some chains are spilled, finalizing spills the rest too.
+	agg.finalize();
+	EXPECT_EQ(countChains(agg), 0);
+	EXPECT_EQ(agg.getCallchainBound(), 5);
+	EXPECT_EQ(budget.getUsed(), 0);
+	EXPECT_EQ(agg.getSampleCount(), 5);
+}
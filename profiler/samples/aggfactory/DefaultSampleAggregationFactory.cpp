@@ -27,8 +27,12 @@
 #include "Sample.h"
 #include "SampleAggregation.h"
 
-DefaultSampleAggregationFactory::DefaultSampleAggregationFactory(CallchainFactory & factory)
-  : ccFactory(factory)
+DefaultSampleAggregationFactory::DefaultSampleAggregationFactory(CallchainFactory & factory,
+    bool trie, size_t maxChains, SpillBudget *spillBudget)
+  : ccFactory(factory),
+    useTrie(trie),
+    maxChains(maxChains),
+    spillBudget(spillBudget)
 {
 
 }
@@ -41,19 +45,19 @@ DefaultSampleAggregationFactory::~DefaultSampleAggregationFactory()
 SampleAggregation &
 DefaultSampleAggregationFactory::GetAggregation(const Sample &sample)
 {
-	auto it = aggregationMap.find(sample.getProcessID());
-	if (it != aggregationMap.end())
-		return *it->second;
+	LiveProcess & proc = aggregationMap[sample.getProcessID()];
+	if (proc.agg == nullptr)
+		proc.agg = &AddAggregation(sample.getProcessID(), proc.name);
 
-	return AddAggregation(sample.getProcessID(), "");
+	return *proc.agg;
 }
 
 SampleAggregation &
 DefaultSampleAggregationFactory::AddAggregation(pid_t pid, const std::string &name)
 {
-	auto ptr = std::make_unique<SampleAggregation>(ccFactory, name, pid);
+	auto ptr = std::make_unique<SampleAggregation>(ccFactory, chainStore,
+	    name, pid, useTrie, maxChains, spillBudget);
 	SampleAggregation & agg = *ptr;
-	aggregationMap[pid] = ptr.get();
 	aggregationOwnerList.push_back(std::move(ptr));
 
 	return agg;
@@ -62,16 +66,57 @@ DefaultSampleAggregationFactory::AddAggregation(pid_t pid, const std::string &na
 void
 DefaultSampleAggregationFactory::HandleExec(const ProcessExec & exec)
 {
-	AddAggregation(exec.getProcessID(), exec.getProcessName());
+	LiveProcess & proc = aggregationMap[exec.getProcessID()];
+
+	/* The old image will never be sampled again. */
+	if (proc.agg != nullptr)
+		proc.agg->finalize();
+
+	proc.name = exec.getProcessName();
+	proc.agg = nullptr;
+	proc.exited = false;
 }
 
 void
 DefaultSampleAggregationFactory::HandleMapIn(pid_t pid, const char *path)
 {
-	if (aggregationMap.count(pid) != 0)
+	auto it = aggregationMap.find(pid);
+	if (it != aggregationMap.end()) {
+		if (!it->second.exited)
+			return;
+
+		/* A new process has the pid; the old one is done for good. */
+		if (it->second.agg != nullptr)
+			it->second.agg->finalize();
+	}
+
+	aggregationMap[pid] = LiveProcess{path, nullptr};
+}
+
+void
+DefaultSampleAggregationFactory::HandleFork(pid_t parent, pid_t child)
+{
+	auto it = aggregationMap.find(parent);
+	if (it == aggregationMap.end())
+		return;
+
+	/* Adding the child may move the parent's entry. */
+	std::string name = it->second.name;
+
+	HandleExec(ProcessExec(child, name, 0));
+}
+
+void
+DefaultSampleAggregationFactory::HandleExit(pid_t pid)
+{
+	auto it = aggregationMap.find(pid);
+	if (it == aggregationMap.end())
 		return;
 
-	AddAggregation(pid, path);
+	/* Late samples are still added to the finalized aggregation. */
+	if (it->second.agg != nullptr)
+		it->second.agg->finalize();
+	it->second.exited = true;
 }
 
 void
@@ -80,6 +125,7 @@ DefaultSampleAggregationFactory::GetAggregationList(AggregationList &list)
 	for (const auto & agg : aggregationOwnerList) {
 		if (agg->getSampleCount() == 0)
 			continue;
+		agg->flushSpill();
 		list.push_back(agg.get());
 	}
 
@@ -0,0 +1,129 @@
+// Copyright (c) 2026 Ryan Stone.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+// OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+// SUCH DAMAGE.
+
+
+#include "DefaultSampleAggregationFactory.h"
+
+#include "Callchain.h"
+#include "Callframe.h"
+#include "CallframeMapper.h"
+#include "DefaultCallchainFactory.h"
+#include "ProcessState.h"
+#include "Sample.h"
+#include "SampleAggregation.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+
+using namespace testing;
+
+class TestMapper : public CallframeMapper
+{
+	std::map<TargetAddr, std::unique_ptr<Callframe>> frames;
+
+public:
+	const Callframe & mapFrame(TargetAddr addr) override
+	{
+		auto & frame = frames[addr];
+		if (!frame)
+			frame = std::make_unique<Callframe>(addr, "/bin/sh");
+		return *frame;
+	}
+
+	SharedString getExecutableName() const override
+	{
+		return "/bin/sh";
+	}
+};
+
+class DefaultSampleAggregationFactoryTestSuite : public ::testing::Test
+{
+public:
+	DefaultCallchainFactory ccFactory;
+	DefaultSampleAggregationFactory factory;
+	TestMapper mapper;
+
+	DefaultSampleAggregationFactoryTestSuite()
+	  : factory(ccFactory)
+	{
+	}
+
+	void AddSample(pid_t pid, uintptr_t pc)
+	{
+		Sample sample(pid, &pc, 1);
+
+		factory.GetAggregation(sample).addSample(mapper, sample);
+	}
+
+	AggregationList GetAggregations()
+	{
+		AggregationList list;
+
+		factory.GetAggregationList(list);
+		return list;
+	}
+};
+
+TEST_F(DefaultSampleAggregationFactoryTestSuite, TestSampleAfterExit)
+{
+	factory.HandleExec(ProcessExec(5, "/bin/sh", 0));
+	AddSample(5, 0x1001);
+	factory.HandleExit(5);
+
+	/* A sample that turns up after the exit joins the process's profile. */
+	AddSample(5, 0x1001);
+	AddSample(5, 0x2001);
+
+	AggregationList list = GetAggregations();
+	ASSERT_EQ(list.size(), 1);
+	EXPECT_EQ(list.front()->getDisplayName(), "/bin/sh (5)");
+	EXPECT_EQ(list.front()->getSampleCount(), 3);
+
+	/* Once the pid is reused, the new process has its own profile. */
+	factory.HandleMapIn(5, "/bin/ls");
+	AddSample(5, 0x1001);
+
+	list = GetAggregations();
+	ASSERT_EQ(list.size(), 2);
+	EXPECT_EQ(list.at(0)->getExecutable(), "/bin/sh");
+	EXPECT_EQ(list.at(0)->getSampleCount(), 3);
+	EXPECT_EQ(list.at(1)->getExecutable(), "/bin/ls");
+	EXPECT_EQ(list.at(1)->getSampleCount(), 1);
+}
+
+TEST_F(DefaultSampleAggregationFactoryTestSuite, TestSampleAfterUnsampledExit)
+{
+	factory.HandleExec(ProcessExec(5, "/bin/sh", 0));
+	factory.HandleExit(5);
+
+	/* The first sample of a process can also turn up after its exit. */
+	AddSample(5, 0x1001);
+	AddSample(5, 0x1001);
+
+	AggregationList list = GetAggregations();
+	ASSERT_EQ(list.size(), 1);
+	EXPECT_EQ(list.front()->getExecutable(), "/bin/sh");
+	EXPECT_EQ(list.front()->getSampleCount(), 2);
+}
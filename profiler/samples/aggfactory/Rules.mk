@@ -4,3 +4,18 @@ LIB :=	aggfactory
 SRCS :=	\
 	DefaultSampleAggregationFactory.cpp \
 
+
+TESTS := \
+	DefaultSampleAggregationFactory \
+
+TEST_DEFAULTSAMPLEAGGREGATIONFACTORY_SRCS := \
+	DefaultSampleAggregationFactory.cpp \
+
+TEST_DEFAULTSAMPLEAGGREGATIONFACTORY_LIBS := \
+	samples \
+	callchainFactory \
+	frame \
+	sharedptr \
+
+TEST_DEFAULTSAMPLEAGGREGATIONFACTORY_STDLIBS := \
+	gmock \
@@ -42,15 +42,36 @@ DefaultAddressSpaceFactory::GetProcessAddressSpace(pid_t pid)
 		return *it->second;
 
 	auto space = std::make_unique<AddressSpace>(imgFactory);
-	auto inserted = addressSpaceMap.insert(std::make_pair(pid, space.get()));
-	addressSpaceList.push_back(std::move(space));
+	auto inserted = addressSpaceMap.insert(std::make_pair(pid, std::move(space)));
 	return *inserted.first->second;
 }
 
 AddressSpace &
 DefaultAddressSpaceFactory::ReplaceAddressSpace(pid_t pid)
 {
+	/*
+	 * Callchains only keep the executable name of the space that they were
+	 * resolved against, so the old space can be freed here.
+	 */
 	addressSpaceMap.erase(pid);
 
 	return GetProcessAddressSpace(pid);
+}
+
+AddressSpace &
+DefaultAddressSpaceFactory::ForkAddressSpace(pid_t parent, pid_t child)
+{
+	AddressSpace & space = ReplaceAddressSpace(child);
+
+	auto it = addressSpaceMap.find(parent);
+	if (it != addressSpaceMap.end())
+		space.forkFrom(*it->second);
+
+	return space;
+}
+
+void
+DefaultAddressSpaceFactory::ReleaseAddressSpace(pid_t pid)
+{
+	addressSpaceMap.erase(pid);
 }
\ No newline at end of file
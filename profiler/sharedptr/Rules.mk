@@ -3,14 +3,26 @@ LIB:= sharedptr
 
 SRCS=	\
 	SharedString.cpp \
+	StringIdTable.cpp \
 
 TESTS := \
 	SharedPtr \
 	SharedString \
+	StringIdTable \
+
+TEST_SHAREDPTR_STDLIBS= \
+	pthread \
 
 TEST_SHAREDSTRING_SRCS= \
 	SharedString.cpp \
 
+TEST_SHAREDSTRING_STDLIBS= \
+	pthread \
+
 TEST_SHAREDSTRING_WRAPFUNCS= \
 	_Znwm=mock_new \
 	_ZdlPv=mock_delete \
+
+TEST_STRINGIDTABLE_SRCS= \
+	SharedString.cpp \
+	StringIdTable.cpp \
@@ -28,6 +28,8 @@
 #include "TestPrinter/SharedPtr.h"
 
 #include <map>
+#include <thread>
+#include <vector>
 
 class TargetClass
 {
@@ -287,3 +289,55 @@ TEST(SharedPtrTestSuite, TestMoveAssignFromNull)
 	third = TargetPtr();
 	ASSERT_TRUE(!third);
 }
+
+TEST(SharedPtrTestSuite, TestUnique)
+{
+	TargetPtr first;
+
+	ASSERT_FALSE(first.unique());
+
+	first = TargetPtr::make(3, 4);
+	ASSERT_TRUE(first.unique());
+
+	{
+		TargetPtr second(first);
+		ASSERT_FALSE(first.unique());
+		ASSERT_FALSE(second.unique());
+	}
+	ASSERT_TRUE(first.unique());
+
+	SharedPtr<TargetClass, AtomicRefCount> atomic(
+	    SharedPtr<TargetClass, AtomicRefCount>::make(5, 6));
+	ASSERT_TRUE(atomic.unique());
+	auto copy = atomic;
+	ASSERT_FALSE(atomic.unique());
+	copy.clear();
+	ASSERT_TRUE(atomic.unique());
+}
+
+TEST(SharedPtrTestSuite, TestConcurrentCopies)
+{
+	typedef SharedPtr<TargetClass, AtomicRefCount> AtomicPtr;
+	const int threads = 8;
+	const int copies = 10000;
+	std::vector<std::thread> workers;
+
+	AtomicPtr ptr(AtomicPtr::make(32, 18));
+	auto * target = ptr.get();
+
+	for (int t = 0; t < threads; ++t) {
+		workers.emplace_back([ptr, copies] () {
+			for (int i = 0; i < copies; ++i) {
+				AtomicPtr copy(ptr);
+				EXPECT_EQ(copy->getX(), 32);
+			}
+		});
+	}
+
+	// The last reference may now be dropped by any of the workers.
+	ptr.clear();
+	for (auto & thread : workers)
+		thread.join();
+
+	ASSERT_TRUE(!TargetClass::IsAllocated(target));
+}
@@ -23,15 +23,60 @@
 
 #include "SharedString.h"
 
+/*
+ * The table is never destroyed, as SharedStrings with static storage
+ * duration may outlive any static table.
+ */
+template <typename RefCount>
+typename BasicSharedString<RefCount>::Interned &
+BasicSharedString<RefCount>::GetInterned()
+{
+	static Interned *interned = new Interned;
+
+	return *interned;
+}
 
+template <typename RefCount>
 void
-SharedString::Init(const char *str)
+BasicSharedString<RefCount>::Init(const char *str)
 {
-	value = new StringValue(str);
+	Interned & interned = GetInterned();
+	std::string_view text(str);
+	std::lock_guard<typename RefCount::Mutex> guard(interned.lock);
+
+	auto it = interned.table.find(text);
+	if (it != interned.table.end()) {
+		/*
+		 * A value whose last reference was just dropped is on its way
+		 * to Destroy() and must not be revived; replace it instead.
+		 */
+		if (it->second->count.tryRef()) {
+			value = it->second;
+			return;
+		}
+		interned.table.erase(it);
+	}
+
+	/* The key refers to the value's own copy of the text. */
+	value = new StringValue(text, std::hash<std::string_view>()(text));
+	interned.table.emplace(value->str, value);
 }
 
+template <typename RefCount>
 void
-SharedString::Destroy(StringValue *str)
+BasicSharedString<RefCount>::Destroy(StringValue *str)
 {
+	Interned & interned = GetInterned();
+
+	{
+		std::lock_guard<typename RefCount::Mutex> guard(interned.lock);
+
+		auto it = interned.table.find(str->str);
+		if (it != interned.table.end() && it->second == str)
+			interned.table.erase(it);
+	}
 	delete str;
 }
+
+template class BasicSharedString<SingleThreadRefCount>;
+template class BasicSharedString<AtomicRefCount>;
@@ -30,13 +30,18 @@
 
 #include <new>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 typedef std::map<const void *, size_t> AllocMap;
 static AllocMap ranges;
+static std::mutex rangesLock;
 
 extern "C" void * mock_new(size_t sz)
 {
 	void * ptr = operator new(sz);;
+	std::lock_guard<std::mutex> guard(rangesLock);
 
 	try {
 		ranges.insert(std::make_pair(ptr, sz));
@@ -50,7 +55,9 @@ extern "C" void * mock_new(size_t sz)
 
 extern "C" void mock_delete(void * ptr)
 {
+	std::unique_lock<std::mutex> guard(rangesLock);
 	ranges.erase(ptr);
+	guard.unlock();
 	::operator delete(ptr);
 }
 
@@ -213,3 +220,57 @@ TEST(SharedStringTestSuite, TestHasher)
 	ASSERT_EQ(sharedHash(second), strHash(second));
 	ASSERT_EQ(sharedHash(empty), strHash(empty));
 }
+
+TEST(SharedStringTestSuite, TestInterning)
+{
+	std::string text("interned");
+	const std::string * data;
+
+	{
+		SharedString first(text);
+		SharedString second(text.c_str());
+
+		// Equal strings share one value, however they were made.
+		ASSERT_EQ(&*first, &*second);
+		ASSERT_EQ(first, second);
+		ASSERT_NE(first, SharedString("Interned"));
+
+		data = &*first;
+		ASSERT_TRUE(IsAllocated(data));
+	}
+
+	// Once the last reference is gone, a new value is made when the text
+	// is seen again.
+	SharedString third(text);
+	ASSERT_EQ(*third, text);
+	ASSERT_TRUE(IsAllocated(&*third));
+}
+
+TEST(SharedStringTestSuite, TestConcurrentInterning)
+{
+	const int threads = 8;
+	const int rounds = 5000;
+	std::vector<ConcurrentSharedString> kept(threads);
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < threads; ++t) {
+		workers.emplace_back([&kept, t, rounds] () {
+			// Strings are constantly created and released, so values
+			// are racing between being found and being destroyed.
+			for (int i = 0; i < rounds; ++i) {
+				ConcurrentSharedString str(std::to_string(i % 7));
+				EXPECT_EQ(*str, std::to_string(i % 7));
+			}
+			kept.at(t) = ConcurrentSharedString("kept");
+		});
+	}
+
+	for (auto & thread : workers)
+		thread.join();
+
+	for (int t = 1; t < threads; ++t) {
+		ASSERT_EQ(kept.at(t), kept.at(0));
+		ASSERT_EQ(&*kept.at(t), &*kept.at(0));
+	}
+	ASSERT_EQ(*kept.at(0), "kept");
+}